@@ -8,6 +8,7 @@
 #include <string.h>
 #include "symbol_table.hpp"
 #include "types.hpp"
+#include "fn_cache.hpp"
 
 namespace drewgon{
 
@@ -16,6 +17,7 @@ class Procedure;
 class IRProgram;
 class ControlFlowGraph;
 class ASTNode;
+class VMBuilder;
 
 class Label{
 public:
@@ -57,8 +59,8 @@ public:
 			case B: return "%rbx";
 			case C: return "%rcx";
 			case D: return "%rdx";
-			case E: return "%r08";
-			case F: return "%r09";
+			case E: return "%r8";
+			case F: return "%r9";
 			case SI: return "%rsi";
 			case DI: return "%rdi";
 		}
@@ -73,7 +75,7 @@ public:
 			case D: return "%dl";
 			case E: return "%r8b";
 			case F: return "%r9b";
-			case SI: return "%bil";
+			case SI: return "%sil";
 			case DI: return "%dil";
 		}
 		throw new InternalError("no such register");
@@ -83,6 +85,7 @@ public:
 class Opd{
 public:
 	Opd(size_t widthIn) : myWidth(widthIn){}
+	virtual ~Opd(){ }
 	virtual std::string valString() = 0;
 	virtual std::string locString() = 0;
 	virtual size_t getWidth(){ return myWidth; }
@@ -121,8 +124,8 @@ public:
 	virtual std::string getMemoryLoc() = 0;
 private:
 	size_t myWidth;
-	bool isGlobal;
-	bool isString;
+	bool isGlobal = false;
+	bool isString = false;
 };
 
 class SymOpd : public Opd{
@@ -281,14 +284,18 @@ enum UnaryOp{
 class Quad{
 public:
 	Quad();
+	virtual ~Quad(){ }
 	void addLabel(Label * label);
 	Label * getLabel(){ return labels.front(); }
+	const std::list<Label *>& getLabels(){ return labels; }
 	void clearLabels(){ labels.clear(); }
 	virtual std::string repr() = 0;
 	std::string commentStr();
 	virtual std::string toString(bool verbose=false);
+	void print(std::ostream& out, bool verbose=false);
 	void setComment(std::string commentIn);
 	virtual void codegenX64(std::ostream& out) = 0;
+	virtual void toVM(VMBuilder& vm) = 0;
 	void codegenLabels(std::ostream& out);
 private:
 	std::string myComment;
@@ -301,6 +308,7 @@ public:
 	std::string repr() override;
 	static std::string oprString(BinOp opr);
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 	Opd * getDst(){ return dst; }
 	Opd * getSrc1(){ return src1; }
 	Opd * getSrc2(){ return src2; }
@@ -317,6 +325,7 @@ public:
 	UnaryOpQuad(Opd * dstIn, UnaryOp opIn, Opd * srcIn);
 	std::string repr() override ;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 	Opd * getDst(){ return dst; }
 	Opd * getSrc(){ return src; }
 	UnaryOp getOp(){ return op; }
@@ -332,6 +341,7 @@ public:
 	AssignQuad(Opd * dstIn, Opd * srcIn, bool isRecord);
 	std::string repr() override;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 	Opd * getDst(){ return dst; }
 	Opd * getSrc(){ return src; }
 private:
@@ -347,6 +357,7 @@ public:
 	: src(srcIn), tgt(tgtIn), srcIsLoc(srcLocIn), tgtIsLoc(tgtLocIn){ }
 	std::string repr() override;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 private:
 	Opd * src;
 	Opd * tgt;
@@ -359,6 +370,7 @@ public:
 	GotoQuad(Label * tgtIn);
 	std::string repr() override;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 	Label * getTarget(){ return tgt; }
 private:
 	Label * tgt;
@@ -371,6 +383,7 @@ public:
 	Label * getTarget(){ return tgt; }
 	Opd * getCnd(){ return cnd; }
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 private:
 	Opd * cnd;
 	Label * tgt;
@@ -381,6 +394,7 @@ public:
 	NopQuad();
 	std::string repr() override;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 };
 
 class IntrinsicOutputQuad : public Quad {
@@ -390,6 +404,7 @@ public:
 	Opd * getSrc(){ return myArg; }
 	const DataType * getType(){ return myType; }
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 private:
 	Opd * myArg;
 	const DataType * myType;
@@ -400,7 +415,9 @@ public:
 	IntrinsicInputQuad(Opd * arg, const DataType * type);
 	std::string repr() override;
 	Opd * getDst(){ return myArg; }
+	const DataType * getType(){ return myType; }
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 private:
 	Opd * myArg;
 	const DataType * myType;
@@ -412,17 +429,23 @@ public:
 	std::string repr() override;
 	Opd * getDst(){ return myDst; }
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 private:
 	Opd * myDst;
 };
 
 class CallQuad : public Quad{
 public:
-	CallQuad(SemSymbol * calleeIn);
+	//ptrIn is the callee's operand if it is a variable of
+	// function type, rather than a function
+	CallQuad(SemSymbol * calleeIn, Opd * ptrIn = nullptr);
 	std::string repr() override;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
+	SemSymbol * getCallee(){ return callee; }
 private:
 	SemSymbol * callee;
+	Opd * ptr;
 };
 
 class EnterQuad : public Quad{
@@ -430,6 +453,7 @@ public:
 	EnterQuad(Procedure * proc);
 	virtual std::string repr() override;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 private:
 	Procedure * myProc;
 };
@@ -439,6 +463,7 @@ public:
 	LeaveQuad(Procedure * proc);
 	virtual std::string repr() override;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 private:
 	Procedure * myProc;
 };
@@ -448,6 +473,7 @@ public:
 	SetArgQuad(size_t indexIn, Opd * opdIn, const DataType * typeIn);
 	std::string repr() override;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 	Opd * getSrc(){ return opd; }
 	size_t getIndex(){ return index; }
 	const DataType * getType(){ return type; }
@@ -459,13 +485,18 @@ private:
 
 class GetArgQuad : public Quad{
 public:
-	GetArgQuad(size_t indexIn, Opd * opdIn, bool isRecord);
+	//numArgsIn is how many arguments the procedure takes
+	GetArgQuad(size_t indexIn, size_t numArgsIn, Opd * opdIn,
+	  bool isRecord);
 	std::string repr() override;
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 	Opd * getDst(){ return opd; }
+	size_t getIndex(){ return index; }
 	bool isRecord(){ return myIsRecord; }
 private:
 	size_t index;
+	size_t numArgs;
 	Opd * opd;
 	bool myIsRecord;
 };
@@ -477,6 +508,7 @@ public:
 	Opd * getSrc(){ return opd; }
 	bool isRecord(){ return myIsRecord; }
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 private:
 	Opd * opd;
 	const bool myIsRecord;
@@ -488,6 +520,7 @@ public:
 	std::string repr() override;
 	Opd * getDst(){ return opd; }
 	void codegenX64(std::ostream& out) override;
+	void toVM(VMBuilder& vm) override;
 	bool isRecord(){ return myIsRecord; }
 private:
 	Opd * opd;
@@ -497,6 +530,7 @@ private:
 class Procedure{
 public:
 	Procedure(IRProgram * prog, std::string name);
+	~Procedure();
 	void addQuad(Quad * quad);
 	Quad * popQuad();
 	IRProgram * getProg();
@@ -507,6 +541,11 @@ public:
 		return *itr;
 	}
 	drewgon::Label * makeLabel();
+	Opd * makeString(std::string val);
+	LitOpd * makeLit(std::string val, size_t width);
+	std::list<std::pair<LitOpd *, std::string>> getStrings(){
+		return strings;
+	}
 
 	void gatherLocal(SemSymbol * sym);
 	void gatherFormal(SemSymbol * sym);
@@ -515,6 +554,7 @@ public:
 	AddrOpd * makeAddrOpd(size_t width);
 
 	std::string toString(bool verbose=false);
+	void print(std::ostream& out, bool verbose=false);
 	std::string getName();
 
 	drewgon::Label * getLeaveLabel();
@@ -528,6 +568,15 @@ public:
 	LeaveQuad * getLeave(){ return leave; }
 	void replaceQuad(Quad * oldQuad, Quad * newQuad);
 
+	//A procedure can be backed by a function cache entry, in
+	// which case its quads are never built and its 3AC and
+	// x64 text come straight from the entry.
+	void setCacheKey(std::string key){ cacheKey = key; }
+	std::string getCacheKey(){ return cacheKey; }
+	void useCached(CachedFn * fn);
+	bool isCached(){ return cached != nullptr; }
+	CachedFn toCached(const std::string& x64);
+
 private:
 	void allocLocals();
 
@@ -541,19 +590,26 @@ private:
 	std::list<SymOpd *> formals;
 	std::list<AddrOpd *> addrOpds;
 	std::list<Quad *> * bodyQuads;
+	std::list<std::pair<LitOpd *, std::string>> strings;
+	std::list<LitOpd *> lits;
+	std::list<Label *> labels;
 	std::string myName;
 	size_t maxTmp;
+	size_t maxLabel = 0;
+	std::string cacheKey;
+	CachedFn * cached = nullptr;
 };
 
 class IRProgram{
 public:
-	IRProgram(TypeAnalysis * taIn) : ta(taIn){
+	IRProgram(TypeAnalysis * taIn, FnCache * cacheIn)
+	: ta(taIn), cache(cacheIn){
 		procs = new std::list<Procedure *>();
 	}
+	~IRProgram();
 	Procedure * makeProc(std::string name);
 	std::list<Procedure *> * getProcs();
-	Label * makeLabel();
-	Opd * makeString(std::string val);
+	FnCache * getCache(){ return cache; }
 	void gatherGlobal(SemSymbol * sym);
 	SymOpd * getGlobal(SemSymbol * sym);
 	size_t opWidth(ASTNode * node);
@@ -561,14 +617,13 @@ public:
 	std::set<Opd *> globalSyms();
 
 	std::string toString(bool verbose=false);
+	void print(std::ostream& out, bool verbose=false);
 
 	void toX64(std::ostream& out);
 private:
 	TypeAnalysis * ta;
-	size_t max_label = 0;
-	size_t str_idx = 0;
+	FnCache * cache;
 	std::list<Procedure *> * procs;
-	HashMap<LitOpd *, std::string> strings;
 	std::map<SemSymbol *, SymOpd *> globals;
 
 	void datagenX64(std::ostream& out);
@@ -1,26 +1,28 @@
 #include "ast.hpp"
+#include "timing.hpp"
 
 namespace drewgon{
 
-IRProgram * ProgramNode::to3AC(TypeAnalysis * ta){
-	IRProgram * prog = new IRProgram(ta);
-	for (auto global : *myGlobals){
+IRProgram * ProgramNode::to3AC(TypeAnalysis * ta, FnCache * cache){
+	IRProgram * prog = new IRProgram(ta, cache);
+	for (auto global : myGlobals){
 		global->to3AC(prog);
 	}
 	return prog;
 }
 
 static void formalsTo3AC(Procedure * proc,
-  std::list<FormalDeclNode *> * myFormals){
-	for (auto formal : *myFormals){
+  const Span<FormalDeclNode *>& myFormals){
+	for (auto formal : myFormals){
 		formal->to3AC(proc);
 	}
 	unsigned int argIdx = 1;
-	for (auto formal : *myFormals){
+	for (auto formal : myFormals){
 		SemSymbol * sym = formal->ID()->getSymbol();
 		SymOpd * opd = proc->getSymOpd(sym);
 
-		Quad * inQuad = new GetArgQuad(argIdx, opd, false);
+		Quad * inQuad = new GetArgQuad(argIdx, myFormals.size(), opd,
+		  false);
 		proc->addQuad(inQuad);
 		argIdx += 1;
 	}
@@ -28,16 +30,35 @@ static void formalsTo3AC(Procedure * proc,
 
 void FnDeclNode::to3AC(IRProgram * prog){
 	SemSymbol * mySym = this->ID()->getSymbol();
-	Procedure * proc = prog->makeProc(mySym->getName());
+	PhaseTimer timer("function", mySym->getName());
 
 	//Put the function itself into global scope
 	// for function pointers
 	prog->gatherGlobal(mySym);
 
+	//The function's text after name analysis has the type of
+	// every identifier in it, so if it is unchanged then so is
+	// everything it uses, and its cached code is still good.
+	std::string cacheKey;
+	FnCache * cache = prog->getCache();
+	if (cache != nullptr){
+		std::ostringstream text;
+		this->unparse(text, 0);
+		cacheKey = text.str();
+		CachedFn * hit = cache->lookup(cacheKey);
+		if (hit != nullptr){
+			prog->makeProc(mySym->getName())->useCached(hit);
+			return;
+		}
+	}
+
+	Procedure * proc = prog->makeProc(mySym->getName());
+	proc->setCacheKey(cacheKey);
+
 	//Generate the getin quads
 	formalsTo3AC(proc, myFormals);
 
-	for (auto stmt : *myBody){
+	for (auto stmt : body()){
 		stmt->to3AC(proc);
 	}
 }
@@ -67,11 +88,11 @@ void FormalDeclNode::to3AC(Procedure * proc){
 }
 
 Opd * IntLitNode::flatten(Procedure * proc){
-	return LitOpd::buildInt(myNum);
+	return proc->makeLit(std::to_string(myNum), 8);
 }
 
 Opd * StrLitNode::flatten(Procedure * proc){
-	Opd * res = proc->getProg()->makeString(myStr);
+	Opd * res = proc->makeString(str());
 	return res;
 }
 
@@ -82,13 +103,13 @@ Opd * MayhemNode::flatten(Procedure * proc){
 }
 
 Opd * TrueNode::flatten(Procedure * proc){
-	Opd * res = new LitOpd("1", 8);
+	Opd * res = proc->makeLit("1", 8);
 	return res;
 }
 
 
 Opd * FalseNode::flatten(Procedure * proc){
-	Opd * res = new LitOpd("0", 8);
+	Opd * res = proc->makeLit("0", 8);
 	return res;
 }
 
@@ -110,9 +131,9 @@ Opd * AssignExpNode::flatten(Procedure * proc){
 	return lhs;
 }
 
-static void argsTo3AC(Procedure * proc, std::list<ExpNode *> * args){
+static void argsTo3AC(Procedure * proc, const Span<ExpNode *>& args){
 	std::list<std::pair<Opd *, const DataType *>> argOpds;
-	for (auto argNode : *args){
+	for (auto argNode : args){
 		Opd * argOpd = argNode->flatten(proc);
 		const DataType * argType = proc->getProg()->nodeType(argNode);
 		argOpds.push_back(std::make_pair(argOpd, argType));
@@ -127,10 +148,12 @@ static void argsTo3AC(Procedure * proc, std::list<ExpNode *> * args){
 
 Opd * CallExpNode::flatten(Procedure * proc){
 	argsTo3AC(proc, myArgs);
-	Quad * callQuad = new CallQuad(myID->getSymbol());
+	SemSymbol * idSym = myID->getSymbol();
+	Opd * ptr = nullptr;
+	if (idSym->getKind() == VAR){ ptr = proc->getSymOpd(idSym); }
+	Quad * callQuad = new CallQuad(idSym, ptr);
 	proc->addQuad(callQuad);
 
-	SemSymbol * idSym = myID->getSymbol();
 	const FnType * calleeType = idSym->getDataType()->asFn();
 	const DataType * retType = calleeType->getReturnType();
 	if (retType->isVoid()){
@@ -328,7 +351,7 @@ void PostIncStmtNode::to3AC(Procedure * proc){
 	size_t width = proc->getProg()->opWidth(this->myID);
 	BinOp opr = BinOp::ADD64;
 	if (width == 1){ opr = BinOp::ADD8; }
-	LitOpd * litOpd = new LitOpd("1", width);
+	LitOpd * litOpd = proc->makeLit("1", width);
 	BinOpQuad * quad = new BinOpQuad(child, opr, child, litOpd);
 	proc->addQuad(quad);
 }
@@ -338,7 +361,7 @@ void PostDecStmtNode::to3AC(Procedure * proc){
 	size_t width = proc->getProg()->opWidth(this->myID);
 	BinOp opr = BinOp::SUB64;
 	if (width == 1){ opr = BinOp::SUB8; }
-	LitOpd * litOpd = new LitOpd("1", width);
+	LitOpd * litOpd = proc->makeLit("1", width);
 	BinOpQuad * quad = new BinOpQuad(child, opr, child, litOpd);
 	proc->addQuad(quad);
 }
@@ -362,7 +385,7 @@ void IfStmtNode::to3AC(Procedure * proc){
 	afterNop->addLabel(afterLabel);
 
 	proc->addQuad(new IfzQuad(cond, afterLabel));
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->to3AC(proc);
 	}
 	proc->addQuad(afterNop);
@@ -380,7 +403,7 @@ void IfElseStmtNode::to3AC(Procedure * proc){
 
 	Quad * jmpFalse = new IfzQuad(cond, elseLabel);
 	proc->addQuad(jmpFalse);
-	for (auto stmt : *myBodyTrue){
+	for (auto stmt : myBodyTrue){
 		stmt->to3AC(proc);
 	}
 
@@ -389,7 +412,7 @@ void IfElseStmtNode::to3AC(Procedure * proc){
 
 	proc->addQuad(elseNop);
 
-	for (auto stmt : *myBodyFalse){
+	for (auto stmt : myBodyFalse){
 		stmt->to3AC(proc);
 	}
 
@@ -410,7 +433,7 @@ void WhileStmtNode::to3AC(Procedure * proc){
 	Quad * jmpFalse = new IfzQuad(cond, afterLabel);
 	proc->addQuad(jmpFalse);
 
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->to3AC(proc);
 	}
 
@@ -434,7 +457,7 @@ void ForStmtNode::to3AC(Procedure * proc){
 	Quad * jmpFalse = new IfzQuad(cond, afterLabel);
 	proc->addQuad(jmpFalse);
 
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->to3AC(proc);
 	}
 	myItr->to3AC(proc);
@@ -452,10 +475,8 @@ void CallStmtNode::to3AC(Procedure * proc){
 	// was unnecessary. Remove it from the procedure.
 	if (res != nullptr){
 		//A void call will not generate a getout
-		Quad * last = proc->popQuad();
+		delete proc->popQuad();
 	}
-	//Should probably delete the last quad, but
-	// we've leaked so much memory why start worrying now?
 }
 
 void ReturnStmtNode::to3AC(Procedure * proc){
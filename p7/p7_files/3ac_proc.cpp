@@ -1,5 +1,6 @@
 #include "3ac.hpp"
 #include <algorithm>
+#include <sstream>
 
 namespace drewgon{
 
@@ -10,14 +11,32 @@ Procedure::Procedure(IRProgram * prog, std::string name)
 	leave = new LeaveQuad(this);
 	bodyQuads = new std::list<Quad *>();
 	if (myName.compare("main") == 0){
-		enter->addLabel(new Label("main"));
+		labels.push_back(new Label("main"));
 	} else {
-		enter->addLabel(new Label("fun_" + myName));
+		labels.push_back(new Label("fun_" + myName));
 	}
-	leaveLabel = myProg->makeLabel();
+	enter->addLabel(labels.back());
+	leaveLabel = makeLabel();
 	leave->addLabel(leaveLabel);
 }
 
+//A procedure owns its quads and everything they refer to but
+// the globals, which belong to the program
+Procedure::~Procedure(){
+	delete enter;
+	delete leave;
+	for (Quad * quad : *bodyQuads){ delete quad; }
+	delete bodyQuads;
+	for (Label * label : labels){ delete label; }
+	for (auto local : locals){ delete local.second; }
+	for (AuxOpd * tmp : temps){ delete tmp; }
+	for (SymOpd * formal : formals){ delete formal; }
+	for (AddrOpd * loc : addrOpds){ delete loc; }
+	for (auto str : strings){ delete str.first; }
+	for (LitOpd * lit : lits){ delete lit; }
+	delete cached;
+}
+
 std::string Procedure::getName(){
 	return myName;
 }
@@ -29,43 +48,92 @@ Label * Procedure::getLeaveLabel(){
 IRProgram * Procedure::getProg(){ return myProg; }
 
 std::string Procedure::toString(bool verbose){
-	std::string res = "";
+	std::ostringstream res;
+	print(res, verbose);
+	return res.str();
+}
+
+void Procedure::print(std::ostream& out, bool verbose){
+	if (cached != nullptr){
+		out << cached->threeAC;
+		return;
+	}
 
-	res += "[BEGIN " + this->getName() + " LOCALS]\n";
+	out << "[BEGIN " << this->getName() << " LOCALS]\n";
 	for (const auto formal : this->formals){
-		res += formal->getName() + " (formal arg of "
-			+ std::to_string(formal->getWidth())
-			+ " bytes)\n";
+		out << formal->getName() << " (formal arg of "
+			<< formal->getWidth()
+			<< " bytes)\n";
 	}
 
 	for (auto local : this->locals){
-		res += local.second->getName() + " (local var of "
-			+ std::to_string(local.second->getWidth())
-			+ " bytes)\n";
+		out << local.second->getName() << " (local var of "
+			<< local.second->getWidth()
+			<< " bytes)\n";
 	}
 
 	for (auto tmp : temps){
-		res += tmp->locString() + " (tmp var of "
-			+ std::to_string(tmp->getWidth())
-			+ " bytes)\n";
+		out << tmp->locString() << " (tmp var of "
+			<< tmp->getWidth()
+			<< " bytes)\n";
 	}
 	for (auto loc : this->addrOpds){
-		res += loc->locString() + " (tmp loc of "
-			+ std::to_string(loc->getWidth())
-			+ " bytes)\n";
+		out << loc->locString() << " (tmp loc of "
+			<< loc->getWidth()
+			<< " bytes)\n";
 	}
-	res += "[END " + this->getName() + " LOCALS]\n";
+	out << "[END " << this->getName() << " LOCALS]\n";
 
-	res += enter->toString(verbose) + "\n";
+	enter->print(out, verbose);
+	out << "\n";
 	for (auto quad : *bodyQuads){
-		res += quad->toString(verbose) + "\n";
+		quad->print(out, verbose);
+		out << "\n";
 	}
-	res += leave->toString(verbose) + "\n";
-	return res;
+	leave->print(out, verbose);
+	out << "\n";
 }
 
+//Labels and strings are numbered per procedure, and carry its
+// name, so that a procedure's code doesn't depend on what came
+// before it in the program (see FnCache)
 Label * Procedure::makeLabel(){
-	return myProg->makeLabel();
+	labels.push_back(
+	  new Label("lbl_" + myName + "_" + std::to_string(maxLabel++)));
+	return labels.back();
+}
+
+Opd * Procedure::makeString(std::string val){
+	std::string name = "str_" + myName + "_"
+		+ std::to_string(strings.size());
+	LitOpd * opd = new LitOpd(name, 8);
+	strings.push_back(std::make_pair(opd, val));
+	return opd;
+}
+
+LitOpd * Procedure::makeLit(std::string val, size_t width){
+	LitOpd * opd = new LitOpd(val, width);
+	lits.push_back(opd);
+	return opd;
+}
+
+void Procedure::useCached(CachedFn * fn){
+	cached = fn;
+	for (auto str : fn->strings){
+		strings.push_back(std::make_pair(new LitOpd(str.first, 8),
+		  str.second));
+	}
+}
+
+CachedFn Procedure::toCached(const std::string& x64){
+	CachedFn fn;
+	fn.threeAC = toString();
+	fn.x64 = x64;
+	for (auto str : strings){
+		fn.strings.push_back(std::make_pair(str.first->valString(),
+		  str.second));
+	}
+	return fn;
 }
 
 void Procedure::addQuad(Quad * quad){
@@ -1,5 +1,6 @@
 #include "3ac.hpp"
 #include "vector"
+#include <sstream>
 #include "type_analysis.hpp"
 
 namespace drewgon {
@@ -10,6 +11,12 @@ Procedure * IRProgram::makeProc(std::string name){
 	return proc;
 }
 
+IRProgram::~IRProgram(){
+	for (Procedure * proc : *procs){ delete proc; }
+	delete procs;
+	for (auto global : globals){ delete global.second; }
+}
+
 std::list<Procedure *> * IRProgram::getProcs(){
 	return procs;
 }
@@ -22,11 +29,6 @@ size_t IRProgram::opWidth(ASTNode * node){
 	return Opd::width(nodeType(node));
 }
 
-Label * IRProgram::makeLabel(){
-	Label * label = new Label("lbl_" + std::to_string(max_label++));
-	return label;
-}
-
 SymOpd * IRProgram::getGlobal(SemSymbol * sym){
 	if (globals.find(sym) != globals.end()){
 		return globals[sym];
@@ -40,31 +42,30 @@ void IRProgram::gatherGlobal(SemSymbol * sym){
 	globals[sym] = res;
 }
 
-Opd * IRProgram::makeString(std::string val){
-	std::string name = "str_" + std::to_string(str_idx++);
-	LitOpd * opd = new LitOpd(name, 8);
-	strings[opd] = val;
-	return opd;
+std::string IRProgram::toString(bool verbose){
+	std::ostringstream res;
+	print(res, verbose);
+	return res.str();
 }
 
-std::string IRProgram::toString(bool verbose){
-	std::string res = "";
-	res += "[BEGIN GLOBALS]\n";
+void IRProgram::print(std::ostream& out, bool verbose){
+	out << "[BEGIN GLOBALS]\n";
 	for (auto entry : globals){
-		res += entry.second->getName() + "\n";
+		out << entry.second->getName() << "\n";
 	}
-	for (auto entry : strings){
-		res += entry.first->valString();
-		res += " " + entry.second;
-		res += "\n";
+	for (Procedure * proc : *procs){
+		for (auto entry : proc->getStrings()){
+			out << entry.first->valString();
+			out << " " << entry.second;
+			out << "\n";
+		}
 	}
 
-	res += "[END GLOBALS]\n";
+	out << "[END GLOBALS]\n";
 
 	for (Procedure * proc : *procs){
-		res += proc->toString(verbose);
+		proc->print(out, verbose);
 	}
-	return res;
 }
 
 std::set<Opd *> IRProgram::globalSyms(){
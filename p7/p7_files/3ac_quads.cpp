@@ -1,3 +1,4 @@
+#include <sstream>
 #include "3ac.hpp"
 
 namespace drewgon{
@@ -24,35 +25,39 @@ std::string Quad::commentStr(){
 }
 
 std::string Quad::toString(bool verbose){
-	auto res = std::string("");
+	std::ostringstream res;
+	print(res, verbose);
+	return res.str();
+}
 
+void Quad::print(std::ostream& out, bool verbose){
 	auto first = true;
 
 	size_t labelSpace = 12;
+	size_t width = 0;
 	for (auto label : labels){
 		if (first){ first = false; }
-		else { res += ","; }
+		else { out << ","; width += 1; }
 
-		res += label->toString();
+		std::string name = label->toString();
+		out << name;
+		width += name.length();
 	}
-	if (!first){ res += ": "; }
-	else { res += "  "; }
-	size_t spaces;
-	if (res.length() > labelSpace){ spaces = 0; }
-	else { spaces = labelSpace - res.length(); }
-	for (size_t i = 0; i < spaces; i++){
-		res += " ";
+	if (!first){ out << ": "; }
+	else { out << "  "; }
+	width += 2;
+	if (width < labelSpace){
+		out << std::string(labelSpace - width, ' ');
 	}
 
-	res += this->repr();
+	out << this->repr();
 	if (verbose){
-		res += commentStr();
+		out << commentStr();
 	}
-
-	return res;
 }
 
-CallQuad::CallQuad(SemSymbol * calleeIn) : callee(calleeIn){ }
+CallQuad::CallQuad(SemSymbol * calleeIn, Opd * ptrIn)
+: callee(calleeIn), ptr(ptrIn){ }
 
 std::string CallQuad::repr(){
 	return "call " + callee->getName();
@@ -226,8 +231,9 @@ std::string SetArgQuad::repr(){
 	return res;
 }
 
-GetArgQuad::GetArgQuad(size_t indexIn, Opd * opdIn, bool isRecordIn)
-: index(indexIn), opd(opdIn), myIsRecord(isRecordIn){
+GetArgQuad::GetArgQuad(size_t indexIn, size_t numArgsIn, Opd * opdIn,
+  bool isRecordIn)
+: index(indexIn), numArgs(numArgsIn), opd(opdIn), myIsRecord(isRecordIn){
 }
 
 std::string GetArgQuad::repr(){
@@ -0,0 +1,44 @@
+#include <algorithm>
+#include "arena.hpp"
+
+namespace drewgon{
+
+//Chunks start small, so that small compilations stay small, and
+// double up to a limit as the arena fills
+static const size_t FIRST_CHUNK = 64 * 1024;
+static const size_t MAX_CHUNK = 4 * 1024 * 1024;
+
+Arena::~Arena(){
+	for (char * chunk : chunks){
+		delete[] chunk;
+	}
+}
+
+void Arena::adopt(Arena& other){
+	chunks.insert(chunks.end(), other.chunks.begin(), other.chunks.end());
+	used += other.used;
+	reserved += other.reserved;
+	other.chunks.clear();
+	other.next = nullptr;
+	other.limit = nullptr;
+	other.chunkSize = 0;
+	other.used = 0;
+	other.reserved = 0;
+}
+
+void * Arena::allocateChunk(size_t size, size_t align){
+	size_t newSize = chunkSize == 0 ? FIRST_CHUNK
+	  : std::min(2 * chunkSize, MAX_CHUNK);
+	//Anything too big for a chunk gets one of its own
+	if (size + align > newSize){ newSize = size + align; }
+
+	char * chunk = new char[newSize];
+	chunks.push_back(chunk);
+	reserved += newSize;
+	next = chunk;
+	limit = chunk + newSize;
+	chunkSize = newSize;
+	return allocate(size, align);
+}
+
+}
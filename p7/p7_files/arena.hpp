@@ -0,0 +1,65 @@
+#ifndef DREWGON_ARENA_HPP
+#define DREWGON_ARENA_HPP
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace drewgon{
+
+// A bump allocator for the many small objects (such as tokens and
+// their positions) that live exactly as long as one compilation.
+// Objects are carved out of large chunks one after another, and
+// every chunk is freed at once when the arena is destroyed; the
+// objects' destructors are never run, so only objects that own
+// nothing else belong here.
+class Arena{
+public:
+	Arena(){ }
+	~Arena();
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	//size bytes, aligned to align (which must be a power of 2)
+	void * allocate(size_t size, size_t align){
+		size_t pad = (align - reinterpret_cast<size_t>(next) % align) % align;
+		if (size + pad > static_cast<size_t>(limit - next)){
+			return allocateChunk(size, align);
+		}
+		void * res = next + pad;
+		next += pad + size;
+		used += size;
+		return res;
+	}
+
+	template <typename T, typename... Args>
+	T * make(Args&&... args){
+		return new (allocate(sizeof(T), alignof(T)))
+		  T(std::forward<Args>(args)...);
+	}
+
+	//Take over everything allocated in other (which is left
+	// empty), so that it lasts as long as this arena does
+	void adopt(Arena& other);
+
+	//Bytes handed out, and bytes taken from the heap to do it
+	size_t bytesUsed() const { return used; }
+	size_t bytesReserved() const { return reserved; }
+	size_t numChunks() const { return chunks.size(); }
+private:
+	void * allocateChunk(size_t size, size_t align);
+
+	std::vector<char *> chunks;
+	char * next = nullptr;
+	char * limit = nullptr;
+	//The size of the chunk being filled (0 before the first), which
+	// the next chunk is sized from
+	size_t chunkSize = 0;
+	size_t used = 0;
+	size_t reserved = 0;
+};
+
+}
+
+#endif
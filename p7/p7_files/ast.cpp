@@ -1,11 +1,38 @@
 #include "ast.hpp"
+#include "rd_parser.hpp"
 
-drewgon::ProgramNode::ProgramNode(std::list<DeclNode *> * globalsIn)
-: ASTNode(new Position(0,0,0,0)), myGlobals(globalsIn){
-	if (!globalsIn->empty()){
-		myPos = new Position(
-			myGlobals->front()->pos(),
-			myGlobals->back()->pos()
+//An empty program is nowhere in particular
+static const drewgon::Position nowhere;
+
+drewgon::ProgramNode::ProgramNode(Span<DeclNode *> globalsIn)
+: ASTNode(&nowhere), myGlobals(globalsIn){
+	if (!myGlobals.empty()){
+		myPos = Position(
+			myGlobals.front()->pos(),
+			myGlobals.back()->pos()
 		);
 	}
 }
+
+//Stops at the first body that fails to parse, as a parser that
+// parsed every body as it went would have
+bool drewgon::ProgramNode::parseBodies(){
+	for (auto global : myGlobals){
+		if (!global->parseBodies()){ return false; }
+	}
+	return true;
+}
+
+const drewgon::Span<drewgon::StmtNode *>& drewgon::FnDeclNode::body(){
+	if (myLazyBody != nullptr){
+		const LazyBody * lazy = myLazyBody;
+		myLazyBody = nullptr;
+		myBodyParsed = RDParser::parseBody(lazy, myBody);
+	}
+	return myBody;
+}
+
+bool drewgon::FnDeclNode::parseBodies(){
+	body();
+	return bodyParsed();
+}
@@ -4,10 +4,13 @@
 #include <ostream>
 #include <sstream>
 #include <string.h>
-#include <list>
+#include <vector>
+#include "arena.hpp"
+#include "span.hpp"
 #include "tokens.hpp"
 #include "types.hpp"
 #include "3ac.hpp"
+#include "flat_ast.hpp"
 
 namespace drewgon {
 
@@ -26,31 +29,42 @@ class FormalDeclNode;
 class TypeNode;
 class ExpNode;
 class IDNode;
-
+class LazyBody;
+
+// AST nodes are made in an Arena that lasts as long as the
+// compilation (see ASTBuilder below), and are never destroyed one
+// by one. So that none of them owns anything the arena would not
+// free, each list of child nodes is a Span of an array in the same
+// arena, and a string literal is a view of the text it was
+// scanned from.
 class ASTNode{
 public:
-	ASTNode(const Position * pos) : myPos(pos){ }
+	ASTNode(const Position * pos) : myPos(*pos){ }
 	virtual void unparse(std::ostream&, int) = 0;
-	const Position * pos() { return myPos; };
+	const Position * pos() { return &myPos; };
 	std::string posStr(){ return pos()->span(); }
 	virtual bool nameAnalysis(SymbolTable *) = 0;
+	//Add this node, and those under it, to a FlatAST
+	virtual NodeIdx toFlat(FlatASTBuilder * flat) = 0;
 	//Note that there is no ASTNode::typeAnalysis. To allow
 	// for different type signatures, type analysis is
 	// implemented as needed in various subclasses
 protected:
-	const Position * myPos = nullptr;
+	Position myPos;
 };
 
 class ProgramNode : public ASTNode{
 public:
-	ProgramNode(std::list<DeclNode *> * globalsIn);
+	ProgramNode(Span<DeclNode *> globalsIn);
 	void unparse(std::ostream&, int) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual bool nameAnalysis(SymbolTable *) override;
 	virtual void typeAnalysis(TypeAnalysis *);
-	IRProgram * to3AC(TypeAnalysis * ta);
+	IRProgram * to3AC(TypeAnalysis * ta, FnCache * cache);
+	bool parseBodies();
 	virtual ~ProgramNode(){ }
 private:
-	std::list<DeclNode *> * myGlobals;
+	Span<DeclNode *> myGlobals;
 };
 
 class ExpNode : public ASTNode{
@@ -66,10 +80,12 @@ public:
 
 class IDNode : public ExpNode{
 public:
-	IDNode(const Position * p, std::string nameIn)
-	: ExpNode(p), name(nameIn), mySymbol(nullptr){}
-	std::string getName(){ return name; }
+	IDNode(const Position * p, SymbolId idIn)
+	: ExpNode(p), myId(idIn), mySymbol(nullptr){}
+	const std::string& getName() const { return Interner::name(myId); }
+	SymbolId getId() const { return myId; }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	void unparseNested(std::ostream& out) override;
 	void attachSymbol(SemSymbol * symbolIn);
 	SemSymbol * getSymbol() const { return mySymbol; }
@@ -77,7 +93,7 @@ public:
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
 private:
-	std::string name;
+	SymbolId myId;
 	SemSymbol * mySymbol;
 };
 
@@ -105,6 +121,9 @@ public:
 	virtual void typeAnalysis(TypeAnalysis *) override = 0;
 	virtual void to3AC(IRProgram * prog) = 0;
 	virtual void to3AC(Procedure * proc) override = 0;
+	//Parse whatever the parser left for later (see
+	// FnDeclNode::body). False if any of it failed to parse.
+	virtual bool parseBodies(){ return true; }
 };
 
 class VarDeclNode : public DeclNode{
@@ -112,6 +131,7 @@ public:
 	VarDeclNode(const Position * p, TypeNode * typeIn, IDNode * IDIn)
 	: DeclNode(p), myType(typeIn), myID(IDIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	IDNode * ID(){ return myID; }
 	TypeNode * getTypeNode() const{ return myType; }
 	bool nameAnalysis(SymbolTable * symTab) override;
@@ -128,6 +148,7 @@ public:
 	FormalDeclNode(const Position * p, TypeNode * type, IDNode * id)
 	: VarDeclNode(p, type, id){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void to3AC(Procedure * proc) override;
 	virtual void to3AC(IRProgram * prog) override;
 };
@@ -136,19 +157,28 @@ class FnDeclNode : public DeclNode{
 public:
 	FnDeclNode(const Position * p,
 	  TypeNode * retTypeIn, IDNode * idIn,
-	  std::list<FormalDeclNode *> * formalsIn,
-	  std::list<StmtNode *> * bodyIn)
+	  Span<FormalDeclNode *> formalsIn,
+	  Span<StmtNode *> bodyIn)
 	: DeclNode(p), myRetType(retTypeIn), myID(idIn),
 	  myFormals(formalsIn), myBody(bodyIn){
 	}
 	IDNode * ID() const { return myID; }
-	std::list<FormalDeclNode *> * getFormals() const{
+	const Span<FormalDeclNode *>& getFormals() const{
 		return myFormals;
 	}
 	virtual TypeNode * getRetTypeNode() {
 		return myRetType;
 	}
-	void unparse(std::ostream& out, int indent) override;
+	//The statements of the body. If the parser left them for
+	// later (see rd_parser.hpp), they are parsed on this first
+	// call; if they fail to, the body is empty and bodyParsed()
+	// is false.
+	const Span<StmtNode *>& body();
+	bool bodyParsed() const { return myBodyParsed; }
+	void deferBody(LazyBody * lazyIn){ myLazyBody = lazyIn; }
+	bool parseBodies() override;
+	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	void to3AC(IRProgram * prog) override;
@@ -156,8 +186,10 @@ public:
 private:
 	TypeNode * myRetType;
 	IDNode * myID;
-	std::list<FormalDeclNode *> * myFormals;
-	std::list<StmtNode *> * myBody;
+	Span<FormalDeclNode *> myFormals;
+	Span<StmtNode *> myBody;
+	LazyBody * myLazyBody = nullptr;
+	bool myBodyParsed = true;
 };
 
 class AssignStmtNode : public StmtNode{
@@ -165,6 +197,7 @@ public:
 	AssignStmtNode(const Position * p, AssignExpNode * expIn)
 	: StmtNode(p), myExp(expIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -177,6 +210,7 @@ public:
 	InputStmtNode(const Position * p, IDNode * dstIn)
 	: StmtNode(p), myDst(dstIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -189,6 +223,7 @@ public:
 	OutputStmtNode(const Position * p, ExpNode * srcIn)
 	: StmtNode(p), mySrc(srcIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -201,6 +236,7 @@ public:
 	PostDecStmtNode(const Position * p, IDNode * inID)
 	: StmtNode(p), myID(inID){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -213,6 +249,7 @@ public:
 	PostIncStmtNode(const Position * p, IDNode * inID)
 	: StmtNode(p), myID(inID){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -223,55 +260,59 @@ private:
 class IfStmtNode : public StmtNode{
 public:
 	IfStmtNode(const Position * p, ExpNode * condIn,
-	  std::list<StmtNode *> * bodyIn)
+	  Span<StmtNode *> bodyIn)
 	: StmtNode(p), myCond(condIn), myBody(bodyIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
 private:
 	ExpNode * myCond;
-	std::list<StmtNode *> * myBody;
+	Span<StmtNode *> myBody;
 };
 
 class IfElseStmtNode : public StmtNode{
 public:
 	IfElseStmtNode(const Position * p, ExpNode * condIn,
-	  std::list<StmtNode *> * bodyTrueIn,
-	  std::list<StmtNode *> * bodyFalseIn)
+	  Span<StmtNode *> bodyTrueIn,
+	  Span<StmtNode *> bodyFalseIn)
 	: StmtNode(p), myCond(condIn),
 	  myBodyTrue(bodyTrueIn), myBodyFalse(bodyFalseIn) { }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
 private:
 	ExpNode * myCond;
-	std::list<StmtNode *> * myBodyTrue;
-	std::list<StmtNode *> * myBodyFalse;
+	Span<StmtNode *> myBodyTrue;
+	Span<StmtNode *> myBodyFalse;
 };
 
 class WhileStmtNode : public StmtNode{
 public:
 	WhileStmtNode(const Position * p, ExpNode * condIn,
-	  std::list<StmtNode *> * bodyIn)
+	  Span<StmtNode *> bodyIn)
 	: StmtNode(p), myCond(condIn), myBody(bodyIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
 private:
 	ExpNode * myCond;
-	std::list<StmtNode *> * myBody;
+	Span<StmtNode *> myBody;
 };
 
 class ForStmtNode : public StmtNode{
 public:
 	ForStmtNode(const Position * p, StmtNode * init, ExpNode * condIn,
-	  StmtNode * itrIn, std::list<StmtNode *> * bodyIn)
+	  StmtNode * itrIn, Span<StmtNode *> bodyIn)
 	: StmtNode(p), myInit(init), myCond(condIn), myItr(itrIn),
 	  myBody(bodyIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * prog) override;
@@ -279,7 +320,7 @@ private:
 	StmtNode * myInit;
 	ExpNode * myCond;
 	StmtNode * myItr;
-	std::list<StmtNode *> * myBody;
+	Span<StmtNode *> myBody;
 };
 
 class ReturnStmtNode : public StmtNode{
@@ -287,6 +328,7 @@ public:
 	ReturnStmtNode(const Position * p, ExpNode * exp)
 	: StmtNode(p), myExp(exp){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * proc) override;
@@ -297,9 +339,10 @@ private:
 class CallExpNode : public ExpNode{
 public:
 	CallExpNode(const Position * p, IDNode * id,
-	  std::list<ExpNode *> * argsIn)
+	  Span<ExpNode *> argsIn)
 	: ExpNode(p), myID(id), myArgs(argsIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	void unparseNested(std::ostream& out) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	void typeAnalysis(TypeAnalysis *) override;
@@ -308,7 +351,7 @@ public:
 	virtual Opd * flatten(Procedure * proc) override;
 private:
 	IDNode * myID;
-	std::list<ExpNode *> * myArgs;
+	Span<ExpNode *> myArgs;
 };
 
 class BinaryExpNode : public ExpNode{
@@ -325,6 +368,7 @@ protected:
 	void binaryEqTyping(TypeAnalysis * typing);
 	void binaryRelTyping(TypeAnalysis * typing);
 	void binaryMathTyping(TypeAnalysis * typing);
+	NodeIdx binaryToFlat(FlatASTBuilder * flat, FlatKind kind);
 };
 
 class PlusNode : public BinaryExpNode{
@@ -332,6 +376,7 @@ public:
 	PlusNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -341,6 +386,7 @@ public:
 	MinusNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -350,6 +396,7 @@ public:
 	TimesNode(const Position * p, ExpNode * e1In, ExpNode * e2In)
 	: BinaryExpNode(p, e1In, e2In){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -359,6 +406,7 @@ public:
 	DivideNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -368,6 +416,7 @@ public:
 	AndNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -377,6 +426,7 @@ public:
 	OrNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -386,6 +436,7 @@ public:
 	EqualsNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -395,6 +446,7 @@ public:
 	NotEqualsNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -404,6 +456,7 @@ public:
 	LessNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
 };
@@ -413,6 +466,7 @@ public:
 	LessEqNode(const Position * pos, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(pos, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -422,6 +476,7 @@ public:
 	GreaterNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
 };
@@ -431,6 +486,7 @@ public:
 	GreaterEqNode(const Position * p, ExpNode * e1, ExpNode * e2)
 	: BinaryExpNode(p, e1, e2){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
 };
@@ -454,6 +510,7 @@ public:
 	NegNode(const Position * p, ExpNode * exp)
 	: UnaryExpNode(p, exp){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -464,6 +521,7 @@ public:
 	NotNode(const Position * p, ExpNode * exp)
 	: UnaryExpNode(p, exp){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -473,6 +531,7 @@ class VoidTypeNode : public TypeNode{
 public:
 	VoidTypeNode(const Position * p) : TypeNode(p){}
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual const DataType * getType() const override {
 		return BasicType::VOID();
 	}
@@ -482,18 +541,20 @@ class IntTypeNode : public TypeNode{
 public:
 	IntTypeNode(const Position * p): TypeNode(p){}
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual const DataType * getType() const override;
 };
 
 class FnTypeNode : public TypeNode{
 public:
-	FnTypeNode(const Position * p, std::list<TypeNode *> * inTypes, TypeNode * outType)
+	FnTypeNode(const Position * p, Span<TypeNode *> inTypes, TypeNode * outType)
 	: TypeNode(p), myInTypes(inTypes), myOutType(outType){}
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual const DataType * getType() const override;
 	virtual bool nameAnalysis(SymbolTable * symTab) override;
 private:
-	const std::list<TypeNode *> * myInTypes;
+	Span<TypeNode *> myInTypes;
 	TypeNode * myOutType;
 };
 
@@ -501,6 +562,7 @@ class BoolTypeNode : public TypeNode{
 public:
 	BoolTypeNode(const Position * p): TypeNode(p) { }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	virtual const DataType * getType() const override;
 };
 
@@ -509,6 +571,7 @@ public:
 	AssignExpNode(const Position * p, IDNode * inDst, ExpNode * inSrc)
 	: ExpNode(p), myDst(inDst), mySrc(inSrc){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
@@ -525,6 +588,7 @@ public:
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -534,17 +598,22 @@ private:
 
 class StrLitNode : public ExpNode{
 public:
-	StrLitNode(const Position * p, const std::string strIn)
-	: ExpNode(p), myStr(strIn){ }
+	//The literal is a view of the text it was scanned from, as
+	// its token is
+	StrLitNode(const Position * p, const char * textIn, size_t lenIn)
+	: ExpNode(p), myText(textIn), myLen(lenIn){ }
+	std::string str() const { return std::string(myText, myLen); }
 	virtual void unparseNested(std::ostream& out) override{
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable *) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
 private:
-	 const std::string myStr;
+	const char * const myText;
+	const size_t myLen;
 };
 
 class MayhemNode : public ExpNode{
@@ -554,6 +623,7 @@ public:
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * proc) override;
@@ -567,6 +637,7 @@ public:
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -579,6 +650,7 @@ public:
 		unparse(out, 0);
 	}
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual Opd * flatten(Procedure * prog) override;
@@ -589,6 +661,7 @@ public:
 	CallStmtNode(const Position * p, CallExpNode * expIn)
 	: StmtNode(p), myCallExp(expIn){ }
 	void unparse(std::ostream& out, int indent) override;
+	NodeIdx toFlat(FlatASTBuilder * flat) override;
 	bool nameAnalysis(SymbolTable * symTab) override;
 	virtual void typeAnalysis(TypeAnalysis *) override;
 	virtual void to3AC(Procedure * proc) override;
@@ -596,6 +669,45 @@ private:
 	CallExpNode * myCallExp;
 };
 
+//Makes the nodes of an AST as it is parsed. A list of child
+// nodes (say, the statements of a block) is gathered on a stack
+// while its construct is parsed, and is copied into the arena, as
+// one array, once the whole construct has been. Lists nest (the
+// statements of a while loop are all parsed before the loop is
+// added to the enclosing block's list), so the items of the list
+// being added to are always the ones on top of the stack.
+class ASTBuilder{
+public:
+	ASTBuilder(Arena * arenaIn) : arena(arenaIn){ }
+	Arena * getArena() const { return arena; }
+
+	template <typename T, typename... Args>
+	T * make(Args&&... args){
+		return arena->make<T>(std::forward<Args>(args)...);
+	}
+
+	//Start a list, returning the handle to add to it with
+	size_t openList() const { return pending.size(); }
+	void add(ASTNode * node){ pending.push_back(node); }
+
+	//Finish the list started at list. Lists opened after it
+	// must be closed first.
+	template <typename T>
+	Span<T *> closeList(size_t list){
+		size_t count = pending.size() - list;
+		T ** items = static_cast<T **>(
+		  arena->allocate(count * sizeof(T *), alignof(T *)));
+		for (size_t i = 0; i < count; i++){
+			items[i] = static_cast<T *>(pending[list + i]);
+		}
+		pending.resize(list);
+		return Span<T *>(items, count);
+	}
+private:
+	Arena * arena;
+	std::vector<ASTNode *> pending;
+};
+
 } //End namespace drewgon
 
 #endif
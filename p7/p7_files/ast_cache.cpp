@@ -0,0 +1,415 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ast_cache.hpp"
+#include "interner.hpp"
+
+namespace drewgon{
+
+//Bump this whenever FlatKind, the operands of any kind or the
+// layout of an entry change, so that entries written by an older
+// dgc are never reused
+static const char AST_CACHE_VERSION[16] = "dgc AST cache 2";
+
+static const char * ENTRY_EXT = ".ast";
+
+//Positions are written out, and mapped back in, as they are
+static_assert(std::is_trivially_copyable<Position>::value
+  && sizeof(Position) == 2 * sizeof(SourceLoc),
+  "Position must be a pair of SourceLocs");
+
+// The start of an entry. The sections follow it in this order,
+// each starting on an 8-byte boundary: the kind, a and b columns,
+// the positions, the extra words, the end of each name (as an
+// offset into the name text), the literal text, the name text and
+// the source text. Everything is in the byte order of the machine
+// that wrote it.
+struct EntryHeader{
+	char version[16];
+	uint64_t sourceSize;
+	uint64_t nodes;
+	uint64_t extraWords;
+	uint64_t textBytes;
+	uint64_t names;
+	uint64_t nameBytes;
+};
+
+//Where each section of an entry starts, and the entry's size
+class EntryLayout{
+public:
+	EntryLayout(const EntryHeader& header){
+		size_t at = sizeof(EntryHeader);
+		kinds = section(at, header.nodes * sizeof(FlatKind));
+		a = section(at, header.nodes * sizeof(uint32_t));
+		b = section(at, header.nodes * sizeof(uint32_t));
+		positions = section(at, header.nodes * sizeof(Position));
+		extra = section(at, header.extraWords * sizeof(uint32_t));
+		nameEnds = section(at, header.names * sizeof(uint32_t));
+		text = section(at, header.textBytes);
+		nameText = section(at, header.nameBytes);
+		source = section(at, header.sourceSize);
+		size = at;
+	}
+	size_t kinds, a, b, positions, extra, nameEnds, text, nameText, source;
+	size_t size;
+private:
+	static size_t section(size_t& at, size_t bytes){
+		size_t start = at;
+		at = (at + bytes + 7) & ~static_cast<size_t>(7);
+		return start;
+	}
+};
+
+//A hash of the source text. This is FNV-1a taken a word rather
+// than a byte at a time (with the high bits folded back in after
+// each), since it is run over every input before it is parsed.
+static uint64_t hashText(const char * text, size_t size){
+	const uint64_t prime = 1099511628211ull;
+	uint64_t hash = 14695981039346656037ull ^ size;
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)){
+		uint64_t word;
+		memcpy(&word, text + i, sizeof(word));
+		hash = (hash ^ word) * prime;
+		hash ^= hash >> 32;
+	}
+	for (; i < size; i++){
+		hash = (hash ^ static_cast<unsigned char>(text[i])) * prime;
+	}
+	return hash;
+}
+
+//What can stand in each place a node is referred to from
+enum class Role{ Global, Stmt, Formal, Type, Exp, ID, Assign, Call };
+
+static bool plays(FlatKind kind, Role role){
+	switch (role){
+	case Role::Global:
+		return kind == FlatKind::VarDecl || kind == FlatKind::FnDecl;
+	case Role::Stmt:
+		return kind == FlatKind::VarDecl
+		  || (kind >= FlatKind::AssignStmt && kind <= FlatKind::CallStmt);
+	case Role::Formal: return kind == FlatKind::FormalDecl;
+	case Role::Type:
+		return kind >= FlatKind::VoidType && kind <= FlatKind::FnType;
+	case Role::Exp: return kind >= FlatKind::ID && kind <= FlatKind::Not;
+	case Role::ID: return kind == FlatKind::ID;
+	case Role::Assign: return kind == FlatKind::Assign;
+	case Role::Call: return kind == FlatKind::Call;
+	}
+	return false;
+}
+
+// Checks that the tree in an entry has the shape of one that
+// FlatAST::build made, so that nothing walking it can read outside
+// its columns, go round in a cycle or meet a node of a kind it
+// doesn't expect. Every operand must be in range: each child is a
+// later node than its parent (as nodes are numbered before their
+// children), of a kind that can stand where it does; each extra
+// block and list lies within the extra words; each literal lies
+// within the text; each ID names an entry in the name table.
+class EntryChecker{
+public:
+	EntryChecker(const EntryHeader& header, const FlatKind * kindsIn,
+	  const uint32_t * aIn, const uint32_t * bIn, const uint32_t * extraIn)
+	: nodes(header.nodes), extraWords(header.extraWords),
+	  textBytes(header.textBytes), names(header.names),
+	  kinds(kindsIn), as(aIn), bs(bIn), extra(extraIn){ }
+
+	bool check() const{
+		if (kinds[0] != FlatKind::Program){ return false; }
+		for (NodeIdx node = 0; node < nodes; node++){
+			if (!check(node)){ return false; }
+		}
+		return true;
+	}
+private:
+	bool check(NodeIdx node) const{
+		uint32_t a = as[node];
+		uint32_t b = bs[node];
+		switch (kinds[node]){
+		case FlatKind::Program:
+			return node == 0 && list(node, a, Role::Global);
+		case FlatKind::VarDecl:
+		case FlatKind::FormalDecl:
+			return child(node, a, Role::Type) && child(node, b, Role::ID);
+		case FlatKind::FnDecl:
+			return block(a, 4) && child(node, extra[a], Role::Type)
+			  && child(node, extra[a + 1], Role::ID)
+			  && list(node, extra[a + 2], Role::Formal)
+			  && list(node, extra[a + 3], Role::Stmt);
+		case FlatKind::AssignStmt: return child(node, a, Role::Assign);
+		case FlatKind::CallStmt: return child(node, a, Role::Call);
+		case FlatKind::InputStmt:
+		case FlatKind::PostDecStmt:
+		case FlatKind::PostIncStmt:
+			return child(node, a, Role::ID);
+		case FlatKind::OutputStmt:
+		case FlatKind::Neg:
+		case FlatKind::Not:
+			return child(node, a, Role::Exp);
+		case FlatKind::IfStmt:
+		case FlatKind::WhileStmt:
+			return child(node, a, Role::Exp) && list(node, b, Role::Stmt);
+		case FlatKind::IfElseStmt:
+			return child(node, a, Role::Exp) && block(b, 2)
+			  && list(node, extra[b], Role::Stmt)
+			  && list(node, extra[b + 1], Role::Stmt);
+		case FlatKind::ForStmt:
+			return block(a, 4) && child(node, extra[a], Role::Stmt)
+			  && child(node, extra[a + 1], Role::Exp)
+			  && child(node, extra[a + 2], Role::Stmt)
+			  && list(node, extra[a + 3], Role::Stmt);
+		case FlatKind::ReturnStmt:
+			return a == FlatAST::NONE || child(node, a, Role::Exp);
+		case FlatKind::ID: return a < names;
+		case FlatKind::StrLit: return a <= textBytes && b <= textBytes - a;
+		case FlatKind::IntLit:
+		case FlatKind::True:
+		case FlatKind::False:
+		case FlatKind::Mayhem:
+		case FlatKind::VoidType:
+		case FlatKind::IntType:
+		case FlatKind::BoolType:
+			return true;
+		case FlatKind::Assign:
+			return child(node, a, Role::ID) && child(node, b, Role::Exp);
+		case FlatKind::Call:
+			return child(node, a, Role::ID) && list(node, b, Role::Exp);
+		case FlatKind::Plus: case FlatKind::Minus: case FlatKind::Times:
+		case FlatKind::Divide: case FlatKind::And: case FlatKind::Or:
+		case FlatKind::Equals: case FlatKind::NotEquals:
+		case FlatKind::Less: case FlatKind::LessEq:
+		case FlatKind::Greater: case FlatKind::GreaterEq:
+			return child(node, a, Role::Exp) && child(node, b, Role::Exp);
+		case FlatKind::FnType:
+			return list(node, a, Role::Type) && child(node, b, Role::Type);
+		}
+		//A byte that isn't a FlatKind
+		return false;
+	}
+
+	bool child(NodeIdx parent, uint32_t node, Role role) const{
+		return node > parent && node < nodes && plays(kinds[node], role);
+	}
+	//count extra words, starting at at
+	bool block(uint32_t at, uint32_t count) const{
+		return at <= extraWords && count <= extraWords - at;
+	}
+	bool list(NodeIdx parent, uint32_t at, Role role) const{
+		if (!block(at, 1) || !block(at + 1, extra[at])){ return false; }
+		for (uint32_t i = 1; i <= extra[at]; i++){
+			if (!child(parent, extra[at + i], role)){ return false; }
+		}
+		return true;
+	}
+
+	const size_t nodes;
+	const size_t extraWords;
+	const size_t textBytes;
+	const size_t names;
+	const FlatKind * const kinds;
+	const uint32_t * const as;
+	const uint32_t * const bs;
+	const uint32_t * const extra;
+};
+
+//Write bytes of data, padded out to the start of the next section
+static void writeSection(std::ostream& out, const void * data, size_t bytes){
+	static const char padding[8] = {};
+	out.write(static_cast<const char *>(data),
+	  static_cast<std::streamsize>(bytes));
+	out.write(padding, static_cast<std::streamsize>((8 - bytes % 8) % 8));
+}
+
+ASTCache::ASTCache(const std::string& dirIn)
+: dir(dirIn), hits(0), misses(0), stores(0){
+	//Create the directory (and any missing parents) up front
+	for (size_t slash = dir.find('/', 1); ;
+	  slash = dir.find('/', slash + 1)){
+		mkdir(dir.substr(0, slash).c_str(), 0777);
+		if (slash == std::string::npos){ break; }
+	}
+}
+
+std::string ASTCache::entryPath(uint64_t hash) const{
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx",
+	  static_cast<unsigned long long>(hash));
+	return dir + "/" + name + ENTRY_EXT;
+}
+
+FlatAST * ASTCache::load(const SourceFile * src){
+	uint64_t hash = hashText(src->data(), src->size());
+	int fd = open(entryPath(hash).c_str(), O_RDONLY);
+	if (fd < 0){
+		misses++;
+		return nullptr;
+	}
+	struct stat info;
+	void * addr = MAP_FAILED;
+	size_t len = 0;
+	if (fstat(fd, &info) == 0
+	  && static_cast<size_t>(info.st_size) >= sizeof(EntryHeader)){
+		len = static_cast<size_t>(info.st_size);
+		addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (addr == MAP_FAILED){
+		misses++;
+		return nullptr;
+	}
+
+	FlatAST * ast = new FlatAST();
+	ast->mapping = addr;
+	ast->mappingSize = len;
+	if (!useEntry(ast, src)){
+		delete ast;
+		misses++;
+		return nullptr;
+	}
+	hits++;
+	return ast;
+}
+
+bool ASTCache::useEntry(FlatAST * ast, const SourceFile * src){
+	const char * base = static_cast<const char *>(ast->mapping);
+	size_t len = ast->mappingSize;
+	EntryHeader header;
+	memcpy(&header, base, sizeof(header));
+	if (memcmp(header.version, AST_CACHE_VERSION, sizeof(header.version)) != 0
+	  || header.sourceSize != src->size()){
+		return false;
+	}
+	//Every count is at most the size of the section it counts,
+	// which keeps the sums below from overflowing
+	if (header.nodes == 0 || header.nodes > len || header.extraWords > len
+	  || header.textBytes > len || header.names > len
+	  || header.nameBytes > len || header.sourceSize > len){
+		return false;
+	}
+	EntryLayout layout(header);
+	if (layout.size != len){ return false; }
+
+	//The entry is only for exactly this text, so a hash collision
+	// is just a miss
+	if (memcmp(base + layout.source, src->data(), src->size()) != 0){
+		return false;
+	}
+	const FlatKind * kinds = reinterpret_cast<const FlatKind *>(
+	  base + layout.kinds);
+	const uint32_t * storedA = reinterpret_cast<const uint32_t *>(
+	  base + layout.a);
+	const uint32_t * bs = reinterpret_cast<const uint32_t *>(base + layout.b);
+	const uint32_t * extra = reinterpret_cast<const uint32_t *>(
+	  base + layout.extra);
+	if (!EntryChecker(header, kinds, storedA, bs, extra).check()){
+		return false;
+	}
+
+	//Intern the program's names, which are numbered differently
+	// in each process
+	const uint32_t * nameEnds = reinterpret_cast<const uint32_t *>(
+	  base + layout.nameEnds);
+	const char * nameText = base + layout.nameText;
+	std::vector<SymbolId> ids(header.names);
+	uint32_t nameStart = 0;
+	for (size_t i = 0; i < header.names; i++){
+		uint32_t nameEnd = nameEnds[i];
+		if (nameEnd < nameStart || nameEnd > header.nameBytes){
+			return false;
+		}
+		ids[i] = Interner::intern(nameText + nameStart, nameEnd - nameStart);
+		nameStart = nameEnd;
+	}
+
+	ast->mySize = header.nodes;
+	ast->myKinds = kinds;
+	ast->myB = bs;
+	ast->myPositions = reinterpret_cast<const Position *>(
+	  base + layout.positions);
+	ast->myExtra = extra;
+	ast->myExtraSize = header.extraWords;
+	ast->myText = base + layout.text;
+	ast->myTextSize = header.textBytes;
+
+	//The a column is the one copy made, since an ID's operand is
+	// its name's index in the entry and has to become its SymbolId
+	ast->as.assign(storedA, storedA + header.nodes);
+	for (size_t i = 0; i < header.nodes; i++){
+		if (kinds[i] == FlatKind::ID){ ast->as[i] = ids[ast->as[i]]; }
+	}
+	ast->myA = ast->as.data();
+	return true;
+}
+
+void ASTCache::store(const SourceFile * src, const FlatAST * ast){
+	uint64_t hash = hashText(src->data(), src->size());
+	std::string path = entryPath(hash);
+
+	//Number the names the program uses in the order they first
+	// appear, and refer to them by those numbers
+	const uint32_t unnumbered = UINT32_MAX;
+	std::vector<uint32_t> numbers(Interner::size(), unnumbered);
+	std::vector<uint32_t> nameEnds;
+	std::string nameText;
+	std::vector<uint32_t> as(ast->myA, ast->myA + ast->mySize);
+	for (size_t i = 0; i < ast->mySize; i++){
+		if (ast->myKinds[i] != FlatKind::ID){ continue; }
+		uint32_t& number = numbers[as[i]];
+		if (number == unnumbered){
+			number = static_cast<uint32_t>(nameEnds.size());
+			nameText += Interner::name(as[i]);
+			nameEnds.push_back(static_cast<uint32_t>(nameText.size()));
+		}
+		as[i] = number;
+	}
+
+	EntryHeader header;
+	memcpy(header.version, AST_CACHE_VERSION, sizeof(header.version));
+	header.sourceSize = src->size();
+	header.nodes = ast->mySize;
+	header.extraWords = ast->myExtraSize;
+	header.textBytes = ast->myTextSize;
+	header.names = nameEnds.size();
+	header.nameBytes = nameText.size();
+
+	//Write to a private file and rename it into place so that
+	// concurrent readers never see a partial entry
+	static std::atomic<unsigned long> tmpCount(0);
+	std::string tmpPath = path + ".tmp." + std::to_string(getpid())
+	  + "." + std::to_string(tmpCount++);
+	std::ofstream out(tmpPath, std::ios::binary);
+	if (!out.good()){ return; }
+	size_t n = ast->mySize;
+	writeSection(out, &header, sizeof(header));
+	writeSection(out, ast->myKinds, n * sizeof(FlatKind));
+	writeSection(out, as.data(), n * sizeof(uint32_t));
+	writeSection(out, ast->myB, n * sizeof(uint32_t));
+	writeSection(out, ast->myPositions, n * sizeof(Position));
+	writeSection(out, ast->myExtra, ast->myExtraSize * sizeof(uint32_t));
+	writeSection(out, nameEnds.data(), nameEnds.size() * sizeof(uint32_t));
+	writeSection(out, ast->myText, ast->myTextSize);
+	writeSection(out, nameText.data(), nameText.size());
+	writeSection(out, src->data(), src->size());
+	out.close();
+	if (!out.good() || rename(tmpPath.c_str(), path.c_str()) != 0){
+		unlink(tmpPath.c_str());
+		return;
+	}
+	stores++;
+}
+
+void ASTCache::reportStats(std::ostream& out) const{
+	out << "AST cache " << dir << ": "
+	  << hits << " hits, " << misses << " misses, "
+	  << stores << " stored\n";
+}
+
+}
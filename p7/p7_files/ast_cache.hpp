@@ -0,0 +1,49 @@
+#ifndef DREWGON_AST_CACHE_HPP
+#define DREWGON_AST_CACHE_HPP
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include "flat_ast.hpp"
+#include "source.hpp"
+
+namespace drewgon{
+
+// An on-disk cache of parsed programs, so that an input that
+// hasn't changed since it was last compiled isn't scanned and
+// parsed again. Each entry is a FlatAST written out as it is laid
+// out in memory (its columns, one after another), keyed by a hash
+// of the source text. Nothing in it is a pointer: children are
+// node indices, positions are offsets into the source, and IDs
+// are indices into a table of the names the program uses (which
+// are interned again as it is loaded). An entry is mapped back in
+// and used in place, columns and all, rather than read and
+// decoded, so loading a large program costs little more than
+// checking and translating its columns. The source text is stored
+// in the entry and compared on lookup, so a hash collision is just
+// a miss, as is an entry whose tree isn't well formed. Safe to
+// share between threads.
+class ASTCache{
+public:
+	ASTCache(const std::string& dirIn);
+
+	//The tree that src parsed to, or nullptr on a miss
+	FlatAST * load(const SourceFile * src);
+	void store(const SourceFile * src, const FlatAST * ast);
+
+	void reportStats(std::ostream& out) const;
+private:
+	std::string entryPath(uint64_t hash) const;
+	//Point ast's columns into the entry it has mapped, if the
+	// entry is intact and is for src
+	static bool useEntry(FlatAST * ast, const SourceFile * src);
+
+	std::string dir;
+	std::atomic<size_t> hits;
+	std::atomic<size_t> misses;
+	std::atomic<size_t> stores;
+};
+
+}
+
+#endif
@@ -0,0 +1,270 @@
+// Measures dgc's passes over the AST as the parser builds it (an
+// object per node, pointing at its children, with a virtual call
+// per node) against the same passes over a FlatAST copy of it (see
+// flat_ast.hpp). Both are built from dgc's own sources (at -O2).
+// Each pass runs a few times on each form of the tree, keeping the
+// best run; the passes over the two agree on their output, so the
+// difference is only in how the tree is laid out and walked.
+//
+// Where the kernel exposes the CPU's counters, the cache misses and
+// instructions of each best run are reported too (otherwise n/a).
+//
+// Last, the flat tree is stored in an ASTCache (in a temporary
+// directory) and loaded back, and the load, and the rebuild of the
+// AST from what was loaded, are timed against parsing the file.
+// The load only maps the entry (and translates its IDs), so the
+// cost of reading the rest of it in is paid by the first pass over
+// the loaded tree instead.
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "session.hpp"
+#include "ast_cache.hpp"
+#include "name_analysis.hpp"
+#include "type_analysis.hpp"
+#include "flat_analysis.hpp"
+
+using namespace drewgon;
+
+namespace {
+
+//Discards what is written to it, so that unparsing costs only
+// the formatting
+class NullBuffer : public std::streambuf{
+protected:
+	int overflow(int c) override { return c; }
+	std::streamsize xsputn(const char *, std::streamsize n) override {
+		return n;
+	}
+};
+
+//One of the CPU's event counters, for this thread
+class Counter{
+public:
+	Counter(uint64_t config){
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = config;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+	}
+	~Counter(){ if (fd >= 0){ close(fd); } }
+	bool available() const { return fd >= 0; }
+	void start(){
+		if (fd < 0){ return; }
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+	uint64_t stop(){
+		uint64_t count = 0;
+		if (fd < 0){ return 0; }
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, &count, sizeof(count)) != sizeof(count)){ return 0; }
+		return count;
+	}
+private:
+	int fd;
+};
+
+class Result{
+public:
+	double ms = 0;
+	uint64_t misses = 0;
+	uint64_t instructions = 0;
+};
+
+//The best of runs runs of pass
+Result best(const std::function<void()>& pass, unsigned int runs){
+	static Counter misses(PERF_COUNT_HW_CACHE_MISSES);
+	static Counter instructions(PERF_COUNT_HW_INSTRUCTIONS);
+	Result res;
+	for (unsigned int i = 0; i < runs; i++){
+		misses.start();
+		instructions.start();
+		auto start = std::chrono::steady_clock::now();
+		pass();
+		auto end = std::chrono::steady_clock::now();
+		Result run;
+		run.instructions = instructions.stop();
+		run.misses = misses.stop();
+		run.ms = std::chrono::duration<double, std::milli>(end - start).count();
+		if (i == 0 || run.ms < res.ms){ res = run; }
+	}
+	return res;
+}
+
+bool haveCounters(){
+	return Counter(PERF_COUNT_HW_CACHE_MISSES).available();
+}
+
+std::string count(uint64_t n){
+	if (!haveCounters()){ return "n/a"; }
+	return std::to_string(n / 1000) + "K";
+}
+
+void printRow(const std::string& pass, const Result& ptr, const Result& flat,
+  double nodes){
+	std::cout << std::left << std::setw(15) << pass << std::right
+	  << std::fixed << std::setprecision(1)
+	  << std::setw(10) << ptr.ms << std::setw(10) << flat.ms
+	  << std::setprecision(2) << std::setw(8) << ptr.ms / flat.ms << "x"
+	  << std::setprecision(1) << std::setw(10) << nodes / flat.ms / 1e3
+	  << std::setw(12) << count(ptr.misses) << std::setw(12) << count(flat.misses)
+	  << std::setw(13) << count(ptr.instructions)
+	  << std::setw(13) << count(flat.instructions) << "\n";
+}
+
+//Remove dir and the files in it
+void removeDir(const char * dir){
+	DIR * listing = opendir(dir);
+	if (listing == nullptr){ return; }
+	while (struct dirent * entry = readdir(listing)){
+		std::string name = entry->d_name;
+		if (name != "." && name != ".."){
+			unlink((std::string(dir) + "/" + name).c_str());
+		}
+	}
+	closedir(listing);
+	rmdir(dir);
+}
+
+void usage(std::ostream& out){
+	out << "Usage: astbench [--runs <n>] <file>\n"
+	<< " [--runs <n>]: Runs of each pass, keeping the best (default 3)\n";
+}
+
+}
+
+int main(int argc, char * argv[]){
+	unsigned int runs = 3;
+	const char * path = nullptr;
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if (arg == "--runs" && i + 1 < argc){
+			runs = static_cast<unsigned int>(std::max(1ul, strtoul(argv[++i], nullptr, 10)));
+		} else if (arg[0] != '-' && path == nullptr){
+			path = argv[i];
+		} else {
+			usage(std::cerr);
+			return 2;
+		}
+	}
+	if (path == nullptr){
+		usage(std::cerr);
+		return 2;
+	}
+
+	CompilationSession session(path);
+	session.setFastScan(true);
+	ProgramNode * ast;
+	try {
+		ast = session.parseAll();
+	} catch (InternalError * e){
+		std::cerr << e->msg() << "\n";
+		return 2;
+	}
+	if (ast == nullptr){ return 2; }
+
+	FlatAST * flat = nullptr;
+	Result flatten = best([&](){
+		delete flat;
+		flat = FlatAST::build(ast);
+	}, runs);
+	double nodes = static_cast<double>(flat->size());
+	std::cout << path << ": " << flat->size() << " nodes; "
+	  << session.astArena()->bytesUsed() / 1000000 << " MB as objects, "
+	  << flat->bytesUsed() / 1000000 << " MB flat (built in "
+	  << std::fixed << std::setprecision(1) << flatten.ms << " ms)\n";
+	std::cout << std::left << std::setw(15) << "pass" << std::right
+	  << std::setw(10) << "ptr (ms)" << std::setw(10) << "flat (ms)"
+	  << std::setw(9) << "speedup" << std::setw(10) << "Mnodes/s"
+	  << std::setw(12) << "ptr misses" << std::setw(12) << "flat misses"
+	  << std::setw(13) << "ptr instrs" << std::setw(13) << "flat instrs"
+	  << "\n";
+
+	//Name analysis attaches symbols to the AST's IDs, which would
+	// then be unparsed, so unparsing goes first
+	NullBuffer nullBuffer;
+	std::ostream null(&nullBuffer);
+	Result ptrUnparse = best([&](){ ast->unparse(null, 0); }, runs);
+	Result flatUnparse = best([&](){ flat->unparse(null); }, runs);
+	printRow("unparse", ptrUnparse, flatUnparse, nodes);
+
+	drewgon::NameAnalysis * names = nullptr;
+	FlatNameAnalysis * flatNames = nullptr;
+	Result ptrNames = best([&](){ names = drewgon::NameAnalysis::build(ast); }, runs);
+	Result flatNamesRes = best([&](){
+		delete flatNames;
+		flatNames = FlatNameAnalysis::build(flat);
+	}, runs);
+	if (names == nullptr || flatNames == nullptr){
+		std::cerr << "Name analysis failed\n";
+		return 1;
+	}
+	printRow("name analysis", ptrNames, flatNamesRes, nodes);
+
+	FlatTypeAnalysis * flatTypes = nullptr;
+	bool typed = true;
+	Result ptrTypes = best([&](){
+		typed = TypeAnalysis::build(names) != nullptr && typed;
+	}, runs);
+	Result flatTypesRes = best([&](){
+		delete flatTypes;
+		flatTypes = FlatTypeAnalysis::build(flatNames);
+	}, runs);
+	if (!typed || flatTypes == nullptr){
+		std::cerr << "Type analysis failed\n";
+		return 1;
+	}
+	printRow("type analysis", ptrTypes, flatTypesRes, nodes);
+
+	char dir[] = "/tmp/astbenchXXXXXX";
+	if (mkdtemp(dir) == nullptr){
+		std::cerr << "Could not make a directory for the AST cache\n";
+		return 1;
+	}
+	ASTCache cache(dir);
+	const SourceFile * src = session.source();
+	cache.store(src, flat);
+	FlatAST * loaded = nullptr;
+	Result load = best([&](){
+		delete loaded;
+		loaded = cache.load(src);
+	}, runs);
+	if (loaded == nullptr){
+		std::cerr << "Loading from the AST cache failed\n";
+		return 1;
+	}
+	Result rebuild = best([&](){
+		Arena arena;
+		ASTBuilder builder(&arena);
+		loaded->toAST(&builder);
+	}, runs);
+	Result parse = best([&](){
+		CompilationSession again(path);
+		again.setFastScan(true);
+		again.parseAll();
+	}, runs);
+	std::cout << "parse " << parse.ms << " ms; from the AST cache: load "
+	  << load.ms << " ms, rebuild the AST " << rebuild.ms << " ms\n";
+	removeDir(dir);
+
+	delete loaded;
+	delete flatTypes;
+	delete flatNames;
+	delete flat;
+	return 0;
+}
@@ -0,0 +1,347 @@
+// Measures how fast the code dgc generates runs. Each program in
+// programs/ has a Drewgon version (<name>.dg) and a hand-written C
+// equivalent (<name>.c). The harness builds the Drewgon one with
+// dgc -x and the C one with gcc -O0 and -O2, runs each a few
+// times counting cycles and instructions (as perf stat would, but
+// through perf_event_open), and reports dgc's slowdown against
+// both. Where hardware counters aren't available (as in many VMs)
+// it compares wall times instead.
+//
+// A dgc build that fails, crashes, runs past the CPU time limit
+// or prints something other than what the C program prints is
+// reported as such rather than timed.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <linux/perf_event.h>
+#include <signal.h>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+class Options{
+public:
+	std::string dgc = "../dgc";
+	std::string cc = "gcc";
+	std::string programs = "programs";
+	std::string work = "/tmp/dgc-codebench";
+	unsigned int runs = 3;
+	//CPU seconds a run may take before it is killed
+	unsigned int timeout = 30;
+};
+
+class Counts{
+public:
+	bool ok = false;
+	//Why it isn't ok
+	std::string status;
+	double wallMs = 0;
+	//Zero when the counters couldn't be read
+	uint64_t cycles = 0;
+	uint64_t instructions = 0;
+};
+
+int openCounter(uint64_t config, pid_t pid, int group){
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = group < 0 ? 1u : 0u;
+	attr.enable_on_exec = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, pid, -1, group, 0));
+}
+
+//Run args with stdout sent to outPath, counting its user-space
+// cycles and instructions from exec to exit
+Counts runCounted(const Options& opts, const std::vector<std::string>& args,
+  const std::string& outPath){
+	Counts res;
+	std::vector<char *> argv;
+	for (const std::string& arg : args){
+		argv.push_back(const_cast<char *>(arg.c_str()));
+	}
+	argv.push_back(nullptr);
+	int go[2];
+	if (pipe(go) != 0){
+		res.status = "pipe failed";
+		return res;
+	}
+	pid_t pid = fork();
+	if (pid < 0){
+		res.status = "fork failed";
+		return res;
+	}
+	if (pid == 0){
+		//Wait for the counters to be attached before exec
+		close(go[1]);
+		char c;
+		if (read(go[0], &c, 1) < 0){ _exit(127); }
+		int out = open(outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (out < 0){ _exit(127); }
+		dup2(out, 1);
+		struct rlimit cpu;
+		cpu.rlim_cur = opts.timeout;
+		cpu.rlim_max = opts.timeout + 1;
+		setrlimit(RLIMIT_CPU, &cpu);
+		execv(argv[0], argv.data());
+		_exit(127);
+	}
+	close(go[0]);
+	int cycles = openCounter(PERF_COUNT_HW_CPU_CYCLES, pid, -1);
+	int instrs = cycles < 0 ? -1
+	  : openCounter(PERF_COUNT_HW_INSTRUCTIONS, pid, cycles);
+	auto start = std::chrono::steady_clock::now();
+	close(go[1]);
+
+	int status;
+	waitpid(pid, &status, 0);
+	auto end = std::chrono::steady_clock::now();
+	res.wallMs = std::chrono::duration<double, std::milli>(end - start).count();
+	uint64_t val;
+	if (cycles >= 0 && read(cycles, &val, sizeof(val)) == sizeof(val)){
+		res.cycles = val;
+	}
+	if (instrs >= 0 && read(instrs, &val, sizeof(val)) == sizeof(val)){
+		res.instructions = val;
+	}
+	if (cycles >= 0){ close(cycles); }
+	if (instrs >= 0){ close(instrs); }
+
+	if (WIFSIGNALED(status)){
+		int sig = WTERMSIG(status);
+		res.status = sig == SIGXCPU || sig == SIGKILL ? "timed out"
+		  : std::string("crashed (") + strsignal(sig) + ")";
+		return res;
+	}
+	//Drewgon programs exit with main's result, so any status is
+	// fine; the output is what gets checked
+	res.ok = true;
+	return res;
+}
+
+//Run a build command, returning the first line of its errors (or
+// an empty string if it succeeded)
+std::string build(const std::vector<std::string>& args, const std::string& errPath){
+	std::vector<char *> argv;
+	for (const std::string& arg : args){
+		argv.push_back(const_cast<char *>(arg.c_str()));
+	}
+	argv.push_back(nullptr);
+	pid_t pid = fork();
+	if (pid == 0){
+		int err = open(errPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (err < 0){ _exit(127); }
+		dup2(err, 1);
+		dup2(err, 2);
+		execvp(argv[0], argv.data());
+		_exit(127);
+	}
+	int status = 0;
+	if (pid < 0 || waitpid(pid, &status, 0) != pid){ return "could not run " + args[0]; }
+	if (WIFEXITED(status) && WEXITSTATUS(status) == 0){ return ""; }
+	std::ifstream in(errPath);
+	std::string line;
+	std::getline(in, line);
+	return line.empty() ? args[0] + " failed" : line;
+}
+
+std::string slurp(const std::string& path){
+	std::ifstream in(path);
+	std::ostringstream res;
+	res << in.rdbuf();
+	return res.str();
+}
+
+//The best of opts.runs runs of a binary, or the first failure.
+// The output of the last run is left in outPath.
+Counts measure(const Options& opts, const std::vector<std::string>& args,
+  const std::string& outPath){
+	Counts best;
+	for (unsigned int i = 0; i < opts.runs; i++){
+		Counts run = runCounted(opts, args, outPath);
+		if (!run.ok){ return run; }
+		if (!best.ok){
+			best = run;
+			continue;
+		}
+		best.wallMs = std::min(best.wallMs, run.wallMs);
+		best.cycles = std::min(best.cycles, run.cycles);
+		best.instructions = std::min(best.instructions, run.instructions);
+	}
+	return best;
+}
+
+//What the slowdowns are computed from
+double cost(const Counts& counts){
+	return counts.cycles > 0 ? static_cast<double>(counts.cycles) : counts.wallMs;
+}
+
+std::vector<std::string> programNames(const std::string& dir){
+	std::vector<std::string> res;
+	DIR * d = opendir(dir.c_str());
+	if (d == nullptr){ return res; }
+	while (struct dirent * ent = readdir(d)){
+		std::string name = ent->d_name;
+		if (name.size() < 4 || name.compare(name.size() - 3, 3, ".dg") != 0){ continue; }
+		std::string base = name.substr(0, name.size() - 3);
+		if (access((dir + "/" + base + ".c").c_str(), R_OK) == 0){
+			res.push_back(base);
+		}
+	}
+	closedir(d);
+	std::sort(res.begin(), res.end());
+	return res;
+}
+
+void printRow(const std::string& prog, const std::string& variant,
+  const Counts& counts, const std::string& note){
+	std::cout << std::left << std::setw(10) << prog << std::setw(8) << variant
+	  << std::right;
+	if (!counts.ok){
+		std::cout << "  " << counts.status << "\n";
+		return;
+	}
+	if (counts.cycles > 0){
+		std::cout << std::setw(14) << counts.cycles << std::setw(14)
+		  << counts.instructions;
+	} else {
+		std::cout << std::setw(14) << "n/a" << std::setw(14) << "n/a";
+	}
+	std::cout << std::setw(11) << std::fixed << std::setprecision(1)
+	  << counts.wallMs << note << "\n";
+}
+
+std::string ratio(double num, double den){
+	std::ostringstream res;
+	res << std::fixed << std::setprecision(2) << num / den << "x";
+	return res.str();
+}
+
+void usage(std::ostream& out){
+	out << "Usage: codebench [options] [program...]\n"
+	<< " [--dgc <path>]: The dgc whose code to measure (default ../dgc)\n"
+	<< " [--cc <path>]: The C compiler to compare against (default gcc)\n"
+	<< " [--programs <dir>]: Where the .dg/.c pairs are (default programs)\n"
+	<< " [--work <dir>]: Where binaries go (default /tmp/dgc-codebench)\n"
+	<< " [--runs <n>]: Runs per binary, keeping the best (default 3)\n"
+	<< " [--timeout <secs>]: CPU time limit per run (default 30)\n";
+}
+
+}
+
+int main(int argc, char * argv[]){
+	Options opts;
+	std::vector<std::string> names;
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if (arg[0] != '-'){
+			names.push_back(arg);
+			continue;
+		}
+		if (i + 1 >= argc){
+			usage(std::cerr);
+			return 2;
+		}
+		std::string val = argv[++i];
+		if (arg == "--dgc"){ opts.dgc = val; }
+		else if (arg == "--cc"){ opts.cc = val; }
+		else if (arg == "--programs"){ opts.programs = val; }
+		else if (arg == "--work"){ opts.work = val; }
+		else if (arg == "--runs"){ opts.runs = static_cast<unsigned int>(std::max(1ul, strtoul(val.c_str(), nullptr, 10))); }
+		else if (arg == "--timeout"){ opts.timeout = static_cast<unsigned int>(strtoul(val.c_str(), nullptr, 10)); }
+		else {
+			usage(std::cerr);
+			return 2;
+		}
+	}
+	if (names.empty()){ names = programNames(opts.programs); }
+	if (names.empty()){
+		std::cerr << "No programs in " << opts.programs << "\n";
+		return 2;
+	}
+	mkdir(opts.work.c_str(), 0755);
+
+	std::cout << std::left << std::setw(10) << "program" << std::setw(8)
+	  << "build" << std::right << std::setw(14) << "cycles" << std::setw(14)
+	  << "instructions" << std::setw(11) << "wall (ms)" << "\n";
+	bool counted = true;
+	size_t failures = 0;
+	for (const std::string& name : names){
+		std::string src = opts.programs + "/" + name;
+		std::string bin = opts.work + "/" + name;
+		std::string err = opts.work + "/build.txt";
+
+		Counts ref[2];
+		const char * const levels[] = {"-O0", "-O2"};
+		for (int l = 0; l < 2; l++){
+			std::string exe = bin + levels[l];
+			std::string failed = build({opts.cc, levels[l], src + ".c", "-o", exe}, err);
+			if (!failed.empty()){
+				ref[l].status = "build failed: " + failed;
+			} else {
+				ref[l] = measure(opts, {exe}, bin + levels[l] + ".out");
+				counted = counted && (!ref[l].ok || ref[l].cycles > 0);
+			}
+			printRow(name, std::string("gcc") + levels[l], ref[l], "");
+		}
+
+		//Natively through dgc -x, and through dgc's interpreter
+		// (whose times include compiling to bytecode)
+		std::string exe = bin + "-dgc";
+		Counts dgc;
+		std::string failed = build({opts.dgc, src + ".dg", "-x", exe}, err);
+		if (!failed.empty()){
+			dgc.status = "build failed: " + failed;
+		} else {
+			dgc = measure(opts, {exe}, exe + ".out");
+		}
+		Counts vm = measure(opts, {opts.dgc, src + ".dg", "--vm"}, bin + "-vm.out");
+		Counts * const runs[] = {&dgc, &vm};
+		const char * const variants[] = {"dgc", "dgc-vm"};
+		const char * const outs[] = {"-dgc.out", "-vm.out"};
+		for (int v = 0; v < 2; v++){
+			Counts& counts = *runs[v];
+			if (counts.ok && ref[0].ok
+			  && slurp(bin + outs[v]) != slurp(bin + "-O0.out")){
+				counts.ok = false;
+				counts.status = "wrong output";
+			}
+			std::string note;
+			if (counts.ok){
+				counted = counted && counts.cycles > 0;
+				for (int l = 0; l < 2; l++){
+					if (ref[l].ok){
+						note += "  " + ratio(cost(counts), cost(ref[l])) + " vs " + levels[l];
+					}
+				}
+			} else {
+				failures++;
+			}
+			printRow(name, variants[v], counts, note);
+		}
+	}
+	if (!counted){
+		std::cout << "(hardware counters unavailable: slowdowns are by wall time)\n";
+	}
+	if (failures > 0){
+		std::cout << failures << " dgc build(s) could not be measured\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,394 @@
+// Generates syntactically and type-valid Drewgon programs of a
+// tunable shape, for measuring how dgc scales with its input.
+//
+// Functions only call functions defined before them, and loops
+// run a small constant number of times, so a generated program
+// always terminates. Nested loops around calls multiply, so gen
+// keeps count of the statements each call runs and leaves out
+// calls that would take a run of the program past a set amount of
+// work. The programs are meant for compiling, but they can be run
+// too.
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+class Shape{
+public:
+	size_t functions = 100;
+	//How deeply if/while/for blocks nest in a function body
+	size_t depth = 2;
+	//How deeply operators nest in an expression
+	size_t nesting = 3;
+	size_t globals = 20;
+	//Percent of expression operands that are calls
+	unsigned int callDensity = 10;
+	//Percent of statements that output a string literal
+	unsigned int strings = 5;
+	//Statements in each block
+	size_t stmts = 6;
+	//If nonzero, generate functions until there are this many
+	// lines (overriding functions)
+	size_t lines = 0;
+	//About how many statements a run of the program may execute
+	double work = 10000000;
+	unsigned int seed = 1;
+};
+
+class Function{
+public:
+	std::string name;
+	size_t intParams;
+	bool boolParam;
+	bool returnsBool;
+	//About how many statements a call runs, calls included
+	double cost;
+};
+
+class Generator{
+public:
+	Generator(const Shape& shapeIn) : shape(shapeIn), rng(shapeIn.seed){ }
+	void generate(std::ostream& out);
+private:
+	unsigned int roll(unsigned int n){
+		return static_cast<unsigned int>(rng() % n);
+	}
+	bool percent(unsigned int pct){ return roll(100) < pct; }
+	void line(const std::string& text);
+	void function(size_t idx);
+	void block(size_t depth);
+	void loopBody(size_t depth, unsigned int trips);
+	void statement(size_t depth);
+	std::string intVar();
+	std::string boolVar();
+	std::string intExp(size_t nesting);
+	std::string boolExp(size_t nesting);
+	std::string call(bool wantBool);
+
+	const Shape& shape;
+	std::mt19937 rng;
+	std::string text;
+	size_t numLines = 0;
+	size_t indent = 0;
+	std::vector<Function> fns;
+	//The variables the function being generated can use
+	std::vector<std::string> ints;
+	std::vector<std::string> bools;
+	//The statements a call to the function being generated runs
+	// so far, and how many times the code being generated runs
+	// per call (the trip counts of the loops around it)
+	double cost = 0;
+	double runs = 1;
+	size_t nextString = 0;
+};
+
+void Generator::line(const std::string& str){
+	text.append(indent, '\t');
+	text += str;
+	text += '\n';
+	numLines++;
+}
+
+std::string Generator::intVar(){
+	return ints[roll(static_cast<unsigned int>(ints.size()))];
+}
+
+std::string Generator::boolVar(){
+	return bools[roll(static_cast<unsigned int>(bools.size()))];
+}
+
+//A call to an earlier function that returns the wanted type, or
+// an empty string if there is none. main calls the last eight
+// functions, so each call may cost an eighth of the program's work.
+std::string Generator::call(bool wantBool){
+	if (fns.empty()){ return ""; }
+	const Function& fn = fns[roll(static_cast<unsigned int>(fns.size()))];
+	if (fn.returnsBool != wantBool){ return ""; }
+	if (cost + fn.cost * runs > shape.work / 8){ return ""; }
+	cost += fn.cost * runs;
+	std::string res = fn.name + "(";
+	for (size_t i = 0; i < fn.intParams; i++){
+		res += (i == 0 ? "" : ", ") + intVar();
+	}
+	if (fn.boolParam){
+		res += (fn.intParams == 0 ? "" : ", ") + boolVar();
+	}
+	return res + ")";
+}
+
+std::string Generator::intExp(size_t nesting){
+	if (nesting == 0 || roll(4) == 0){
+		if (percent(shape.callDensity)){
+			std::string res = call(false);
+			if (!res.empty()){ return res; }
+		}
+		switch (roll(3)){
+			case 0: return std::to_string(roll(1000));
+			default: return intVar();
+		}
+	}
+	switch (roll(5)){
+		case 0: return "(" + intExp(nesting - 1) + " - " + intExp(nesting - 1) + ")";
+		case 1: return "(" + intExp(nesting - 1) + " * " + intExp(nesting - 1) + ")";
+		case 2: return "(" + intExp(nesting - 1) + " / " + std::to_string(roll(9) + 1) + ")";
+		case 3: return "-" + intVar();
+		default: return "(" + intExp(nesting - 1) + " + " + intExp(nesting - 1) + ")";
+	}
+}
+
+std::string Generator::boolExp(size_t nesting){
+	if (nesting == 0 || roll(4) == 0){
+		if (percent(shape.callDensity)){
+			std::string res = call(true);
+			if (!res.empty()){ return res; }
+		}
+		switch (roll(4)){
+			case 0: return "true";
+			case 1: return "false";
+			default: return boolVar();
+		}
+	}
+	static const char * const rel[] = {"<", ">", "<=", ">=", "==", "!="};
+	switch (roll(4)){
+		case 0: return "(" + boolExp(nesting - 1) + " and " + boolExp(nesting - 1) + ")";
+		case 1: return "(" + boolExp(nesting - 1) + " or " + boolExp(nesting - 1) + ")";
+		case 2: return "!" + boolVar();
+		default: return "(" + intExp(nesting - 1) + " " + rel[roll(6)] + " "
+		  + intExp(nesting - 1) + ")";
+	}
+}
+
+void Generator::statement(size_t depth){
+	cost += runs;
+	if (percent(shape.strings)){
+		line("output \"s" + std::to_string(nextString++) + "\\n\";");
+		return;
+	}
+	unsigned int kind = roll(depth > 0 ? 10 : 7);
+	switch (kind){
+		case 0: line(intVar() + "++;"); return;
+		case 1: line("output " + intExp(shape.nesting) + ";"); return;
+		case 2: line(boolVar() + " = " + boolExp(shape.nesting) + ";"); return;
+		case 3: {
+			std::string res = call(roll(2) == 0);
+			if (!res.empty()){
+				line(res + ";");
+				return;
+			}
+			break;
+		}
+		case 7: {
+			//Both branches are counted, as if each ran every time
+			line("if (" + boolExp(shape.nesting) + "){");
+			block(depth - 1);
+			if (roll(2) == 0){
+				line("} else {");
+				block(depth - 1);
+			}
+			line("}");
+			return;
+		}
+		case 8: {
+			//Each level of nesting has its own loop variable, so
+			// inner loops can't keep outer ones going
+			std::string i = "i" + std::to_string(depth - 1);
+			unsigned int trips = roll(4) + 1;
+			line("for (" + i + " = 0; " + i + " < " + std::to_string(trips)
+			  + "; " + i + "++){");
+			loopBody(depth, trips);
+			line("}");
+			return;
+		}
+		case 9: {
+			std::string i = "i" + std::to_string(depth - 1);
+			unsigned int trips = roll(4) + 1;
+			line(i + " = " + std::to_string(trips) + ";");
+			line("while (" + i + " > 0){");
+			loopBody(depth, trips);
+			indent++;
+			line(i + "--;");
+			indent--;
+			line("}");
+			return;
+		}
+		default: break;
+	}
+	line(intVar() + " = " + intExp(shape.nesting) + ";");
+}
+
+void Generator::loopBody(size_t depth, unsigned int trips){
+	double outer = runs;
+	runs *= trips;
+	block(depth - 1);
+	runs = outer;
+}
+
+void Generator::block(size_t depth){
+	indent++;
+	for (size_t i = 0; i < shape.stmts; i++){
+		statement(depth);
+	}
+	indent--;
+}
+
+void Generator::function(size_t idx){
+	Function fn;
+	fn.name = "f" + std::to_string(idx);
+	fn.intParams = roll(4);
+	fn.boolParam = roll(2) == 0;
+	fn.returnsBool = roll(4) == 0;
+	cost = 0;
+	runs = 1;
+
+	std::string header = (fn.returnsBool ? "bool " : "int ") + fn.name + "(";
+	ints.clear();
+	bools.clear();
+	for (size_t i = 0; i < shape.globals; i++){
+		(i % 3 == 2 ? bools : ints).push_back("g" + std::to_string(i));
+	}
+	for (size_t i = 0; i < fn.intParams; i++){
+		ints.push_back("p" + std::to_string(i));
+		header += (i == 0 ? "" : ", ") + std::string("int ") + ints.back();
+	}
+	if (fn.boolParam){
+		bools.push_back("q");
+		header += (fn.intParams == 0 ? "" : ", ") + std::string("bool q");
+	}
+	line(header + "){");
+	indent++;
+	line("int x;");
+	line("int y;");
+	line("bool b;");
+	ints.push_back("x");
+	ints.push_back("y");
+	bools.push_back("b");
+	for (size_t i = 0; i < shape.depth; i++){
+		line("int i" + std::to_string(i) + ";");
+	}
+	//Locals start out as whatever was on the stack, so set them
+	// before they are read, for a run to be repeatable
+	line("x = 0;");
+	line("y = 0;");
+	line("b = false;");
+	indent--;
+	block(shape.depth);
+	indent++;
+	line("return " + (fn.returnsBool ? boolExp(shape.nesting) : intExp(shape.nesting)) + ";");
+	indent--;
+	line("}");
+	line("");
+	fn.cost = cost;
+	fns.push_back(fn);
+}
+
+void Generator::generate(std::ostream& out){
+	for (size_t i = 0; i < shape.globals; i++){
+		line((i % 3 == 2 ? "bool g" : "int g") + std::to_string(i) + ";");
+	}
+	line("");
+	for (size_t i = 0; shape.lines > 0 ? numLines < shape.lines : i < shape.functions; i++){
+		function(i);
+		//Write as we go, so huge programs needn't fit in memory
+		out << text;
+		text.clear();
+	}
+
+	//main calls the last few functions
+	line("int main(){");
+	indent++;
+	for (size_t i = fns.size() > 8 ? fns.size() - 8 : 0; i < fns.size(); i++){
+		const Function& fn = fns[i];
+		std::string args;
+		for (size_t p = 0; p < fn.intParams; p++){
+			args += (p == 0 ? "" : ", ") + std::to_string(p + 1);
+		}
+		if (fn.boolParam){
+			args += fn.intParams == 0 ? "true" : ", true";
+		}
+		line("output " + fn.name + "(" + args + ");");
+	}
+	line("return 0;");
+	indent--;
+	line("}");
+	out << text;
+}
+
+void usage(std::ostream& out){
+	out << "Usage: gen [options] [-o <file>]\n"
+	<< " [--functions <n>]: Number of functions (default 100)\n"
+	<< " [--lines <n>]: Generate functions until the program is <n> lines\n"
+	<< " [--depth <n>]: Nesting depth of if/while/for blocks (default 2)\n"
+	<< " [--nesting <n>]: Nesting depth of expressions (default 3)\n"
+	<< " [--globals <n>]: Number of global variables (default 20)\n"
+	<< " [--calls <pct>]: Percent of operands that are calls (default 10)\n"
+	<< " [--strings <pct>]: Percent of statements that output a string (default 5)\n"
+	<< " [--stmts <n>]: Statements per block (default 6)\n"
+	<< " [--work <n>]: Leave out calls that would make a run of the\n"
+	<< "  program execute more than about <n> statements (default 10000000)\n"
+	<< " [--seed <n>]: Random seed (default 1)\n";
+}
+
+bool parseNum(const char * str, size_t& res){
+	char * end;
+	unsigned long long val = strtoull(str, &end, 10);
+	if (*str == '\0' || *end != '\0'){ return false; }
+	res = static_cast<size_t>(val);
+	return true;
+}
+
+}
+
+int main(int argc, char * argv[]){
+	Shape shape;
+	const char * outPath = nullptr;
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if (i + 1 >= argc){
+			usage(std::cerr);
+			return 1;
+		}
+		const char * val = argv[++i];
+		size_t num = 0;
+		if (arg == "-o"){
+			outPath = val;
+			continue;
+		}
+		if (!parseNum(val, num)){
+			usage(std::cerr);
+			return 1;
+		}
+		if (arg == "--functions"){ shape.functions = num; }
+		else if (arg == "--lines"){ shape.lines = num; }
+		else if (arg == "--depth"){ shape.depth = num; }
+		else if (arg == "--nesting"){ shape.nesting = num; }
+		else if (arg == "--globals"){ shape.globals = num; }
+		else if (arg == "--calls"){ shape.callDensity = static_cast<unsigned int>(num); }
+		else if (arg == "--strings"){ shape.strings = static_cast<unsigned int>(num); }
+		else if (arg == "--stmts"){ shape.stmts = num; }
+		else if (arg == "--work"){ shape.work = static_cast<double>(num); }
+		else if (arg == "--seed"){ shape.seed = static_cast<unsigned int>(num); }
+		else {
+			usage(std::cerr);
+			return 1;
+		}
+	}
+	//Every function needs an int and a bool to work with
+	if (shape.globals < 3){ shape.globals = 3; }
+
+	Generator gen(shape);
+	if (outPath == nullptr){
+		gen.generate(std::cout);
+		return 0;
+	}
+	std::ofstream out(outPath);
+	if (!out.good()){
+		std::cerr << "Could not open " << outPath << "\n";
+		return 1;
+	}
+	gen.generate(out);
+	return out.good() ? 0 : 1;
+}
@@ -0,0 +1,380 @@
+// Measures how dgc's compile time and memory scale with program
+// size. For each size on the ladder (1K to 10M lines), it has gen
+// write a program, compiles it with dgc -ftime-report a few times,
+// and keeps the best wall time of each top-level phase, the whole
+// run's wall time and its peak RSS. Those are compared against a
+// stored baseline, and any that got notably worse are flagged (and
+// make the harness exit with status 1).
+//
+// Baselines are only meaningful on the machine and build of dgc
+// that recorded them, so the baseline names both, and the harness
+// won't compare against one recorded elsewhere. Rerun with
+// --update after changing machines or compilers, or after a
+// change that is meant to move the numbers.
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+const size_t LADDER[] = {1000, 10000, 100000, 1000000, 10000000};
+const char * const TOTAL = "total";
+const char * const PEAK_RSS = "peak RSS (KB)";
+
+class Options{
+public:
+	std::string dgc = "../dgc";
+	std::string gen = "./gen";
+	std::string work = "/tmp/dgc-bench";
+	std::string baseline = "baseline.txt";
+	std::string stage = "asm";
+	//How dgc was built (the compiler and its version)
+	std::string build = "unknown";
+	size_t maxLines = 10000000;
+	unsigned int runs = 3;
+	//How much worse than the baseline (in percent) counts as a
+	// regression
+	double threshold = 15;
+	bool update = false;
+};
+
+//Measurements for one program size, by metric
+typedef std::map<std::string, double> Metrics;
+//Measurements by program size
+typedef std::map<size_t, Metrics> Results;
+
+class Baseline{
+public:
+	//The machine and the build of dgc the results were taken on
+	std::string host;
+	std::string build;
+	Results results;
+};
+
+class Run{
+public:
+	bool ok;
+	double wallMs;
+	long peakRssKb;
+};
+
+//Run argv with stdout discarded and stderr sent to errPath
+Run runProcess(const std::vector<std::string>& args, const std::string& errPath){
+	std::vector<char *> argv;
+	for (const std::string& arg : args){
+		argv.push_back(const_cast<char *>(arg.c_str()));
+	}
+	argv.push_back(nullptr);
+
+	Run res;
+	res.ok = false;
+	res.wallMs = 0;
+	res.peakRssKb = 0;
+	auto start = std::chrono::steady_clock::now();
+	pid_t pid = fork();
+	if (pid < 0){ return res; }
+	if (pid == 0){
+		int devNull = open("/dev/null", O_WRONLY);
+		int err = open(errPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (devNull < 0 || err < 0){ _exit(127); }
+		dup2(devNull, 1);
+		dup2(err, 2);
+		execv(argv[0], argv.data());
+		_exit(127);
+	}
+	int status;
+	struct rusage usage;
+	if (wait4(pid, &status, 0, &usage) != pid){ return res; }
+	auto end = std::chrono::steady_clock::now();
+	res.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+	res.wallMs = std::chrono::duration<double, std::milli>(end - start).count();
+	res.peakRssKb = usage.ru_maxrss;
+	return res;
+}
+
+//The top-level phases of a -ftime-report, whose lines are two
+// 12-column times (wall, then CPU) and the phase, indented two
+// spaces more for each level of nesting
+Metrics parseTimeReport(const std::string& path){
+	Metrics res;
+	std::ifstream in(path);
+	std::string line;
+	bool inReport = false;
+	while (std::getline(in, line)){
+		if (line.compare(0, 8, "===-- Ti") == 0){
+			inReport = true;
+			continue;
+		}
+		if (!inReport || line.size() <= 27 || line[26] == ' '){ continue; }
+		char * end;
+		double wall = strtod(line.c_str(), &end);
+		if (end == line.c_str()){ continue; }
+		std::string phase = line.substr(26);
+		res[phase] = res.count(phase) ? std::min(res[phase], wall) : wall;
+	}
+	return res;
+}
+
+//The dgc flags that take the compilation through the stage
+std::vector<std::string> stageFlags(const Options& opts, size_t lines){
+	std::string out = "/dev/null";
+	if (opts.stage == "check"){ return {"-c"}; }
+	if (opts.stage == "3ac"){ return {"-a", out}; }
+	if (opts.stage == "asm"){ return {"-o", out}; }
+	if (opts.stage == "obj"){ return {"-b", out}; }
+	//Linking makes its output executable, so it gets a real file
+	return {"-x", opts.work + "/prog_" + std::to_string(lines)};
+}
+
+bool measure(const Options& opts, size_t lines, Metrics& res){
+	std::string src = opts.work + "/prog_" + std::to_string(lines) + ".dg";
+	std::string err = opts.work + "/report.txt";
+	Run gen = runProcess({opts.gen, "--lines", std::to_string(lines),
+	  "-o", src}, err);
+	if (!gen.ok){
+		std::cerr << "gen failed for " << lines << " lines\n";
+		return false;
+	}
+
+	std::vector<std::string> args = {opts.dgc, src, "-ftime-report"};
+	std::vector<std::string> flags = stageFlags(opts, lines);
+	args.insert(args.end(), flags.begin(), flags.end());
+	for (unsigned int i = 0; i < opts.runs; i++){
+		Run run = runProcess(args, err);
+		if (!run.ok){
+			std::cerr << "dgc failed on " << src << " (see " << err << ")\n";
+			return false;
+		}
+		Metrics phases = parseTimeReport(err);
+		phases[TOTAL] = run.wallMs;
+		phases[PEAK_RSS] = static_cast<double>(run.peakRssKb);
+		for (auto& phase : phases){
+			auto known = res.find(phase.first);
+			if (known == res.end() || phase.second < known->second){
+				res[phase.first] = phase.second;
+			}
+		}
+	}
+	unlink(src.c_str());
+	return true;
+}
+
+//The machine we're running on: its architecture, CPU model and
+// number of CPUs. The hostname is left out, as it tells little
+// about speed and changes with every container.
+std::string hostDescription(){
+	std::string res = "unknown";
+	struct utsname name;
+	if (uname(&name) == 0){ res = name.machine; }
+	std::ifstream cpus("/proc/cpuinfo");
+	std::string line;
+	std::string model;
+	size_t count = 0;
+	while (std::getline(cpus, line)){
+		if (line.compare(0, 9, "processor") == 0){ count++; }
+		if (model.empty() && line.compare(0, 10, "model name") == 0){
+			size_t colon = line.find(':');
+			if (colon != std::string::npos){
+				model = line.substr(line.find_first_not_of(" \t", colon + 1));
+			}
+		}
+	}
+	if (!model.empty()){ res += ", " + model; }
+	long online = sysconf(_SC_NPROCESSORS_ONLN);
+	if (online > 0){ count = static_cast<size_t>(online); }
+	return res + ", " + std::to_string(count) + (count == 1 ? " CPU" : " CPUs");
+}
+
+//Baselines are a "host: " and a "build: " line, then lines of
+// "<program lines> <value> <metric>"
+Baseline readBaseline(const std::string& path){
+	Baseline res;
+	std::ifstream in(path);
+	std::string line;
+	while (std::getline(in, line)){
+		if (line.empty() || line[0] == '#'){ continue; }
+		if (line.compare(0, 6, "host: ") == 0){
+			res.host = line.substr(6);
+			continue;
+		}
+		if (line.compare(0, 7, "build: ") == 0){
+			res.build = line.substr(7);
+			continue;
+		}
+		std::istringstream fields(line);
+		size_t lines;
+		double val;
+		std::string metric;
+		if (!(fields >> lines >> val)){ continue; }
+		std::getline(fields >> std::ws, metric);
+		res.results[lines][metric] = val;
+	}
+	return res;
+}
+
+bool writeBaseline(const std::string& path, const Baseline& baseline){
+	std::ofstream out(path);
+	out << "# dgc compile-time baseline: <program lines> <value> <metric>\n"
+	  << "# Times are best-of-run wall milliseconds. Regenerate with\n"
+	  << "# make baseline.\n"
+	  << "host: " << baseline.host << "\n"
+	  << "build: " << baseline.build << "\n";
+	for (auto& size : baseline.results){
+		for (auto& metric : size.second){
+			out << size.first << " " << std::fixed << std::setprecision(3)
+			  << metric.second << " " << metric.first << "\n";
+		}
+	}
+	return out.good();
+}
+
+//Differences smaller than these are noise whatever the percentage
+bool isRegression(const Options& opts, const std::string& metric,
+  double now, double base){
+	double floor = metric == PEAK_RSS ? 2048 : 2;
+	return now - base > floor && now > base * (1 + opts.threshold / 100);
+}
+
+void usage(std::ostream& out){
+	out << "Usage: harness [options]\n"
+	<< " [--dgc <path>]: The dgc to measure (default ../dgc)\n"
+	<< " [--gen <path>]: The program generator (default ./gen)\n"
+	<< " [--work <dir>]: Where generated programs go (default /tmp/dgc-bench)\n"
+	<< " [--baseline <file>]: Baseline to compare against (default baseline.txt)\n"
+	<< " [--update]: Record this run's numbers as the baseline\n"
+	<< " [--build <desc>]: How dgc was built, e.g. its compiler and version\n"
+	<< "  (the baseline is only compared against runs of the same build)\n"
+	<< " [--max-lines <n>]: Skip programs bigger than <n> lines\n"
+	<< " [--runs <n>]: Compilations per size, keeping the best (default 3)\n"
+	<< " [--threshold <pct>]: Slowdown that counts as a regression (default 15)\n"
+	<< " [--stage check|3ac|asm|obj|exe]: How far to compile (default asm)\n";
+}
+
+bool parseArgs(int argc, char * argv[], Options& opts){
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if (arg == "--update"){
+			opts.update = true;
+			continue;
+		}
+		if (i + 1 >= argc){ return false; }
+		std::string val = argv[++i];
+		if (arg == "--dgc"){ opts.dgc = val; }
+		else if (arg == "--gen"){ opts.gen = val; }
+		else if (arg == "--work"){ opts.work = val; }
+		else if (arg == "--baseline"){ opts.baseline = val; }
+		else if (arg == "--build"){ opts.build = val; }
+		else if (arg == "--max-lines"){ opts.maxLines = strtoul(val.c_str(), nullptr, 10); }
+		else if (arg == "--runs"){ opts.runs = static_cast<unsigned int>(std::max(1ul, strtoul(val.c_str(), nullptr, 10))); }
+		else if (arg == "--threshold"){ opts.threshold = strtod(val.c_str(), nullptr); }
+		else if (arg == "--stage"){
+			if (val != "check" && val != "3ac" && val != "asm" && val != "obj"
+			  && val != "exe"){
+				return false;
+			}
+			opts.stage = val;
+		}
+		else { return false; }
+	}
+	return true;
+}
+
+}
+
+int main(int argc, char * argv[]){
+	Options opts;
+	if (!parseArgs(argc, argv, opts)){
+		usage(std::cerr);
+		return 2;
+	}
+	mkdir(opts.work.c_str(), 0755);
+
+	Baseline recorded = readBaseline(opts.baseline);
+	Baseline updated;
+	updated.host = hostDescription();
+	updated.build = opts.build;
+	bool sameSetup = recorded.host == updated.host
+	  && recorded.build == updated.build;
+	if (!opts.update && !sameSetup){
+		std::cerr << opts.baseline << " was recorded on\n  "
+		  << (recorded.host.empty() ? "an unknown host" : recorded.host)
+		  << "\nwith\n  "
+		  << (recorded.build.empty() ? "an unknown build" : recorded.build)
+		  << "\nbut this is\n  " << updated.host << "\nwith\n  "
+		  << updated.build << "\nso its numbers can't be compared. Record"
+		  << " a baseline for this host and build with --update (make"
+		  << " baseline).\n";
+		return 2;
+	}
+	const Results& baseline = recorded.results;
+	Results& results = updated.results;
+	//Sizes this run skips keep their old numbers, if those were
+	// taken on this host and build
+	if (sameSetup){ results = baseline; }
+	size_t regressions = 0;
+	bool failed = false;
+	std::cout << std::setw(9) << "lines" << "  " << std::left << std::setw(20)
+	  << "metric" << std::right << std::setw(12) << "now" << std::setw(12)
+	  << "baseline" << std::setw(10) << "change" << "\n";
+	for (size_t lines : LADDER){
+		if (lines > opts.maxLines){ continue; }
+		Metrics now;
+		//Bigger programs would fail too (typically for want of
+		// memory), so stop climbing
+		if (!measure(opts, lines, now)){
+			failed = true;
+			break;
+		}
+		results[lines] = now;
+		for (auto& metric : now){
+			std::cout << std::setw(9) << lines << "  " << std::left
+			  << std::setw(20) << metric.first << std::right << std::fixed
+			  << std::setprecision(metric.first == PEAK_RSS ? 0 : 2)
+			  << std::setw(12) << metric.second;
+			auto sizeBase = baseline.find(lines);
+			if (sizeBase == baseline.end()
+			  || sizeBase->second.count(metric.first) == 0){
+				std::cout << std::setw(12) << "-" << "\n";
+				continue;
+			}
+			double base = sizeBase->second.at(metric.first);
+			std::cout << std::setw(12) << base;
+			if (base > 0){
+				std::cout << std::setw(9) << std::showpos << std::setprecision(1)
+				  << (metric.second - base) / base * 100 << std::noshowpos << "%";
+			}
+			if (!opts.update && isRegression(opts, metric.first, metric.second, base)){
+				std::cout << "  REGRESSION";
+				regressions++;
+			}
+			std::cout << "\n";
+		}
+		std::cout.flush();
+	}
+
+	if (opts.update){
+		if (!writeBaseline(opts.baseline, updated)){
+			std::cerr << "Could not write " << opts.baseline << "\n";
+			return 2;
+		}
+		std::cout << "Baseline written to " << opts.baseline << "\n";
+		return failed ? 2 : 0;
+	}
+	if (regressions > 0){
+		std::cout << regressions << " regression(s) against " << opts.baseline << "\n";
+		return 1;
+	}
+	return failed ? 2 : 0;
+}
@@ -0,0 +1,135 @@
+// Measures how fast dgc's scanners turn source text into tokens:
+// the flex one, and the hand-written one at each level of SIMD the
+// CPU supports. Both are built from dgc's own sources (at -O2), and
+// each scans the whole input a few times, keeping the best run.
+//
+// The scanners are also checked against each other: a level that
+// produces a different number of tokens than flex is reported.
+// With --threads, each scanner is also run on the input split into
+// chunks on that many threads (as dgc --lex-threads does).
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include "scanner.hpp"
+
+using namespace drewgon;
+
+namespace {
+
+using Lexeme = drewgon::Parser::semantic_type;
+
+class Result{
+public:
+	size_t tokens = 0;
+	double ms = 0;
+};
+
+//Scan the whole input, as the parser would
+Result scanAll(const SourceFile * src, bool handWritten, unsigned int threads){
+	Result res;
+	Arena arena;
+	Scanner scanner(src, &arena, handWritten, threads);
+	Lexeme lex;
+	auto start = std::chrono::steady_clock::now();
+	while (scanner.next(&lex) != TokenKind::END){ res.tokens++; }
+	auto end = std::chrono::steady_clock::now();
+	res.ms = std::chrono::duration<double, std::milli>(end - start).count();
+	return res;
+}
+
+Result best(const SourceFile * src, bool handWritten, unsigned int runs,
+  unsigned int threads = 1){
+	Result res = scanAll(src, handWritten, threads);
+	for (unsigned int i = 1; i < runs; i++){
+		Result run = scanAll(src, handWritten, threads);
+		if (run.ms < res.ms){ res = run; }
+	}
+	return res;
+}
+
+void printRow(const std::string& scanner, const Result& res, double bytes,
+  const Result& flex){
+	double secs = res.ms / 1000;
+	std::cout << std::left << std::setw(14) << scanner << std::right
+	  << std::fixed << std::setw(12) << res.tokens
+	  << std::setprecision(1) << std::setw(11) << res.ms
+	  << std::setprecision(2) << std::setw(12) << res.tokens / secs / 1e6
+	  << std::setw(10) << bytes / secs / 1e6
+	  << std::setw(9) << flex.ms / res.ms << "x\n";
+}
+
+void usage(std::ostream& out){
+	out << "Usage: lexbench [--runs <n>] [--threads <n>] <file>\n"
+	<< " [--runs <n>]: Scans per scanner, keeping the best (default 3)\n"
+	<< " [--threads <n>]: Also scan in parallel on <n> threads\n";
+}
+
+}
+
+int main(int argc, char * argv[]){
+	unsigned int runs = 3;
+	unsigned int threads = 1;
+	const char * path = nullptr;
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		if (arg == "--runs" && i + 1 < argc){
+			runs = static_cast<unsigned int>(std::max(1ul, strtoul(argv[++i], nullptr, 10)));
+		} else if (arg == "--threads" && i + 1 < argc){
+			threads = static_cast<unsigned int>(std::max(1ul, strtoul(argv[++i], nullptr, 10)));
+		} else if (arg[0] != '-' && path == nullptr){
+			path = argv[i];
+		} else {
+			usage(std::cerr);
+			return 2;
+		}
+	}
+	if (path == nullptr){
+		usage(std::cerr);
+		return 2;
+	}
+	SourceFile * src = SourceFile::open(path);
+	if (src == nullptr){
+		std::cerr << "Could not read " << path << "\n";
+		return 2;
+	}
+	double bytes = static_cast<double>(src->size());
+	std::cout << path << ": " << std::fixed << std::setprecision(1)
+	  << bytes / 1e6 << " MB\n";
+	std::cout << std::left << std::setw(14) << "scanner" << std::right
+	  << std::setw(12) << "tokens" << std::setw(11) << "best (ms)"
+	  << std::setw(12) << "Mtokens/s" << std::setw(10) << "MB/s"
+	  << std::setw(10) << "vs flex" << "\n";
+
+	Result flex = best(src, false, runs);
+	printRow("flex", flex, bytes, flex);
+	bool mismatch = false;
+	if (threads > 1){
+		std::string suffix = " x" + std::to_string(threads);
+		Result par = best(src, false, runs, threads);
+		printRow("flex" + suffix, par, bytes, flex);
+		Result hand = best(src, true, runs, threads);
+		printRow("hand" + suffix, hand, bytes, flex);
+		if (par.tokens != flex.tokens || hand.tokens != flex.tokens){
+			std::cout << "  (expected " << flex.tokens << " tokens, as flex found)\n";
+			mismatch = true;
+		}
+	}
+
+	//The hand-written scanner at the CPU's best level, then at each
+	// narrower one
+	int level = Scanner::simdLevel();
+	for (; level >= Scanner::SCALAR; level--){
+		Scanner::SimdLevel simd = static_cast<Scanner::SimdLevel>(level);
+		Scanner::limitSimd(simd);
+		Result hand = best(src, true, runs);
+		printRow(std::string("hand/") + Scanner::simdName(simd), hand, bytes, flex);
+		if (hand.tokens != flex.tokens){
+			std::cout << "  (expected " << flex.tokens << " tokens, as flex found)\n";
+			mismatch = true;
+		}
+	}
+	delete src;
+	return mismatch ? 1 : 0;
+}
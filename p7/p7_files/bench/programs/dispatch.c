@@ -0,0 +1,43 @@
+#include <stdio.h>
+
+long inc(long x){
+	return x + 1;
+}
+
+long dbl(long x){
+	return x + x;
+}
+
+long dec(long x){
+	return x - 1;
+}
+
+int main(){
+	long (*op)(long);
+	long i;
+	long k;
+	long acc;
+	acc = 1;
+	k = 0;
+	for (i = 0; i < 30000000; i++){
+		if (k == 0){
+			op = inc;
+		} else {
+			if (k == 1){
+				op = dbl;
+			} else {
+				op = dec;
+			}
+		}
+		acc = op(acc);
+		if (acc > 1000000){
+			acc = acc - 1000000;
+		}
+		k++;
+		if (k == 3){
+			k = 0;
+		}
+	}
+	printf("%ld\n", acc);
+	return 0;
+}
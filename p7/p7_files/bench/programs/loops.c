@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+long total;
+
+int main(){
+	long i;
+	long j;
+	long acc;
+	acc = 0;
+	for (i = 0; i < 8000; i++){
+		for (j = 0; j < 8000; j++){
+			acc = acc + i * j - (i + j) * 3;
+			acc = acc - acc / 1000003 * 1000003;
+		}
+		total = total + acc;
+	}
+	printf("%ld\n", total);
+	return 0;
+}
@@ -0,0 +1,24 @@
+#include <stdio.h>
+
+int main(){
+	long n;
+	long d;
+	long count;
+	long prime;
+	count = 0;
+	for (n = 2; n < 400000; n++){
+		prime = 1;
+		d = 2;
+		while (prime && d * d <= n){
+			if (n - n / d * d == 0){
+				prime = 0;
+			}
+			d++;
+		}
+		if (prime){
+			count++;
+		}
+	}
+	printf("%ld\n", count);
+	return 0;
+}
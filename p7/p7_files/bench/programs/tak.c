@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+long tak(long x, long y, long z){
+	if (y < x){
+		return tak(tak(x - 1, y, z), tak(y - 1, z, x), tak(z - 1, x, y));
+	}
+	return z;
+}
+
+int main(){
+	printf("%ld\n", tak(30, 20, 10));
+	return 0;
+}
@@ -9,7 +9,6 @@
 %token-table
 
 %code requires{
-	#include <list>
 	#include "tokens.hpp"
 	#include "ast.hpp"
 	namespace drewgon {
@@ -31,6 +30,7 @@
 
 %parse-param { drewgon::Scanner &scanner }
 %parse-param { drewgon::ProgramNode** root }
+%parse-param { drewgon::ASTBuilder * ast }
 %code{
    // C std code for utility functions
    #include <iostream>
@@ -45,7 +45,7 @@
   //Request tokens from our scanner member, not
   // from a global function
   #undef yylex
-  #define yylex scanner.yylex
+  #define yylex scanner.lex
 }
 
 %union {
@@ -58,23 +58,18 @@
    drewgon::StrToken*                      transStrToken;
    drewgon::ProgramNode*                   transProgram;
    drewgon::DeclNode *                     transDecl;
-   std::list<drewgon::DeclNode *> *        transDeclList;
    drewgon::VarDeclNode *                  transVarDecl;
-   std::list<drewgon::TypeNode *> *        transTypeList;
    drewgon::FnTypeNode *                   transFnType;
-   std::list<drewgon::VarDeclNode *> *     transVarDeclList;
    drewgon::FormalDeclNode *               transFormal;
-   std::list<drewgon::FormalDeclNode *> *  transFormalList;
    drewgon::TypeNode *                     transType;
    drewgon::IDNode *                       transID;
    drewgon::FnDeclNode *                   transFn;
-   std::list<drewgon::VarDeclNode *> *     transVarDecls;
-   std::list<drewgon::StmtNode *> *        transStmts;
    drewgon::StmtNode *                     transStmt;
    drewgon::ExpNode *                      transExp;
    drewgon::AssignExpNode *                transAssignExp;
    drewgon::CallExpNode *                  transCallExp;
-   std::list<drewgon::ExpNode *> *         transActuals;
+   //A list being built (see ASTBuilder::openList)
+   size_t                                  transList;
 }
 
 %define parse.assert
@@ -122,23 +117,23 @@
 %token	<transToken>     WHILE
 
 %type <transProgram> program
-%type <transDeclList> globals
+%type <transList> globals
 %type <transVarDecl> varDecl
 %type <transFn> fnDecl
 %type <transExp> term
 %type <transExp> exp
-%type <transActuals> actualsList
+%type <transList> actualsList
 %type <transCallExp> callExp
 %type <transAssignExp> assignExp
 %type <transID> id
 %type <transStmt> stmt
 %type <transStmt> blockStmt
-%type <transStmts> stmtList
+%type <transList> stmtList
 %type <transType> type
 %type <transFnType> fnType
-%type <transTypeList> typeList
+%type <transList> typeList
 %type <transFormal> formalDecl
-%type <transFormalList> formals
+%type <transList> formals
 %type <transType> primType
 
 /* NOTE: Make sure to add precedence and associativity
@@ -156,32 +151,30 @@
 
 program 	: globals
 		  {
-		  $$ = new ProgramNode($1);
+		  $$ = ast->make<ProgramNode>(ast->closeList<DeclNode>($1));
 		  *root = $$;
 		  }
 
 globals 	: globals varDecl SEMICOL
 	  	  {
 	  	  $$ = $1;
-	  	  DeclNode * declNode = $2;
-		  $$->push_back(declNode);
+		  ast->add($2);
 	  	  }
 		| globals fnDecl
 		  {
 	  	  $$ = $1;
-	  	  DeclNode * declNode = $2;
-		  $$->push_back(declNode);
+		  ast->add($2);
 		  }
 
 		| /* epsilon */
 		  {
-		  $$ = new std::list<DeclNode * >();
+		  $$ = ast->openList();
 		  }
 
 varDecl 	: type id
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new VarDeclNode(p, $1, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = ast->make<VarDeclNode>(&p, $1, $2);
 		  }
 
 type		: primType
@@ -195,282 +188,283 @@ type		: primType
 
 primType 	: INT
 	  	  {
-		  $$ = new IntTypeNode($1->pos());
+		  $$ = ast->make<IntTypeNode>($1->pos());
 		  }
 		| BOOL
 		  {
-		  $$ = new BoolTypeNode($1->pos());
+		  $$ = ast->make<BoolTypeNode>($1->pos());
 		  }
 		| VOID
 		  {
-		  $$ = new VoidTypeNode($1->pos());
+		  $$ = ast->make<VoidTypeNode>($1->pos());
 		  }
 
 fnType		: LPAREN typeList RPAREN ARROW type
 		  {
-		  const Position * pos = new Position($1->pos(), $5->pos());
-		  $$ = new FnTypeNode(pos, $2, $5);
+		  Position pos($1->pos(), $5->pos());
+		  $$ = ast->make<FnTypeNode>(&pos, ast->closeList<TypeNode>($2), $5);
 		  }
 		| LPAREN RPAREN ARROW type
 		  {
-		  const Position * pos = new Position($1->pos(), $4->pos());
-		  std::list<TypeNode *> * n = new std::list<TypeNode *>();
-		  $$ = new FnTypeNode(pos,n,$4);
+		  Position pos($1->pos(), $4->pos());
+		  $$ = ast->make<FnTypeNode>(&pos, Span<TypeNode *>(), $4);
 		  }
 
 typeList	: type
 		  {
-		  $$ = new std::list<TypeNode *>();
-		  $$->push_back($1);
+		  $$ = ast->openList();
+		  ast->add($1);
 		  }
 		| typeList COMMA type
 		  {
 		  $$ = $1;
-		  $$->push_back($3);
+		  ast->add($3);
 		  }
 
 
 fnDecl 		: type id LPAREN RPAREN LCURLY stmtList RCURLY
 		  {
-		  const Position * pos = new Position($1->pos(), $7->pos());
-		  std::list<FormalDeclNode *> * f = new std::list<FormalDeclNode *>();
-		  $$ = new FnDeclNode(pos, $1, $2, f, $6);
+		  Position pos($1->pos(), $7->pos());
+		  Span<StmtNode *> body = ast->closeList<StmtNode>($6);
+		  $$ = ast->make<FnDeclNode>(&pos, $1, $2, Span<FormalDeclNode *>(),
+		    body);
 		  }
 		| type id LPAREN formals RPAREN LCURLY stmtList RCURLY
 		  {
-		  const Position * pos = new Position($1->pos(), $8->pos());
-		  $$ = new FnDeclNode(pos, $1, $2, $4, $7);
+		  Position pos($1->pos(), $8->pos());
+		  //The body was opened after the formals, so is closed first
+		  Span<StmtNode *> body = ast->closeList<StmtNode>($7);
+		  Span<FormalDeclNode *> formals = ast->closeList<FormalDeclNode>($4);
+		  $$ = ast->make<FnDeclNode>(&pos, $1, $2, formals, body);
 		  }
 
 formals 	: formalDecl
 		  {
-		  $$ = new std::list<FormalDeclNode *>();
-		  $$->push_back($1);
+		  $$ = ast->openList();
+		  ast->add($1);
 		  }
 		| formals COMMA formalDecl
 		  {
 		  $$ = $1;
-		  $$->push_back($3);
+		  ast->add($3);
 		  }
 
 formalDecl 	: type id
 		  {
-		  const Position * pos = new Position($1->pos(), $2->pos());
-		  $$ = new FormalDeclNode(pos, $1, $2);
+		  Position pos($1->pos(), $2->pos());
+		  $$ = ast->make<FormalDeclNode>(&pos, $1, $2);
 		  }
 
 stmtList 	: /* epsilon */
 	   	  {
-		  $$ = new std::list<StmtNode *>();
+		  $$ = ast->openList();
 	   	  }
 		| stmtList stmt SEMICOL
 	  	  {
 		  $$ = $1;
-		  $$->push_back($2);
+		  ast->add($2);
 	  	  }
 		| stmtList blockStmt
 	  	  {
 		  $$ = $1;
-		  $$->push_back($2);
+		  ast->add($2);
 	  	  }
 
 blockStmt	: WHILE LPAREN exp RPAREN LCURLY stmtList RCURLY
 		  {
-		  const Position * p = new Position($1->pos(), $7->pos());
-		  $$ = new WhileStmtNode(p, $3, $6);
+		  Position p($1->pos(), $7->pos());
+		  $$ = ast->make<WhileStmtNode>(&p, $3, ast->closeList<StmtNode>($6));
 		  }
 		| FOR LPAREN stmt SEMICOL exp SEMICOL stmt RPAREN LCURLY stmtList RCURLY
 		  {
-		  const Position * p = new Position($1->pos(), $11->pos());
-		  $$ = new ForStmtNode(p, $3, $5, $7, $10);
+		  Position p($1->pos(), $11->pos());
+		  $$ = ast->make<ForStmtNode>(&p, $3, $5, $7,
+		    ast->closeList<StmtNode>($10));
 		  }
 		| IF LPAREN exp RPAREN LCURLY stmtList RCURLY
 		  {
-		  const Position * p = new Position($1->pos(), $7->pos());
-		  $$ = new IfStmtNode(p, $3, $6);
+		  Position p($1->pos(), $7->pos());
+		  $$ = ast->make<IfStmtNode>(&p, $3, ast->closeList<StmtNode>($6));
 		  }
 		| IF LPAREN exp RPAREN LCURLY stmtList RCURLY ELSE LCURLY stmtList RCURLY
 		  {
-		  const Position * p = new Position($1->pos(), $11->pos());
-		  $$ = new IfElseStmtNode(p, $3, $6, $10);
+		  Position p($1->pos(), $11->pos());
+		  Span<StmtNode *> bodyFalse = ast->closeList<StmtNode>($10);
+		  Span<StmtNode *> bodyTrue = ast->closeList<StmtNode>($6);
+		  $$ = ast->make<IfElseStmtNode>(&p, $3, bodyTrue, bodyFalse);
 		  }
 
 stmt		: varDecl
 		  {
-		  const Position * p = $1->pos();
-		  $$ = new VarDeclNode(p, $1->getTypeNode(), $1->ID());
+		  $$ = $1;
 		  }
 		| assignExp
 		  {
-		  $$ = new AssignStmtNode($1->pos(), $1);
+		  $$ = ast->make<AssignStmtNode>($1->pos(), $1);
 		  }
 		| id POSTDEC
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new PostDecStmtNode(p, $1);
+		  Position p($1->pos(), $2->pos());
+		  $$ = ast->make<PostDecStmtNode>(&p, $1);
 		  }
 		| id POSTINC
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new PostIncStmtNode(p, $1);
+		  Position p($1->pos(), $2->pos());
+		  $$ = ast->make<PostIncStmtNode>(&p, $1);
 		  }
 		| INPUT id
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new InputStmtNode(p, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = ast->make<InputStmtNode>(&p, $2);
 		  }
 		| OUTPUT exp
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new OutputStmtNode(p, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = ast->make<OutputStmtNode>(&p, $2);
 		  }
 		| RETURN exp
 		  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new ReturnStmtNode(p, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = ast->make<ReturnStmtNode>(&p, $2);
 		  }
 		| RETURN
 		  {
-		  $$ = new ReturnStmtNode($1->pos(), nullptr);
+		  $$ = ast->make<ReturnStmtNode>($1->pos(), nullptr);
 		  }
 		| callExp
 		  {
-		  $$ = new CallStmtNode($1->pos(), $1);
+		  $$ = ast->make<CallStmtNode>($1->pos(), $1);
 		  }
 
 exp		: assignExp
 		  { $$ = $1; }
 		| exp MINUS exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new MinusNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<MinusNode>(&p, $1, $3);
 		  }
 		| exp PLUS exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new PlusNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<PlusNode>(&p, $1, $3);
 		  }
 		| exp TIMES exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new TimesNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<TimesNode>(&p, $1, $3);
 		  }
 		| exp DIVIDE exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new DivideNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<DivideNode>(&p, $1, $3);
 		  }
 		| exp AND exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new AndNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<AndNode>(&p, $1, $3);
 		  }
 		| exp OR exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new OrNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<OrNode>(&p, $1, $3);
 		  }
 		| exp EQUALS exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new EqualsNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<EqualsNode>(&p, $1, $3);
 		  }
 		| exp NOTEQUALS exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new NotEqualsNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<NotEqualsNode>(&p, $1, $3);
 		  }
 		| exp GREATER exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new GreaterNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<GreaterNode>(&p, $1, $3);
 		  }
 		| exp GREATEREQ exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new GreaterEqNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<GreaterEqNode>(&p, $1, $3);
 		  }
 		| exp LESS exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new LessNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<LessNode>(&p, $1, $3);
 		  }
 		| exp LESSEQ exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new LessEqNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<LessEqNode>(&p, $1, $3);
 		  }
 		| NOT exp
 	  	  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new NotNode(p, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = ast->make<NotNode>(&p, $2);
 		  }
 		| MINUS term
 	  	  {
-		  const Position * p = new Position($1->pos(), $2->pos());
-		  $$ = new NegNode(p, $2);
+		  Position p($1->pos(), $2->pos());
+		  $$ = ast->make<NegNode>(&p, $2);
 		  }
 		| term
 	  	  { $$ = $1; }
 
 assignExp	: id ASSIGN exp
 		  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  $$ = new AssignExpNode(p, $1, $3);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<AssignExpNode>(&p, $1, $3);
 		  }
 
 callExp		: id LPAREN RPAREN
 		  {
-		  const Position * p = new Position($1->pos(), $3->pos());
-		  std::list<ExpNode *> * noargs =
-		    new std::list<ExpNode *>();
-		  $$ = new CallExpNode(p, $1, noargs);
+		  Position p($1->pos(), $3->pos());
+		  $$ = ast->make<CallExpNode>(&p, $1, Span<ExpNode *>());
 		  }
 		| id LPAREN actualsList RPAREN
 		  {
-		  const Position * p = new Position($1->pos(), $4->pos());
-		  $$ = new CallExpNode(p, $1, $3);
+		  Position p($1->pos(), $4->pos());
+		  $$ = ast->make<CallExpNode>(&p, $1, ast->closeList<ExpNode>($3));
 		  }
 
 actualsList	: exp
 		  {
-		  std::list<ExpNode *> * list =
-		    new std::list<ExpNode *>();
-		  list->push_back($1);
-		  $$ = list;
+		  $$ = ast->openList();
+		  ast->add($1);
 		  }
 		| actualsList COMMA exp
 		  {
 		  $$ = $1;
-		  $$->push_back($3);
+		  ast->add($3);
 		  }
 
 term 		: id
 		  { $$ = $1; }
 		| INTLITERAL
-		  { $$ = new IntLitNode($1->pos(), $1->num()); }
+		  { $$ = ast->make<IntLitNode>($1->pos(), $1->num()); }
 		| STRINGLITERAL
-		  { $$ = new StrLitNode($1->pos(), $1->str()); }
+		  { $$ = ast->make<StrLitNode>($1->pos(), $1->text(), $1->length()); }
 		| TRUE
-		  { $$ = new TrueNode($1->pos()); }
+		  { $$ = ast->make<TrueNode>($1->pos()); }
 		| FALSE
-		  { $$ = new FalseNode($1->pos()); }
+		  { $$ = ast->make<FalseNode>($1->pos()); }
 		| LPAREN exp RPAREN
 		  { $$ = $2; }
 		| MAYHEM
-		  { $$ = new MayhemNode($1->pos()); }
+		  { $$ = ast->make<MayhemNode>($1->pos()); }
 		| callExp
 		  { $$ = $1; }
 
 id		: ID
 		  {
 		  const Position * pos = $1->pos();
-		  $$ = new IDNode(pos, $1->value());
+		  $$ = ast->make<IDNode>(pos, $1->id());
 		  }
 
 %%
 
 void drewgon::Parser::error(const std::string& msg){
-	std::cout << msg << std::endl;
-	std::cerr << "syntax error" << std::endl;
+	Report::messages() << msg << std::endl;
+	Report::diagnostics() << "syntax error" << std::endl;
 }
@@ -0,0 +1,137 @@
+/*
+The runtime that dgc's built-in linker (-x) links programs
+against. It provides the same functions as stddrewgon.c, but
+talks to the kernel directly instead of going through libc, so
+that a program is just its own code plus the handful of these
+functions it calls. It is built with -ffunction-sections so the
+linker can drop the functions a program doesn't use.
+*/
+#include <stdint.h>
+
+static int64_t sys3(int64_t num, int64_t a, int64_t b, int64_t c){
+	int64_t ret;
+	__asm__ volatile ("syscall"
+		: "=a"(ret)
+		: "a"(num), "D"(a), "S"(b), "d"(c)
+		: "rcx", "r11", "memory");
+	return ret;
+}
+
+static void writeAll(const char * buf, int64_t len){
+	while (len > 0){
+		int64_t wrote = sys3(1, 1, (int64_t)buf, len);
+		if (wrote == -4){ continue; } /* EINTR */
+		if (wrote <= 0){ return; }
+		buf += wrote;
+		len -= wrote;
+	}
+}
+
+/* Read one byte from stdin, or return -1 at the end of input */
+static int readByte(void){
+	unsigned char c;
+	while (1){
+		int64_t got = sys3(0, 0, (int64_t)&c, 1);
+		if (got == -4){ continue; } /* EINTR */
+		if (got <= 0){ return -1; }
+		return c;
+	}
+}
+
+/*
+Programs start here rather than in crt1.o: call main with the
+stack aligned as the ABI expects, then exit with its result
+*/
+__asm__(
+	".section .text._start,\"ax\",@progbits\n"
+	".globl _start\n"
+	"_start:\n"
+	"	xorl %ebp, %ebp\n"
+	"	andq $-16, %rsp\n"
+	"	callq main\n"
+	"	movq %rax, %rdi\n"
+	"	movl $231, %eax\n" /* exit_group */
+	"	syscall\n"
+	"	hlt\n"
+	".text\n"
+);
+
+/*
+Like stddrewgon.c's version, this is only a random 31-bit
+value, seeded from the time on first use
+*/
+int64_t mayhem(){
+	static uint64_t state = 0;
+	if (state == 0){
+		state = (uint64_t)sys3(201, 0, 0, 0) | 1; /* time */
+	}
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return (int64_t)(state >> 33);
+}
+
+void printBool(int64_t c){
+	if (c == 0){
+		writeAll("false", 5);
+	} else{
+		writeAll("true", 4);
+	}
+}
+
+void printInt(long int num){
+	char buf[24];
+	char * pos = buf + sizeof(buf);
+	uint64_t mag = num < 0 ? 0 - (uint64_t)num : (uint64_t)num;
+	do {
+		*--pos = (char)('0' + mag % 10);
+		mag /= 10;
+	} while (mag != 0);
+	if (num < 0){ *--pos = '-'; }
+	writeAll(pos, buf + sizeof(buf) - pos);
+}
+
+void printString(const char * str){
+	int64_t len = 0;
+	while (str[len] != '\0'){ len++; }
+	writeAll(str, len);
+}
+
+int64_t getBool(){
+	int c = readByte();
+	readByte(); /* Consume trailing newline */
+	if (c == '0'){
+		return 0;
+	} else {
+		return 1;
+	}
+}
+
+/* Reads a line the way fgets(buffer, 32, stdin) and atol do */
+int64_t getInt(){
+	char buffer[32];
+	int len = 0;
+	while (len < 31){
+		int c = readByte();
+		if (c < 0){ break; }
+		buffer[len++] = (char)c;
+		if (c == '\n'){ break; }
+	}
+
+	int pos = 0;
+	while (pos < len && (buffer[pos] == ' ' || (buffer[pos] >= '\t'
+	  && buffer[pos] <= '\r'))){
+		pos++;
+	}
+	int negative = 0;
+	if (pos < len && (buffer[pos] == '-' || buffer[pos] == '+')){
+		negative = buffer[pos] == '-';
+		pos++;
+	}
+	uint64_t res = 0;
+	while (pos < len && buffer[pos] >= '0' && buffer[pos] <= '9'){
+		res = res * 10 + (uint64_t)(buffer[pos] - '0');
+		pos++;
+	}
+	return negative ? (int64_t)(0 - res) : (int64_t)res;
+}
@@ -54,7 +54,7 @@ public:
 		const Position * pos,
 		const char * msg
 	){
-		std::cerr << "FATAL "
+		diagnostics() << "FATAL "
 		<< pos->span()
 		<< ": "
 		<< msg  << std::endl;
@@ -66,6 +66,38 @@ public:
 	){
 		fatal(pos,msg.c_str());
 	}
+
+	//The stream that error reports are written to. This is
+	// std::cerr unless the calling thread has redirected it,
+	// which lets concurrent compilations (e.g. in batch mode)
+	// each collect their own diagnostics.
+	static std::ostream& diagnostics(){
+		std::ostream * redirect = diagSink();
+		return redirect == nullptr ? std::cerr : *redirect;
+	}
+
+	//The stream that the parser's verbose messages go to,
+	// std::cout unless redirected.
+	static std::ostream& messages(){
+		std::ostream * redirect = msgSink();
+		return redirect == nullptr ? std::cout : *redirect;
+	}
+
+	//Redirect this thread's diagnostics and messages. Passing
+	// nullptr restores the default stream.
+	static void redirect(std::ostream * diagIn, std::ostream * msgIn){
+		diagSink() = diagIn;
+		msgSink() = msgIn;
+	}
+private:
+	static std::ostream *& diagSink(){
+		static thread_local std::ostream * sink = nullptr;
+		return sink;
+	}
+	static std::ostream *& msgSink(){
+		static thread_local std::ostream * sink = nullptr;
+		return sink;
+	}
 };
 
 }
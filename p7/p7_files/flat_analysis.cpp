@@ -0,0 +1,561 @@
+#include <assert.h>
+
+#include "flat_analysis.hpp"
+#include "symbol_table.hpp"
+#include "errName.hpp"
+#include "timing.hpp"
+
+namespace drewgon{
+
+//The type a type node declares, as TypeNode::getType
+static const DataType * declaredType(const FlatAST * ast, NodeIdx node){
+	switch (ast->kind(node)){
+	case FlatKind::VoidType: return BasicType::VOID();
+	case FlatKind::IntType: return BasicType::INT();
+	case FlatKind::BoolType: return BasicType::BOOL();
+	case FlatKind::FnType: {
+		auto formals = new std::list<const DataType *>();
+		for (NodeIdx formal : ast->list(ast->a(node))){
+			formals->push_back(declaredType(ast, formal));
+		}
+		return FnType::produce(TypeList::produce(formals),
+		  declaredType(ast, ast->b(node)));
+	}
+	default:
+		throw new InternalError("Declared type of a non-type");
+	}
+}
+
+//The type of a FnDecl, from its formals and return type
+static FnType * fnDeclType(const FlatAST * ast, NodeIdx fnDecl){
+	uint32_t parts = ast->a(fnDecl);
+	auto formals = new std::list<const DataType *>();
+	for (NodeIdx formal : ast->list(ast->extra(parts + 2))){
+		formals->push_back(declaredType(ast, ast->a(formal)));
+	}
+	return FnType::produce(TypeList::produce(formals),
+	  declaredType(ast, ast->extra(parts)));
+}
+
+// Name analysis, as in name_analysis.cpp: every node is analyzed
+// (so that every error is reported) even once one has failed.
+class FlatNamer{
+public:
+	FlatNamer(FlatNameAnalysis * namesIn)
+	: ast(namesIn->ast), symbols(namesIn->symbols),
+	  symTab(namesIn->symTab){ }
+
+	bool program(NodeIdx node){
+		symTab.enterScope();
+		bool res = true;
+		for (NodeIdx decl : ast->list(ast->a(node))){
+			res = stmt(decl) && res;
+		}
+		symTab.leaveScope();
+		return res;
+	}
+private:
+	bool stmts(uint32_t list){
+		bool res = true;
+		for (NodeIdx stmt : ast->list(list)){
+			res = this->stmt(stmt) && res;
+		}
+		return res;
+	}
+
+	//stmts, in a scope of their own
+	bool block(uint32_t list){
+		symTab.enterScope();
+		bool res = stmts(list);
+		symTab.leaveScope();
+		return res;
+	}
+
+	bool stmt(NodeIdx node){
+		uint32_t a = ast->a(node);
+		bool res = true;
+		switch (ast->kind(node)){
+		case FlatKind::VarDecl:
+		case FlatKind::FormalDecl:
+			return varDecl(node);
+		case FlatKind::FnDecl:
+			return fnDecl(node);
+		case FlatKind::AssignStmt:
+		case FlatKind::InputStmt:
+		case FlatKind::OutputStmt:
+		case FlatKind::PostDecStmt:
+		case FlatKind::PostIncStmt:
+		case FlatKind::CallStmt:
+			return exp(a);
+		case FlatKind::IfStmt:
+		case FlatKind::WhileStmt:
+			res = exp(a) && res;
+			return block(ast->b(node)) && res;
+		case FlatKind::IfElseStmt:
+			res = exp(a) && res;
+			res = block(ast->extra(ast->b(node))) && res;
+			return block(ast->extra(ast->b(node) + 1)) && res;
+		case FlatKind::ForStmt:
+			symTab.enterScope();
+			res = stmt(ast->extra(a)) && res;
+			res = exp(ast->extra(a + 1)) && res;
+			res = stmts(ast->extra(a + 3)) && res;
+			res = stmt(ast->extra(a + 2)) && res;
+			symTab.leaveScope();
+			return res;
+		case FlatKind::ReturnStmt:
+			return a == FlatAST::NONE || exp(a);
+		default:
+			throw new InternalError("Name analysis of a non-statement");
+		}
+	}
+
+	bool exp(NodeIdx node){
+		uint32_t a = ast->a(node);
+		bool res = true;
+		switch (ast->kind(node)){
+		case FlatKind::ID: {
+			SemSymbol * sym = symTab.find(a);
+			if (sym == nullptr){
+				return NameErr::undeclID(ast->pos(node));
+			}
+			symbols[node] = sym;
+			return true;
+		}
+		case FlatKind::IntLit:
+		case FlatKind::StrLit:
+		case FlatKind::True:
+		case FlatKind::False:
+		case FlatKind::Mayhem:
+			return true;
+		case FlatKind::Call:
+			res = exp(a) && res;
+			for (NodeIdx arg : ast->list(ast->b(node))){
+				res = exp(arg) && res;
+			}
+			return res;
+		case FlatKind::Neg:
+		case FlatKind::Not:
+			return exp(a);
+		default: {
+			//Assign, or a binary operator
+			bool lhs = exp(a);
+			bool rhs = exp(ast->b(node));
+			return lhs && rhs;
+		}
+		}
+	}
+
+	//As FnTypeNode::nameAnalysis (any other type is valid)
+	bool validType(NodeIdx node){
+		if (ast->kind(node) != FlatKind::FnType){ return true; }
+		for (NodeIdx formal : ast->list(ast->a(node))){
+			if (!declaredType(ast, formal)->validVarType()){ return false; }
+		}
+		return true;
+	}
+
+	bool varDecl(NodeIdx node){
+		NodeIdx id = ast->b(node);
+		bool validType = this->validType(ast->a(node));
+		SymbolId varId = ast->a(id);
+		const DataType * dataType = declaredType(ast, ast->a(node));
+
+		if (validType){
+			validType = dataType->validVarType();
+		}
+		if (!validType){
+			NameErr::badVarType(ast->pos(id));
+		}
+
+		bool validName = !symTab.clash(varId);
+		if (!validName){ NameErr::multiDecl(ast->pos(id)); }
+
+		if (!validType || !validName){ return false; }
+		symTab.insert(new VarSymbol(varId, dataType));
+		symbols[id] = symTab.find(varId);
+		return true;
+	}
+
+	bool fnDecl(NodeIdx node){
+		uint32_t parts = ast->a(node);
+		NodeIdx id = ast->extra(parts + 1);
+		SymbolId fnId = ast->a(id);
+		PhaseTimer timer("function", Interner::name(fnId));
+
+		bool validRet = validType(ast->extra(parts));
+
+		ScopeTable * atFnScope = symTab.getCurrentScope();
+		symTab.enterScope();
+
+		bool validName = true;
+		if (atFnScope->clash(fnId)){
+			NameErr::multiDecl(ast->pos(id));
+			validName = false;
+		}
+
+		bool validFormals = true;
+		for (NodeIdx formal : ast->list(ast->extra(parts + 2))){
+			validFormals = varDecl(formal) && validFormals;
+		}
+
+		//The function is in scope in its own body, to allow for
+		// recursive calls
+		if (validName){
+			atFnScope->addFn(fnId, fnDeclType(ast, node));
+			symbols[id] = atFnScope->lookup(fnId);
+		}
+
+		bool validBody = stmts(ast->extra(parts + 3));
+
+		symTab.leaveScope();
+		return validRet && validFormals && validName && validBody;
+	}
+
+	const FlatAST * ast;
+	std::vector<SemSymbol *>& symbols;
+	SymbolTable& symTab;
+};
+
+FlatNameAnalysis * FlatNameAnalysis::build(const FlatAST * astIn){
+	FlatNameAnalysis * names = new FlatNameAnalysis(astIn);
+	if (!FlatNamer(names).program(astIn->root())){
+		delete names;
+		return nullptr;
+	}
+	return names;
+}
+
+// Type analysis, as in type_analysis.cpp, reporting its errors
+// through a TypeAnalysis of its own
+class FlatTyper{
+public:
+	FlatTyper(FlatNameAnalysis * namesIn, FlatTypeAnalysis * typesIn)
+	: ast(namesIn->ast), symbols(namesIn->symbols), types(typesIn->types){ }
+
+	bool passed(){ return report.passed(); }
+
+	void program(NodeIdx node){
+		for (NodeIdx decl : ast->list(ast->a(node))){
+			stmt(decl);
+		}
+		types[node] = BasicType::VOID();
+	}
+private:
+	void stmts(uint32_t list){
+		for (NodeIdx stmt : ast->list(list)){
+			this->stmt(stmt);
+		}
+	}
+
+	void stmt(NodeIdx node){
+		uint32_t a = ast->a(node);
+		switch (ast->kind(node)){
+		case FlatKind::VarDecl:
+		case FlatKind::FormalDecl:
+			types[node] = declaredType(ast, a);
+			return;
+		case FlatKind::FnDecl:
+			fnDecl(node);
+			return;
+		case FlatKind::AssignStmt:
+		case FlatKind::CallStmt:
+			exp(a);
+			return;
+		case FlatKind::PostDecStmt:
+		case FlatKind::PostIncStmt: {
+			const DataType * type = exp(a);
+			if (type->asError()){ return; }
+			if (type->isInt()){ return; }
+			report.errMathOpd(ast->pos(a));
+			return;
+		}
+		case FlatKind::InputStmt: {
+			const DataType * type = exp(a);
+			if (type->asFn()){ report.errAssignFn(ast->pos(a)); }
+			return;
+		}
+		case FlatKind::OutputStmt: {
+			const DataType * type = exp(a);
+			if (type->asError()){ return; }
+			if (type->isVoid()){
+				report.errOutputVoid(ast->pos(a));
+			} else if (type->asFn()){
+				report.errOutputFn(ast->pos(a));
+			}
+			return;
+		}
+		case FlatKind::IfStmt:
+			ifCond(a);
+			stmts(ast->b(node));
+			return;
+		case FlatKind::IfElseStmt:
+			ifCond(a);
+			stmts(ast->extra(ast->b(node)));
+			stmts(ast->extra(ast->b(node) + 1));
+			return;
+		case FlatKind::WhileStmt:
+			loopCond(a);
+			stmts(ast->b(node));
+			return;
+		case FlatKind::ForStmt:
+			stmt(ast->extra(a));
+			loopCond(ast->extra(a + 1));
+			stmt(ast->extra(a + 2));
+			stmts(ast->extra(a + 3));
+			return;
+		case FlatKind::ReturnStmt:
+			returnStmt(node);
+			return;
+		default:
+			throw new InternalError("Type analysis of a non-statement");
+		}
+	}
+
+	void ifCond(NodeIdx cond){
+		const DataType * type = exp(cond);
+		if (!type->asError() && !type->isBool()){
+			report.errIfCond(ast->pos(cond));
+		}
+	}
+
+	void loopCond(NodeIdx cond){
+		const DataType * type = exp(cond);
+		if (!type->asError() && !type->isBool()){
+			report.errLoopCond(ast->pos(cond));
+		}
+	}
+
+	void returnStmt(NodeIdx node){
+		NodeIdx val = ast->a(node);
+		const DataType * fnRet = fnType->getReturnType();
+		if (fnRet == BasicType::VOID()){
+			if (val != FlatAST::NONE){
+				exp(val);
+				report.extraRetValue(ast->pos(val));
+			}
+			return;
+		}
+		if (val == FlatAST::NONE){
+			report.errRetEmpty(ast->pos(node));
+			return;
+		}
+		const DataType * type = exp(val);
+		if (!type->asError() && type != fnRet){
+			report.errRetWrong(ast->pos(val));
+		}
+	}
+
+	void fnDecl(NodeIdx node){
+		uint32_t parts = ast->a(node);
+		NodeIdx id = ast->extra(parts + 1);
+		PhaseTimer timer("function", Interner::name(ast->a(id)));
+		for (NodeIdx formal : ast->list(ast->extra(parts + 2))){
+			stmt(formal);
+		}
+		fnType = fnDeclType(ast, node);
+		types[node] = fnType;
+		stmts(ast->extra(parts + 3));
+		fnType = nullptr;
+	}
+
+	//The type of an expression, once it has been checked
+	const DataType * exp(NodeIdx node){
+		const DataType * type = expType(node);
+		types[node] = type;
+		return type;
+	}
+
+	const DataType * expType(NodeIdx node){
+		uint32_t a = ast->a(node);
+		switch (ast->kind(node)){
+		case FlatKind::ID:
+			assert(symbols[node] != nullptr);
+			return symbols[node]->getDataType();
+		case FlatKind::IntLit:
+		case FlatKind::Mayhem:
+			return BasicType::INT();
+		case FlatKind::StrLit:
+			return BasicType::STRING();
+		case FlatKind::True:
+		case FlatKind::False:
+			return BasicType::BOOL();
+		case FlatKind::Assign:
+			return assign(node);
+		case FlatKind::Call:
+			return call(node);
+		case FlatKind::Plus:
+		case FlatKind::Minus:
+		case FlatKind::Times:
+		case FlatKind::Divide: {
+			bool lhsValid = mathOpd(a);
+			bool rhsValid = mathOpd(ast->b(node));
+			if (!lhsValid || !rhsValid){ return ErrorType::produce(); }
+			return BasicType::INT();
+		}
+		case FlatKind::And:
+		case FlatKind::Or: {
+			bool lhsValid = logicOpd(a);
+			bool rhsValid = logicOpd(ast->b(node));
+			if (!lhsValid || !rhsValid){ return ErrorType::produce(); }
+			return BasicType::BOOL();
+		}
+		case FlatKind::Equals:
+		case FlatKind::NotEquals: {
+			const DataType * lhsType = eqOpd(a);
+			const DataType * rhsType = eqOpd(ast->b(node));
+			if (lhsType->asError() || rhsType->asError()){
+				return ErrorType::produce();
+			}
+			if (lhsType == rhsType){ return BasicType::BOOL(); }
+			report.errEqOpr(ast->pos(node));
+			return ErrorType::produce();
+		}
+		case FlatKind::Less:
+		case FlatKind::LessEq:
+		case FlatKind::Greater:
+		case FlatKind::GreaterEq: {
+			bool lhsValid = relOpd(a);
+			bool rhsValid = relOpd(ast->b(node));
+			if (!lhsValid || !rhsValid){ return ErrorType::produce(); }
+			return BasicType::BOOL();
+		}
+		case FlatKind::Neg: {
+			const DataType * type = exp(a);
+			if (type->asError()){ return type; }
+			if (type->isInt()){ return BasicType::INT(); }
+			report.errMathOpd(ast->pos(a));
+			return ErrorType::produce();
+		}
+		case FlatKind::Not: {
+			const DataType * type = exp(a);
+			if (type->asError()){ return ErrorType::produce(); }
+			if (type->isBool()){ return type; }
+			report.errLogicOpd(ast->pos(a));
+			return ErrorType::produce();
+		}
+		default:
+			throw new InternalError("Type analysis of a non-expression");
+		}
+	}
+
+	//Each of these checks an operand, reporting it if it is
+	// invalid (and not already an error)
+	bool mathOpd(NodeIdx opd){
+		const DataType * type = exp(opd);
+		if (type->isInt()){ return true; }
+		if (!type->asError()){ report.errMathOpd(ast->pos(opd)); }
+		return false;
+	}
+
+	bool logicOpd(NodeIdx opd){
+		const DataType * type = exp(opd);
+		if (type->isBool()){ return true; }
+		if (!type->asError()){ report.errLogicOpd(ast->pos(opd)); }
+		return false;
+	}
+
+	const DataType * eqOpd(NodeIdx opd){
+		const DataType * type = exp(opd);
+		if (type->isInt() || type->isBool()){ return type; }
+		if (!type->asError()){ report.errEqOpd(ast->pos(opd)); }
+		return ErrorType::produce();
+	}
+
+	bool relOpd(NodeIdx opd){
+		const DataType * type = exp(opd);
+		if (type->isInt()){ return true; }
+		if (!type->asError()){
+			report.errRelOpd(ast->pos(opd));
+			types[opd] = ErrorType::produce();
+		}
+		return false;
+	}
+
+	static bool validAssignOpd(const DataType * type){
+		return type->isBool() || type->isInt() || type->asFn()
+		  || type->asError();
+	}
+
+	const DataType * assign(NodeIdx node){
+		NodeIdx dst = ast->a(node);
+		NodeIdx src = ast->b(node);
+		const DataType * dstType = exp(dst);
+		const DataType * srcType = exp(src);
+
+		bool validOperands = true;
+		bool knownError = dstType->asError() || srcType->asError();
+		if (!validAssignOpd(dstType)){
+			report.errAssignOpd(ast->pos(dst));
+			validOperands = false;
+		}
+		if (!validAssignOpd(srcType)){
+			report.errAssignOpd(ast->pos(src));
+			validOperands = false;
+		}
+		if (!validOperands || knownError){ return ErrorType::produce(); }
+
+		if (dstType != srcType){
+			report.errAssignOpr(ast->pos(node));
+			return ErrorType::produce();
+		}
+		if (symbols[dst]->getKind() == FN){
+			report.errAssignOpd(ast->pos(dst));
+			report.errAssignOpd(ast->pos(src));
+			return ErrorType::produce();
+		}
+		return dstType;
+	}
+
+	const DataType * call(NodeIdx node){
+		Span<const NodeIdx> args = ast->list(ast->b(node));
+		for (NodeIdx arg : args){ exp(arg); }
+
+		NodeIdx callee = ast->a(node);
+		assert(symbols[callee] != nullptr);
+		const FnType * calleeType = symbols[callee]->getDataType()->asFn();
+		if (calleeType == nullptr){
+			report.errCallee(ast->pos(callee));
+			return ErrorType::produce();
+		}
+
+		const std::list<const DataType *> * formals =
+		  calleeType->getFormalTypes()->getTypes();
+		if (args.size() != formals->size()){
+			report.errArgCount(ast->pos(node));
+		} else {
+			auto formal = formals->begin();
+			for (NodeIdx arg : args){
+				const DataType * actualType = types[arg];
+				const DataType * formalType = *formal++;
+				if (actualType->asError() || formalType->asError()){
+					continue;
+				}
+				if (formalType != actualType){
+					report.errArgMatch(ast->pos(arg));
+				}
+			}
+		}
+		//Even with bad args, the call is of the return type
+		return calleeType->getReturnType();
+	}
+
+	const FlatAST * ast;
+	const std::vector<SemSymbol *>& symbols;
+	std::vector<const DataType *>& types;
+	const FnType * fnType = nullptr;
+	TypeAnalysis report;
+};
+
+FlatTypeAnalysis * FlatTypeAnalysis::build(FlatNameAnalysis * names){
+	FlatTypeAnalysis * types = new FlatTypeAnalysis(names->ast);
+	FlatTyper typer(names, types);
+	typer.program(names->ast->root());
+	if (!typer.passed()){
+		delete types;
+		return nullptr;
+	}
+	return types;
+}
+
+}
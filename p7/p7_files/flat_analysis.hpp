@@ -0,0 +1,45 @@
+#ifndef DREWGON_FLAT_ANALYSIS_HPP
+#define DREWGON_FLAT_ANALYSIS_HPP
+
+#include "flat_ast.hpp"
+#include "type_analysis.hpp"
+
+namespace drewgon{
+
+// Name and type analysis of a FlatAST. Each reports exactly the
+// errors its counterpart (NameAnalysis, TypeAnalysis) would for
+// the AST the FlatAST was copied from, in the same order. Rather
+// than being attached to nodes, or kept in a map keyed by them,
+// their results are columns of their own, indexed by NodeIdx like
+// the tree's.
+
+class FlatNameAnalysis{
+public:
+	//nullptr if there were any errors
+	static FlatNameAnalysis * build(const FlatAST * astIn);
+	const FlatAST * ast;
+	//The symbol each ID refers to, or nullptr (for other nodes)
+	std::vector<SemSymbol *> symbols;
+	//Where those symbols were declared, which owns them
+	SymbolTable symTab;
+private:
+	FlatNameAnalysis(const FlatAST * astIn)
+	: ast(astIn), symbols(astIn->size(), nullptr){ }
+};
+
+class FlatTypeAnalysis{
+public:
+	//nullptr if there were any errors
+	static FlatTypeAnalysis * build(FlatNameAnalysis * names);
+	const FlatAST * ast;
+	//The type of each node, or nullptr for nodes, such as
+	// statements, whose type nothing asks for
+	std::vector<const DataType *> types;
+private:
+	FlatTypeAnalysis(const FlatAST * astIn)
+	: ast(astIn), types(astIn->size(), nullptr){ }
+};
+
+}
+
+#endif
@@ -0,0 +1,279 @@
+#include <sys/mman.h>
+#include "ast.hpp"
+#include "flat_ast.hpp"
+
+namespace drewgon{
+
+FlatAST * FlatAST::build(ProgramNode * root){
+	FlatAST * flat = new FlatAST();
+	FlatASTBuilder builder(flat);
+	root->toFlat(&builder);
+	flat->useOwnColumns();
+	return flat;
+}
+
+void FlatAST::useOwnColumns(){
+	mySize = kinds.size();
+	myKinds = kinds.data();
+	myA = as.data();
+	myB = bs.data();
+	myPositions = positions.data();
+	myExtra = extras.data();
+	myExtraSize = extras.size();
+	myText = texts.data();
+	myTextSize = texts.size();
+}
+
+FlatAST::~FlatAST(){
+	if (mapping != nullptr){ munmap(mapping, mappingSize); }
+}
+
+size_t FlatAST::bytesUsed() const{
+	return mySize * (sizeof(FlatKind) + 2 * sizeof(uint32_t)
+	  + sizeof(Position))
+	  + myExtraSize * sizeof(uint32_t) + myTextSize;
+}
+
+//A node with no operands
+static NodeIdx leafToFlat(FlatASTBuilder * flat, FlatKind kind,
+  const Position * pos, uint32_t a = 0, uint32_t b = 0){
+	NodeIdx node = flat->add(kind, pos);
+	flat->set(node, a, b);
+	return node;
+}
+
+NodeIdx ProgramNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::Program, pos());
+	flat->set(node, flat->list(myGlobals));
+	return node;
+}
+
+NodeIdx VarDeclNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::VarDecl, pos());
+	NodeIdx type = myType->toFlat(flat);
+	flat->set(node, type, myID->toFlat(flat));
+	return node;
+}
+
+NodeIdx FormalDeclNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::FormalDecl, pos());
+	NodeIdx type = getTypeNode()->toFlat(flat);
+	flat->set(node, type, ID()->toFlat(flat));
+	return node;
+}
+
+NodeIdx FnDeclNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::FnDecl, pos());
+	uint32_t parts = flat->reserveExtra(4);
+	flat->setExtra(parts, myRetType->toFlat(flat));
+	flat->setExtra(parts + 1, myID->toFlat(flat));
+	flat->setExtra(parts + 2, flat->list(myFormals));
+	flat->setExtra(parts + 3, flat->list(body()));
+	flat->set(node, parts);
+	return node;
+}
+
+NodeIdx AssignStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::AssignStmt, pos());
+	flat->set(node, myExp->toFlat(flat));
+	return node;
+}
+
+NodeIdx InputStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::InputStmt, pos());
+	flat->set(node, myDst->toFlat(flat));
+	return node;
+}
+
+NodeIdx OutputStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::OutputStmt, pos());
+	flat->set(node, mySrc->toFlat(flat));
+	return node;
+}
+
+NodeIdx PostDecStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::PostDecStmt, pos());
+	flat->set(node, myID->toFlat(flat));
+	return node;
+}
+
+NodeIdx PostIncStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::PostIncStmt, pos());
+	flat->set(node, myID->toFlat(flat));
+	return node;
+}
+
+NodeIdx IfStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::IfStmt, pos());
+	NodeIdx cond = myCond->toFlat(flat);
+	flat->set(node, cond, flat->list(myBody));
+	return node;
+}
+
+NodeIdx IfElseStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::IfElseStmt, pos());
+	NodeIdx cond = myCond->toFlat(flat);
+	uint32_t bodies = flat->reserveExtra(2);
+	flat->setExtra(bodies, flat->list(myBodyTrue));
+	flat->setExtra(bodies + 1, flat->list(myBodyFalse));
+	flat->set(node, cond, bodies);
+	return node;
+}
+
+NodeIdx WhileStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::WhileStmt, pos());
+	NodeIdx cond = myCond->toFlat(flat);
+	flat->set(node, cond, flat->list(myBody));
+	return node;
+}
+
+NodeIdx ForStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::ForStmt, pos());
+	uint32_t parts = flat->reserveExtra(4);
+	flat->setExtra(parts, myInit->toFlat(flat));
+	flat->setExtra(parts + 1, myCond->toFlat(flat));
+	flat->setExtra(parts + 2, myItr->toFlat(flat));
+	flat->setExtra(parts + 3, flat->list(myBody));
+	flat->set(node, parts);
+	return node;
+}
+
+NodeIdx ReturnStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::ReturnStmt, pos());
+	flat->set(node, myExp == nullptr ? FlatAST::NONE : myExp->toFlat(flat));
+	return node;
+}
+
+NodeIdx CallStmtNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::CallStmt, pos());
+	flat->set(node, myCallExp->toFlat(flat));
+	return node;
+}
+
+NodeIdx IDNode::toFlat(FlatASTBuilder * flat){
+	return leafToFlat(flat, FlatKind::ID, pos(), myId);
+}
+
+NodeIdx IntLitNode::toFlat(FlatASTBuilder * flat){
+	return leafToFlat(flat, FlatKind::IntLit, pos(),
+	  static_cast<uint32_t>(myNum));
+}
+
+NodeIdx StrLitNode::toFlat(FlatASTBuilder * flat){
+	return leafToFlat(flat, FlatKind::StrLit, pos(),
+	  flat->text(str()), static_cast<uint32_t>(myLen));
+}
+
+NodeIdx TrueNode::toFlat(FlatASTBuilder * flat){
+	return leafToFlat(flat, FlatKind::True, pos());
+}
+
+NodeIdx FalseNode::toFlat(FlatASTBuilder * flat){
+	return leafToFlat(flat, FlatKind::False, pos());
+}
+
+NodeIdx MayhemNode::toFlat(FlatASTBuilder * flat){
+	return leafToFlat(flat, FlatKind::Mayhem, pos());
+}
+
+NodeIdx AssignExpNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::Assign, pos());
+	NodeIdx dst = myDst->toFlat(flat);
+	flat->set(node, dst, mySrc->toFlat(flat));
+	return node;
+}
+
+NodeIdx CallExpNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::Call, pos());
+	NodeIdx callee = myID->toFlat(flat);
+	flat->set(node, callee, flat->list(myArgs));
+	return node;
+}
+
+NodeIdx BinaryExpNode::binaryToFlat(FlatASTBuilder * flat, FlatKind kind){
+	NodeIdx node = flat->add(kind, pos());
+	NodeIdx lhs = myExp1->toFlat(flat);
+	flat->set(node, lhs, myExp2->toFlat(flat));
+	return node;
+}
+
+NodeIdx PlusNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::Plus);
+}
+
+NodeIdx MinusNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::Minus);
+}
+
+NodeIdx TimesNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::Times);
+}
+
+NodeIdx DivideNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::Divide);
+}
+
+NodeIdx AndNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::And);
+}
+
+NodeIdx OrNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::Or);
+}
+
+NodeIdx EqualsNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::Equals);
+}
+
+NodeIdx NotEqualsNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::NotEquals);
+}
+
+NodeIdx LessNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::Less);
+}
+
+NodeIdx LessEqNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::LessEq);
+}
+
+NodeIdx GreaterNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::Greater);
+}
+
+NodeIdx GreaterEqNode::toFlat(FlatASTBuilder * flat){
+	return binaryToFlat(flat, FlatKind::GreaterEq);
+}
+
+NodeIdx NegNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::Neg, pos());
+	flat->set(node, myExp->toFlat(flat));
+	return node;
+}
+
+NodeIdx NotNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::Not, pos());
+	flat->set(node, myExp->toFlat(flat));
+	return node;
+}
+
+NodeIdx VoidTypeNode::toFlat(FlatASTBuilder * flat){
+	return leafToFlat(flat, FlatKind::VoidType, pos());
+}
+
+NodeIdx IntTypeNode::toFlat(FlatASTBuilder * flat){
+	return leafToFlat(flat, FlatKind::IntType, pos());
+}
+
+NodeIdx BoolTypeNode::toFlat(FlatASTBuilder * flat){
+	return leafToFlat(flat, FlatKind::BoolType, pos());
+}
+
+NodeIdx FnTypeNode::toFlat(FlatASTBuilder * flat){
+	NodeIdx node = flat->add(FlatKind::FnType, pos());
+	uint32_t ins = flat->list(myInTypes);
+	flat->set(node, ins, myOutType->toFlat(flat));
+	return node;
+}
+
+}
@@ -0,0 +1,195 @@
+#ifndef DREWGON_FLAT_AST_HPP
+#define DREWGON_FLAT_AST_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "position.hpp"
+#include "span.hpp"
+#include "interner.hpp"
+
+namespace drewgon{
+
+class ProgramNode;
+class ASTBuilder;
+class SemSymbol;
+class DataType;
+
+//Where a node sits in a FlatAST
+typedef uint32_t NodeIdx;
+
+//What a node of a FlatAST is: one kind for each concrete class
+// of ASTNode
+enum class FlatKind : uint8_t{
+	Program,
+	VarDecl, FormalDecl, FnDecl,
+	AssignStmt, InputStmt, OutputStmt, PostDecStmt, PostIncStmt,
+	IfStmt, IfElseStmt, WhileStmt, ForStmt, ReturnStmt, CallStmt,
+	ID, IntLit, StrLit, True, False, Mayhem,
+	Assign, Call,
+	Plus, Minus, Times, Divide, And, Or,
+	Equals, NotEquals, Less, LessEq, Greater, GreaterEq,
+	Neg, Not,
+	VoidType, IntType, BoolType, FnType,
+};
+
+// A data-oriented copy of the AST. Rather than an object per node
+// that points at its children, the tree is a handful of parallel
+// arrays (columns) indexed by NodeIdx: a node's kind, two 32-bit
+// operands and its position. What the operands mean depends on
+// the kind:
+//
+//   Program                a: list of globals
+//   VarDecl, FormalDecl    a: type, b: ID
+//   FnDecl                 a: extra [ret type, ID, formals list,
+//                            body list]
+//   AssignStmt             a: Assign
+//   InputStmt, PostDecStmt,
+//     PostIncStmt          a: ID
+//   OutputStmt             a: exp
+//   IfStmt, WhileStmt      a: cond, b: body list
+//   IfElseStmt             a: cond, b: extra [true list, false list]
+//   ForStmt                a: extra [init, cond, itr, body list]
+//   ReturnStmt             a: exp, or NONE
+//   CallStmt               a: Call
+//   ID                     a: SymbolId
+//   IntLit                 a: the value
+//   StrLit                 a: offset into the literal text, b: length
+//   Assign                 a: dst ID, b: src
+//   Call                   a: callee ID, b: args list
+//   Plus ... GreaterEq     a: lhs, b: rhs
+//   Neg, Not               a: operand
+//   FnType                 a: list of formal types, b: return type
+//
+// An "extra" operand, and a list, is an index into a further array
+// of 32-bit words. A list is its length followed by its items.
+//
+// Nodes are numbered in the order the source gives them (each
+// node before its children), so a walk of the tree in source order
+// reads each column front to back. Passes over the tree dispatch
+// on the kind with a switch, in place of a virtual call per node.
+class FlatAST{
+public:
+	static const NodeIdx NONE = UINT32_MAX;
+
+	//Copy the tree under root, which must have every function
+	// body parsed
+	static FlatAST * build(ProgramNode * root);
+
+	NodeIdx root() const { return 0; }
+	size_t size() const { return mySize; }
+	FlatKind kind(NodeIdx node) const { return myKinds[node]; }
+	uint32_t a(NodeIdx node) const { return myA[node]; }
+	uint32_t b(NodeIdx node) const { return myB[node]; }
+	const Position * pos(NodeIdx node) const { return &myPositions[node]; }
+
+	uint32_t extra(uint32_t at) const { return myExtra[at]; }
+	Span<const NodeIdx> list(uint32_t at) const{
+		return Span<const NodeIdx>(&myExtra[at + 1], myExtra[at]);
+	}
+	const char * text(NodeIdx strLit) const{
+		return myText + myA[strLit];
+	}
+
+	//As ProgramNode::unparse. Each ID is followed by its type if
+	// symbols (a column of the symbol each node refers to) is
+	// given and has one for it.
+	void unparse(std::ostream& out,
+	  const std::vector<SemSymbol *> * symbols = nullptr) const;
+
+	//Rebuild the AST the tree was copied from, allocating it
+	// with builder. Its string literals point into the tree's
+	// text, so the tree must outlive it.
+	ProgramNode * toAST(ASTBuilder * builder) const;
+
+	//The bytes taken by the columns
+	size_t bytesUsed() const;
+
+	~FlatAST();
+private:
+	friend class FlatASTBuilder;
+	friend class ASTCache;
+	FlatAST(){ }
+	//Point the columns at the vectors below, once they are filled
+	void useOwnColumns();
+
+	//The columns. For a tree built from an AST they point into
+	// the vectors below; for one loaded by an ASTCache they point
+	// into the file it is mapped from (all but myA, whose IDs are
+	// translated as it is loaded).
+	size_t mySize = 0;
+	const FlatKind * myKinds = nullptr;
+	const uint32_t * myA = nullptr;
+	const uint32_t * myB = nullptr;
+	const Position * myPositions = nullptr;
+	const uint32_t * myExtra = nullptr;
+	size_t myExtraSize = 0;
+	const char * myText = nullptr;
+	size_t myTextSize = 0;
+
+	std::vector<FlatKind> kinds;
+	std::vector<uint32_t> as;
+	std::vector<uint32_t> bs;
+	std::vector<Position> positions;
+	std::vector<uint32_t> extras;
+	std::string texts;
+
+	//The mapped cache file, if the tree was loaded from one
+	void * mapping = nullptr;
+	size_t mappingSize = 0;
+};
+
+//Fills in a FlatAST, one node at a time (see ASTNode::toFlat). A
+// node is added before its children, which gives it its index,
+// and its operands are set once they have been added.
+class FlatASTBuilder{
+public:
+	FlatASTBuilder(FlatAST * astIn) : ast(astIn){ }
+
+	NodeIdx add(FlatKind kind, const Position * pos){
+		NodeIdx node = static_cast<NodeIdx>(ast->kinds.size());
+		ast->kinds.push_back(kind);
+		ast->as.push_back(0);
+		ast->bs.push_back(0);
+		ast->positions.push_back(*pos);
+		return node;
+	}
+	void set(NodeIdx node, uint32_t a, uint32_t b = 0){
+		ast->as[node] = a;
+		ast->bs[node] = b;
+	}
+
+	//Room for count words of extra operands, to be filled in
+	// with setExtra
+	uint32_t reserveExtra(size_t count){
+		uint32_t at = static_cast<uint32_t>(ast->extras.size());
+		ast->extras.resize(ast->extras.size() + count);
+		return at;
+	}
+	void setExtra(uint32_t at, uint32_t word){ ast->extras[at] = word; }
+
+	//Add each of nodes (and its children) as a list
+	template <typename T>
+	uint32_t list(const Span<T *>& nodes){
+		uint32_t at = reserveExtra(nodes.size() + 1);
+		setExtra(at, static_cast<uint32_t>(nodes.size()));
+		for (size_t i = 0; i < nodes.size(); i++){
+			setExtra(at + 1 + static_cast<uint32_t>(i), nodes[i]->toFlat(this));
+		}
+		return at;
+	}
+
+	//Keep the text of a string literal, returning its offset
+	uint32_t text(const std::string& str){
+		uint32_t at = static_cast<uint32_t>(ast->texts.size());
+		ast->texts += str;
+		return at;
+	}
+private:
+	FlatAST * ast;
+};
+
+}
+
+#endif
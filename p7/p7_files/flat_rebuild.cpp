@@ -0,0 +1,165 @@
+#include "ast.hpp"
+#include "flat_ast.hpp"
+#include "errors.hpp"
+
+namespace drewgon{
+
+// Rebuilds the AST a FlatAST was copied from, node for node, so
+// that a tree loaded from an ASTCache can go through the passes
+// (and the back end) that only work on the AST.
+class ASTRebuilder{
+public:
+	ASTRebuilder(const FlatAST * astIn, ASTBuilder * builderIn)
+	: ast(astIn), builder(builderIn){ }
+
+	ProgramNode * program(){
+		return builder->make<ProgramNode>(
+		  list<DeclNode>(ast->a(ast->root())));
+	}
+
+	StmtNode * stmt(NodeIdx node){
+		const Position * p = ast->pos(node);
+		uint32_t a = ast->a(node);
+		switch (ast->kind(node)){
+		case FlatKind::VarDecl:
+			return builder->make<VarDeclNode>(p, type(a), id(ast->b(node)));
+		case FlatKind::FormalDecl:
+			return formal(node);
+		case FlatKind::FnDecl:
+			return builder->make<FnDeclNode>(p, type(ast->extra(a)),
+			  id(ast->extra(a + 1)), list<FormalDeclNode>(ast->extra(a + 2)),
+			  list<StmtNode>(ast->extra(a + 3)));
+		case FlatKind::AssignStmt:
+			return builder->make<AssignStmtNode>(p, assign(a));
+		case FlatKind::InputStmt:
+			return builder->make<InputStmtNode>(p, id(a));
+		case FlatKind::OutputStmt:
+			return builder->make<OutputStmtNode>(p, exp(a));
+		case FlatKind::PostDecStmt:
+			return builder->make<PostDecStmtNode>(p, id(a));
+		case FlatKind::PostIncStmt:
+			return builder->make<PostIncStmtNode>(p, id(a));
+		case FlatKind::IfStmt:
+			return builder->make<IfStmtNode>(p, exp(a),
+			  list<StmtNode>(ast->b(node)));
+		case FlatKind::IfElseStmt:
+			return builder->make<IfElseStmtNode>(p, exp(a),
+			  list<StmtNode>(ast->extra(ast->b(node))),
+			  list<StmtNode>(ast->extra(ast->b(node) + 1)));
+		case FlatKind::WhileStmt:
+			return builder->make<WhileStmtNode>(p, exp(a),
+			  list<StmtNode>(ast->b(node)));
+		case FlatKind::ForStmt:
+			return builder->make<ForStmtNode>(p, stmt(ast->extra(a)),
+			  exp(ast->extra(a + 1)), stmt(ast->extra(a + 2)),
+			  list<StmtNode>(ast->extra(a + 3)));
+		case FlatKind::ReturnStmt:
+			return builder->make<ReturnStmtNode>(p,
+			  a == FlatAST::NONE ? nullptr : exp(a));
+		case FlatKind::CallStmt:
+			return builder->make<CallStmtNode>(p, call(a));
+		default:
+			throw new InternalError("Rebuild of a non-statement");
+		}
+	}
+
+	ExpNode * exp(NodeIdx node){
+		const Position * p = ast->pos(node);
+		uint32_t a = ast->a(node);
+		uint32_t b = ast->b(node);
+		switch (ast->kind(node)){
+		case FlatKind::ID: return id(node);
+		case FlatKind::IntLit:
+			return builder->make<IntLitNode>(p, static_cast<int>(a));
+		case FlatKind::StrLit:
+			return builder->make<StrLitNode>(p, ast->text(node),
+			  static_cast<size_t>(b));
+		case FlatKind::True: return builder->make<TrueNode>(p);
+		case FlatKind::False: return builder->make<FalseNode>(p);
+		case FlatKind::Mayhem: return builder->make<MayhemNode>(p);
+		case FlatKind::Assign: return assign(node);
+		case FlatKind::Call: return call(node);
+		case FlatKind::Plus: return binary<PlusNode>(node);
+		case FlatKind::Minus: return binary<MinusNode>(node);
+		case FlatKind::Times: return binary<TimesNode>(node);
+		case FlatKind::Divide: return binary<DivideNode>(node);
+		case FlatKind::And: return binary<AndNode>(node);
+		case FlatKind::Or: return binary<OrNode>(node);
+		case FlatKind::Equals: return binary<EqualsNode>(node);
+		case FlatKind::NotEquals: return binary<NotEqualsNode>(node);
+		case FlatKind::Less: return binary<LessNode>(node);
+		case FlatKind::LessEq: return binary<LessEqNode>(node);
+		case FlatKind::Greater: return binary<GreaterNode>(node);
+		case FlatKind::GreaterEq: return binary<GreaterEqNode>(node);
+		case FlatKind::Neg: return builder->make<NegNode>(p, exp(a));
+		case FlatKind::Not: return builder->make<NotNode>(p, exp(a));
+		default:
+			throw new InternalError("Rebuild of a non-expression");
+		}
+	}
+
+	TypeNode * type(NodeIdx node){
+		const Position * p = ast->pos(node);
+		switch (ast->kind(node)){
+		case FlatKind::VoidType: return builder->make<VoidTypeNode>(p);
+		case FlatKind::IntType: return builder->make<IntTypeNode>(p);
+		case FlatKind::BoolType: return builder->make<BoolTypeNode>(p);
+		case FlatKind::FnType:
+			return builder->make<FnTypeNode>(p, list<TypeNode>(ast->a(node)),
+			  type(ast->b(node)));
+		default:
+			throw new InternalError("Rebuild of a non-type");
+		}
+	}
+private:
+	IDNode * id(NodeIdx node){
+		return builder->make<IDNode>(ast->pos(node), ast->a(node));
+	}
+	FormalDeclNode * formal(NodeIdx node){
+		return builder->make<FormalDeclNode>(ast->pos(node),
+		  type(ast->a(node)), id(ast->b(node)));
+	}
+	AssignExpNode * assign(NodeIdx node){
+		return builder->make<AssignExpNode>(ast->pos(node),
+		  id(ast->a(node)), exp(ast->b(node)));
+	}
+	CallExpNode * call(NodeIdx node){
+		return builder->make<CallExpNode>(ast->pos(node),
+		  id(ast->a(node)), list<ExpNode>(ast->b(node)));
+	}
+	template <typename T>
+	T * binary(NodeIdx node){
+		return builder->make<T>(ast->pos(node), exp(ast->a(node)),
+		  exp(ast->b(node)));
+	}
+
+	//The items of the list at at, each rebuilt as a T
+	template <typename T>
+	Span<T *> list(uint32_t at){
+		Span<const NodeIdx> nodes = ast->list(at);
+		T ** items = static_cast<T **>(builder->getArena()->allocate(
+		  nodes.size() * sizeof(T *), alignof(T *)));
+		for (size_t i = 0; i < nodes.size(); i++){
+			items[i] = item(nodes[i], static_cast<T *>(nullptr));
+		}
+		return Span<T *>(items, nodes.size());
+	}
+	DeclNode * item(NodeIdx node, DeclNode *){
+		return static_cast<DeclNode *>(stmt(node));
+	}
+	FormalDeclNode * item(NodeIdx node, FormalDeclNode *){
+		return formal(node);
+	}
+	StmtNode * item(NodeIdx node, StmtNode *){ return stmt(node); }
+	ExpNode * item(NodeIdx node, ExpNode *){ return exp(node); }
+	TypeNode * item(NodeIdx node, TypeNode *){ return type(node); }
+
+	const FlatAST * ast;
+	ASTBuilder * builder;
+};
+
+ProgramNode * FlatAST::toAST(ASTBuilder * builder) const{
+	return ASTRebuilder(this, builder).program();
+}
+
+}
@@ -0,0 +1,269 @@
+#include "flat_ast.hpp"
+#include "symbol_table.hpp"
+#include "errors.hpp"
+
+namespace drewgon{
+
+// Unparses a FlatAST exactly as unparse.cpp does the AST it was
+// copied from. An indent of -1 asks for a statement without its
+// indentation or trailing ";\n", as in the header of a for loop.
+class FlatUnparser{
+public:
+	FlatUnparser(const FlatAST * astIn, std::ostream& outIn,
+	  const std::vector<SemSymbol *> * symbolsIn)
+	: ast(astIn), out(outIn), symbols(symbolsIn){ }
+
+	void stmts(uint32_t list, int indent){
+		for (NodeIdx stmt : ast->list(list)){
+			this->stmt(stmt, indent);
+		}
+	}
+
+	void stmt(NodeIdx node, int indent){
+		uint32_t a = ast->a(node);
+		switch (ast->kind(node)){
+		case FlatKind::Program:
+			stmts(a, indent);
+			return;
+		case FlatKind::VarDecl:
+			startLine(indent);
+			type(a);
+			out << " ";
+			exp(ast->b(node));
+			endLine(indent);
+			return;
+		case FlatKind::FormalDecl:
+			doIndent(indent);
+			type(a);
+			out << " ";
+			exp(ast->b(node));
+			return;
+		case FlatKind::FnDecl:
+			doIndent(indent);
+			type(ast->extra(a));
+			out << " ";
+			exp(ast->extra(a + 1));
+			out << "(";
+			list(ast->extra(a + 2));
+			out << "){\n";
+			stmts(ast->extra(a + 3), indent + 1);
+			doIndent(indent);
+			out << "}\n";
+			return;
+		case FlatKind::AssignStmt:
+		case FlatKind::CallStmt:
+			startLine(indent);
+			exp(a);
+			endLine(indent);
+			return;
+		case FlatKind::InputStmt:
+			startLine(indent);
+			out << "input ";
+			exp(a);
+			endLine(indent);
+			return;
+		case FlatKind::OutputStmt:
+			startLine(indent);
+			out << "output ";
+			exp(a);
+			endLine(indent);
+			return;
+		case FlatKind::PostIncStmt:
+			startLine(indent);
+			exp(a);
+			out << "++";
+			endLine(indent);
+			return;
+		case FlatKind::PostDecStmt:
+			startLine(indent);
+			exp(a);
+			out << "--";
+			endLine(indent);
+			return;
+		case FlatKind::IfStmt:
+			doIndent(indent);
+			out << "if (";
+			exp(a);
+			out << "){\n";
+			stmts(ast->b(node), indent + 1);
+			doIndent(indent);
+			out << "}\n";
+			return;
+		case FlatKind::IfElseStmt:
+			doIndent(indent);
+			out << "if (";
+			exp(a);
+			out << "){\n";
+			stmts(ast->extra(ast->b(node)), indent + 1);
+			doIndent(indent);
+			out << "} else {\n";
+			stmts(ast->extra(ast->b(node) + 1), indent + 1);
+			doIndent(indent);
+			out << "}\n";
+			return;
+		case FlatKind::WhileStmt:
+			doIndent(indent);
+			out << "while (";
+			exp(a);
+			out << "){\n";
+			stmts(ast->b(node), indent + 1);
+			doIndent(indent);
+			out << "}\n";
+			return;
+		case FlatKind::ForStmt:
+			doIndent(indent);
+			out << "for (";
+			stmt(ast->extra(a), -1);
+			out << "; ";
+			exp(ast->extra(a + 1));
+			out << "; ";
+			stmt(ast->extra(a + 2), -1);
+			out << "){\n";
+			stmts(ast->extra(a + 3), indent + 1);
+			doIndent(indent);
+			out << "}\n";
+			return;
+		case FlatKind::ReturnStmt:
+			startLine(indent);
+			out << "return";
+			if (a != FlatAST::NONE){
+				out << " ";
+				exp(a);
+			}
+			endLine(indent);
+			return;
+		default:
+			throw new InternalError("Unparse of a non-statement");
+		}
+	}
+
+	void exp(NodeIdx node){
+		uint32_t a = ast->a(node);
+		switch (ast->kind(node)){
+		case FlatKind::ID:
+			out << Interner::name(a);
+			if (symbols != nullptr && (*symbols)[node] != nullptr){
+				out << "("
+				  << (*symbols)[node]->getDataType()->getString()
+				  << ")";
+			}
+			return;
+		case FlatKind::IntLit:
+			out << static_cast<int>(a);
+			return;
+		case FlatKind::StrLit:
+			out.write(ast->text(node),
+			  static_cast<std::streamsize>(ast->b(node)));
+			return;
+		case FlatKind::True: out << "true"; return;
+		case FlatKind::False: out << "false"; return;
+		case FlatKind::Mayhem: out << "mayhem"; return;
+		case FlatKind::Assign:
+			exp(a);
+			out << " = ";
+			nested(ast->b(node));
+			return;
+		case FlatKind::Call:
+			exp(a);
+			out << "(";
+			list(ast->b(node));
+			out << ")";
+			return;
+		case FlatKind::Plus: binary(node, " + "); return;
+		case FlatKind::Minus: binary(node, " - "); return;
+		case FlatKind::Times: binary(node, " * "); return;
+		case FlatKind::Divide: binary(node, " / "); return;
+		case FlatKind::And: binary(node, " and "); return;
+		case FlatKind::Or: binary(node, " or "); return;
+		case FlatKind::Equals: binary(node, " == "); return;
+		case FlatKind::NotEquals: binary(node, " != "); return;
+		case FlatKind::Less: binary(node, " < "); return;
+		case FlatKind::LessEq: binary(node, " <= "); return;
+		case FlatKind::Greater: binary(node, " > "); return;
+		case FlatKind::GreaterEq: binary(node, " >= "); return;
+		case FlatKind::Neg:
+			out << "-";
+			nested(a);
+			return;
+		case FlatKind::Not:
+			out << "!";
+			nested(a);
+			return;
+		default:
+			//A type, or a formal in a FnDecl's list
+			type(node);
+			return;
+		}
+	}
+
+	void type(NodeIdx node){
+		switch (ast->kind(node)){
+		case FlatKind::VoidType: out << "void"; return;
+		case FlatKind::IntType: out << "int"; return;
+		case FlatKind::BoolType: out << "bool"; return;
+		case FlatKind::FnType:
+			out << "fn (";
+			list(ast->a(node));
+			out << ")";
+			out << "->";
+			type(ast->b(node));
+			return;
+		default:
+			stmt(node, 0);
+			return;
+		}
+	}
+private:
+	void doIndent(int indent){
+		for (int k = 0 ; k < indent; k++){ out << "    "; }
+	}
+	void startLine(int indent){ if (indent != -1){ doIndent(indent); } }
+	void endLine(int indent){ if (indent != -1){ out << ";\n"; } }
+
+	//A comma-separated list, such as the args of a call
+	void list(uint32_t at){
+		bool first = true;
+		for (NodeIdx item : ast->list(at)){
+			if (first){ first = false; }
+			else { out << ", "; }
+			exp(item);
+		}
+	}
+
+	//An operand, parenthesized unless it is a single term
+	void nested(NodeIdx node){
+		switch (ast->kind(node)){
+		case FlatKind::ID:
+		case FlatKind::IntLit:
+		case FlatKind::StrLit:
+		case FlatKind::True:
+		case FlatKind::False:
+		case FlatKind::Mayhem:
+		case FlatKind::Call:
+			exp(node);
+			return;
+		default:
+			out << "(";
+			exp(node);
+			out << ")";
+			return;
+		}
+	}
+
+	void binary(NodeIdx node, const char * op){
+		nested(ast->a(node));
+		out << op;
+		nested(ast->b(node));
+	}
+
+	const FlatAST * ast;
+	std::ostream& out;
+	const std::vector<SemSymbol *> * symbols;
+};
+
+void FlatAST::unparse(std::ostream& out,
+  const std::vector<SemSymbol *> * symbols) const{
+	FlatUnparser(this, out, symbols).stmt(root(), 0);
+}
+
+}
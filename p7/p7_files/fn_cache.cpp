@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "fn_cache.hpp"
+
+namespace drewgon{
+
+//Bump this whenever the layout of an entry changes. Entries
+// written by another build of dgc (whose back end may emit other
+// code) are told apart by the build's identity, in the key.
+static const char * CACHE_VERSION = "dgc function cache 3";
+
+static const char * ENTRY_EXT = ".fn";
+
+static uint64_t fnv1a(const std::string& str){
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : str){
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+//A hash of the running dgc binary, so that an entry is only
+// reused by the very build that wrote it. If the binary can't be
+// read, entries are only reused within this process.
+static std::string hashBuild(){
+	std::ifstream exe("/proc/self/exe", std::ios::binary);
+	if (!exe.good()){ return "process " + std::to_string(getpid()); }
+	uint64_t hash = 14695981039346656037ull;
+	std::vector<char> block(1 << 16);
+	while (exe.read(block.data(), static_cast<std::streamsize>(block.size()))
+	  || exe.gcount() > 0){
+		size_t len = static_cast<size_t>(exe.gcount());
+		size_t i = 0;
+		//A word at a time, as the binary is megabytes long
+		for (; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)){
+			uint64_t word;
+			memcpy(&word, block.data() + i, sizeof(word));
+			hash ^= word;
+			hash *= 1099511628211ull;
+		}
+		for (; i < len; i++){
+			hash ^= static_cast<unsigned char>(block[i]);
+			hash *= 1099511628211ull;
+		}
+	}
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx",
+	  static_cast<unsigned long long>(hash));
+	return name;
+}
+
+static const std::string& buildIdentity(){
+	static const std::string identity = hashBuild();
+	return identity;
+}
+
+//The key an entry is stored under: the function's, qualified by
+// the entry layout and the build of dgc
+static std::string entryKey(const std::string& fnKey){
+	return std::string(CACHE_VERSION) + "\n" + buildIdentity() + "\n"
+	  + fnKey;
+}
+
+//A decimal count, which must be all digits and fit in a size_t
+static bool parseCount(const std::string& str, size_t& val){
+	if (str.empty()
+	  || str.find_first_not_of("0123456789") != std::string::npos){
+		return false;
+	}
+	errno = 0;
+	unsigned long long parsed = strtoull(str.c_str(), nullptr, 10);
+	if (errno == ERANGE || parsed > SIZE_MAX){ return false; }
+	val = static_cast<size_t>(parsed);
+	return true;
+}
+
+static void writeField(std::ostream& out, const std::string& field){
+	out << field.size() << "\n" << field << "\n";
+}
+
+static bool readField(const std::string& data, size_t& pos,
+  std::string& field){
+	size_t newline = data.find('\n', pos);
+	if (newline == std::string::npos){ return false; }
+	size_t len;
+	if (!parseCount(data.substr(pos, newline - pos), len)){ return false; }
+	pos = newline + 1;
+	if (len > data.size() - pos || data.size() - pos - len < 1){
+		return false;
+	}
+	field = data.substr(pos, len);
+	pos += len + 1;
+	return true;
+}
+
+FnCache::FnCache(const std::string& dirIn, size_t limitIn)
+: dir(dirIn), limit(limitIn), hits(0), misses(0), stores(0),
+  evicted(0), evictedBytes(0){
+	//Create the directory (and any missing parents) up front
+	for (size_t slash = dir.find('/', 1); ;
+	  slash = dir.find('/', slash + 1)){
+		mkdir(dir.substr(0, slash).c_str(), 0777);
+		if (slash == std::string::npos){ break; }
+	}
+}
+
+std::string FnCache::entryPath(const std::string& key) const{
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx",
+	  static_cast<unsigned long long>(fnv1a(key)));
+	return dir + "/" + name + ENTRY_EXT;
+}
+
+CachedFn * FnCache::lookup(const std::string& fnKey){
+	std::string key = entryKey(fnKey);
+	std::string path = entryPath(key);
+	std::ifstream in(path, std::ios::binary);
+	if (!in.good()){
+		misses++;
+		return nullptr;
+	}
+	std::ostringstream contents;
+	contents << in.rdbuf();
+	std::string data = contents.str();
+
+	size_t pos = 0;
+	std::string storedKey;
+	std::string count;
+	size_t numStrings = 0;
+	CachedFn * fn = new CachedFn();
+	//Each string takes two fields of at least "0\n\n", so a count
+	// of more than the rest of the entry could hold is corrupt
+	bool ok = readField(data, pos, storedKey) && storedKey == key
+	  && readField(data, pos, fn->threeAC)
+	  && readField(data, pos, fn->x64)
+	  && readField(data, pos, count)
+	  && parseCount(count, numStrings)
+	  && numStrings <= (data.size() - pos) / 6;
+	if (ok){
+		for (size_t i = 0; ok && i < numStrings; i++){
+			std::pair<std::string, std::string> str;
+			ok = readField(data, pos, str.first)
+			  && readField(data, pos, str.second);
+			fn->strings.push_back(str);
+		}
+	}
+	if (!ok || pos != data.size()){
+		delete fn;
+		misses++;
+		return nullptr;
+	}
+
+	//Mark the entry as recently used, for eviction
+	utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+	hits++;
+	return fn;
+}
+
+void FnCache::store(const std::string& fnKey, const CachedFn& fn){
+	std::string key = entryKey(fnKey);
+	std::string path = entryPath(key);
+
+	//Write to a private file and rename it into place so that
+	// concurrent readers never see a partial entry
+	static std::atomic<unsigned long> tmpCount(0);
+	std::string tmpPath = path + ".tmp." + std::to_string(getpid())
+	  + "." + std::to_string(tmpCount++);
+	std::ofstream out(tmpPath, std::ios::binary);
+	if (!out.good()){ return; }
+	writeField(out, key);
+	writeField(out, fn.threeAC);
+	writeField(out, fn.x64);
+	writeField(out, std::to_string(fn.strings.size()));
+	for (const auto& str : fn.strings){
+		writeField(out, str.first);
+		writeField(out, str.second);
+	}
+	out.close();
+	if (!out.good() || rename(tmpPath.c_str(), path.c_str()) != 0){
+		unlink(tmpPath.c_str());
+		return;
+	}
+	stores++;
+}
+
+void FnCache::evict(){
+	if (limit == 0){ return; }
+
+	struct Entry{
+		std::string path;
+		size_t size;
+		struct timespec used;
+	};
+	std::vector<Entry> entries;
+	size_t total = 0;
+
+	DIR * listing = opendir(dir.c_str());
+	if (listing == nullptr){ return; }
+	std::string ext = ENTRY_EXT;
+	while (struct dirent * dirEntry = readdir(listing)){
+		std::string name = dirEntry->d_name;
+		if (name.size() <= ext.size()
+		  || name.compare(name.size() - ext.size(), ext.size(), ext) != 0){
+			continue;
+		}
+		Entry entry;
+		entry.path = dir + "/" + name;
+		struct stat info;
+		if (stat(entry.path.c_str(), &info) != 0){ continue; }
+		entry.size = static_cast<size_t>(info.st_size);
+		entry.used = info.st_mtim;
+		total += entry.size;
+		entries.push_back(entry);
+	}
+	closedir(listing);
+	if (total <= limit){ return; }
+
+	std::sort(entries.begin(), entries.end(),
+	  [](const Entry& a, const Entry& b){
+		if (a.used.tv_sec != b.used.tv_sec){
+			return a.used.tv_sec < b.used.tv_sec;
+		}
+		return a.used.tv_nsec < b.used.tv_nsec;
+	});
+	for (const Entry& entry : entries){
+		if (total <= limit){ break; }
+		if (unlink(entry.path.c_str()) == 0){
+			total -= entry.size;
+			evicted++;
+			evictedBytes += entry.size;
+		}
+	}
+}
+
+void FnCache::reportStats(std::ostream& out) const{
+	out << "Function cache " << dir << ": "
+	  << hits << " hits, " << misses << " misses, "
+	  << stores << " stored, " << evicted << " evicted ("
+	  << evictedBytes << " bytes)\n";
+}
+
+bool FnCache::parseSize(const std::string& str, size_t& size){
+	size_t digits = str.find_first_not_of("0123456789");
+	if (digits == 0 || str.empty()){ return false; }
+	if (!parseCount(str.substr(0, digits), size)){ return false; }
+	if (digits == std::string::npos){ return true; }
+	if (digits + 1 != str.size()){ return false; }
+	unsigned int shift;
+	switch (str[digits]){
+		case 'K': case 'k': shift = 10; break;
+		case 'M': case 'm': shift = 20; break;
+		case 'G': case 'g': shift = 30; break;
+		default: return false;
+	}
+	if (size > (SIZE_MAX >> shift)){ return false; }
+	size <<= shift;
+	return true;
+}
+
+}
@@ -0,0 +1,61 @@
+#ifndef DREWGON_FN_CACHE_HPP
+#define DREWGON_FN_CACHE_HPP
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace drewgon{
+
+// What the back end produced for one function: its 3AC and x64
+// text along with the string literals it defines. Labels and
+// string names are scoped to the function (lbl_<fn>_N,
+// str_<fn>_N), so the text can be spliced into any program.
+class CachedFn{
+public:
+	std::string threeAC;
+	std::string x64;
+	std::vector<std::pair<std::string, std::string>> strings;
+};
+
+// An on-disk, content-addressed cache of compiled functions.
+// Entries are keyed by the function's text after name analysis,
+// where every identifier carries its type, so a function is only
+// reused if neither it nor the signatures of the globals it uses
+// have changed. The key is stored in the entry and compared on
+// lookup, so a hash collision is just a miss. Safe to share
+// between threads.
+class FnCache{
+public:
+	FnCache(const std::string& dirIn, size_t limitIn);
+
+	//The cached function for key, or nullptr on a miss
+	CachedFn * lookup(const std::string& key);
+	void store(const std::string& key, const CachedFn& fn);
+
+	//Delete the least recently used entries until the cache
+	// fits in its size limit (if it has one)
+	void evict();
+
+	void reportStats(std::ostream& out) const;
+
+	//Parse a size like 4096, 512K, 64M or 2G. Returns false
+	// if str isn't one.
+	static bool parseSize(const std::string& str, size_t& size);
+private:
+	std::string entryPath(const std::string& key) const;
+
+	std::string dir;
+	size_t limit;
+	std::atomic<size_t> hits;
+	std::atomic<size_t> misses;
+	std::atomic<size_t> stores;
+	std::atomic<size_t> evicted;
+	std::atomic<size_t> evictedBytes;
+};
+
+}
+
+#endif
@@ -0,0 +1,485 @@
+#include <cstring>
+#include "scanner.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DREWGON_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+// A hand-written equivalent of the flex scanner in drewgon.l: the
+// same tokens, positions and errors, including for malformed input.
+// Runs of blanks, comment text, identifier characters, digits and
+// plain string characters are measured 16 (SSE2) or 32 (AVX2) bytes
+// at a time, picked at run time by what the CPU supports, and
+// keywords are told from identifiers by a perfect hash.
+
+namespace drewgon{
+
+using TokenKind = drewgon::Parser::token;
+
+//The kinds of run the scanner measures. A run is made of the
+// bytes inRun accepts, and ends at the first byte it doesn't.
+enum RunKind{
+	BLANK_RUN,   //Spaces and tabs
+	IDENT_RUN,   //Letters, digits and underscores
+	DIGIT_RUN,
+	COMMENT_RUN, //Anything but a newline
+	STRING_RUN   //Anything but a quote, backslash or newline
+};
+
+template <RunKind kind>
+static inline bool inRun(unsigned char c){
+	switch (kind){
+	case BLANK_RUN: return c == ' ' || c == '\t';
+	case IDENT_RUN:
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+		  || (c >= '0' && c <= '9') || c == '_';
+	case DIGIT_RUN: return c >= '0' && c <= '9';
+	case COMMENT_RUN: return c != '\n';
+	case STRING_RUN: return c != '"' && c != '\\' && c != '\n';
+	}
+	return false;
+}
+
+template <RunKind kind>
+static size_t spanScalar(const char * p, const char * end){
+	const char * start = p;
+	while (p < end && inRun<kind>(static_cast<unsigned char>(*p))){ p++; }
+	return static_cast<size_t>(p - start);
+}
+
+#ifdef DREWGON_X86_SIMD
+
+//Which bytes of v (one bit each) are in [lo, hi]. The compares
+// are signed, so bytes of 0x80 and up are never in range, which
+// suits every range used here.
+static inline __m128i inRange16(__m128i v, char lo, char hi){
+	return _mm_and_si128(
+	  _mm_cmpgt_epi8(v, _mm_set1_epi8(static_cast<char>(lo - 1))),
+	  _mm_cmplt_epi8(v, _mm_set1_epi8(static_cast<char>(hi + 1))));
+}
+
+static inline __m128i is16(__m128i v, char c){
+	return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+
+template <RunKind kind>
+static inline unsigned int runMask16(__m128i v){
+	__m128i in = _mm_setzero_si128();
+	switch (kind){
+	case BLANK_RUN:
+		in = _mm_or_si128(is16(v, ' '), is16(v, '\t'));
+		break;
+	case IDENT_RUN:
+		//Setting bit 5 lowercases letters without making
+		// anything else a letter
+		in = _mm_or_si128(
+		  _mm_or_si128(inRange16(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'),
+		    inRange16(v, '0', '9')),
+		  is16(v, '_'));
+		break;
+	case DIGIT_RUN:
+		in = inRange16(v, '0', '9');
+		break;
+	case COMMENT_RUN:
+		in = _mm_andnot_si128(is16(v, '\n'), _mm_set1_epi8(-1));
+		break;
+	case STRING_RUN:
+		in = _mm_andnot_si128(
+		  _mm_or_si128(_mm_or_si128(is16(v, '"'), is16(v, '\\')), is16(v, '\n')),
+		  _mm_set1_epi8(-1));
+		break;
+	}
+	return static_cast<unsigned int>(_mm_movemask_epi8(in));
+}
+
+template <RunKind kind>
+static size_t spanSSE2(const char * p, const char * end){
+	const char * start = p;
+	while (end - p >= 16){
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		unsigned int out = ~runMask16<kind>(v) & 0xffffu;
+		if (out != 0){
+			return static_cast<size_t>(p - start)
+			  + static_cast<size_t>(__builtin_ctz(out));
+		}
+		p += 16;
+	}
+	return static_cast<size_t>(p - start) + spanScalar<kind>(p, end);
+}
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+static inline __m256i inRange32(__m256i v, char lo, char hi){
+	return _mm256_and_si256(
+	  _mm256_cmpgt_epi8(v, _mm256_set1_epi8(static_cast<char>(lo - 1))),
+	  _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(hi + 1)), v));
+}
+
+static inline __m256i is32(__m256i v, char c){
+	return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+
+template <RunKind kind>
+static inline unsigned int runMask32(__m256i v){
+	__m256i in = _mm256_setzero_si256();
+	switch (kind){
+	case BLANK_RUN:
+		in = _mm256_or_si256(is32(v, ' '), is32(v, '\t'));
+		break;
+	case IDENT_RUN:
+		in = _mm256_or_si256(
+		  _mm256_or_si256(inRange32(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z'),
+		    inRange32(v, '0', '9')),
+		  is32(v, '_'));
+		break;
+	case DIGIT_RUN:
+		in = inRange32(v, '0', '9');
+		break;
+	case COMMENT_RUN:
+		in = _mm256_andnot_si256(is32(v, '\n'), _mm256_set1_epi8(-1));
+		break;
+	case STRING_RUN:
+		in = _mm256_andnot_si256(
+		  _mm256_or_si256(_mm256_or_si256(is32(v, '"'), is32(v, '\\')), is32(v, '\n')),
+		  _mm256_set1_epi8(-1));
+		break;
+	}
+	return static_cast<unsigned int>(_mm256_movemask_epi8(in));
+}
+
+template <RunKind kind>
+static size_t spanAVX2(const char * p, const char * end){
+	const char * start = p;
+	while (end - p >= 32){
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		unsigned int out = ~runMask32<kind>(v);
+		if (out != 0){
+			return static_cast<size_t>(p - start)
+			  + static_cast<size_t>(__builtin_ctz(out));
+		}
+		p += 32;
+	}
+	//Finish off with 16 bytes at a time
+	return static_cast<size_t>(p - start) + spanSSE2<kind>(p, end);
+}
+
+#pragma GCC pop_options
+
+#endif
+
+//The length of the run of kind starting at p. Most runs (names,
+// numbers, indentation) are only a few bytes long, and end before
+// a vector would even be loaded, so those bytes are checked one at
+// a time first.
+template <RunKind kind>
+static inline size_t span(Scanner::SimdLevel simd, const char * p,
+  const char * end){
+	const size_t SHORT_RUN = 8;
+	size_t len = 0;
+	for (; len < SHORT_RUN; len++){
+		if (p + len == end
+		  || !inRun<kind>(static_cast<unsigned char>(p[len]))){
+			return len;
+		}
+	}
+#ifdef DREWGON_X86_SIMD
+	switch (simd){
+	case Scanner::AVX2: return len + spanAVX2<kind>(p + len, end);
+	case Scanner::SSE2: return len + spanSSE2<kind>(p + len, end);
+	case Scanner::SCALAR: break;
+	}
+#endif
+	return len + spanScalar<kind>(p + len, end);
+}
+
+static Scanner::SimdLevel bestSimd(){
+#ifdef DREWGON_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")){ return Scanner::AVX2; }
+	if (__builtin_cpu_supports("sse2")){ return Scanner::SSE2; }
+#endif
+	return Scanner::SCALAR;
+}
+
+static Scanner::SimdLevel& simdSlot(){
+	static Scanner::SimdLevel level = bestSimd();
+	return level;
+}
+
+Scanner::SimdLevel Scanner::simdLevel(){
+	return simdSlot();
+}
+
+const char * Scanner::simdName(SimdLevel level){
+	switch (level){
+	case AVX2: return "avx2";
+	case SSE2: return "sse2";
+	case SCALAR: break;
+	}
+	return "scalar";
+}
+
+void Scanner::limitSimd(SimdLevel level){
+	if (level < simdSlot()){ simdSlot() = level; }
+}
+
+//Keywords by a perfect hash of their length and first and last
+// letters: no two keywords share a slot, so telling whether an
+// identifier is a keyword takes one probe and one compare.
+class KeywordTable{
+public:
+	KeywordTable(){
+		for (Slot& slot : slots){
+			slot.text = nullptr;
+			slot.len = 0;
+			slot.kind = TokenKind::ID;
+		}
+		add("int", TokenKind::INT);
+		add("fn", TokenKind::FN);
+		add("bool", TokenKind::BOOL);
+		add("void", TokenKind::VOID);
+		add("if", TokenKind::IF);
+		add("else", TokenKind::ELSE);
+		add("while", TokenKind::WHILE);
+		add("for", TokenKind::FOR);
+		add("return", TokenKind::RETURN);
+		add("output", TokenKind::OUTPUT);
+		add("input", TokenKind::INPUT);
+		add("false", TokenKind::FALSE);
+		add("true", TokenKind::TRUE);
+		add("mayhem", TokenKind::MAYHEM);
+		add("and", TokenKind::AND);
+		add("or", TokenKind::OR);
+	}
+
+	//The keyword's token kind, or ID if it isn't one
+	int kind(const char * text, size_t len) const{
+		if (len < MIN_LEN || len > MAX_LEN){ return TokenKind::ID; }
+		const Slot& slot = slots[hash(text, len)];
+		if (slot.len != len || memcmp(slot.text, text, len) != 0){
+			return TokenKind::ID;
+		}
+		return slot.kind;
+	}
+private:
+	static const size_t MIN_LEN = 2;
+	static const size_t MAX_LEN = 6;
+	static const size_t NUM_SLOTS = 32;
+
+	class Slot{
+	public:
+		const char * text;
+		size_t len;
+		int kind;
+	};
+
+	static size_t hash(const char * text, size_t len){
+		size_t first = static_cast<unsigned char>(text[0]);
+		size_t last = static_cast<unsigned char>(text[len - 1]);
+		return (3 * first + last + 4 * len) % NUM_SLOTS;
+	}
+
+	void add(const char * text, int kind){
+		size_t len = strlen(text);
+		Slot& slot = slots[hash(text, len)];
+		if (slot.text != nullptr){
+			throw new InternalError("Keyword hash collision");
+		}
+		slot.text = text;
+		slot.len = len;
+		slot.kind = kind;
+	}
+
+	Slot slots[NUM_SLOTS];
+};
+
+static const KeywordTable keywords;
+
+int Scanner::scan(drewgon::Parser::semantic_type * const lval){
+	this->yylval = lval;
+	const char * const text = src->data();
+	const char * const end = text + textEnd;
+	while (true){
+		const char * p = text + scanPos;
+		if (p == end){ return TokenKind::END; }
+		tokenStart = scanPos;
+
+		//The token (or blank space, comment or error) at p is
+		// len bytes long
+		size_t len = 1;
+		unsigned char c = static_cast<unsigned char>(*p);
+		switch (c){
+		case ' ':
+		case '\t':
+			len = span<BLANK_RUN>(simd, p, end);
+			scanPos += len;
+			continue;
+		case '\n':
+			scanPos++;
+			continue;
+		case '\r':
+			if (p + 1 < end && p[1] == '\n'){
+				scanPos += 2;
+				continue;
+			}
+			break;
+		case '/':
+			if (p + 1 < end && p[1] == '/'){
+				len = 2 + span<COMMENT_RUN>(simd, p + 2, end);
+				scanPos += len;
+				continue;
+			}
+			scanPos++;
+			return makeBareToken(TokenKind::DIVIDE, 1);
+		case '"': {
+			int tokenKind = scanString(p, end);
+			if (tokenKind != TokenKind::END){ return tokenKind; }
+			continue;
+		}
+		default:
+			break;
+		}
+
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'){
+			len = 1 + span<IDENT_RUN>(simd, p + 1, end);
+			scanPos += len;
+			int kind = keywords.kind(p, len);
+			if (kind == TokenKind::ID){ return makeIDToken(p, len); }
+			return makeBareToken(kind, len);
+		}
+		if (c >= '0' && c <= '9'){
+			len = 1 + span<DIGIT_RUN>(simd, p + 1, end);
+			scanPos += len;
+			return makeIntToken(p, len);
+		}
+
+		//Operators are at most two characters long
+		scanPos++;
+		switch (c){
+		case '{': return makeBareToken(TokenKind::LCURLY, 1);
+		case '}': return makeBareToken(TokenKind::RCURLY, 1);
+		case '(': return makeBareToken(TokenKind::LPAREN, 1);
+		case ')': return makeBareToken(TokenKind::RPAREN, 1);
+		case ';': return makeBareToken(TokenKind::SEMICOL, 1);
+		case ',': return makeBareToken(TokenKind::COMMA, 1);
+		case '*': return makeBareToken(TokenKind::TIMES, 1);
+		case '+':
+			if (p + 1 < end && p[1] == '+'){
+				scanPos++;
+				return makeBareToken(TokenKind::POSTINC, 2);
+			}
+			return makeBareToken(TokenKind::PLUS, 1);
+		case '-':
+			if (p + 1 < end && (p[1] == '-' || p[1] == '>')){
+				scanPos++;
+				return makeBareToken(p[1] == '-' ? TokenKind::POSTDEC
+				  : TokenKind::ARROW, 2);
+			}
+			return makeBareToken(TokenKind::MINUS, 1);
+		case '!':
+		case '=':
+		case '<':
+		case '>': {
+			static const int alone[] = {TokenKind::NOT, TokenKind::ASSIGN,
+			  TokenKind::LESS, TokenKind::GREATER};
+			static const int withEq[] = {TokenKind::NOTEQUALS,
+			  TokenKind::EQUALS, TokenKind::LESSEQ, TokenKind::GREATEREQ};
+			size_t which = c == '!' ? 0 : c == '=' ? 1 : c == '<' ? 2 : 3;
+			if (p + 1 < end && p[1] == '='){
+				scanPos++;
+				return makeBareToken(withEq[which], 2);
+			}
+			return makeBareToken(alone[which], 1);
+		}
+		default:
+			break;
+		}
+
+		Position pos = matchPos(1);
+		errIllegal(&pos, std::string(p, 1));
+	}
+}
+
+//Scan the string literal whose opening quote is at quote, matching
+// it as drewgon.l's four string rules would: the longest match
+// wins, and the earliest rule breaks ties. Returns STRINGLITERAL
+// for a good literal, and otherwise reports the error and returns
+// END (to scan on from after the bad literal).
+int Scanner::scanString(const char * quote, const char * end){
+	//The common case: plain characters up to the closing quote
+	const char * body = quote + 1;
+	const char * stop = body + span<STRING_RUN>(simd, body, end);
+	if (stop < end && *stop == '"'){
+		size_t len = static_cast<size_t>(stop + 1 - quote);
+		scanPos += len;
+		return makeStrToken(quote, len);
+	}
+
+	//Otherwise there is a backslash or the line ends first. The
+	// good string rules take only \n, \t, \" and \\ escapes; what
+	// they match is found by reading the escapes in order.
+	const char * good = body;
+	const char * closed = nullptr;
+	while (good < end && *good != '\n'){
+		if (*good == '"'){
+			closed = good;
+			break;
+		}
+		if (*good == '\\'){
+			char esc = good + 1 < end ? good[1] : '\0';
+			if (esc != 'n' && esc != 't' && esc != '"' && esc != '\\'){ break; }
+			good += 2;
+			continue;
+		}
+		good++;
+	}
+
+	//The bad escape rules also let a backslash stand alone, so any
+	// quote with a backslash before it can be read as escaped. They
+	// can run up to the first quote without one (which the bad
+	// terminated rule includes) or else the end of the line, and
+	// match if some backslash in between can be read as a bad
+	// escape: that is, any but one that must escape a quote.
+	const char * bare = nullptr;
+	const char * lineEnd = body;
+	for (; lineEnd < end && *lineEnd != '\n'; lineEnd++){
+		if (*lineEnd == '"' && lineEnd[-1] != '\\'){
+			bare = lineEnd;
+			break;
+		}
+	}
+	const char * badEnd = bare != nullptr ? bare : lineEnd;
+	bool hasBad = false;
+	for (const char * q = body; q < badEnd && !hasBad; q++){
+		hasBad = *q == '\\' && (q + 1 == badEnd || q[1] != '"');
+	}
+
+	//Lengths of the matches of drewgon.l's string rules, in order
+	size_t lens[4] = {
+		closed != nullptr ? static_cast<size_t>(closed + 1 - quote) : 0,
+		static_cast<size_t>((closed != nullptr ? closed : good) - quote),
+		hasBad ? static_cast<size_t>(badEnd - quote) : 0,
+		hasBad && bare != nullptr ? static_cast<size_t>(bare + 1 - quote) : 0,
+	};
+	size_t rule = 0;
+	for (size_t i = 1; i < 4; i++){
+		if (lens[i] > lens[rule]){ rule = i; }
+	}
+	size_t len = lens[rule];
+	scanPos += len;
+	if (rule == 0){ return makeStrToken(quote, len); }
+
+	Position pos = matchPos(len);
+	if (rule == 1){
+		errStrUnterm(&pos);
+	} else if (rule == 2){
+		errStrEscAndUnterm(&pos);
+	} else {
+		errStrEsc(&pos);
+	}
+	return TokenKind::END;
+}
+
+}
@@ -0,0 +1,54 @@
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include "host_runtime.hpp"
+#include "errors.hpp"
+
+namespace drewgon{
+namespace hostrt{
+
+int64_t mayhem(){
+	static bool seeded = false;
+	if (!seeded){
+		srand(static_cast<unsigned int>(time(nullptr)));
+		seeded = true;
+	}
+	return rand();
+}
+
+void printBool(int64_t c){
+	Report::messages() << (c == 0 ? "false" : "true");
+}
+
+void printInt(int64_t num){
+	Report::messages() << num;
+}
+
+void printString(const char * str){
+	Report::messages() << str;
+}
+
+int64_t getBool(){
+	Report::messages().flush();
+	int c = std::cin.get();
+	std::cin.get(); // Consume trailing newline
+	return c == '0' ? 0 : 1;
+}
+
+int64_t getInt(){
+	Report::messages().flush();
+	//Read like fgets(buffer, 32, stdin) does
+	char buffer[32];
+	size_t len = 0;
+	while (len < sizeof(buffer) - 1){
+		int c = std::cin.get();
+		if (c == EOF){ break; }
+		buffer[len++] = static_cast<char>(c);
+		if (c == '\n'){ break; }
+	}
+	buffer[len] = '\0';
+	return strtol(buffer, nullptr, 10);
+}
+
+}
+}
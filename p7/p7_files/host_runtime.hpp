@@ -0,0 +1,24 @@
+#ifndef DREWGON_HOST_RUNTIME_HPP
+#define DREWGON_HOST_RUNTIME_HPP
+
+#include <cstdint>
+
+namespace drewgon{
+
+// The runtime, as stddrewgon.c provides it to linked programs,
+// for programs that run inside dgc (--run and --vm). Output goes
+// to Report::messages() and input comes from std::cin.
+namespace hostrt{
+
+int64_t mayhem();
+void printBool(int64_t c);
+void printInt(int64_t num);
+void printString(const char * str);
+int64_t getBool();
+int64_t getInt();
+
+}
+
+}
+
+#endif
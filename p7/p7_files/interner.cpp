@@ -0,0 +1,131 @@
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include "interner.hpp"
+#include "errors.hpp"
+
+namespace drewgon{
+
+//Names are stored in segments that double in size, so that none
+// is ever moved: segment k holds FIRST_SEGMENT << k names
+static const size_t FIRST_SEGMENT = 1024;
+static const size_t NUM_SEGMENTS = 23;
+//Each thread remembers the names it interned most recently, so
+// that most names are found again without taking the lock
+static const size_t CACHE_SLOTS = 4096;
+
+namespace {
+
+//A view of a name, either being looked up or in a segment
+class Text{
+public:
+	const char * data;
+	size_t len;
+	bool operator==(const Text& other) const{
+		return len == other.len && memcmp(data, other.data, len) == 0;
+	}
+};
+
+class TextHash{
+public:
+	size_t operator()(const Text& text) const{
+		//FNV-1a
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < text.len; i++){
+			hash ^= static_cast<unsigned char>(text.data[i]);
+			hash *= 1099511628211ull;
+		}
+		return static_cast<size_t>(hash);
+	}
+};
+
+class Table{
+public:
+	std::mutex lock;
+	std::unordered_map<Text, SymbolId, TextHash> ids;
+	std::string * segments[NUM_SEGMENTS] = { };
+	size_t count = 0;
+};
+
+class CacheSlot{
+public:
+	size_t hash;
+	//Zero (as every slot starts) for an empty slot
+	size_t idPlusOne;
+};
+
+thread_local CacheSlot cache[CACHE_SLOTS];
+
+Table& table(){
+	static Table theTable;
+	return theTable;
+}
+
+//Which segment id is in, and where
+size_t segmentOf(size_t id){
+	unsigned long long slots = id / FIRST_SEGMENT + 1;
+	return static_cast<size_t>(63 - __builtin_clzll(slots));
+}
+
+size_t offsetOf(size_t id, size_t seg){
+	return id - FIRST_SEGMENT * ((static_cast<size_t>(1) << seg) - 1);
+}
+
+//The ID of key, given a new one if it has none yet
+SymbolId lookupOrAdd(const Text& key){
+	Table& tab = table();
+	std::lock_guard<std::mutex> guard(tab.lock);
+	auto known = tab.ids.find(key);
+	if (known != tab.ids.end()){ return known->second; }
+
+	size_t id = tab.count;
+	size_t seg = segmentOf(id);
+	if (seg >= NUM_SEGMENTS){
+		throw new InternalError("Too many distinct identifiers");
+	}
+	if (tab.segments[seg] == nullptr){
+		tab.segments[seg] = new std::string[FIRST_SEGMENT << seg];
+	}
+	std::string& stored = tab.segments[seg][offsetOf(id, seg)];
+	stored.assign(key.data, key.len);
+	//The table's key is a view of the stored name, which never moves
+	Text storedKey;
+	storedKey.data = stored.data();
+	storedKey.len = key.len;
+	tab.ids[storedKey] = static_cast<SymbolId>(id);
+	tab.count++;
+	return static_cast<SymbolId>(id);
+}
+
+}
+
+SymbolId Interner::intern(const char * text, size_t len){
+	Text key;
+	key.data = text;
+	key.len = len;
+	size_t hash = TextHash()(key);
+	CacheSlot& slot = cache[hash % CACHE_SLOTS];
+	if (slot.idPlusOne != 0 && slot.hash == hash){
+		SymbolId id = static_cast<SymbolId>(slot.idPlusOne - 1);
+		const std::string& known = name(id);
+		if (known.size() == len && memcmp(known.data(), text, len) == 0){
+			return id;
+		}
+	}
+	slot.hash = hash;
+	slot.idPlusOne = static_cast<size_t>(lookupOrAdd(key)) + 1;
+	return static_cast<SymbolId>(slot.idPlusOne - 1);
+}
+
+const std::string& Interner::name(SymbolId id){
+	size_t seg = segmentOf(id);
+	return table().segments[seg][offsetOf(id, seg)];
+}
+
+size_t Interner::size(){
+	Table& tab = table();
+	std::lock_guard<std::mutex> guard(tab.lock);
+	return tab.count;
+}
+
+}
@@ -0,0 +1,37 @@
+#ifndef DREWGON_INTERNER_HPP
+#define DREWGON_INTERNER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace drewgon{
+
+//A dense number standing for one distinct identifier
+typedef uint32_t SymbolId;
+
+// The table of every identifier dgc has seen. Each distinct name
+// is given the next SymbolId the first time it is interned (which
+// the scanner does as it makes each ID token), so that the rest of
+// the front end can compare, hash and store names as numbers.
+//
+// The table is shared by every compilation in the process (batch
+// mode and parallel scans run several threads at once). Interning
+// takes a lock unless the thread interned the same name recently.
+// Names are never moved or freed once interned, so looking one up
+// by its ID takes no lock at all.
+class Interner{
+public:
+	static SymbolId intern(const char * text, size_t len);
+	static SymbolId intern(const std::string& text){
+		return intern(text.data(), text.size());
+	}
+	//The name that id was given for
+	static const std::string& name(SymbolId id);
+	//How many distinct names have been interned
+	static size_t size();
+};
+
+}
+
+#endif
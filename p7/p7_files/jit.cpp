@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "jit.hpp"
+#include "errors.hpp"
+#include "host_runtime.hpp"
+
+namespace drewgon{
+
+namespace {
+
+class RuntimeFn{
+public:
+	const char * name;
+	uintptr_t addr;
+};
+
+const RuntimeFn runtimeFns[] = {
+	{"mayhem", reinterpret_cast<uintptr_t>(&hostrt::mayhem)},
+	{"printBool", reinterpret_cast<uintptr_t>(&hostrt::printBool)},
+	{"printInt", reinterpret_cast<uintptr_t>(&hostrt::printInt)},
+	{"printString", reinterpret_cast<uintptr_t>(&hostrt::printString)},
+	{"getBool", reinterpret_cast<uintptr_t>(&hostrt::getBool)},
+	{"getInt", reinterpret_cast<uintptr_t>(&hostrt::getInt)},
+};
+
+//Runtime functions are too far away for the program's rel32
+// calls, so each gets a stub in the image that calls it. The
+// stub also realigns the stack, which generated code doesn't
+// keep 16-byte aligned at calls.
+const unsigned char stubCode[] = {
+	0x55,                               //push %rbp
+	0x48, 0x89, 0xe5,                   //mov %rsp, %rbp
+	0x48, 0x83, 0xe4, 0xf0,             //and $-16, %rsp
+	0x49, 0xbb, 0, 0, 0, 0, 0, 0, 0, 0, //movabs $fn, %r11
+	0x41, 0xff, 0xd3,                   //call *%r11
+	0xc9,                               //leave
+	0xc3,                               //ret
+};
+const size_t STUB_ADDR_AT = 10;
+const size_t STUB_SIZE = 32;
+
+//Called from C++ to run main: generated code doesn't preserve
+// the callee-saved registers, so this saves them all
+const unsigned char entryCode[] = {
+	0x53,                         //push %rbx
+	0x55,                         //push %rbp
+	0x41, 0x54,                   //push %r12
+	0x41, 0x55,                   //push %r13
+	0x41, 0x56,                   //push %r14
+	0x41, 0x57,                   //push %r15
+	0x48, 0x83, 0xec, 0x08,       //sub $8, %rsp
+	0xe8, 0, 0, 0, 0,             //call main
+	0x48, 0x83, 0xc4, 0x08,       //add $8, %rsp
+	0x41, 0x5f,                   //pop %r15
+	0x41, 0x5e,                   //pop %r14
+	0x41, 0x5d,                   //pop %r13
+	0x41, 0x5c,                   //pop %r12
+	0x5d,                         //pop %rbp
+	0x5b,                         //pop %rbx
+	0xc3,                         //ret
+};
+const size_t ENTRY_CALL_AT = 15;
+
+const uint64_t PAGE_SIZE = 0x1000;
+
+size_t roundUp(size_t val, size_t align){
+	return (val + align - 1) / align * align;
+}
+
+[[noreturn]] void jitError(const std::string& msg){
+	throw new InternalError(("JIT: " + msg).c_str());
+}
+
+}
+
+JITImage * JITImage::load(const ObjModule& mod){
+	std::unordered_map<std::string, size_t> defined;
+	for (size_t i = 0; i < mod.symbols.size(); i++){
+		if (mod.symbols[i].section != ObjSymbol::UNDEFINED){
+			defined[mod.symbols[i].name] = i;
+		}
+	}
+
+	//Everything referenced but not defined must be a runtime
+	// function, which gets a stub
+	std::vector<std::string> stubs;
+	std::unordered_map<std::string, size_t> stubIdx;
+	std::set<std::string> missing;
+	std::string undefined;
+	for (const ObjSection& sec : mod.sections){
+		for (const ObjReloc& rel : sec.relocs){
+			if (defined.count(rel.symbol) || stubIdx.count(rel.symbol)){
+				continue;
+			}
+			bool found = false;
+			for (const RuntimeFn& fn : runtimeFns){
+				found = found || rel.symbol == fn.name;
+			}
+			if (!found){
+				if (missing.insert(rel.symbol).second){
+					undefined += "\n  undefined reference to `" + rel.symbol + "'";
+				}
+				continue;
+			}
+			stubIdx[rel.symbol] = stubs.size();
+			stubs.push_back(rel.symbol);
+		}
+	}
+	if (!undefined.empty()){ jitError(undefined.substr(3)); }
+
+	//Code (the entry thunk, stubs, then executable sections) on
+	// pages that become read-only; data on the pages after
+	size_t stubsAt = roundUp(sizeof(entryCode), 16);
+	size_t pos = stubsAt + stubs.size() * STUB_SIZE;
+	std::vector<size_t> offsets(mod.sections.size());
+	for (int pass = 0; pass < 2; pass++){
+		bool wantExec = pass == 0;
+		if (!wantExec){ pos = roundUp(pos, PAGE_SIZE); }
+		for (size_t i = 0; i < mod.sections.size(); i++){
+			const ObjSection& sec = mod.sections[i];
+			if (sec.exec != wantExec){ continue; }
+			pos = roundUp(pos, sec.align == 0 ? 1 : sec.align);
+			offsets[i] = pos;
+			pos += sec.bytes.size();
+		}
+	}
+	size_t codeSize = 0;
+	for (size_t i = 0; i < mod.sections.size(); i++){
+		if (mod.sections[i].exec){
+			codeSize = std::max(codeSize, offsets[i] + mod.sections[i].bytes.size());
+		}
+	}
+	codeSize = roundUp(codeSize, PAGE_SIZE);
+	size_t total = roundUp(std::max(pos, codeSize + 1), PAGE_SIZE);
+
+	void * mapped = mmap(nullptr, total, PROT_READ | PROT_WRITE,
+	  MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if (mapped == MAP_FAILED){ jitError("could not map memory"); }
+	JITImage * image = new JITImage();
+	image->mem = static_cast<unsigned char *>(mapped);
+	image->size = total;
+	unsigned char * mem = image->mem;
+	uint64_t base = reinterpret_cast<uintptr_t>(mem);
+
+	memcpy(mem, entryCode, sizeof(entryCode));
+	for (size_t s = 0; s < stubs.size(); s++){
+		unsigned char * stub = mem + stubsAt + s * STUB_SIZE;
+		memcpy(stub, stubCode, sizeof(stubCode));
+		memset(stub + sizeof(stubCode), 0x90, STUB_SIZE - sizeof(stubCode));
+		for (const RuntimeFn& fn : runtimeFns){
+			if (stubs[s] != fn.name){ continue; }
+			memcpy(stub + STUB_ADDR_AT, &fn.addr, sizeof(fn.addr));
+		}
+	}
+	for (size_t i = 0; i < mod.sections.size(); i++){
+		const ObjSection& sec = mod.sections[i];
+		if (!sec.bytes.empty()){
+			memcpy(mem + offsets[i], sec.bytes.data(), sec.bytes.size());
+		}
+	}
+
+	auto addressOf = [&](const std::string& name) -> uint64_t{
+		auto def = defined.find(name);
+		if (def != defined.end()){
+			const ObjSymbol& sym = mod.symbols[def->second];
+			return base + offsets[sym.section] + sym.offset;
+		}
+		return base + stubsAt + stubIdx.at(name) * STUB_SIZE;
+	};
+
+	try {
+		for (size_t i = 0; i < mod.sections.size(); i++){
+			const ObjSection& sec = mod.sections[i];
+			for (const ObjReloc& rel : sec.relocs){
+				if (rel.offset + relocWidth(rel.type) > sec.bytes.size()){
+					jitError("relocation outside its section");
+				}
+				uint64_t place = base + offsets[i] + rel.offset;
+				if (!applyReloc(mem + offsets[i] + rel.offset, rel, place,
+				  addressOf(rel.symbol))){
+					jitError("relocation against `" + rel.symbol + "' is out of range");
+				}
+			}
+		}
+		if (defined.count("main") == 0){ jitError("no main function"); }
+		ObjReloc call;
+		call.offset = ENTRY_CALL_AT;
+		call.type = R_X86_64_PC32;
+		call.symbol = "main";
+		call.addend = -4;
+		applyReloc(mem + ENTRY_CALL_AT, call, base + ENTRY_CALL_AT,
+		  addressOf("main"));
+	} catch (InternalError *){
+		delete image;
+		throw;
+	}
+	if (mprotect(mem, codeSize, PROT_READ | PROT_EXEC) != 0){
+		delete image;
+		jitError("could not make code executable");
+	}
+	image->entry = mem;
+
+	//Functions are the labels in code other than the ones the
+	// back end makes for branches
+	std::vector<std::pair<uint64_t, std::string>> fns;
+	fns.push_back(std::make_pair(base, std::string("drewgon_jit_entry")));
+	for (size_t s = 0; s < stubs.size(); s++){
+		fns.push_back(std::make_pair(base + stubsAt + s * STUB_SIZE,
+		  "drewgon_stub_" + stubs[s]));
+	}
+	uint64_t codeEnd = base + stubsAt + stubs.size() * STUB_SIZE;
+	for (size_t i = 0; i < mod.sections.size(); i++){
+		if (!mod.sections[i].exec){ continue; }
+		codeEnd = std::max(codeEnd, base + offsets[i] + mod.sections[i].bytes.size());
+	}
+	for (const ObjSymbol& sym : mod.symbols){
+		if (sym.section == ObjSymbol::UNDEFINED){ continue; }
+		if (!mod.sections[sym.section].exec){ continue; }
+		if (sym.name.compare(0, 4, "lbl_") == 0){ continue; }
+		fns.push_back(std::make_pair(addressOf(sym.name), sym.name));
+	}
+	std::sort(fns.begin(), fns.end());
+	std::ofstream perfMap("/tmp/perf-" + std::to_string(getpid()) + ".map",
+	  std::ios::app);
+	for (size_t f = 0; f < fns.size(); f++){
+		uint64_t end = f + 1 < fns.size() ? fns[f + 1].first : codeEnd;
+		perfMap << std::hex << fns[f].first << " " << end - fns[f].first
+		  << " " << fns[f].second << "\n";
+	}
+	return image;
+}
+
+JITImage::~JITImage(){
+	if (mem != nullptr){ munmap(mem, size); }
+}
+
+int64_t JITImage::run(){
+	auto main = reinterpret_cast<int64_t (*)()>(entry);
+	int64_t result = main();
+	Report::messages().flush();
+	return result;
+}
+
+}
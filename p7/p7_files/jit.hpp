@@ -0,0 +1,36 @@
+#ifndef DREWGON_JIT_HPP
+#define DREWGON_JIT_HPP
+
+#include <cstdint>
+#include "obj_module.hpp"
+
+namespace drewgon{
+
+// A program loaded into executable memory in this process, ready
+// to run. Calls to the runtime (printInt, getInt, mayhem, ...) are
+// bound to functions in dgc itself, whose output goes to
+// Report::messages(). The memory is mapped in the low 2GB, since
+// generated code addresses its globals and strings absolutely.
+//
+// Loading also appends the program's functions to
+// /tmp/perf-<pid>.map, so that perf can symbolize them.
+class JITImage{
+public:
+	//Throws an InternalError if mod refers to anything that
+	// neither it nor the runtime defines
+	static JITImage * load(const ObjModule& mod);
+	~JITImage();
+
+	//Call main, returning whatever it leaves in %rax
+	int64_t run();
+private:
+	JITImage() : mem(nullptr), size(0), entry(nullptr){ }
+
+	unsigned char * mem;
+	size_t size;
+	unsigned char * entry;
+};
+
+}
+
+#endif
@@ -0,0 +1,338 @@
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include "linker.hpp"
+#include "errors.hpp"
+#include "source.hpp"
+
+namespace drewgon{
+
+static const uint64_t BASE_ADDR = 0x400000;
+static const uint64_t PAGE_SIZE = 0x1000;
+static const size_t EHDR_SIZE = 64;
+static const size_t PHDR_SIZE = 56;
+
+[[noreturn]] static void linkError(const std::string& msg){
+	throw new InternalError(("Link: " + msg).c_str());
+}
+
+static void put(std::vector<unsigned char>& buf, uint64_t val, size_t width){
+	for (size_t i = 0; i < width; i++){
+		buf.push_back(static_cast<unsigned char>(val >> (8 * i)));
+	}
+}
+
+Linker::~Linker(){
+	for (Input& input : inputs){
+		delete input.mod;
+	}
+}
+
+void Linker::addObject(ObjModule * mod, const std::string& name){
+	Input input;
+	input.mod = mod;
+	input.name = name;
+	input.required = true;
+	inputs.push_back(input);
+}
+
+void Linker::addArchive(const char * path){
+	SourceFile * file = SourceFile::open(path);
+	if (file == nullptr){
+		linkError(std::string("could not read archive ") + path);
+	}
+	const char * data = file->data();
+	size_t size = file->size();
+	if (size < 8 || memcmp(data, "!<arch>\n", 8) != 0){
+		delete file;
+		linkError(std::string(path) + " is not an archive");
+	}
+
+	//GNU ar format: 60-byte member headers, with long member
+	// names kept in the // member and the symbol index in /
+	const char * longNames = nullptr;
+	size_t longNamesSize = 0;
+	size_t pos = 8;
+	try {
+		while (pos + 60 <= size){
+			const char * hdr = data + pos;
+			if (hdr[58] != '`' || hdr[59] != '\n'){
+				linkError(std::string(path) + " has a bad member header");
+			}
+			std::string name(hdr, 16);
+			name.erase(name.find_last_not_of(' ') + 1);
+			std::string sizeField(hdr + 48, 10);
+			size_t memberSize = strtoull(sizeField.c_str(), nullptr, 10);
+			size_t body = pos + 60;
+			if (memberSize > size - body){
+				linkError(std::string(path) + " is truncated");
+			}
+			pos = body + memberSize + (memberSize & 1);
+
+			if (name == "/" || name == "/SYM64/"){ continue; }
+			if (name == "//"){
+				longNames = data + body;
+				longNamesSize = memberSize;
+				continue;
+			}
+			if (name.size() > 1 && name[0] == '/' && longNames != nullptr){
+				size_t offset = strtoull(name.c_str() + 1, nullptr, 10);
+				if (offset >= longNamesSize){
+					linkError(std::string(path) + " has a bad member name");
+				}
+				const char * start = longNames + offset;
+				const char * end = start;
+				while (end < longNames + longNamesSize && *end != '\n'){ end++; }
+				name.assign(start, end);
+			}
+			if (!name.empty() && name[name.size() - 1] == '/'){
+				name.erase(name.size() - 1);
+			}
+
+			Input input;
+			input.name = std::string(path) + "(" + name + ")";
+			input.mod = ObjModule::readELF(data + body, memberSize, input.name);
+			input.required = false;
+			inputs.push_back(input);
+		}
+	} catch (InternalError *){
+		delete file;
+		throw;
+	}
+	delete file;
+}
+
+void Linker::linkInput(size_t idx){
+	Input& input = inputs[idx];
+	input.linked = true;
+	const std::vector<ObjSymbol>& symbols = input.mod->symbols;
+	for (size_t i = 0; i < symbols.size(); i++){
+		const ObjSymbol& sym = symbols[i];
+		if (sym.section == ObjSymbol::UNDEFINED){ continue; }
+		input.defined[sym.name] = i;
+		if (!sym.global){ continue; }
+		auto prev = globals.find(sym.name);
+		if (prev != globals.end()){
+			linkError("multiple definition of `" + sym.name + "' in "
+			  + inputs[prev->second.input].name + " and " + input.name);
+		}
+		SymbolRef ref;
+		ref.input = idx;
+		ref.symbol = i;
+		globals[sym.name] = ref;
+	}
+}
+
+//Link in archive members until every symbol the linked inputs
+// refer to is defined, or no member can define the rest
+void Linker::pullMembers(){
+	std::unordered_map<std::string, size_t> providers;
+	for (size_t i = 0; i < inputs.size(); i++){
+		if (inputs[i].required){ continue; }
+		for (const ObjSymbol& sym : inputs[i].mod->symbols){
+			if (sym.global && sym.section != ObjSymbol::UNDEFINED
+			  && providers.count(sym.name) == 0){
+				providers[sym.name] = i;
+			}
+		}
+	}
+
+	size_t scanned = 0;
+	std::vector<size_t> order;
+	for (size_t i = 0; i < inputs.size(); i++){
+		if (inputs[i].linked){ order.push_back(i); }
+	}
+	while (scanned < order.size()){
+		const Input& input = inputs[order[scanned++]];
+		for (const ObjSymbol& sym : input.mod->symbols){
+			if (sym.section != ObjSymbol::UNDEFINED){ continue; }
+			if (globals.count(sym.name) != 0){ continue; }
+			auto provider = providers.find(sym.name);
+			if (provider == providers.end()){ continue; }
+			if (inputs[provider->second].linked){ continue; }
+			linkInput(provider->second);
+			order.push_back(provider->second);
+		}
+	}
+}
+
+bool Linker::resolve(size_t input, const std::string& name,
+  SymbolRef& ref) const{
+	const Input& from = inputs[input];
+	auto local = from.defined.find(name);
+	if (local != from.defined.end()){
+		ref.input = input;
+		ref.symbol = local->second;
+		return true;
+	}
+	auto global = globals.find(name);
+	if (global == globals.end()){ return false; }
+	ref = global->second;
+	return true;
+}
+
+void Linker::link(std::ostream& out, const std::string& entry){
+	for (size_t i = 0; i < inputs.size(); i++){
+		if (inputs[i].required){ linkInput(i); }
+	}
+	pullMembers();
+
+	//Keep only the sections reachable from the entry point
+	auto entryRef = globals.find(entry);
+	if (entryRef == globals.end()){
+		linkError("no definition of the entry point `" + entry + "'");
+	}
+	std::vector<std::vector<bool>> live(inputs.size());
+	std::vector<std::vector<uint64_t>> addrs(inputs.size());
+	for (size_t i = 0; i < inputs.size(); i++){
+		live[i].assign(inputs[i].mod->sections.size(), false);
+		addrs[i].assign(inputs[i].mod->sections.size(), 0);
+	}
+	std::vector<std::pair<size_t, size_t>> work;
+	auto mark = [&](const SymbolRef& ref){
+		size_t section = inputs[ref.input].mod->symbols[ref.symbol].section;
+		if (!live[ref.input][section]){
+			live[ref.input][section] = true;
+			work.push_back(std::make_pair(ref.input, section));
+		}
+	};
+	mark(entryRef->second);
+	std::set<std::string> missing;
+	std::string undefined;
+	while (!work.empty()){
+		std::pair<size_t, size_t> item = work.back();
+		work.pop_back();
+		const ObjSection& sec = inputs[item.first].mod->sections[item.second];
+		for (const ObjReloc& rel : sec.relocs){
+			SymbolRef ref;
+			if (resolve(item.first, rel.symbol, ref)){
+				mark(ref);
+			} else if (missing.insert(rel.symbol).second){
+				undefined += "\n  undefined reference to `" + rel.symbol
+				  + "' in " + inputs[item.first].name;
+			}
+		}
+	}
+	if (!undefined.empty()){ linkError(undefined.substr(3)); }
+
+	kept = 0;
+	discarded = 0;
+	bool anyWritable = false;
+	for (size_t i = 0; i < inputs.size(); i++){
+		if (!inputs[i].linked){ continue; }
+		for (size_t s = 0; s < live[i].size(); s++){
+			if (live[i][s]){
+				kept++;
+				anyWritable = anyWritable || inputs[i].mod->sections[s].write;
+			} else {
+				discarded++;
+			}
+		}
+	}
+
+	//Lay out code and read-only data in one segment (after the
+	// headers) and writable data in another, starting on a new
+	// page. File offsets and addresses match mod the page size.
+	size_t numPhdrs = anyWritable ? 3 : 2;
+	std::vector<unsigned char> image(EHDR_SIZE + PHDR_SIZE * numPhdrs, 0);
+	uint64_t segEnd[2] = {0, 0};
+	uint64_t segStart[2] = {0, 0};
+	for (int seg = 0; seg < 2; seg++){
+		bool wantWrite = seg == 1;
+		if (wantWrite){
+			if (!anyWritable){ break; }
+			image.resize((image.size() + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE, 0);
+		}
+		segStart[seg] = image.size();
+		//Code first, so it isn't interleaved with data
+		for (int exec = 1; exec >= 0; exec--){
+			for (size_t i = 0; i < inputs.size(); i++){
+				if (!inputs[i].linked){ continue; }
+				std::vector<ObjSection>& sections = inputs[i].mod->sections;
+				for (size_t s = 0; s < sections.size(); s++){
+					const ObjSection& sec = sections[s];
+					if (!live[i][s] || sec.write != wantWrite
+					  || sec.exec != (exec == 1)){
+						continue;
+					}
+					size_t align = sec.align == 0 ? 1 : sec.align;
+					image.resize((image.size() + align - 1) / align * align,
+					  sec.exec ? 0x90 : 0);
+					addrs[i][s] = BASE_ADDR + image.size();
+					image.insert(image.end(), sec.bytes.begin(), sec.bytes.end());
+				}
+			}
+		}
+		segEnd[seg] = image.size();
+	}
+
+	auto addressOf = [&](const SymbolRef& ref) -> uint64_t{
+		const ObjSymbol& sym = inputs[ref.input].mod->symbols[ref.symbol];
+		return addrs[ref.input][sym.section] + sym.offset;
+	};
+
+	for (size_t i = 0; i < inputs.size(); i++){
+		if (!inputs[i].linked){ continue; }
+		const std::vector<ObjSection>& sections = inputs[i].mod->sections;
+		for (size_t s = 0; s < sections.size(); s++){
+			if (!live[i][s]){ continue; }
+			const ObjSection& sec = sections[s];
+			for (const ObjReloc& rel : sec.relocs){
+				SymbolRef ref;
+				resolve(i, rel.symbol, ref);
+				uint64_t place = addrs[i][s] + rel.offset;
+				if (rel.offset + relocWidth(rel.type) > sec.bytes.size()){
+					linkError("relocation outside its section in " + inputs[i].name);
+				}
+				if (!applyReloc(&image[place - BASE_ADDR], rel, place,
+				  addressOf(ref))){
+					linkError("relocation against `" + rel.symbol
+					  + "' is out of range in " + inputs[i].name);
+				}
+			}
+		}
+	}
+
+	std::vector<unsigned char> hdr;
+	const unsigned char ident[16] = {0x7f, 'E', 'L', 'F', 2, 1, 1, 0};
+	hdr.insert(hdr.end(), ident, ident + 16);
+	put(hdr, 2, 2);               //ET_EXEC
+	put(hdr, 62, 2);              //EM_X86_64
+	put(hdr, 1, 4);               //EV_CURRENT
+	put(hdr, addressOf(entryRef->second), 8);
+	put(hdr, EHDR_SIZE, 8);       //e_phoff
+	put(hdr, 0, 8);               //e_shoff: no section headers
+	put(hdr, 0, 4);               //e_flags
+	put(hdr, EHDR_SIZE, 2);
+	put(hdr, PHDR_SIZE, 2);
+	put(hdr, numPhdrs, 2);
+	put(hdr, 64, 2);              //e_shentsize
+	put(hdr, 0, 2);               //e_shnum
+	put(hdr, 0, 2);               //e_shstrndx
+
+	auto phdr = [&hdr](uint32_t type, uint32_t flags, uint64_t offset,
+	  uint64_t addr, uint64_t size, uint64_t align){
+		put(hdr, type, 4);
+		put(hdr, flags, 4);
+		put(hdr, offset, 8);
+		put(hdr, addr, 8);
+		put(hdr, addr, 8);
+		put(hdr, size, 8);
+		put(hdr, size, 8);
+		put(hdr, align, 8);
+	};
+	//The first segment starts at the file's start, so that it
+	// maps the headers too
+	phdr(1, 5, 0, BASE_ADDR, segEnd[0], PAGE_SIZE); //PT_LOAD, R+X
+	if (anyWritable){
+		phdr(1, 6, segStart[1], BASE_ADDR + segStart[1],
+		  segEnd[1] - segStart[1], PAGE_SIZE);  //PT_LOAD, R+W
+	}
+	phdr(0x6474e551, 6, 0, 0, 0, 16);           //PT_GNU_STACK, R+W
+	memcpy(image.data(), hdr.data(), hdr.size());
+
+	out.write(reinterpret_cast<const char *>(image.data()),
+	  static_cast<std::streamsize>(image.size()));
+}
+
+}
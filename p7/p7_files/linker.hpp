@@ -0,0 +1,70 @@
+#ifndef DREWGON_LINKER_HPP
+#define DREWGON_LINKER_HPP
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "obj_module.hpp"
+
+namespace drewgon{
+
+// Links relocatable objects into a static x86-64 ELF executable.
+// Objects added directly are always linked; archive members are
+// linked only if they define a symbol that is otherwise
+// undefined. Sections that nothing reachable from the entry
+// point refers to are discarded, so a program only carries the
+// runtime functions it calls.
+//
+// Problems (undefined or duplicate symbols, malformed inputs,
+// relocations that don't fit) are reported by throwing an
+// InternalError.
+class Linker{
+public:
+	Linker(){ }
+	~Linker();
+
+	//The linker takes ownership of mod
+	void addObject(ObjModule * mod, const std::string& name);
+	void addArchive(const char * path);
+
+	//Resolve, lay out and write the executable, which starts
+	// running at entry
+	void link(std::ostream& out, const std::string& entry = "_start");
+
+	//How much of the input ended up in the executable
+	size_t sectionsKept() const { return kept; }
+	size_t sectionsDiscarded() const { return discarded; }
+private:
+	class Input{
+	public:
+		ObjModule * mod;
+		std::string name;
+		//Objects are required; archive members are not
+		bool required;
+		bool linked = false;
+		//The symbols this input defines, by name
+		std::unordered_map<std::string, size_t> defined;
+	};
+	class SymbolRef{
+	public:
+		size_t input;
+		size_t symbol;
+	};
+
+	void linkInput(size_t idx);
+	void pullMembers();
+	//What name refers to in the given input: its own definition
+	// if it has one, and otherwise the global one
+	bool resolve(size_t input, const std::string& name,
+	  SymbolRef& ref) const;
+
+	std::vector<Input> inputs;
+	std::unordered_map<std::string, SymbolRef> globals;
+	size_t kept = 0;
+	size_t discarded = 0;
+};
+
+}
+
+#endif
@@ -3,101 +3,134 @@
 #include <cstring>
 #include <fstream>
 #include <string.h>
+#include <sstream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <list>
+#include <functional>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "errors.hpp"
 #include "scanner.hpp"
 #include "name_analysis.hpp"
 #include "type_analysis.hpp"
+#include "session.hpp"
+#include "server.hpp"
+#include "timing.hpp"
+#include "fn_cache.hpp"
+#include "ast_cache.hpp"
+#include "out_stream.hpp"
+#include "x64_assembler.hpp"
+#include "linker.hpp"
+#include "jit.hpp"
+#include "vm.hpp"
 
 using namespace drewgon;
 
-static void usageAndDie(){
-	std::cerr << "Usage: dgc <infile>\n"
+static void usage(std::ostream& out){
+	out << "Usage: dgc <infile>\n"
 	<< " [-t <tokensFile>]: Output tokens to <tokensFile>\n"
+	<< " [--binary-tokens]: Output -t tokens in a compact binary\n"
+	<< "  format, which dgc accepts as input in place of the source\n"
 	<< " [-p]: Parse the input to check syntax\n"
 	<< " [-u <unparseFile>]: Output canonical program text to <unparseFile>\n"
 	<< " [-n <nameFile>]: Output name analysis to <nameFile>\n"
 	<< " [-c]: Do type checking\n"
 	<< " [-a <3ACFile>]: Output program as 3-address code\n"
 	<< " [-o <ASMFile>]: Output x64 assembly to <ASMFile>\n"
+	<< " [-b <objFile>]: Assemble to an ELF object file <objFile>\n"
+	<< " [-x <exeFile>]: Link a static executable <exeFile>\n"
+	<< " [--runtime <archive>]: Link -x executables against <archive>\n"
+	<< "  (default: libdrewgon_rt.a next to dgc)\n"
+	<< " [--run]: Compile into memory and run the program, exiting\n"
+	<< "  with its result\n"
+	<< " [--vm]: Interpret the program's 3AC, exiting with its result\n"
+	<< " [--fast-scan]: Scan with the hand-written (SIMD) scanner\n"
+	<< "  instead of the flex one\n"
+	<< " [--lex-threads <n>]: Scan a large input in chunks, on up to\n"
+	<< "  <n> threads\n"
+	<< " [--pipeline]: Scan on a thread of its own, while parsing\n"
+	<< " [--rd-parse]: Parse with the hand-written recursive-descent\n"
+	<< "  parser instead of the bison one\n"
+	<< " [--lazy-bodies]: Parse each function body only when it is\n"
+	<< "  needed (with the recursive-descent parser). -p then checks\n"
+	<< "  only the syntax outside of function bodies\n"
+	<< " [--flat-ast]: Do -u, -n and -c on a flat copy of the AST,\n"
+	<< "  with passes that switch on each node's kind\n"
+	<< " [-ftime-report]: Report the time spent in each phase\n"
+	<< " [-fmem-report]: Report the memory used for tokens and the AST\n"
+	<< " [--trace <traceFile>]: Write a Chrome trace of each phase\n"
+	<< " [--cache-dir <dir>]: Reuse code for unchanged functions\n"
+	<< " [--cache-limit <size>]: Evict old cache entries beyond <size>\n"
+	<< " [--cache-stats]: Report function (and AST) cache hits and\n"
+	<< "  misses\n"
+	<< " [--ast-cache <dir>]: Reuse the parsed AST of unchanged inputs\n"
+	<< "Batch usage: dgc --batch [-j <threads>] <infile|@listFile>...\n"
+	<< "  Compiles every input concurrently. Output flags take a\n"
+	<< "  directory, and each input's outputs are written to\n"
+	<< "  <dir>/<input name>.{tokens,unparse,names,3ac,s,o}\n"
+	<< "  (and -x executables to <dir>/<input name>)\n"
+	<< "Server usage: dgc --serve <socket>\n"
+	<< "  Handles compile requests sent to <socket> until killed.\n"
+	<< "  Requests can't use --run or --vm\n"
+	<< "Client usage: dgc --client <socket> <dgc arguments>...\n"
+	<< "  Runs one compilation on the server listening at <socket>\n"
 	;
-	std::cout << std::flush;
-	std::cerr << std::flush;
-	exit(1);
 }
 
-static void writeTokenStream(const char * inPath, const char * outPath){
-	std::ifstream inStream(inPath);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream";
-		msg += inPath;
-		throw new drewgon::InternalError(msg.c_str());
+//Run emit on the stream for outPath: stdout (or wherever this
+// thread's messages are redirected) for --, and otherwise a
+// buffered file that is written out as emit fills it.
+static void writeOutput(const char * outPath,
+  std::function<void(std::ostream&)> emit){
+	if (strcmp(outPath, "--") == 0){
+		emit(Report::messages());
+		return;
 	}
-	if (outPath == nullptr){
-		std::string msg = "No tokens output file given";
-		throw new drewgon::InternalError(msg.c_str());
+	FileOutStream outStream(outPath);
+	if (!outStream.good()){
+		std::string msg = "Bad output file ";
+		msg += outPath;
+		throw new InternalError(msg.c_str());
 	}
-
-	Scanner scanner(&inStream);
-	if (strcmp(outPath, "--") == 0){
-		scanner.outputTokens(std::cout);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new InternalError(msg.c_str());
-		}
-		scanner.outputTokens(outStream);
-		outStream.close();
+	emit(outStream);
+	if (!outStream.close()){
+		std::string msg = "Could not write output file ";
+		msg += outPath;
+		throw new InternalError(msg.c_str());
 	}
 }
 
-static drewgon::ProgramNode * parse(const char * inFile){
-	std::ifstream inStream(inFile);
-	if (!inStream.good()){
-		std::string msg = "Bad input stream ";
-		msg += inFile;
-		throw new InternalError(msg.c_str());
+static void writeTokenStream(CompilationSession& session,
+  const char * outPath, bool binary){
+	if (outPath == nullptr){
+		std::string msg = "No tokens output file given";
+		throw new drewgon::InternalError(msg.c_str());
 	}
 
-	//This pointer will be set to the root of the
-	// AST after parsing
-	drewgon::ProgramNode * root = nullptr;
-
-	drewgon::Scanner scanner(&inStream);
-	drewgon::Parser parser(scanner, &root);
-
-	int errCode = parser.parse();
-	if (errCode != 0){ return nullptr; }
-
-	return root;
-}
-
-static void outputAST(ASTNode * ast, const char * outPath){
-	if (strcmp(outPath, "--") == 0){
-		ast->unparse(std::cout, 0);
-	} else {
-		std::ofstream outStream(outPath);
-		if (!outStream.good()){
-			std::string msg = "Bad output file ";
-			msg += outPath;
-			throw new drewgon::InternalError(msg.c_str());
+	PhaseTimer timer("tokens");
+	Scanner scanner(session.source(), session.tokenArena(),
+	  session.fastScan(), session.lexThreads(), session.pipeline());
+	writeOutput(outPath, [&scanner, binary](std::ostream& out){
+		if (binary){
+			scanner.outputBinaryTokens(out);
+		} else {
+			scanner.outputTokens(out);
 		}
-		ast->unparse(outStream, 0);
-	}
+	});
 }
 
-static drewgon::NameAnalysis * doNameAnalysis(const char * inputPath){
-	drewgon::ProgramNode * ast = parse(inputPath);
-	if (ast == nullptr){ return nullptr; }
-
-	return drewgon::NameAnalysis::build(ast);
+static void outputAST(ASTNode * ast, const char * outPath){
+	writeOutput(outPath, [ast](std::ostream& out){
+		ast->unparse(out, 0);
+	});
 }
 
-static bool doUnparsing(const char * inputPath, const char * outPath){
-	drewgon::ProgramNode * ast = parse(inputPath);
+static bool doUnparsing(CompilationSession& session, const char * outPath){
+	drewgon::ProgramNode * ast = session.parseAll();
 	if (ast == nullptr){
-		std::cerr << "No AST built\n";
+		Report::diagnostics() << "No AST built\n";
 		return false;
 	}
 
@@ -105,171 +138,737 @@ static bool doUnparsing(const char * inputPath, const char * outPath){
 	return true;
 }
 
-static drewgon::TypeAnalysis * doTypeAnalysis(const char * inputPath){
-	drewgon::NameAnalysis * nameAnalysis = doNameAnalysis(inputPath);
-	if (nameAnalysis == nullptr){ return nullptr; }
-	return TypeAnalysis::build(nameAnalysis);
-}
-
 static void write3AC(drewgon::IRProgram * prog, const char * outPath){
 	if (outPath == nullptr){
 		throw new InternalError("Null 3AC flat file given");
 	}
-	std::string flatProg = prog->toString();
-	if (strcmp(outPath, "--") == 0){
-		std::cout << flatProg << std::endl;
-	} else {
-		std::ofstream outStream(outPath);
-		outStream << flatProg << std::endl;
-		outStream.close();
+	PhaseTimer timer("3AC output");
+	writeOutput(outPath, [prog](std::ostream& out){
+		prog->print(out);
+		out << std::endl;
+	});
+}
+
+
+static int writeX64(drewgon::IRProgram * prog, const char * outPath){
+	if (outPath == nullptr){
+		throw new InternalError("Null codegen file given");
 	}
+	PhaseTimer timer("x64 codegen");
+	writeOutput(outPath, [prog](std::ostream& out){
+		prog->toX64(out);
+	});
+	return 0;
 }
 
+//Assemble the program in-process rather than writing out
+// assembly text for as
+static ObjModule * assemble(drewgon::IRProgram * prog){
+	std::ostringstream text;
+	{
+		PhaseTimer timer("x64 codegen");
+		prog->toX64(text);
+	}
+	PhaseTimer timer("assemble");
+	return assembleX64(text.str());
+}
 
-static IRProgram * do3AC(const char * inputPath){
-	drewgon::TypeAnalysis * typeAnalysis = doTypeAnalysis(inputPath);
-	if (typeAnalysis == nullptr){ return nullptr; }
+static void writeObject(drewgon::IRProgram * prog, const char * outPath){
+	if (outPath == nullptr){
+		throw new InternalError("Null object file given");
+	}
+	ObjModule * obj = assemble(prog);
+	writeOutput(outPath, [obj](std::ostream& out){
+		obj->writeELF(out);
+	});
+	delete obj;
+}
 
-	IRProgram * prog = typeAnalysis->ast->to3AC(typeAnalysis);
-	return prog;
+//The runtime archive installed alongside the dgc binary
+static std::string defaultRuntime(){
+	std::vector<char> exe(4096);
+	ssize_t len = readlink("/proc/self/exe", exe.data(), exe.size() - 1);
+	if (len <= 0){ return "libdrewgon_rt.a"; }
+	std::string path(exe.data(), static_cast<size_t>(len));
+	size_t slash = path.find_last_of('/');
+	return path.substr(0, slash + 1) + "libdrewgon_rt.a";
 }
 
-static int writeX64(drewgon::IRProgram * prog, const char * outPath){
+//Link the program against the runtime into an executable, with
+// no assembler, linker or libc involved
+static void writeExecutable(drewgon::IRProgram * prog, const char * outPath,
+  const char * runtimePath){
 	if (outPath == nullptr){
-		throw new InternalError("Null codegen file given");
+		throw new InternalError("Null executable file given");
 	}
-	if (strcmp(outPath, "--") == 0){
-		prog->toX64(std::cout);
-	} else {
-		std::ofstream outStream(outPath);
-		prog->toX64(outStream);
-		outStream.close();
+	Linker linker;
+	linker.addObject(assemble(prog), "<program>");
+	PhaseTimer timer("link");
+	linker.addArchive(runtimePath != nullptr ?
+	  runtimePath : defaultRuntime().c_str());
+	writeOutput(outPath, [&linker](std::ostream& out){
+		linker.link(out);
+	});
+	if (strcmp(outPath, "--") != 0 && chmod(outPath, 0755) != 0){
+		std::string msg = "Could not make executable ";
+		msg += outPath;
+		throw new InternalError(msg.c_str());
 	}
-	return 0;
 }
 
-int
-main( const int argc, const char **argv )
-{
-	if (argc <= 1){ usageAndDie(); }
-	std::ifstream * input = new std::ifstream(argv[1]);
-	if (input == nullptr){ usageAndDie(); }
-	if (!input->good()){
-		std::cerr << "Bad path " << argv[1] << std::endl;
-		usageAndDie();
+//Load the program into this process and call its main. The
+// result is the program's exit status.
+static int runProgram(drewgon::IRProgram * prog){
+	ObjModule * obj = assemble(prog);
+	JITImage * image;
+	try {
+		PhaseTimer timer("jit load");
+		image = JITImage::load(*obj);
+	} catch (InternalError *){
+		delete obj;
+		throw;
 	}
+	delete obj;
+	int64_t result;
+	{
+		PhaseTimer timer("run");
+		result = image->run();
+	}
+	delete image;
+	return static_cast<int>(result & 0xff);
+}
 
-	const char * inFile = NULL;
-	const char * tokensFile = NULL;
+//Like runProgram, but interpreting the 3AC rather than running
+// generated code
+static int interpretProgram(drewgon::IRProgram * prog){
+	VMProgram * vm = VMProgram::compile(prog);
+	int64_t result;
+	{
+		PhaseTimer timer("run");
+		result = vm->run();
+	}
+	delete vm;
+	return static_cast<int>(result & 0xff);
+}
+
+//The outputs requested on the command line. In single-file
+// mode each path names an output file (or -- for stdout); in
+// batch mode it names the directory per-file outputs go to.
+struct OutputRequest{
+	const char * tokensFile = nullptr;
+	bool binaryTokens = false;
 	bool checkParse = false;
-	const char * unparseFile = NULL;
-	const char * namesFile = NULL;
+	const char * unparseFile = nullptr;
+	const char * namesFile = nullptr;
 	bool checkTypes = false;
-	const char * threeACFile = NULL;
-	const char * asmFile = NULL;
+	const char * threeACFile = nullptr;
+	const char * asmFile = nullptr;
+	const char * objFile = nullptr;
+	const char * exeFile = nullptr;
+	const char * runtimeFile = nullptr;
+	bool run = false;
+	bool vm = false;
+	bool fastScan = false;
+	unsigned int lexThreads = 1;
+	bool pipeline = false;
+	bool rdParse = false;
+	bool lazyBodies = false;
+	bool flatAST = false;
+	bool timeReport = false;
+	bool memReport = false;
+	TraceLog * trace = nullptr;
+	FnCache * cache = nullptr;
+	ASTCache * astCache = nullptr;
+};
 
-	bool useful = false;
-	int i = 1;
-	for (int i = 1 ; i < argc ; i++){
-		if (argv[i][0] == '-'){
-			if (argv[i][1] == 't'){
-				i++;
-				tokensFile = argv[i];
-				useful = true;
-			} else if (argv[i][1] == 'p'){
-				checkParse = true;
-				useful = true;
-			} else if (argv[i][1] == 'u'){
-				i++;
-				if (i >= argc){ usageAndDie(); }
-				unparseFile = argv[i];
-				useful = true;
-			} else if (argv[i][1] == 'n'){
-				i++;
-				namesFile = argv[i];
-				useful = true;
-			} else if (argv[i][1] == 'c'){
-				checkTypes = true;
-				useful = true;
-			} else if (argv[i][1] == 'a'){
-				i++;
-				if (i >= argc){ usageAndDie(); }
-				threeACFile = argv[i];
-				useful = true;
-			} else if (argv[i][1] == 'o'){
-				i++;
-				if (i >= argc){ usageAndDie(); }
-				asmFile = argv[i];
-				useful = true;
-			} else {
-				std::cerr << "Unrecognized argument: ";
-				std::cerr << argv[i] << std::endl;
-				usageAndDie();
-			}
+//As doUnparsing and the -n and -c outputs, but of the flat AST.
+// Returns false if the program had errors.
+static bool doFlatOutputs(CompilationSession& session,
+  const OutputRequest& req){
+	if (req.unparseFile != nullptr){
+		FlatAST * ast = session.flatAST();
+		if (ast == nullptr){
+			Report::diagnostics() << "No AST built\n";
 		} else {
-			if (inFile == NULL){
-				inFile = argv[i];
-			} else {
-				std::cerr << "Only 1 input file allowed";
-				std::cerr << argv[i] << std::endl;
-				usageAndDie();
-			}
+			writeOutput(req.unparseFile, [ast](std::ostream& out){
+				ast->unparse(out);
+			});
 		}
 	}
-	if (inFile == NULL){
-		usageAndDie();
+	if (req.namesFile != nullptr){
+		FlatNameAnalysis * na = session.flatNameAnalysis();
+		if (na == nullptr){
+			Report::diagnostics() << "Name Analysis Failed\n";
+			return false;
+		}
+		writeOutput(req.namesFile, [na](std::ostream& out){
+			na->ast->unparse(out, &na->symbols);
+		});
 	}
-	if (!useful){
-		std::cerr << "Hey, you didn't tell dgc to do anything!\n";
-		usageAndDie();
+	if (req.checkTypes){
+		if (session.flatTypeAnalysis() == nullptr){
+			Report::diagnostics() << "Type Analysis Failed\n";
+			return false;
+		}
 	}
+	return true;
+}
 
+static int compileOutputs(const char * inFile, const OutputRequest& req){
+	//All of the outputs below share one session, so the
+	// input is parsed, analyzed and lowered at most once
+	// no matter how many outputs are requested.
+	CompilationSession session(inFile);
+	session.setCache(req.cache);
+	session.setASTCache(req.astCache);
+	session.setFastScan(req.fastScan);
+	session.setLexThreads(req.lexThreads);
+	session.setPipeline(req.pipeline);
+	session.setRDParse(req.rdParse);
+	session.setLazyBodies(req.lazyBodies);
+	session.setMemReport(req.memReport);
 	try {
-		if (tokensFile != nullptr){
-			writeTokenStream(inFile, tokensFile);
+		if (req.tokensFile != nullptr){
+			writeTokenStream(session, req.tokensFile, req.binaryTokens);
 		}
-		if (checkParse){
-			if (!parse(inFile)){
-				std::cerr << "Parse failed" << std::endl;
+		if (req.checkParse){
+			if (!session.parse()){
+				Report::diagnostics() << "Parse failed" << std::endl;
 			}
 		}
-		if (unparseFile != nullptr){
-			doUnparsing(inFile, unparseFile);
+		if (req.flatAST){
+			if (!doFlatOutputs(session, req)){ return 1; }
+		}
+		if (req.unparseFile != nullptr && !req.flatAST){
+			doUnparsing(session, req.unparseFile);
 		}
-		if (namesFile){
+		if (req.namesFile && !req.flatAST){
 			drewgon::NameAnalysis * na;
-			na = doNameAnalysis(inFile);
+			na = session.nameAnalysis();
 			if (na == nullptr){
-				std::cerr << "Name Analysis Failed\n";
+				Report::diagnostics() << "Name Analysis Failed\n";
 				return 1;
 			}
-			outputAST(na->ast, namesFile);
+			outputAST(na->ast, req.namesFile);
 		}
-		if (checkTypes){
+		if (req.checkTypes && !req.flatAST){
 			drewgon::TypeAnalysis * ta;
-			ta = doTypeAnalysis(inFile);
+			ta = session.typeAnalysis();
 			if (ta == nullptr){
-				std::cerr << "Type Analysis Failed\n";
+				Report::diagnostics() << "Type Analysis Failed\n";
 				return 1;
 			}
 		}
-		if (threeACFile != nullptr){
-			auto prog = do3AC(inFile);
+		if (req.threeACFile != nullptr){
+			auto prog = session.ir();
+			if (prog == nullptr){ return 1; }
+			write3AC(prog, req.threeACFile);
+		}
+		if (req.asmFile != nullptr){
+			auto prog = session.ir();
+			if (prog == nullptr){ return 1; }
+			writeX64(prog, req.asmFile);
+		}
+		if (req.objFile != nullptr){
+			auto prog = session.ir();
+			if (prog == nullptr){ return 1; }
+			writeObject(prog, req.objFile);
+		}
+		if (req.exeFile != nullptr){
+			auto prog = session.ir();
 			if (prog == nullptr){ return 1; }
-			write3AC(prog, threeACFile);
+			writeExecutable(prog, req.exeFile, req.runtimeFile);
 		}
-		if (asmFile != nullptr){
-			auto prog = do3AC(inFile);
+		if (req.run){
+			auto prog = session.ir();
 			if (prog == nullptr){ return 1; }
-			writeX64(prog, asmFile);
+			return runProgram(prog);
+		}
+		if (req.vm){
+			auto prog = session.ir();
+			if (prog == nullptr){ return 1; }
+			return interpretProgram(prog);
 		}
 	} catch (drewgon::ToDoError * e){
-		std::cerr << "ToDoError: " << e->msg() << "\n";
+		Report::diagnostics() << "ToDoError: " << e->msg() << "\n";
+		delete e;
 		return 1;
 	} catch (drewgon::InternalError * e){
-		std::cerr << "InternalError: " << e->msg() << "\n";
+		Report::diagnostics() << "InternalError: " << e->msg() << "\n";
+		delete e;
 		return 1;
 	}
+	return 0;
+}
+
+//Run every requested output for one input file. Diagnostics
+// go to Report::diagnostics() so that a caller can collect them.
+static int compile(const char * inFile, const OutputRequest& req){
+	TimingTrack track(inFile, req.timeReport, req.trace);
+	int status = compileOutputs(inFile, req);
+	track.report(Report::diagnostics());
+	return status;
+}
+
+//Read the inputs named in a response file, one per line.
+// Blank lines and lines starting with # are skipped.
+static bool readResponseFile(const char * path,
+  std::vector<std::string>& inputs){
+	std::ifstream list(path);
+	if (!list.good()){
+		Report::diagnostics() << "Bad response file " << path << std::endl;
+		return false;
+	}
+	std::string line;
+	while (std::getline(list, line)){
+		size_t end = line.find_last_not_of(" \t\r");
+		if (end == std::string::npos){ continue; }
+		size_t start = line.find_first_not_of(" \t");
+		if (line[start] == '#'){ continue; }
+		inputs.push_back(line.substr(start, end - start + 1));
+	}
+	return true;
+}
+
+//The path an output for the given input goes to in batch mode
+static std::string batchPath(const char * dir, const std::string& input,
+  const char * ext){
+	size_t slash = input.find_last_of('/');
+	std::string stem = slash == std::string::npos ?
+		input : input.substr(slash + 1);
+	size_t dot = stem.find_last_of('.');
+	if (dot != std::string::npos && dot != 0){ stem = stem.substr(0, dot); }
+	return std::string(dir) + "/" + stem + ext;
+}
+
+//One input of a batch compilation, along with where its
+// outputs go and what happened when it was compiled.
+struct BatchJob{
+	std::string input;
+	std::string tokensPath;
+	std::string unparsePath;
+	std::string namesPath;
+	std::string threeACPath;
+	std::string asmPath;
+	std::string objPath;
+	std::string exePath;
+	OutputRequest req;
+	std::ostringstream log;
+	int status = 0;
+};
+
+static const char * batchOutput(const char * dir, BatchJob& job,
+  const char * ext, std::string& storage){
+	if (dir == nullptr){ return nullptr; }
+	storage = batchPath(dir, job.input, ext);
+	return storage.c_str();
+}
+
+//Compile every input on a pool of worker threads. Each file's
+// diagnostics are collected separately and printed, in input
+// order, once all files are done.
+static int compileBatch(const std::vector<std::string>& inputs,
+  const OutputRequest& dirs, unsigned int numThreads){
+	std::ostream& diagnostics = Report::diagnostics();
+	std::ostream& messages = Report::messages();
+
+	const char * given[] = { dirs.tokensFile, dirs.unparseFile,
+		dirs.namesFile, dirs.threeACFile, dirs.asmFile, dirs.objFile,
+		dirs.exeFile };
+	for (const char * dir : given){
+		if (dir != nullptr && strcmp(dir, "--") == 0){
+			diagnostics << "Batch outputs must be directories, not --\n";
+			usage(diagnostics);
+			return 1;
+		}
+	}
+
+	std::vector<BatchJob> jobs(inputs.size());
+	for (size_t i = 0; i < inputs.size(); i++){
+		BatchJob& job = jobs[i];
+		job.input = inputs[i];
+		job.req.checkParse = dirs.checkParse;
+		job.req.checkTypes = dirs.checkTypes;
+		job.req.timeReport = dirs.timeReport;
+		job.req.fastScan = dirs.fastScan;
+		job.req.lexThreads = dirs.lexThreads;
+		job.req.pipeline = dirs.pipeline;
+		job.req.rdParse = dirs.rdParse;
+		job.req.lazyBodies = dirs.lazyBodies;
+		job.req.flatAST = dirs.flatAST;
+		job.req.binaryTokens = dirs.binaryTokens;
+		job.req.memReport = dirs.memReport;
+		job.req.trace = dirs.trace;
+		job.req.cache = dirs.cache;
+		job.req.astCache = dirs.astCache;
+		job.req.runtimeFile = dirs.runtimeFile;
+		job.req.tokensFile = batchOutput(dirs.tokensFile, job,
+			".tokens", job.tokensPath);
+		job.req.unparseFile = batchOutput(dirs.unparseFile, job,
+			".unparse", job.unparsePath);
+		job.req.namesFile = batchOutput(dirs.namesFile, job,
+			".names", job.namesPath);
+		job.req.threeACFile = batchOutput(dirs.threeACFile, job,
+			".3ac", job.threeACPath);
+		job.req.asmFile = batchOutput(dirs.asmFile, job,
+			".s", job.asmPath);
+		job.req.objFile = batchOutput(dirs.objFile, job,
+			".o", job.objPath);
+		job.req.exeFile = batchOutput(dirs.exeFile, job,
+			"", job.exePath);
+	}
+
+	//Two inputs with the same name would overwrite each
+	// other's outputs
+	for (size_t i = 0; i < jobs.size(); i++){
+		for (size_t j = i + 1; j < jobs.size(); j++){
+			if (batchPath("", jobs[i].input, "")
+			  == batchPath("", jobs[j].input, "")){
+				diagnostics << "Inputs " << jobs[i].input << " and "
+				  << jobs[j].input << " would share output paths\n";
+				return 1;
+			}
+		}
+	}
 
+	//The calling thread works through jobs too, so it puts
+	// back its own streams (which a compile server may have
+	// redirected) once it runs out of work.
+	std::atomic<size_t> next(0);
+	auto worker = [&jobs, &next](){
+		std::ostream& diagIn = Report::diagnostics();
+		std::ostream& msgIn = Report::messages();
+		while (true){
+			size_t idx = next++;
+			if (idx >= jobs.size()){ break; }
+			BatchJob& job = jobs[idx];
+			Report::redirect(&job.log, &job.log);
+			job.status = compile(job.input.c_str(), job.req);
+		}
+		Report::redirect(&diagIn, &msgIn);
+	};
+
+	if (numThreads > jobs.size()){
+		numThreads = static_cast<unsigned int>(jobs.size());
+	}
+	std::vector<std::thread> pool;
+	for (unsigned int t = 1; t < numThreads; t++){
+		pool.push_back(std::thread(worker));
+	}
+	worker();
+	for (auto& thread : pool){
+		thread.join();
+	}
+	Report::redirect(&diagnostics, &messages);
+
+	size_t failed = 0;
+	for (BatchJob& job : jobs){
+		std::string log = job.log.str();
+		if (job.status != 0){ failed++; }
+		if (!log.empty() || job.status != 0){
+			diagnostics << "==> " << job.input << " <=="
+			  << (job.status != 0 ? " (failed)" : "") << "\n";
+			diagnostics << log;
+		}
+	}
+	if (failed > 0){
+		diagnostics << failed << " of " << jobs.size()
+		  << " files failed\n";
+		return 1;
+	}
 	return 0;
 }
+
+//Everything a dgc command line asks for. The paths that
+// OutputRequest points to are owned by paths.
+struct Invocation{
+	std::vector<std::string> inputs;
+	OutputRequest req;
+	bool batch = false;
+	unsigned int numThreads = 1;
+	const char * tracePath = nullptr;
+	const char * cacheDir = nullptr;
+	const char * astCacheDir = nullptr;
+	size_t cacheLimit = 0;
+	bool cacheStats = false;
+	std::list<std::string> paths;
+
+	//A path given on the command line, relative to cwd
+	// unless it is absolute (or cwd is empty)
+	const char * path(const std::string& cwd, const std::string& arg){
+		if (cwd.empty() || arg == "--" || arg[0] == '/'){
+			paths.push_back(arg);
+		} else {
+			paths.push_back(cwd + "/" + arg);
+		}
+		return paths.back().c_str();
+	}
+};
+
+//Parse a command line into inv, for a request to a compile
+// server if served. Errors are reported on
+// Report::diagnostics(), followed by the usage message.
+static bool parseArgs(const std::vector<std::string>& args,
+  const std::string& cwd, bool served, Invocation& inv){
+	std::ostream& err = Report::diagnostics();
+	if (args.empty()){
+		usage(err);
+		return false;
+	}
+
+	inv.numThreads = std::thread::hardware_concurrency();
+	if (inv.numThreads == 0){ inv.numThreads = 1; }
+
+	OutputRequest& req = inv.req;
+	bool useful = false;
+	size_t argc = args.size();
+	for (size_t i = 0 ; i < argc ; i++){
+		const std::string& arg = args[i];
+		if (arg == "--batch"){
+			inv.batch = true;
+		} else if (arg == "-ftime-report"){
+			req.timeReport = true;
+		} else if (arg == "-fmem-report"){
+			req.memReport = true;
+		} else if (arg == "--fast-scan"){
+			req.fastScan = true;
+		} else if (arg == "--lex-threads"){
+			i++;
+			int requested = i < argc ? atoi(args[i].c_str()) : 0;
+			if (requested <= 0){
+				usage(err);
+				return false;
+			}
+			req.lexThreads = static_cast<unsigned int>(requested);
+		} else if (arg == "--pipeline"){
+			req.pipeline = true;
+		} else if (arg == "--rd-parse"){
+			req.rdParse = true;
+		} else if (arg == "--lazy-bodies"){
+			req.lazyBodies = true;
+		} else if (arg == "--flat-ast"){
+			req.flatAST = true;
+		} else if (arg == "--binary-tokens"){
+			req.binaryTokens = true;
+		} else if (arg == "--trace"){
+			i++;
+			if (i >= argc){
+				usage(err);
+				return false;
+			}
+			inv.tracePath = inv.path(cwd, args[i]);
+		} else if (arg == "--cache-dir"){
+			i++;
+			if (i >= argc){
+				usage(err);
+				return false;
+			}
+			inv.cacheDir = inv.path(cwd, args[i]);
+		} else if (arg == "--ast-cache"){
+			i++;
+			if (i >= argc){
+				usage(err);
+				return false;
+			}
+			inv.astCacheDir = inv.path(cwd, args[i]);
+		} else if (arg == "--cache-limit"){
+			i++;
+			if (i >= argc || !FnCache::parseSize(args[i], inv.cacheLimit)){
+				usage(err);
+				return false;
+			}
+		} else if (arg == "--run"){
+			req.run = true;
+			useful = true;
+		} else if (arg == "--vm"){
+			req.vm = true;
+			useful = true;
+		} else if (arg == "--runtime"){
+			i++;
+			if (i >= argc){
+				usage(err);
+				return false;
+			}
+			req.runtimeFile = inv.path(cwd, args[i]);
+		} else if (arg == "--cache-stats"){
+			inv.cacheStats = true;
+		} else if (arg[0] == '-'){
+			char flag = arg.size() > 1 ? arg[1] : '\0';
+			bool takesValue = flag == 't' || flag == 'u' || flag == 'n'
+			  || flag == 'a' || flag == 'o' || flag == 'b' || flag == 'x'
+			  || flag == 'j';
+			if (takesValue){
+				i++;
+				if (i >= argc){
+					usage(err);
+					return false;
+				}
+			}
+			if (flag == 't'){
+				req.tokensFile = inv.path(cwd, args[i]);
+				useful = true;
+			} else if (flag == 'p'){
+				req.checkParse = true;
+				useful = true;
+			} else if (flag == 'u'){
+				req.unparseFile = inv.path(cwd, args[i]);
+				useful = true;
+			} else if (flag == 'n'){
+				req.namesFile = inv.path(cwd, args[i]);
+				useful = true;
+			} else if (flag == 'c'){
+				req.checkTypes = true;
+				useful = true;
+			} else if (flag == 'a'){
+				req.threeACFile = inv.path(cwd, args[i]);
+				useful = true;
+			} else if (flag == 'o'){
+				req.asmFile = inv.path(cwd, args[i]);
+				useful = true;
+			} else if (flag == 'b'){
+				req.objFile = inv.path(cwd, args[i]);
+				useful = true;
+			} else if (flag == 'x'){
+				req.exeFile = inv.path(cwd, args[i]);
+				useful = true;
+			} else if (flag == 'j'){
+				int requested = atoi(args[i].c_str());
+				if (requested <= 0){
+					usage(err);
+					return false;
+				}
+				inv.numThreads = static_cast<unsigned int>(requested);
+			} else {
+				err << "Unrecognized argument: ";
+				err << arg << std::endl;
+				usage(err);
+				return false;
+			}
+		} else if (arg[0] == '@'){
+			std::vector<std::string> listed;
+			if (!readResponseFile(inv.path(cwd, arg.substr(1)), listed)){
+				usage(err);
+				return false;
+			}
+			for (const std::string& input : listed){
+				inv.inputs.push_back(inv.path(cwd, input));
+			}
+			inv.batch = true;
+		} else if (!arg.empty()){
+			inv.inputs.push_back(inv.path(cwd, arg));
+		}
+	}
+	if (inv.inputs.empty()){
+		usage(err);
+		return false;
+	}
+	if (inv.batch && (req.run || req.vm)){
+		err << (req.run ? "--run" : "--vm")
+		  << " takes a single input, not --batch\n";
+		usage(err);
+		return false;
+	}
+	if (served && (req.run || req.vm)){
+		//The program would run inside the server, on its
+		// threads and its stdin, alongside every other request
+		err << (req.run ? "--run" : "--vm")
+		  << " can't be used through a compile server\n";
+		usage(err);
+		return false;
+	}
+	if (req.vm && inv.cacheDir != nullptr){
+		//Cached functions have no 3AC to interpret
+		err << "--vm can't be used with --cache-dir\n";
+		usage(err);
+		return false;
+	}
+	if (!inv.batch && inv.inputs.size() > 1){
+		err << "Only 1 input file allowed (use --batch): ";
+		err << inv.inputs[1] << std::endl;
+		usage(err);
+		return false;
+	}
+	for (const std::string& input : inv.inputs){
+		std::ifstream check(input);
+		if (!check.good()){
+			err << "Bad path " << input << std::endl;
+			usage(err);
+			return false;
+		}
+	}
+	if (!useful){
+		err << "Hey, you didn't tell dgc to do anything!\n";
+		usage(err);
+		return false;
+	}
+	return true;
+}
+
+//Run one dgc command line. This is what main does for a
+// normal invocation and what the compile server does for
+// each request it receives (with served set).
+static int runCommand(const std::vector<std::string>& args,
+  const std::string& cwd, bool served){
+	Invocation inv;
+	if (!parseArgs(args, cwd, served, inv)){ return 1; }
+
+	TraceLog trace;
+	if (inv.tracePath != nullptr){ inv.req.trace = &trace; }
+	FnCache * cache = nullptr;
+	if (inv.cacheDir != nullptr){
+		cache = new FnCache(inv.cacheDir, inv.cacheLimit);
+		inv.req.cache = cache;
+	}
+	ASTCache * astCache = nullptr;
+	if (inv.astCacheDir != nullptr){
+		astCache = new ASTCache(inv.astCacheDir);
+		inv.req.astCache = astCache;
+	}
+
+	int status;
+	if (inv.batch){
+		status = compileBatch(inv.inputs, inv.req, inv.numThreads);
+	} else {
+		status = compile(inv.inputs[0].c_str(), inv.req);
+	}
+
+	if (cache != nullptr){
+		cache->evict();
+		if (inv.cacheStats){ cache->reportStats(Report::diagnostics()); }
+		delete cache;
+	}
+	if (astCache != nullptr){
+		if (inv.cacheStats){ astCache->reportStats(Report::diagnostics()); }
+		delete astCache;
+	}
+
+	if (inv.tracePath != nullptr && !trace.write(inv.tracePath)){
+		Report::diagnostics() << "Could not write trace file "
+		  << inv.tracePath << std::endl;
+		return 1;
+	}
+	return status;
+}
+
+int
+main( const int argc, const char **argv )
+{
+	//Nothing here writes through C stdio, so std::cout can
+	// buffer on its own (which matters for large -- outputs)
+	std::ios::sync_with_stdio(false);
+	std::vector<std::string> args(argv + 1, argv + argc);
+
+	int status;
+	if (argc == 3 && strcmp(argv[1], "--serve") == 0){
+		status = runServer(argv[2], [](const std::vector<std::string>& a,
+		  const std::string& cwd){ return runCommand(a, cwd, true); });
+	} else if (argc >= 3 && strcmp(argv[1], "--client") == 0){
+		args.erase(args.begin(), args.begin() + 2);
+		status = runClient(argv[2], args);
+	} else {
+		status = runCommand(args, "", false);
+	}
+	std::cout << std::flush;
+	std::cerr << std::flush;
+	return status;
+}
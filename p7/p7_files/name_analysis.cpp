@@ -2,6 +2,7 @@
 #include "symbol_table.hpp"
 #include "errName.hpp"
 #include "types.hpp"
+#include "timing.hpp"
 
 namespace drewgon{
 
@@ -9,7 +10,7 @@ bool ProgramNode::nameAnalysis(SymbolTable * symTab){
 	//Enter the global scope
 	symTab->enterScope();
 	bool res = true;
-	for (auto decl : *myGlobals){
+	for (auto decl : myGlobals){
 		res = decl->nameAnalysis(symTab) && res;
 	}
 	//Leave the global scope
@@ -41,7 +42,7 @@ bool IfStmtNode::nameAnalysis(SymbolTable * symTab){
 	bool result = true;
 	result = myCond->nameAnalysis(symTab) && result;
 	symTab->enterScope();
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		result = stmt->nameAnalysis(symTab) && result;
 	}
 	symTab->leaveScope();
@@ -52,12 +53,12 @@ bool IfElseStmtNode::nameAnalysis(SymbolTable * symTab){
 	bool result = true;
 	result = myCond->nameAnalysis(symTab) && result;
 	symTab->enterScope();
-	for (auto stmt : *myBodyTrue){
+	for (auto stmt : myBodyTrue){
 		result = stmt->nameAnalysis(symTab) && result;
 	}
 	symTab->leaveScope();
 	symTab->enterScope();
-	for (auto stmt : *myBodyFalse){
+	for (auto stmt : myBodyFalse){
 		result = stmt->nameAnalysis(symTab) && result;
 	}
 	symTab->leaveScope();
@@ -68,7 +69,7 @@ bool WhileStmtNode::nameAnalysis(SymbolTable * symTab){
 	bool result = true;
 	result = myCond->nameAnalysis(symTab) && result;
 	symTab->enterScope();
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		result = stmt->nameAnalysis(symTab) && result;
 	}
 	symTab->leaveScope();
@@ -81,7 +82,7 @@ bool ForStmtNode::nameAnalysis(SymbolTable * symTab){
 	symTab->enterScope();
 	result = myInit->nameAnalysis(symTab) && result;
 	result = myCond->nameAnalysis(symTab) && result;
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		result = stmt->nameAnalysis(symTab) && result;
 	}
 	result = myItr->nameAnalysis(symTab) && result;
@@ -91,7 +92,7 @@ bool ForStmtNode::nameAnalysis(SymbolTable * symTab){
 
 bool VarDeclNode::nameAnalysis(SymbolTable * symTab){
 	bool validType = myType->nameAnalysis(symTab);
-	std::string varName = ID()->getName();
+	SymbolId varId = ID()->getId();
 	const DataType * dataType = getTypeNode()->getType();
 
 	if (dataType == nullptr){
@@ -104,21 +105,22 @@ bool VarDeclNode::nameAnalysis(SymbolTable * symTab){
 		NameErr::badVarType(ID()->pos());
 	}
 
-	bool validName = !symTab->clash(varName);
+	bool validName = !symTab->clash(varId);
 	if (!validName){ NameErr::multiDecl(ID()->pos()); }
 
 	if (!validType || !validName){
 		return false;
 	} else {
-		symTab->insert(new VarSymbol(varName, dataType));
-		SemSymbol * sym = symTab->find(varName);
+		symTab->insert(new VarSymbol(varId, dataType));
+		SemSymbol * sym = symTab->find(varId);
 		this->myID->attachSymbol(sym);
 		return true;
 	}
 }
 
 bool FnDeclNode::nameAnalysis(SymbolTable * symTab){
-	std::string fnName = this->ID()->getName();
+	SymbolId fnId = this->ID()->getId();
+	PhaseTimer timer("function", this->ID()->getName());
 
 	bool validRet = myRetType->nameAnalysis(symTab);
 
@@ -132,34 +134,36 @@ bool FnDeclNode::nameAnalysis(SymbolTable * symTab){
 	  scope for a global function)
 	*/
 	bool validName = true;
-	if (atFnScope->clash(fnName)){
+	if (atFnScope->clash(fnId)){
 		NameErr::multiDecl(ID()->pos());
 		validName = false;
 	}
 
 	bool validFormals = true;
-	auto formalTypeNodes = list<TypeNode *>();
-	for (auto formal : *(this->myFormals)){
+	std::vector<TypeNode *> formalTypeNodes;
+	for (auto formal : myFormals){
 		validFormals = formal->nameAnalysis(symTab) && validFormals;
 		TypeNode * formalTypeNode = formal->getTypeNode();
 		formalTypeNodes.push_back(formalTypeNode);
 	}
-	auto formalTypes = TypeList::produce(&formalTypeNodes);
+	auto formalTypes = TypeList::produce(Span<TypeNode *>(
+	  formalTypeNodes.data(), formalTypeNodes.size()));
 
 	const DataType * retType = this->getRetTypeNode()->getType();
 	FnType * dataType = FnType::produce(formalTypes, retType);
 	//Make sure the fnSymbol is in the symbol table before
 	// analyzing the body, to allow for recursive calls
 	if (validName){
-		atFnScope->addFn(fnName, dataType);
-		SemSymbol * sym = atFnScope->lookup(fnName);
+		atFnScope->addFn(fnId, dataType);
+		SemSymbol * sym = atFnScope->lookup(fnId);
 		this->myID->attachSymbol(sym);
 	}
 
 	bool validBody = true;
-	for (auto stmt : *myBody){
+	for (auto stmt : body()){
 		validBody = stmt->nameAnalysis(symTab) && validBody;
 	}
+	validBody = validBody && bodyParsed();
 
 	symTab->leaveScope();
 	return (validRet && validFormals && validName && validBody);
@@ -174,7 +178,7 @@ bool BinaryExpNode::nameAnalysis(SymbolTable * symTab){
 bool CallExpNode::nameAnalysis(SymbolTable* symTab){
 	bool result = true;
 	result = myID->nameAnalysis(symTab) && result;
-	for (auto arg : *myArgs){
+	for (auto arg : myArgs){
 		result = arg->nameAnalysis(symTab) && result;
 	}
 	return result;
@@ -242,8 +246,7 @@ bool MayhemNode::nameAnalysis(SymbolTable * symTab){
 }
 
 bool IDNode::nameAnalysis(SymbolTable* symTab){
-	std::string myName = this->getName();
-	SemSymbol * sym = symTab->find(myName);
+	SemSymbol * sym = symTab->find(this->getId());
 	if (sym == nullptr){
 		return NameErr::undeclID(pos());
 	}
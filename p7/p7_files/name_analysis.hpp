@@ -9,19 +9,27 @@ class NameAnalysis{
 public:
 	static NameAnalysis * build(ProgramNode * astIn){
 		NameAnalysis * nameAnalysis = new NameAnalysis;
-		SymbolTable * symTab = new SymbolTable();
-		bool res = astIn->nameAnalysis(symTab);
-		delete symTab;
-		if (!res){ return nullptr; }
+		nameAnalysis->symTab = new SymbolTable();
+		bool res = astIn->nameAnalysis(nameAnalysis->symTab);
+		if (!res){
+			delete nameAnalysis;
+			return nullptr;
+		}
 
 		nameAnalysis->ast = astIn;
 		return nameAnalysis;
 	}
 	ProgramNode * ast;
 
+	//The symbols attached to the AST's IDs go with the table
+	// they were declared in
+	~NameAnalysis(){
+		delete symTab;
+	}
 private:
 	NameAnalysis(){
 	}
+	SymbolTable * symTab = nullptr;
 };
 
 }
@@ -0,0 +1,435 @@
+#include <cstring>
+#include <map>
+#include "obj_module.hpp"
+#include "errors.hpp"
+
+namespace drewgon{
+
+ObjModule::ObjModule(){
+	sections.push_back(ObjSection(".text", true, false, 16));
+	sections.push_back(ObjSection(".data", false, true, 8));
+}
+
+ObjSymbol * ObjModule::findSymbol(const std::string& name){
+	for (ObjSymbol& sym : symbols){
+		if (sym.name == name){ return &sym; }
+	}
+	return nullptr;
+}
+
+const ObjSymbol * ObjModule::findSymbol(const std::string& name) const{
+	for (const ObjSymbol& sym : symbols){
+		if (sym.name == name){ return &sym; }
+	}
+	return nullptr;
+}
+
+size_t relocWidth(RelocType type){
+	return type == R_X86_64_64 ? 8 : 4;
+}
+
+bool applyReloc(unsigned char * loc, const ObjReloc& rel, uint64_t place,
+  uint64_t symAddr){
+	int64_t val = static_cast<int64_t>(symAddr) + rel.addend;
+	bool fits = true;
+	if (rel.type == R_X86_64_PC32 || rel.type == R_X86_64_PLT32){
+		val -= static_cast<int64_t>(place);
+		fits = val >= INT32_MIN && val <= INT32_MAX;
+	} else if (rel.type == R_X86_64_32){
+		fits = val >= 0 && val <= static_cast<int64_t>(UINT32_MAX);
+	} else if (rel.type == R_X86_64_32S){
+		fits = val >= INT32_MIN && val <= INT32_MAX;
+	}
+	if (!fits){ return false; }
+	for (size_t i = 0; i < relocWidth(rel.type); i++){
+		loc[i] = static_cast<unsigned char>(static_cast<uint64_t>(val) >> (8 * i));
+	}
+	return true;
+}
+
+//Little-endian writers for building the ELF image
+static void put16(std::vector<unsigned char>& buf, uint16_t val){
+	for (int i = 0; i < 2; i++){
+		buf.push_back(static_cast<unsigned char>(val >> (8 * i)));
+	}
+}
+
+static void put32(std::vector<unsigned char>& buf, uint32_t val){
+	for (int i = 0; i < 4; i++){
+		buf.push_back(static_cast<unsigned char>(val >> (8 * i)));
+	}
+}
+
+static void put64(std::vector<unsigned char>& buf, uint64_t val){
+	for (int i = 0; i < 8; i++){
+		buf.push_back(static_cast<unsigned char>(val >> (8 * i)));
+	}
+}
+
+static void padTo(std::vector<unsigned char>& buf, size_t align){
+	while (buf.size() % align != 0){ buf.push_back(0); }
+}
+
+//A string table, as ELF lays them out
+class StrTab{
+public:
+	StrTab(){ bytes.push_back(0); }
+	uint32_t add(const std::string& str){
+		if (str.empty()){ return 0; }
+		uint32_t idx = static_cast<uint32_t>(bytes.size());
+		bytes.insert(bytes.end(), str.begin(), str.end());
+		bytes.push_back(0);
+		return idx;
+	}
+	std::vector<unsigned char> bytes;
+};
+
+static const uint32_t SHT_PROGBITS = 1;
+static const uint32_t SHT_SYMTAB = 2;
+static const uint32_t SHT_STRTAB = 3;
+static const uint32_t SHT_RELA = 4;
+static const uint32_t SHT_NOBITS = 8;
+static const uint64_t SHF_WRITE = 0x1;
+static const uint64_t SHF_ALLOC = 0x2;
+static const uint64_t SHF_EXECINSTR = 0x4;
+static const uint64_t SHF_INFO_LINK = 0x40;
+
+class SectionHeader{
+public:
+	uint32_t name = 0;
+	uint32_t type = 0;
+	uint64_t flags = 0;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	uint32_t link = 0;
+	uint32_t info = 0;
+	uint64_t align = 0;
+	uint64_t entsize = 0;
+};
+
+void ObjModule::writeELF(std::ostream& out) const{
+	StrTab shstrtab;
+	StrTab strtab;
+	std::vector<SectionHeader> headers(1);
+	std::vector<unsigned char> image(64, 0);
+
+	//Section indices in the file: the null section, then
+	// each of our sections, then their relocations, then the
+	// symbol and string tables
+	size_t numSections = sections.size();
+	uint32_t firstRela = static_cast<uint32_t>(1 + numSections);
+	uint32_t symtabIdx = firstRela + static_cast<uint32_t>(numSections);
+	uint32_t strtabIdx = symtabIdx + 1;
+
+	for (const ObjSection& sec : sections){
+		padTo(image, sec.align);
+		SectionHeader hdr;
+		hdr.name = shstrtab.add(sec.name);
+		hdr.type = SHT_PROGBITS;
+		hdr.flags = SHF_ALLOC | (sec.exec ? SHF_EXECINSTR : 0)
+		  | (sec.write ? SHF_WRITE : 0);
+		hdr.offset = image.size();
+		hdr.size = sec.bytes.size();
+		hdr.align = sec.align;
+		image.insert(image.end(), sec.bytes.begin(), sec.bytes.end());
+		headers.push_back(hdr);
+	}
+
+	//ELF wants local symbols first. Each section gets a
+	// section symbol, as assemblers conventionally emit.
+	std::vector<unsigned char> symtab(24, 0);
+	std::map<std::string, uint32_t> symIdx;
+	uint32_t numSyms = 1;
+	for (size_t i = 0; i < numSections; i++){
+		put32(symtab, 0);
+		symtab.push_back(3); //STB_LOCAL, STT_SECTION
+		symtab.push_back(0);
+		put16(symtab, static_cast<uint16_t>(1 + i));
+		put64(symtab, 0);
+		put64(symtab, 0);
+		numSyms++;
+	}
+	uint32_t firstGlobal = 0;
+	for (int pass = 0; pass < 2; pass++){
+		bool wantGlobal = pass == 1;
+		if (wantGlobal){ firstGlobal = numSyms; }
+		for (const ObjSymbol& sym : symbols){
+			if (sym.global != wantGlobal){ continue; }
+			put32(symtab, strtab.add(sym.name));
+			symtab.push_back(wantGlobal ? 0x10 : 0x00); //STT_NOTYPE
+			symtab.push_back(0);
+			if (sym.section == ObjSymbol::UNDEFINED){
+				put16(symtab, 0);
+			} else {
+				put16(symtab, static_cast<uint16_t>(1 + sym.section));
+			}
+			put64(symtab, sym.section == ObjSymbol::UNDEFINED ? 0 : sym.offset);
+			put64(symtab, 0);
+			symIdx[sym.name] = numSyms++;
+		}
+	}
+
+	for (size_t i = 0; i < numSections; i++){
+		const ObjSection& sec = sections[i];
+		padTo(image, 8);
+		SectionHeader hdr;
+		hdr.name = shstrtab.add(".rela" + sec.name);
+		hdr.type = SHT_RELA;
+		hdr.flags = SHF_INFO_LINK;
+		hdr.offset = image.size();
+		hdr.link = symtabIdx;
+		hdr.info = static_cast<uint32_t>(1 + i);
+		hdr.align = 8;
+		hdr.entsize = 24;
+		for (const ObjReloc& rel : sec.relocs){
+			uint64_t sym = symIdx.at(rel.symbol);
+			put64(image, rel.offset);
+			put64(image, sym << 32 | rel.type);
+			put64(image, static_cast<uint64_t>(rel.addend));
+		}
+		hdr.size = image.size() - hdr.offset;
+		headers.push_back(hdr);
+	}
+
+	padTo(image, 8);
+	SectionHeader symHdr;
+	symHdr.name = shstrtab.add(".symtab");
+	symHdr.type = SHT_SYMTAB;
+	symHdr.offset = image.size();
+	symHdr.size = symtab.size();
+	symHdr.link = strtabIdx;
+	symHdr.info = firstGlobal;
+	symHdr.align = 8;
+	symHdr.entsize = 24;
+	image.insert(image.end(), symtab.begin(), symtab.end());
+	headers.push_back(symHdr);
+
+	SectionHeader strHdr;
+	strHdr.name = shstrtab.add(".strtab");
+	strHdr.type = SHT_STRTAB;
+	strHdr.offset = image.size();
+	strHdr.size = strtab.bytes.size();
+	strHdr.align = 1;
+	image.insert(image.end(), strtab.bytes.begin(), strtab.bytes.end());
+	headers.push_back(strHdr);
+
+	//An empty .note.GNU-stack marks the stack non-executable
+	SectionHeader stackHdr;
+	stackHdr.name = shstrtab.add(".note.GNU-stack");
+	stackHdr.type = SHT_PROGBITS;
+	stackHdr.offset = image.size();
+	stackHdr.align = 1;
+	headers.push_back(stackHdr);
+
+	SectionHeader shstrHdr;
+	shstrHdr.name = shstrtab.add(".shstrtab");
+	shstrHdr.type = SHT_STRTAB;
+	shstrHdr.offset = image.size();
+	shstrHdr.size = shstrtab.bytes.size();
+	shstrHdr.align = 1;
+	image.insert(image.end(), shstrtab.bytes.begin(), shstrtab.bytes.end());
+	headers.push_back(shstrHdr);
+
+	padTo(image, 8);
+	uint64_t shoff = image.size();
+	for (const SectionHeader& hdr : headers){
+		put32(image, hdr.name);
+		put32(image, hdr.type);
+		put64(image, hdr.flags);
+		put64(image, 0);
+		put64(image, hdr.offset);
+		put64(image, hdr.size);
+		put32(image, hdr.link);
+		put32(image, hdr.info);
+		put64(image, hdr.align);
+		put64(image, hdr.entsize);
+	}
+
+	std::vector<unsigned char> ehdr;
+	const unsigned char ident[16] = {0x7f, 'E', 'L', 'F', 2, 1, 1, 0};
+	ehdr.insert(ehdr.end(), ident, ident + 16);
+	put16(ehdr, 1);     //ET_REL
+	put16(ehdr, 62);    //EM_X86_64
+	put32(ehdr, 1);     //EV_CURRENT
+	put64(ehdr, 0);     //e_entry
+	put64(ehdr, 0);     //e_phoff
+	put64(ehdr, shoff);
+	put32(ehdr, 0);     //e_flags
+	put16(ehdr, 64);    //e_ehsize
+	put16(ehdr, 0);     //e_phentsize
+	put16(ehdr, 0);     //e_phnum
+	put16(ehdr, 64);    //e_shentsize
+	put16(ehdr, static_cast<uint16_t>(headers.size()));
+	put16(ehdr, static_cast<uint16_t>(headers.size() - 1));
+	memcpy(image.data(), ehdr.data(), ehdr.size());
+
+	out.write(reinterpret_cast<const char *>(image.data()),
+	  static_cast<std::streamsize>(image.size()));
+}
+
+//Little-endian readers for the ELF reader, which checks bounds
+// before using them
+static uint64_t get(const char * data, size_t offset, size_t width){
+	uint64_t val = 0;
+	for (size_t i = 0; i < width; i++){
+		uint64_t byte = static_cast<unsigned char>(data[offset + i]);
+		val |= byte << (8 * i);
+	}
+	return val;
+}
+
+ObjModule * ObjModule::readELF(const char * data, size_t size,
+  const std::string& fileName){
+	auto bad = [&fileName](const char * why) -> InternalError *{
+		std::string msg = fileName + ": " + why;
+		return new InternalError(msg.c_str());
+	};
+	const unsigned char ident[7] = {0x7f, 'E', 'L', 'F', 2, 1, 1};
+	if (size < 64 || memcmp(data, ident, 7) != 0){
+		throw bad("not an ELF64 little-endian object");
+	}
+	if (get(data, 16, 2) != 1 || get(data, 18, 2) != 62){
+		throw bad("not an x86-64 relocatable object");
+	}
+	uint64_t shoff = get(data, 40, 8);
+	size_t shnum = get(data, 60, 2);
+	size_t shstrndx = get(data, 62, 2);
+	if (shoff > size || shnum * 64 > size - shoff || shstrndx >= shnum){
+		throw bad("bad section headers");
+	}
+
+	std::vector<SectionHeader> headers(shnum);
+	for (size_t i = 0; i < shnum; i++){
+		size_t at = shoff + i * 64;
+		SectionHeader& hdr = headers[i];
+		hdr.name = static_cast<uint32_t>(get(data, at, 4));
+		hdr.type = static_cast<uint32_t>(get(data, at + 4, 4));
+		hdr.flags = get(data, at + 8, 8);
+		hdr.offset = get(data, at + 24, 8);
+		hdr.size = get(data, at + 32, 8);
+		hdr.link = static_cast<uint32_t>(get(data, at + 40, 4));
+		hdr.info = static_cast<uint32_t>(get(data, at + 44, 4));
+		hdr.align = get(data, at + 48, 8);
+		hdr.entsize = get(data, at + 56, 8);
+		if (hdr.type != SHT_NOBITS
+		  && (hdr.offset > size || hdr.size > size - hdr.offset)){
+			throw bad("section extends past the end of the file");
+		}
+	}
+	auto strAt = [&](size_t table, uint64_t idx) -> std::string{
+		const SectionHeader& hdr = headers[table];
+		if (idx >= hdr.size){ throw bad("bad string table offset"); }
+		const char * str = data + hdr.offset + idx;
+		return std::string(str, strnlen(str, hdr.size - idx));
+	};
+
+	//Sections that take up memory become our sections; the
+	// rest (symbol tables, notes, comments) are dropped
+	ObjModule * mod = new ObjModule();
+	mod->sections.clear();
+	const size_t DROPPED = static_cast<size_t>(-1);
+	std::vector<size_t> sectionIdx(shnum, DROPPED);
+	for (size_t i = 1; i < shnum; i++){
+		const SectionHeader& hdr = headers[i];
+		if ((hdr.flags & SHF_ALLOC) == 0){ continue; }
+		if (hdr.type != SHT_PROGBITS && hdr.type != SHT_NOBITS){
+			throw bad("unsupported allocated section type");
+		}
+		ObjSection sec(strAt(shstrndx, hdr.name),
+		  (hdr.flags & SHF_EXECINSTR) != 0, (hdr.flags & SHF_WRITE) != 0,
+		  hdr.align == 0 ? 1 : hdr.align);
+		if (hdr.type == SHT_NOBITS){
+			sec.bytes.resize(hdr.size, 0);
+		} else {
+			sec.bytes.assign(data + hdr.offset, data + hdr.offset + hdr.size);
+		}
+		sectionIdx[i] = mod->sections.size();
+		mod->sections.push_back(sec);
+	}
+
+	//Symbols, indexed as in the file so relocations can find
+	// them; an empty name means the symbol isn't usable
+	std::vector<std::string> symNames;
+	for (size_t i = 1; i < shnum; i++){
+		const SectionHeader& hdr = headers[i];
+		if (hdr.type != SHT_SYMTAB){ continue; }
+		if (hdr.entsize != 24 || hdr.link >= shnum){
+			throw bad("bad symbol table");
+		}
+		size_t count = hdr.size / 24;
+		symNames.assign(count, "");
+		for (size_t s = 1; s < count; s++){
+			size_t at = hdr.offset + s * 24;
+			uint64_t info = get(data, at + 4, 1);
+			size_t shndx = get(data, at + 6, 2);
+			uint64_t value = get(data, at + 8, 8);
+			uint64_t bind = info >> 4;
+			uint64_t type = info & 0xf;
+			std::string name;
+			if (type == 3){
+				//STT_SECTION
+				if (shndx >= shnum || sectionIdx[shndx] == DROPPED){ continue; }
+				name = mod->sections[sectionIdx[shndx]].name;
+			} else if (type == 4){
+				//STT_FILE
+				continue;
+			} else {
+				name = strAt(hdr.link, get(data, at, 4));
+			}
+			if (name.empty()){ continue; }
+			symNames[s] = name;
+
+			ObjSymbol sym;
+			sym.name = name;
+			sym.global = bind != 0;
+			sym.offset = value;
+			if (shndx == 0){
+				sym.section = ObjSymbol::UNDEFINED;
+				sym.offset = 0;
+			} else if (shndx >= 0xff00){
+				throw bad("absolute and common symbols are not supported");
+			} else if (shndx >= shnum || sectionIdx[shndx] == DROPPED){
+				continue;
+			} else {
+				sym.section = sectionIdx[shndx];
+			}
+			if (type == 3 && mod->findSymbol(name) != nullptr){ continue; }
+			mod->symbols.push_back(sym);
+		}
+	}
+
+	for (size_t i = 1; i < shnum; i++){
+		const SectionHeader& hdr = headers[i];
+		if (hdr.type != SHT_RELA){ continue; }
+		if (hdr.info >= shnum || sectionIdx[hdr.info] == DROPPED){ continue; }
+		if (hdr.entsize != 24){ throw bad("bad relocation section"); }
+		ObjSection& target = mod->sections[sectionIdx[hdr.info]];
+		for (size_t r = 0; r < hdr.size / 24; r++){
+			size_t at = hdr.offset + r * 24;
+			uint64_t info = get(data, at + 8, 8);
+			size_t symIdx = info >> 32;
+			uint32_t type = static_cast<uint32_t>(info & 0xffffffff);
+			if (type == 0){ continue; }
+			if (type != R_X86_64_64 && type != R_X86_64_PC32
+			  && type != R_X86_64_PLT32 && type != R_X86_64_32
+			  && type != R_X86_64_32S){
+				throw bad("unsupported relocation type (use -fno-pic)");
+			}
+			if (symIdx >= symNames.size() || symNames[symIdx].empty()){
+				throw bad("relocation against an unusable symbol");
+			}
+			ObjReloc rel;
+			rel.offset = get(data, at, 8);
+			rel.type = static_cast<RelocType>(type);
+			rel.symbol = symNames[symIdx];
+			rel.addend = static_cast<int64_t>(get(data, at + 16, 8));
+			if (rel.offset > target.bytes.size()){
+				throw bad("relocation outside its section");
+			}
+			target.relocs.push_back(rel);
+		}
+	}
+	return mod;
+}
+
+}
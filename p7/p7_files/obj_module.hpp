@@ -0,0 +1,94 @@
+#ifndef DREWGON_OBJ_MODULE_HPP
+#define DREWGON_OBJ_MODULE_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace drewgon{
+
+//The x86-64 ELF relocation types the back end produces (and
+// the linker accepts)
+enum RelocType : uint32_t {
+	R_X86_64_64 = 1,
+	R_X86_64_PC32 = 2,
+	R_X86_64_PLT32 = 4,
+	R_X86_64_32 = 10,
+	R_X86_64_32S = 11,
+};
+
+//The number of bytes a relocation of this type patches
+size_t relocWidth(RelocType type);
+
+// A place in a section that has to be patched with the address
+// of a symbol (plus addend) once that address is known
+class ObjReloc{
+public:
+	size_t offset;
+	RelocType type;
+	std::string symbol;
+	int64_t addend;
+};
+
+//Patch the bytes at loc, which will be loaded at address place,
+// for rel against a symbol at address symAddr. Returns false if
+// the result doesn't fit in the relocated field.
+bool applyReloc(unsigned char * loc, const ObjReloc& rel, uint64_t place,
+  uint64_t symAddr);
+
+class ObjSection{
+public:
+	ObjSection(std::string nameIn, bool execIn, bool writeIn,
+	  size_t alignIn)
+	: name(nameIn), exec(execIn), write(writeIn), align(alignIn){ }
+	std::string name;
+	bool exec;
+	bool write;
+	size_t align;
+	std::vector<unsigned char> bytes;
+	std::vector<ObjReloc> relocs;
+};
+
+class ObjSymbol{
+public:
+	std::string name;
+	//Index into the module's sections, or UNDEFINED
+	size_t section;
+	size_t offset;
+	bool global;
+	static const size_t UNDEFINED = static_cast<size_t>(-1);
+};
+
+// Machine code and data for one compiled program, along with
+// its symbols and the relocations still to be applied. This is
+// what the integrated assembler produces, and what can be
+// written out as an ELF relocatable object (or linked or loaded
+// directly, without going through a file).
+class ObjModule{
+public:
+	//An empty .text and .data, for the assembler to fill in
+	ObjModule();
+	//Read the allocated sections of an ELF64 x86-64 relocatable
+	// object, along with their symbols and relocations. Section
+	// symbols are named after their section. Throws an
+	// InternalError naming the file if it can't be used.
+	static ObjModule * readELF(const char * data, size_t size,
+	  const std::string& fileName);
+	std::vector<ObjSection> sections;
+	std::vector<ObjSymbol> symbols;
+
+	static const size_t TEXT = 0;
+	static const size_t DATA = 1;
+
+	//The symbol with this name, or nullptr
+	ObjSymbol * findSymbol(const std::string& name);
+	const ObjSymbol * findSymbol(const std::string& name) const;
+
+	//Write the module as an ELF64 x86-64 relocatable object
+	void writeELF(std::ostream& out) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,87 @@
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "out_stream.hpp"
+
+namespace drewgon{
+
+FdStreamBuf::FdStreamBuf(int fdIn, size_t bufSize)
+: fd(fdIn), myOK(fdIn >= 0), buf(bufSize){
+	setp(buf.data(), buf.data() + buf.size());
+}
+
+FdStreamBuf::~FdStreamBuf(){
+	flushBuffer();
+}
+
+bool FdStreamBuf::flushBuffer(){
+	const char * pos = pbase();
+	size_t len = static_cast<size_t>(pptr() - pbase());
+	setp(buf.data(), buf.data() + buf.size());
+	while (myOK && len > 0){
+		ssize_t wrote = write(fd, pos, len);
+		if (wrote < 0){
+			if (errno == EINTR){ continue; }
+			myOK = false;
+			break;
+		}
+		pos += wrote;
+		len -= static_cast<size_t>(wrote);
+	}
+	return myOK;
+}
+
+FdStreamBuf::int_type FdStreamBuf::overflow(int_type ch){
+	if (!flushBuffer()){ return traits_type::eof(); }
+	if (!traits_type::eq_int_type(ch, traits_type::eof())){
+		*pptr() = traits_type::to_char_type(ch);
+		pbump(1);
+	}
+	return traits_type::not_eof(ch);
+}
+
+std::streamsize FdStreamBuf::xsputn(const char * s, std::streamsize n){
+	std::streamsize done = 0;
+	while (done < n){
+		std::streamsize room = epptr() - pptr();
+		if (room == 0){
+			if (!flushBuffer()){ return done; }
+			room = epptr() - pptr();
+		}
+		std::streamsize chunk = n - done < room ? n - done : room;
+		memcpy(pptr(), s + done, static_cast<size_t>(chunk));
+		pbump(static_cast<int>(chunk));
+		done += chunk;
+	}
+	return done;
+}
+
+int FdStreamBuf::sync(){
+	return flushBuffer() ? 0 : -1;
+}
+
+FileOutStream::FileOutStream(const char * path)
+: std::ostream(nullptr),
+  fd(open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666)),
+  sbuf(new FdStreamBuf(fd)){
+	rdbuf(sbuf);
+	if (fd < 0){ setstate(std::ios::badbit); }
+}
+
+FileOutStream::~FileOutStream(){
+	close();
+	delete sbuf;
+}
+
+bool FileOutStream::close(){
+	if (fd < 0){ return false; }
+	flush();
+	bool ok = sbuf->ok();
+	if (::close(fd) != 0){ ok = false; }
+	fd = -1;
+	if (!ok){ setstate(std::ios::badbit); }
+	return ok;
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef DREWGON_OUT_STREAM_HPP
+#define DREWGON_OUT_STREAM_HPP
+
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+namespace drewgon{
+
+// A streambuf that collects output in one large buffer and
+// writes it to a file descriptor each time the buffer fills, so
+// that big outputs are streamed to disk without being built up
+// in memory first.
+class FdStreamBuf : public std::streambuf{
+public:
+	FdStreamBuf(int fdIn, size_t bufSize = 1 << 20);
+	~FdStreamBuf();
+	//Whether every write so far has succeeded
+	bool ok() const { return myOK; }
+protected:
+	int_type overflow(int_type ch) override;
+	std::streamsize xsputn(const char * s, std::streamsize n) override;
+	int sync() override;
+private:
+	bool flushBuffer();
+	int fd;
+	bool myOK;
+	std::vector<char> buf;
+};
+
+// An output file written through an FdStreamBuf
+class FileOutStream : public std::ostream{
+public:
+	FileOutStream(const char * path);
+	~FileOutStream();
+	//Flush and close the file. Returns false if the file
+	// couldn't be opened or any write to it failed.
+	bool close();
+private:
+	int fd;
+	FdStreamBuf * sbuf;
+};
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include "parallel_scanner.hpp"
+#include "scanner.hpp"
+#include "tokens.hpp"
+
+namespace drewgon{
+
+using Lexeme = drewgon::Parser::semantic_type;
+
+//Splitting a source into chunks smaller than this costs more (in
+// starting threads) than it saves
+static const size_t MIN_CHUNK = 1024 * 1024;
+
+//Scans one chunk, keeping its errors for later rather than
+// reporting them
+class ParallelScanner::ChunkScanner : public Scanner{
+public:
+	ChunkScanner(const SourceFile * src, Chunk * chunkIn, bool handWritten)
+	: Scanner(src, chunkIn->begin, chunkIn->end, &chunkIn->arena,
+	    handWritten),
+	  chunk(chunkIn){ }
+
+	virtual void reportError(Position * pos, const std::string& msg) override{
+		chunk->errors.push_back(Error(chunk->tokens.size(), pos, msg));
+	}
+private:
+	Chunk * chunk;
+};
+
+size_t ParallelScanner::numChunks(const SourceFile * src, unsigned int threads){
+	size_t chunks = std::min(static_cast<size_t>(threads),
+	  src->size() / MIN_CHUNK);
+	return std::max(chunks, static_cast<size_t>(1));
+}
+
+ParallelScanner::ParallelScanner(const SourceFile * srcIn, Arena * arenaIn,
+  bool handWrittenIn, size_t numChunks)
+: src(srcIn), arena(arenaIn), handWritten(handWrittenIn){
+	//Each chunk ends just after the first newline past its
+	// share of the text (or at the end of the text)
+	const char * text = src->data();
+	size_t size = src->size();
+	size_t begin = 0;
+	for (size_t i = 1; i <= numChunks; i++){
+		size_t end = size;
+		if (i < numChunks){
+			size_t share = std::max(size / numChunks * i, begin);
+			const void * newline = memchr(text + share, '\n', size - share);
+			if (newline != nullptr){
+				end = static_cast<size_t>(
+				  static_cast<const char *>(newline) - text) + 1;
+			}
+		}
+		Chunk * chunk = new Chunk();
+		chunk->begin = begin;
+		chunk->end = end;
+		chunks.push_back(chunk);
+		begin = end;
+	}
+}
+
+ParallelScanner::~ParallelScanner(){
+	for (Chunk * chunk : chunks){
+		delete chunk;
+	}
+}
+
+template <typename Work>
+void ParallelScanner::eachChunk(Work work){
+	std::vector<std::thread> pool;
+	for (size_t i = 1; i < chunks.size(); i++){
+		pool.push_back(std::thread(work, chunks[i]));
+	}
+	work(chunks[0]);
+	for (auto& thread : pool){
+		thread.join();
+	}
+}
+
+void ParallelScanner::scanAll(){
+	eachChunk([this](Chunk * chunk){ scanChunk(chunk); });
+	for (Chunk * chunk : chunks){
+		if (chunk->failure){ std::rethrow_exception(chunk->failure); }
+		arena->adopt(chunk->arena);
+	}
+}
+
+void ParallelScanner::scanChunk(Chunk * chunk){
+	try {
+		ChunkScanner scanner(src, chunk, handWritten);
+		Lexeme lex;
+		while (scanner.next(&lex) != TokenKind::END){
+			chunk->tokens.push_back(lex.lexeme);
+		}
+	} catch (...) {
+		chunk->failure = std::current_exception();
+	}
+}
+
+int ParallelScanner::next(Lexeme * lval, Scanner * owner){
+	if (!scanned){
+		scanned = true;
+		scanAll();
+	}
+	while (chunkIdx < chunks.size()){
+		Chunk * chunk = chunks[chunkIdx];
+		if (errorIdx < chunk->errors.size()
+		  && chunk->errors[errorIdx].before == tokenIdx){
+			Error& err = chunk->errors[errorIdx++];
+			owner->reportError(&err.pos, err.msg);
+			continue;
+		}
+		if (tokenIdx < chunk->tokens.size()){
+			Token * tok = chunk->tokens[tokenIdx++];
+			lval->lexeme = tok;
+			return tok->kind();
+		}
+		//The chunk's tokens are all handed out
+		std::vector<Token *>().swap(chunk->tokens);
+		chunkIdx++;
+		tokenIdx = 0;
+		errorIdx = 0;
+	}
+	return TokenKind::END;
+}
+
+}
@@ -0,0 +1,91 @@
+#ifndef DREWGON_PARALLEL_SCANNER_HPP
+#define DREWGON_PARALLEL_SCANNER_HPP
+
+#include <exception>
+#include <string>
+#include <vector>
+#include "grammar.hh"
+#include "arena.hpp"
+#include "position.hpp"
+#include "source.hpp"
+
+// Scans a large source on several threads at once. The text is
+// split into chunks, each of which ends just after a newline, and
+// each chunk is scanned by its own Scanner (flex's or the
+// hand-written one) into its own list of tokens. The lists are
+// then handed out in order, as if one Scanner had read the whole
+// text.
+//
+// A chunk can always be scanned without knowing what came before
+// it. No Drewgon token, comment or string literal (not even an
+// unterminated one) goes past the end of a line, so the character
+// after a newline is never inside a string or a comment: it is
+// where the scanner would start afresh anyway. Positions are
+// offsets into the whole text, so they need no fixing up either.
+//
+// Lexical errors are kept with the token they come before, and
+// are reported as the tokens are handed out, so that they come out
+// in the same order (relative to the parser's own errors) as they
+// would from a single scanner.
+
+namespace drewgon{
+
+class Scanner;
+class Token;
+
+class ParallelScanner{
+public:
+	//How many chunks src should be split into for threads
+	// threads. A source too small to be worth splitting is one
+	// chunk.
+	static size_t numChunks(const SourceFile * src, unsigned int threads);
+
+	//Tokens are made in arenaIn (once they are all scanned)
+	ParallelScanner(const SourceFile * srcIn, Arena * arenaIn,
+	  bool handWrittenIn, size_t numChunks);
+	~ParallelScanner();
+
+	//The next token, as Scanner::yylex would return it. The first
+	// call scans the whole source. Lexical errors are reported
+	// through owner as they are passed.
+	int next(Parser::semantic_type * lval, Scanner * owner);
+private:
+	class Error{
+	public:
+		Error(size_t beforeIn, const Position * posIn, const std::string& msgIn)
+		: before(beforeIn), pos(*posIn), msg(msgIn){ }
+		//The index of the token the error comes before
+		size_t before;
+		Position pos;
+		std::string msg;
+	};
+
+	class Chunk{
+	public:
+		size_t begin;
+		size_t end;
+		Arena arena;
+		std::vector<Token *> tokens;
+		std::vector<Error> errors;
+		std::exception_ptr failure;
+	};
+	class ChunkScanner;
+
+	void scanAll();
+	void scanChunk(Chunk * chunk);
+	//Run work on every chunk, one thread per chunk
+	template <typename Work> void eachChunk(Work work);
+
+	const SourceFile * src;
+	Arena * arena;
+	const bool handWritten;
+	std::vector<Chunk *> chunks;
+	bool scanned = false;
+	size_t chunkIdx = 0;
+	size_t tokenIdx = 0;
+	size_t errorIdx = 0;
+};
+
+}
+
+#endif
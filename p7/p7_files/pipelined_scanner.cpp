@@ -0,0 +1,117 @@
+#include "pipelined_scanner.hpp"
+#include "scanner.hpp"
+#include "tokens.hpp"
+
+namespace drewgon{
+
+using Lexeme = drewgon::Parser::semantic_type;
+
+//How many times a thread checks the ring before it gives up the
+// rest of its time slice to wait
+static const unsigned int SPINS = 64;
+
+static void backOff(unsigned int& tries){
+	if (++tries >= SPINS){
+		std::this_thread::yield();
+		tries = 0;
+	}
+}
+
+//Scans the whole source, passing its errors through the ring
+// rather than reporting them
+class PipelinedScanner::ProducerScanner : public Scanner{
+public:
+	ProducerScanner(PipelinedScanner * pipeIn)
+	: Scanner(pipeIn->src, pipeIn->arena, pipeIn->handWritten,
+	    pipeIn->threads),
+	  pipe(pipeIn){ }
+
+	virtual void reportError(Position * pos, const std::string& msg) override{
+		pipe->pushError(pos, msg);
+	}
+private:
+	PipelinedScanner * pipe;
+};
+
+PipelinedScanner::PipelinedScanner(const SourceFile * srcIn, Arena * arenaIn,
+  bool handWrittenIn, unsigned int threadsIn)
+: src(srcIn), arena(arenaIn), handWritten(handWrittenIn),
+  threads(threadsIn){
+	producer = std::thread([this](){ produce(); });
+}
+
+PipelinedScanner::~PipelinedScanner(){
+	cancelled = true;
+	finish();
+}
+
+void PipelinedScanner::finish(){
+	if (producer.joinable()){ producer.join(); }
+}
+
+bool PipelinedScanner::push(const Entry& entry){
+	unsigned int tries = 0;
+	while (true){
+		if (cancelled.load(std::memory_order_relaxed)){ return false; }
+		if (ring.tryPush(entry)){ return true; }
+		backOff(tries);
+	}
+}
+
+bool PipelinedScanner::pushError(const Position * pos, const std::string& msg){
+	errors.push_back(Error(pos, msg));
+	Entry entry;
+	entry.kind = ERROR_ENTRY;
+	entry.tok = nullptr;
+	entry.err = &errors.back();
+	return push(entry);
+}
+
+void PipelinedScanner::produce(){
+	Entry entry;
+	entry.tok = nullptr;
+	entry.err = nullptr;
+	try {
+		ProducerScanner scanner(this);
+		Lexeme lex;
+		do {
+			entry.kind = scanner.next(&lex);
+			entry.tok = entry.kind == TokenKind::END ? nullptr : lex.lexeme;
+		} while (push(entry) && entry.kind != TokenKind::END);
+	} catch (...) {
+		failure = std::current_exception();
+		entry.kind = FAILED_ENTRY;
+		entry.tok = nullptr;
+		push(entry);
+	}
+}
+
+int PipelinedScanner::next(Lexeme * lval, Scanner * owner){
+	if (done){ return TokenKind::END; }
+	Entry entry;
+	while (true){
+		unsigned int tries = 0;
+		while (!ring.tryPop(entry)){ backOff(tries); }
+		if (entry.kind == ERROR_ENTRY){
+			Error err = *entry.err;
+			owner->reportError(&err.pos, err.msg);
+			continue;
+		}
+		break;
+	}
+	if (entry.kind == FAILED_ENTRY){
+		done = true;
+		finish();
+		std::rethrow_exception(failure);
+	}
+	if (entry.kind == TokenKind::END){
+		//The producer has nothing left to do
+		done = true;
+		finish();
+		return TokenKind::END;
+	}
+	lval->lexeme = entry.tok;
+	return entry.kind;
+}
+
+}
@@ -0,0 +1,90 @@
+#ifndef DREWGON_PIPELINED_SCANNER_HPP
+#define DREWGON_PIPELINED_SCANNER_HPP
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <string>
+#include <thread>
+#include "grammar.hh"
+#include "arena.hpp"
+#include "position.hpp"
+#include "source.hpp"
+#include "spsc_ring.hpp"
+
+// Scans on a thread of its own while the parser runs, so that on a
+// machine with a core to spare the time spent scanning is hidden
+// behind the time spent parsing. The scanning thread runs an
+// ordinary Scanner (flex's or the hand-written one, on the whole
+// source or split into parallel chunks) and passes each token to
+// the parser's thread through a lock-free ring (see spsc_ring.hpp).
+//
+// The ring is bounded: when the parser falls behind, the scanning
+// thread waits for room, so a fast scanner never runs far ahead of
+// the parser. Lexical errors go through the ring too, in order
+// with the tokens, and are reported from the parser's thread just
+// as a Scanner on that thread would report them. If the parser
+// stops early (at a syntax error), the scanning thread is stopped
+// when the scanner is destroyed.
+
+namespace drewgon{
+
+class Scanner;
+class Token;
+
+class PipelinedScanner{
+public:
+	//Tokens are made in arenaIn, which nothing else may allocate
+	// in until the scan is done
+	PipelinedScanner(const SourceFile * srcIn, Arena * arenaIn,
+	  bool handWrittenIn, unsigned int threadsIn);
+	~PipelinedScanner();
+
+	//The next token, as Scanner::yylex would return it. Lexical
+	// errors are reported through owner as they are passed.
+	int next(Parser::semantic_type * lval, Scanner * owner);
+private:
+	class Error{
+	public:
+		Error(const Position * posIn, const std::string& msgIn)
+		: pos(*posIn), msg(msgIn){ }
+		Position pos;
+		std::string msg;
+	};
+
+	//A token, or (with a kind no token has) an error or a failure
+	class Entry{
+	public:
+		int kind;
+		Token * tok;
+		const Error * err;
+	};
+	static const int ERROR_ENTRY = -1;
+	static const int FAILED_ENTRY = -2;
+	static const size_t RING_SIZE = 4096;
+
+	class ProducerScanner;
+
+	void produce();
+	//Producer only: false if the scan has been cancelled
+	bool push(const Entry& entry);
+	bool pushError(const Position * pos, const std::string& msg);
+	void finish();
+
+	const SourceFile * src;
+	Arena * arena;
+	const bool handWritten;
+	const unsigned int threads;
+	SpscRing<Entry, RING_SIZE> ring;
+	//Written by the producer only; entries point into it, and
+	// a deque never moves what it already holds
+	std::deque<Error> errors;
+	std::exception_ptr failure;
+	std::atomic<bool> cancelled{false};
+	std::thread producer;
+	bool done = false;
+};
+
+}
+
+#endif
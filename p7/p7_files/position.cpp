@@ -0,0 +1,19 @@
+#include "position.hpp"
+#include "errors.hpp"
+
+namespace drewgon{
+
+std::string Position::format(SourceLoc loc){
+	size_t line = 0;
+	size_t col = 0;
+	if (loc != NOWHERE){
+		const SourceManager * lines = SourceManager::current();
+		if (lines == nullptr){
+			throw new InternalError("No source to locate a position in");
+		}
+		lines->locate(loc, line, col);
+	}
+	return "[" + std::to_string(line) + "," + std::to_string(col) + "]";
+}
+
+}
@@ -2,47 +2,39 @@
 #define DREWGON_POSITION_H
 
 #include <string>
+#include "source.hpp"
 
 namespace drewgon{
 
+// A span of the file being compiled, from the byte offset where
+// it begins to the one where it ends. Every token and AST node
+// holds one, so it is kept small: it becomes lines and columns
+// only when it is printed, by the file's SourceManager (the
+// current one on the printing thread).
 class Position{
 public:
-	Position(size_t lineI, size_t colI, size_t lineE, size_t colE)
-	: myLineI(lineI), myColI(colI), myLineE(lineE), myColE(colE){
+	//Nowhere in particular
+	Position() : myBegin(NOWHERE), myEnd(NOWHERE){ }
+	Position(SourceLoc beginIn, SourceLoc endIn)
+	: myBegin(beginIn), myEnd(endIn){
 	}
 	Position(const Position * start, const Position * end)
-	: myLineI(start->myLineI), myColI(start->myColI),
-	  myLineE(end->myLineE),myColE(end->myColE){
+	: myBegin(start->myBegin), myEnd(end->myEnd){
 	}
-	virtual void expand(const Position * start, const Position * end){
-	  myLineI = start->myLineI;
-	  myColI = start->myColI;
-	  myLineE = end->myLineE;
-	  myColE = end->myColE;
-	}
-	virtual std::string begin() const{
-		std::string result = "["
-		+ std::to_string(myLineI)
-		+ ","
-		+ std::to_string(myColI)
-		+ "]";
-		return result;
-	}
-	virtual std::string span() const{
-		std::string result = begin()
-		+ "-["
-		+ std::to_string(myLineE)
-		+ ","
-		+ std::to_string(myColE)
-		+ "]";
-		return result;
+	SourceLoc offsetBegin() const { return myBegin; }
+	SourceLoc offsetEnd() const { return myEnd; }
+	//As [line,col]
+	std::string begin() const{ return format(myBegin); }
+	//As [line,col]-[line,col]
+	std::string span() const{
+		return format(myBegin) + "-" + format(myEnd);
 	}
 private:
-	size_t myLineI;
-	size_t myColI;
-	size_t myLineE;
-	size_t myColE;
+	static const SourceLoc NOWHERE = UINT32_MAX;
+	static std::string format(SourceLoc loc);
 
+	SourceLoc myBegin;
+	SourceLoc myEnd;
 };
 
 }
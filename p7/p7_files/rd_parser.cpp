@@ -0,0 +1,468 @@
+#include <algorithm>
+#include "rd_parser.hpp"
+#include "scanner.hpp"
+#include "tokens.hpp"
+
+namespace drewgon{
+
+//Binding powers of the binary operators, from drewgon.yy's
+// precedence declarations; 0 for anything that is not one
+static const int OR_PREC = 1;
+static const int AND_PREC = 2;
+static const int REL_PREC = 3;
+static const int ADD_PREC = 4;
+static const int MUL_PREC = 5;
+static const int NOT_PREC = 6;
+
+static int binaryPrec(int kind){
+	switch (kind){
+	case TokenKind::OR: return OR_PREC;
+	case TokenKind::AND: return AND_PREC;
+	case TokenKind::LESS:
+	case TokenKind::GREATER:
+	case TokenKind::LESSEQ:
+	case TokenKind::GREATEREQ:
+	case TokenKind::EQUALS:
+	case TokenKind::NOTEQUALS:
+		return REL_PREC;
+	case TokenKind::PLUS:
+	case TokenKind::MINUS:
+		return ADD_PREC;
+	case TokenKind::TIMES:
+	case TokenKind::DIVIDE:
+		return MUL_PREC;
+	default:
+		return 0;
+	}
+}
+
+static bool startsExp(int kind){
+	switch (kind){
+	case TokenKind::ID:
+	case TokenKind::INTLITERAL:
+	case TokenKind::STRINGLITERAL:
+	case TokenKind::TRUE:
+	case TokenKind::FALSE:
+	case TokenKind::LPAREN:
+	case TokenKind::MAYHEM:
+	case TokenKind::NOT:
+	case TokenKind::MINUS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//A token's name as bison's messages give it
+static std::string tokenName(int kind){
+	if (kind == TokenKind::END){ return "end file"; }
+	return tokenKindString(kind);
+}
+
+RDParser::Nest::Nest(RDParser * parserIn) : parser(parserIn){
+	if (++parser->depth > MAX_DEPTH){
+		parser->fail("syntax error, nesting too deep");
+	}
+}
+
+int RDParser::parse(){
+	try {
+		size_t globals = ast->openList();
+		while (peek() != TokenKind::END){
+			ast->add(global());
+		}
+		*root = ast->make<ProgramNode>(ast->closeList<DeclNode>(globals));
+		return 0;
+	} catch (Abort&) {
+		return 1;
+	}
+}
+
+bool RDParser::parseBody(const LazyBody * body, Span<StmtNode *>& stmts){
+	ASTBuilder builder(body->arena);
+	RDParser parser(body->tokens, &builder);
+	try {
+		size_t list = parser.stmtList();
+		parser.expect(TokenKind::RCURLY);
+		stmts = builder.closeList<StmtNode>(list);
+		return true;
+	} catch (Abort&) {
+		return false;
+	}
+}
+
+int RDParser::peek(){
+	if (haveNext){ return nextKind; }
+	haveNext = true;
+	if (scanner != nullptr){
+		nextKind = scanner->lex(&lval);
+	} else if (stored != storedEnd){
+		lval.lexeme = *stored++;
+		nextKind = lval.lexeme->kind();
+	} else {
+		lval.lexeme = nullptr;
+		nextKind = TokenKind::END;
+	}
+	return nextKind;
+}
+
+Token * RDParser::take(){
+	peek();
+	haveNext = false;
+	return lval.lexeme;
+}
+
+Token * RDParser::expect(int kind){
+	if (peek() != kind){ unexpected(kind); }
+	return take();
+}
+
+void RDParser::unexpected(){
+	fail("syntax error, unexpected " + tokenName(peek()));
+}
+
+void RDParser::unexpected(int expected){
+	fail("syntax error, unexpected " + tokenName(peek())
+	  + ", expecting " + tokenName(expected));
+}
+
+void RDParser::fail(const std::string& msg){
+	Report::messages() << msg << std::endl;
+	Report::diagnostics() << "syntax error" << std::endl;
+	throw Abort();
+}
+
+DeclNode * RDParser::global(){
+	TypeNode * declType = type();
+	IDNode * name = id();
+	if (peek() == TokenKind::LPAREN){ return fnDecl(declType, name); }
+	expect(TokenKind::SEMICOL);
+	Position p(declType->pos(), name->pos());
+	return ast->make<VarDeclNode>(&p, declType, name);
+}
+
+TypeNode * RDParser::type(){
+	Nest nest(this);
+	switch (peek()){
+	case TokenKind::INT: return ast->make<IntTypeNode>(take()->pos());
+	case TokenKind::BOOL: return ast->make<BoolTypeNode>(take()->pos());
+	case TokenKind::VOID: return ast->make<VoidTypeNode>(take()->pos());
+	case TokenKind::FN: break;
+	default: unexpected();
+	}
+	take();
+	Token * lparen = expect(TokenKind::LPAREN);
+	Span<TypeNode *> inTypes;
+	if (peek() == TokenKind::RPAREN){
+		take();
+	} else {
+		size_t list = ast->openList();
+		ast->add(type());
+		while (peek() == TokenKind::COMMA){
+			take();
+			ast->add(type());
+		}
+		expect(TokenKind::RPAREN);
+		inTypes = ast->closeList<TypeNode>(list);
+	}
+	expect(TokenKind::ARROW);
+	TypeNode * outType = type();
+	Position p(lparen->pos(), outType->pos());
+	return ast->make<FnTypeNode>(&p, inTypes, outType);
+}
+
+IDNode * RDParser::id(){
+	IDToken * tok = static_cast<IDToken *>(expect(TokenKind::ID));
+	return ast->make<IDNode>(tok->pos(), tok->id());
+}
+
+FnDeclNode * RDParser::fnDecl(TypeNode * retType, IDNode * name){
+	expect(TokenKind::LPAREN);
+	Span<FormalDeclNode *> formals;
+	if (peek() == TokenKind::RPAREN){
+		take();
+	} else {
+		size_t list = ast->openList();
+		while (true){
+			TypeNode * formalType = type();
+			IDNode * formalName = id();
+			Position p(formalType->pos(), formalName->pos());
+			ast->add(ast->make<FormalDeclNode>(&p, formalType, formalName));
+			if (peek() != TokenKind::COMMA){ break; }
+			take();
+		}
+		expect(TokenKind::RPAREN);
+		formals = ast->closeList<FormalDeclNode>(list);
+	}
+	expect(TokenKind::LCURLY);
+	if (lazyBodies){
+		LazyBody * lazy = skipBody();
+		Position p(retType->pos(), lazy->tokens.back()->pos());
+		FnDeclNode * fn = ast->make<FnDeclNode>(&p, retType, name, formals,
+		  Span<StmtNode *>());
+		fn->deferBody(lazy);
+		return fn;
+	}
+	size_t body = stmtList();
+	Token * rcurly = expect(TokenKind::RCURLY);
+	Position p(retType->pos(), rcurly->pos());
+	return ast->make<FnDeclNode>(&p, retType, name, formals,
+	  ast->closeList<StmtNode>(body));
+}
+
+LazyBody * RDParser::skipBody(){
+	skipped.clear();
+	size_t open = 1;
+	while (open > 0){
+		switch (peek()){
+		case TokenKind::END: unexpected();
+		case TokenKind::LCURLY: open++; break;
+		case TokenKind::RCURLY: open--; break;
+		default: break;
+		}
+		skipped.push_back(take());
+	}
+	Arena * arena = ast->getArena();
+	Token ** tokens = static_cast<Token **>(
+	  arena->allocate(skipped.size() * sizeof(Token *), alignof(Token *)));
+	std::copy(skipped.begin(), skipped.end(), tokens);
+	return arena->make<LazyBody>(Span<Token *>(tokens, skipped.size()), arena);
+}
+
+size_t RDParser::stmtList(){
+	Nest nest(this);
+	size_t list = ast->openList();
+	while (peek() != TokenKind::RCURLY){
+		switch (peek()){
+		case TokenKind::WHILE:
+		case TokenKind::FOR:
+		case TokenKind::IF:
+			ast->add(blockStmt());
+			break;
+		default:
+			ast->add(stmt());
+			expect(TokenKind::SEMICOL);
+		}
+	}
+	return list;
+}
+
+StmtNode * RDParser::blockStmt(){
+	Token * keyword = take();
+	int kind = keyword->kind();
+	expect(TokenKind::LPAREN);
+	StmtNode * init = nullptr;
+	StmtNode * itr = nullptr;
+	ExpNode * cond;
+	if (kind == TokenKind::FOR){
+		init = stmt();
+		expect(TokenKind::SEMICOL);
+		cond = exp(OR_PREC);
+		expect(TokenKind::SEMICOL);
+		itr = stmt();
+	} else {
+		cond = exp(OR_PREC);
+	}
+	expect(TokenKind::RPAREN);
+	expect(TokenKind::LCURLY);
+	size_t body = stmtList();
+	Token * rcurly = expect(TokenKind::RCURLY);
+
+	if (kind == TokenKind::IF && peek() == TokenKind::ELSE){
+		take();
+		expect(TokenKind::LCURLY);
+		size_t elseBody = stmtList();
+		rcurly = expect(TokenKind::RCURLY);
+		Position p(keyword->pos(), rcurly->pos());
+		Span<StmtNode *> bodyFalse = ast->closeList<StmtNode>(elseBody);
+		Span<StmtNode *> bodyTrue = ast->closeList<StmtNode>(body);
+		return ast->make<IfElseStmtNode>(&p, cond, bodyTrue, bodyFalse);
+	}
+
+	Position p(keyword->pos(), rcurly->pos());
+	Span<StmtNode *> stmts = ast->closeList<StmtNode>(body);
+	if (kind == TokenKind::WHILE){
+		return ast->make<WhileStmtNode>(&p, cond, stmts);
+	} else if (kind == TokenKind::FOR){
+		return ast->make<ForStmtNode>(&p, init, cond, itr, stmts);
+	}
+	return ast->make<IfStmtNode>(&p, cond, stmts);
+}
+
+StmtNode * RDParser::stmt(){
+	switch (peek()){
+	case TokenKind::INT:
+	case TokenKind::BOOL:
+	case TokenKind::VOID:
+	case TokenKind::FN: {
+		TypeNode * declType = type();
+		IDNode * name = id();
+		Position p(declType->pos(), name->pos());
+		return ast->make<VarDeclNode>(&p, declType, name);
+	}
+	case TokenKind::ID: {
+		IDNode * name = id();
+		switch (peek()){
+		case TokenKind::ASSIGN: {
+			take();
+			ExpNode * src = exp(OR_PREC);
+			Position p(name->pos(), src->pos());
+			AssignExpNode * assign = ast->make<AssignExpNode>(&p, name, src);
+			return ast->make<AssignStmtNode>(assign->pos(), assign);
+		}
+		case TokenKind::POSTDEC: {
+			Position p(name->pos(), take()->pos());
+			return ast->make<PostDecStmtNode>(&p, name);
+		}
+		case TokenKind::POSTINC: {
+			Position p(name->pos(), take()->pos());
+			return ast->make<PostIncStmtNode>(&p, name);
+		}
+		case TokenKind::LPAREN: {
+			CallExpNode * call = callExp(name);
+			return ast->make<CallStmtNode>(call->pos(), call);
+		}
+		default:
+			unexpected();
+		}
+	}
+	case TokenKind::INPUT: {
+		Token * input = take();
+		IDNode * dst = id();
+		Position p(input->pos(), dst->pos());
+		return ast->make<InputStmtNode>(&p, dst);
+	}
+	case TokenKind::OUTPUT: {
+		Token * output = take();
+		ExpNode * src = exp(OR_PREC);
+		Position p(output->pos(), src->pos());
+		return ast->make<OutputStmtNode>(&p, src);
+	}
+	case TokenKind::RETURN: {
+		Token * ret = take();
+		if (!startsExp(peek())){
+			return ast->make<ReturnStmtNode>(ret->pos(), nullptr);
+		}
+		ExpNode * val = exp(OR_PREC);
+		Position p(ret->pos(), val->pos());
+		return ast->make<ReturnStmtNode>(&p, val);
+	}
+	default:
+		unexpected();
+	}
+}
+
+//Operators binding at least as tightly as minPrec are taken into
+// the expression; the rest are left for the caller
+ExpNode * RDParser::exp(int minPrec){
+	Nest nest(this);
+	ExpNode * lhs = prefix();
+	while (true){
+		int prec = binaryPrec(peek());
+		if (prec == 0 || prec < minPrec){ return lhs; }
+		int op = take()->kind();
+		ExpNode * rhs = exp(prec + 1);
+		Position p(lhs->pos(), rhs->pos());
+		switch (op){
+		case TokenKind::OR: lhs = ast->make<OrNode>(&p, lhs, rhs); break;
+		case TokenKind::AND: lhs = ast->make<AndNode>(&p, lhs, rhs); break;
+		case TokenKind::LESS: lhs = ast->make<LessNode>(&p, lhs, rhs); break;
+		case TokenKind::GREATER: lhs = ast->make<GreaterNode>(&p, lhs, rhs); break;
+		case TokenKind::LESSEQ: lhs = ast->make<LessEqNode>(&p, lhs, rhs); break;
+		case TokenKind::GREATEREQ:
+			lhs = ast->make<GreaterEqNode>(&p, lhs, rhs);
+			break;
+		case TokenKind::EQUALS: lhs = ast->make<EqualsNode>(&p, lhs, rhs); break;
+		case TokenKind::NOTEQUALS:
+			lhs = ast->make<NotEqualsNode>(&p, lhs, rhs);
+			break;
+		case TokenKind::PLUS: lhs = ast->make<PlusNode>(&p, lhs, rhs); break;
+		case TokenKind::MINUS: lhs = ast->make<MinusNode>(&p, lhs, rhs); break;
+		case TokenKind::TIMES: lhs = ast->make<TimesNode>(&p, lhs, rhs); break;
+		default: lhs = ast->make<DivideNode>(&p, lhs, rhs); break;
+		}
+		//The relational operators do not chain
+		if (prec == REL_PREC && binaryPrec(peek()) == REL_PREC){
+			unexpected();
+		}
+	}
+}
+
+ExpNode * RDParser::prefix(){
+	switch (peek()){
+	case TokenKind::NOT: {
+		Token * op = take();
+		ExpNode * operand = exp(NOT_PREC);
+		Position p(op->pos(), operand->pos());
+		return ast->make<NotNode>(&p, operand);
+	}
+	case TokenKind::MINUS: {
+		Token * op = take();
+		ExpNode * operand = term();
+		Position p(op->pos(), operand->pos());
+		return ast->make<NegNode>(&p, operand);
+	}
+	case TokenKind::ID:
+		return idExp(true);
+	default:
+		return term();
+	}
+}
+
+ExpNode * RDParser::term(){
+	switch (peek()){
+	case TokenKind::ID:
+		return idExp(false);
+	case TokenKind::INTLITERAL: {
+		IntLitToken * lit = static_cast<IntLitToken *>(take());
+		return ast->make<IntLitNode>(lit->pos(), lit->num());
+	}
+	case TokenKind::STRINGLITERAL: {
+		StrToken * lit = static_cast<StrToken *>(take());
+		return ast->make<StrLitNode>(lit->pos(), lit->text(), lit->length());
+	}
+	case TokenKind::TRUE: return ast->make<TrueNode>(take()->pos());
+	case TokenKind::FALSE: return ast->make<FalseNode>(take()->pos());
+	case TokenKind::MAYHEM: return ast->make<MayhemNode>(take()->pos());
+	case TokenKind::LPAREN: {
+		take();
+		ExpNode * inner = exp(OR_PREC);
+		expect(TokenKind::RPAREN);
+		return inner;
+	}
+	default:
+		unexpected();
+	}
+}
+
+//An id, a call, or (if assignable) an assignment to the id
+ExpNode * RDParser::idExp(bool assignable){
+	IDNode * name = id();
+	if (peek() == TokenKind::LPAREN){ return callExp(name); }
+	if (assignable && peek() == TokenKind::ASSIGN){
+		take();
+		ExpNode * src = exp(OR_PREC);
+		Position p(name->pos(), src->pos());
+		return ast->make<AssignExpNode>(&p, name, src);
+	}
+	return name;
+}
+
+CallExpNode * RDParser::callExp(IDNode * callee){
+	expect(TokenKind::LPAREN);
+	Span<ExpNode *> args;
+	if (peek() != TokenKind::RPAREN){
+		size_t list = ast->openList();
+		ast->add(exp(OR_PREC));
+		while (peek() == TokenKind::COMMA){
+			take();
+			ast->add(exp(OR_PREC));
+		}
+		args = ast->closeList<ExpNode>(list);
+	}
+	Token * rparen = expect(TokenKind::RPAREN);
+	Position p(callee->pos(), rparen->pos());
+	return ast->make<CallExpNode>(&p, callee, args);
+}
+
+}
@@ -0,0 +1,133 @@
+#ifndef DREWGON_RD_PARSER_HPP
+#define DREWGON_RD_PARSER_HPP
+
+#include "grammar.hh"
+#include "ast.hpp"
+
+// A hand-written parser for the grammar in drewgon.yy, which can
+// be used in place of the one bison generates from it. Statements
+// and declarations are parsed by recursive descent, and
+// expressions by precedence climbing (Pratt parsing), using the
+// same precedence and associativity as drewgon.yy declares:
+//
+//   ASSIGN                    lowest, right
+//   OR                        left
+//   AND                       left
+//   LESS ... NOTEQUALS        non-associative
+//   PLUS MINUS                left
+//   TIMES DIVIDE              left
+//   NOT                       highest
+//
+// An assignment is an id followed by ASSIGN, wherever an expression
+// may begin with one (so a + b = c is a + (b = c), as bison shifts
+// the ASSIGN there), and a unary minus applies only to a term.
+//
+// It accepts exactly the programs the bison parser does, and builds
+// the same AST, with the same positions, through the same
+// ASTBuilder. Syntax errors are reported in the same way, naming
+// the unexpected token; the tokens listed as expected may differ,
+// since bison's list depends on the state its tables happen to be
+// in. Nesting deeper than MAX_DEPTH is reported as an error rather
+// than left to overflow the stack.
+//
+// It can also leave function bodies unparsed: each body's tokens
+// (found by matching braces) are kept, and its statements are
+// parsed from them only when the body is first asked for (see
+// FnDeclNode::body). A pass that looks only at the globals and
+// function signatures, such as -p, then costs little more than
+// scanning. A syntax error in a body is reported only once the body
+// is parsed, if it ever is.
+
+namespace drewgon{
+
+class Scanner;
+class Token;
+
+//The tokens of a function body that is yet to be parsed, from
+// just after its LCURLY up to and including its RCURLY
+class LazyBody{
+public:
+	LazyBody(Span<Token *> tokensIn, Arena * arenaIn)
+	: tokens(tokensIn), arena(arenaIn){ }
+	Span<Token *> tokens;
+	//Where the body's nodes are to be made
+	Arena * arena;
+};
+
+class RDParser{
+public:
+	//If lazyBodiesIn is set, function bodies are left unparsed
+	RDParser(Scanner& scannerIn, ProgramNode ** rootIn, ASTBuilder * astIn,
+	  bool lazyBodiesIn = false)
+	: scanner(&scannerIn), root(rootIn), ast(astIn),
+	  lazyBodies(lazyBodiesIn){ }
+
+	//As Parser::parse: 0 once *root is set, or 1 after a syntax
+	// error has been reported
+	int parse();
+
+	//Parse a body left by a lazy parse into stmts. Returns false
+	// after reporting a syntax error.
+	static bool parseBody(const LazyBody * body, Span<StmtNode *>& stmts);
+private:
+	//Parses from tokens already scanned, rather than a Scanner
+	RDParser(const Span<Token *>& tokensIn, ASTBuilder * astIn)
+	: scanner(nullptr), root(nullptr), ast(astIn), lazyBodies(false),
+	  stored(tokensIn.begin()), storedEnd(tokensIn.end()){ }
+
+	static const unsigned int MAX_DEPTH = 4096;
+
+	//Thrown (by value) to abandon the parse once an error has
+	// been reported
+	class Abort{ };
+
+	//The kind of the next token, which is read only when it is
+	// first asked for, as bison reads its lookahead
+	int peek();
+	Token * take();
+	Token * expect(int kind);
+	[[noreturn]] void unexpected();
+	[[noreturn]] void unexpected(int expected);
+	[[noreturn]] void fail(const std::string& msg);
+
+	//Raises the nesting depth for as long as it lives
+	class Nest{
+	public:
+		Nest(RDParser * parserIn);
+		~Nest(){ parser->depth--; }
+	private:
+		RDParser * parser;
+	};
+
+	DeclNode * global();
+	TypeNode * type();
+	IDNode * id();
+	FnDeclNode * fnDecl(TypeNode * retType, IDNode * name);
+	//Keep the tokens of a body, up to its RCURLY, for later
+	LazyBody * skipBody();
+	size_t stmtList();
+	StmtNode * blockStmt();
+	StmtNode * stmt();
+	ExpNode * exp(int minPrec);
+	ExpNode * prefix();
+	ExpNode * term();
+	ExpNode * idExp(bool assignable);
+	CallExpNode * callExp(IDNode * callee);
+
+	Scanner * scanner;
+	ProgramNode ** root;
+	ASTBuilder * ast;
+	const bool lazyBodies;
+	//The tokens of the body being skipped
+	std::vector<Token *> skipped;
+	Token ** stored = nullptr;
+	Token ** storedEnd = nullptr;
+	Parser::semantic_type lval;
+	int nextKind = 0;
+	bool haveNext = false;
+	unsigned int depth = 0;
+};
+
+}
+
+#endif
@@ -1,25 +1,118 @@
+#include <climits>
 #include <fstream>
 #include "scanner.hpp"
+#include "token_stream.hpp"
+#include "parallel_scanner.hpp"
+#include "pipelined_scanner.hpp"
 
 using namespace drewgon;
 
 using TokenKind = drewgon::Parser::token;
 using Lexeme = drewgon::Parser::semantic_type;
 
+Scanner::Scanner(const SourceFile * srcIn, Arena * arenaIn,
+  bool handWrittenIn, unsigned int threads, bool pipelined)
+: yyFlexLexer(nullptr), src(srcIn), arena(arenaIn),
+  textEnd(srcIn->size()), handWritten(handWrittenIn), simd(simdLevel())
+{
+	//Every offset (and the end) must fit in a SourceLoc
+	if (src->size() >= UINT32_MAX){
+		throw new InternalError("Input files must be smaller than 4 GB");
+	}
+	if (TokenReader::recognizes(src)){
+		replay = new TokenReader(src, arena);
+		return;
+	}
+	if (pipelined){
+		pipeline = new PipelinedScanner(src, arena, handWritten, threads);
+		return;
+	}
+	size_t chunks = ParallelScanner::numChunks(src, threads);
+	if (chunks > 1){
+		parallel = new ParallelScanner(src, arena, handWritten, chunks);
+	}
+}
+
+Scanner::Scanner(const SourceFile * srcIn, size_t begin, size_t end,
+  Arena * arenaIn, bool handWrittenIn)
+: yyFlexLexer(nullptr), src(srcIn), arena(arenaIn), textEnd(end),
+  readPos(begin), tokenStart(begin), tokenEnd(begin),
+  handWritten(handWrittenIn), simd(simdLevel()), scanPos(begin)
+{
+}
+
+Scanner::~Scanner(){
+	delete replay;
+	delete parallel;
+	delete pipeline;
+}
+
+int Scanner::replayNext(Lexeme * const lval){
+	return replay->next(lval);
+}
+
+int Scanner::parallelNext(Lexeme * const lval){
+	return parallel->next(lval, this);
+}
+
+int Scanner::pipelineNext(Lexeme * const lval){
+	return pipeline->next(lval, this);
+}
+
+SourceLoc Scanner::endLoc() const{
+	if (replay != nullptr){ return replay->endLoc(); }
+	return static_cast<SourceLoc>(textEnd);
+}
+
+void Scanner::reportError(Position * pos, const std::string& msg){
+	errors++;
+	Report::fatal(pos, msg);
+	if (recorder != nullptr){ recorder->error(pos, msg); }
+}
+
 void Scanner::outputTokens(std::ostream& outstream){
 	Lexeme lex;
 	int tokenKind;
 	while(true){
-		tokenKind = this->yylex(&lex);
+		tokenKind = this->next(&lex);
 		if (tokenKind == TokenKind::END){
-			outstream << "EOF"
-			  << " [" << this->lineNum
-			  << "," << this->colNum << "]"
-			  << std::endl;
+			outstream << "EOF "
+			  << Position(endLoc(), endLoc()).begin()
+			  << "\n";
 			return;
 		} else {
 			outstream << lex.lexeme->toString()
-			  << std::endl;
+			  << "\n";
 		}
 	}
 }
+
+void Scanner::outputBinaryTokens(std::ostream& outstream){
+	TokenWriter writer(outstream, src->lines());
+	recorder = &writer;
+	Lexeme lex;
+	while (this->next(&lex) != TokenKind::END){
+		writer.token(lex.lexeme);
+	}
+	writer.end(endLoc());
+	recorder = nullptr;
+}
+
+int Scanner::intLiteral(const char * digits, size_t len, bool& overflow){
+	//Leading zeros don't count towards the value's length
+	size_t i = 0;
+	while (i < len && digits[i] == '0'){ i++; }
+	if (len - i > 10){
+		overflow = true;
+		return 0;
+	}
+	uint64_t val = 0;
+	for (; i < len; i++){
+		val = val * 10 + static_cast<uint64_t>(digits[i] - '0');
+	}
+	if (val > INT_MAX){
+		overflow = true;
+		return 0;
+	}
+	return static_cast<int>(val);
+}
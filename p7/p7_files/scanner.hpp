@@ -5,23 +5,40 @@
 #include <FlexLexer.h>
 #endif
 
+#include <cstring>
 #include "grammar.hh"
 #include "errors.hpp"
+#include "timing.hpp"
+#include "source.hpp"
+#include "arena.hpp"
 
 using TokenKind = drewgon::Parser::token;
 
 namespace drewgon{
 
+class TokenReader;
+class TokenWriter;
+class ParallelScanner;
+class PipelinedScanner;
+
 class Scanner : public yyFlexLexer{
 public:
 
-   Scanner(std::istream *in) : yyFlexLexer(in)
-   {
-	lineNum = 1;
-	colNum = 1;
-   };
-   virtual ~Scanner() {
-   };
+   // The scanner reads straight out of the source's text,
+   // which must outlive every token it produces. The tokens
+   // (and their positions) are allocated in arenaIn, so they
+   // last as long as it does. Tokens come from the flex scanner
+   // unless handWrittenIn is set, in which case they come from
+   // the (equivalent) hand-written one. If the source is a
+   // binary token stream (see token_stream.hpp) rather than
+   // program text, its tokens are replayed instead. A large
+   // source is split and scanned on up to threads threads (see
+   // parallel_scanner.hpp). If pipelined is set, the scanning is
+   // done on a thread of its own (see pipelined_scanner.hpp).
+   Scanner(const SourceFile * srcIn, Arena * arenaIn,
+     bool handWrittenIn = false, unsigned int threads = 1,
+     bool pipelined = false);
+   virtual ~Scanner();
 
    //get rid of override virtual function warning
    using FlexLexer::yylex;
@@ -29,48 +46,176 @@ public:
    // YY_DECL defined in the flex drewgon.l
    virtual int yylex( drewgon::Parser::semantic_type * const lval);
 
+   // The hand-written scanner, in hand_scanner.cpp. It has the
+   // same contract as yylex, and produces the same tokens,
+   // positions and errors.
+   int scan( drewgon::Parser::semantic_type * const lval);
+
+   // The next token from whichever scanner is in use
+   int next( drewgon::Parser::semantic_type * const lval){
+	if (replay != nullptr){ return replayNext(lval); }
+	if (parallel != nullptr){ return parallelNext(lval); }
+	if (pipeline != nullptr){ return pipelineNext(lval); }
+	return handWritten ? scan(lval) : yylex(lval);
+   }
+
+   // The parser's entry point into the scanner. When timing
+   // is on, the time spent scanning is added up per token.
+   int lex( drewgon::Parser::semantic_type * const lval){
+	TimingTrack * track = TimingTrack::current();
+	if (track == nullptr){ return next(lval); }
+	uint64_t start = TimingTrack::wallNow();
+	int tokenKind = next(lval);
+	track->accumulate("scan", TimingTrack::wallNow() - start);
+	return tokenKind;
+   }
+
+   // How many lexical errors have been reported so far
+   size_t numErrors() const { return errors; }
+
+   // Hand flex the next part of the source
+   virtual int LexerInput(char * buf, int maxSize) override{
+	size_t len = textEnd - readPos;
+	if (len > static_cast<size_t>(maxSize)){
+		len = static_cast<size_t>(maxSize);
+	}
+	memcpy(buf, src->data() + readPos, len);
+	readPos += len;
+	return static_cast<int>(len);
+   }
+
+   // Where the current match begins in the source. Every
+   // character of the input is matched by some rule, so
+   // this stays in step with flex's own buffer.
+   const char * tokenText() const{
+	return src->data() + tokenStart;
+   }
+
+   void advanceToken(int len){
+	tokenStart = tokenEnd;
+	tokenEnd += static_cast<size_t>(len);
+   }
+
+   // Where the len characters of the current match are
+   Position matchPos(size_t len) const{
+	SourceLoc begin = static_cast<SourceLoc>(tokenStart);
+	return Position(begin, begin + static_cast<SourceLoc>(len));
+   }
+
    int makeBareToken(int tagIn){
-	size_t len = static_cast<size_t>(yyleng);
-	Position * pos = new Position(
-	  this->lineNum, this->colNum,
-	  this->lineNum, this->colNum+len);
-        this->yylval->lexeme = new Token(pos, tagIn);
-        colNum += len;
+	return makeBareToken(tagIn, static_cast<size_t>(yyleng));
+   }
+
+   // Each of these makes the token for the first len characters
+   // of the current match
+   int makeBareToken(int tagIn, size_t len){
+        this->yylval->lexeme = arena->make<Token>(matchPos(len), tagIn);
         return tagIn;
    }
 
+   int makeIDToken(const char * text, size_t len){
+	yylval->transToken = arena->make<IDToken>(matchPos(len), text, len);
+	return TokenKind::ID;
+   }
+
+   int makeStrToken(const char * text, size_t len){
+	yylval->transToken = arena->make<StrToken>(matchPos(len), text, len);
+	return TokenKind::STRINGLITERAL;
+   }
+
+   int makeIntToken(const char * digits, size_t len){
+	bool overflow = false;
+	int intVal = intLiteral(digits, len, overflow);
+	Position pos = matchPos(len);
+	if (overflow){ errIntOverflow(&pos); }
+	yylval->transToken = arena->make<IntLitToken>(pos, intVal);
+	return TokenKind::INTLITERAL;
+   }
+
+   // The value of a run of decimal digits, or 0 (with overflow
+   // set) if it is too big for an int
+   static int intLiteral(const char * digits, size_t len, bool& overflow);
+
+   // Report a lexical error, and record it in the binary token
+   // stream if one is being written
+   virtual void reportError(Position * pos, const std::string& msg);
+
    void errIllegal(Position * pos, std::string match){
-	drewgon::Report::fatal(pos,
+	reportError(pos,
 	"Illegal character " + match);
    }
 
    void errStrEsc(Position * pos){
-	drewgon::Report::fatal(pos,
+	reportError(pos,
 	"String literal with bad escape sequence detected");
    }
 
    void errStrUnterm(Position * pos){
-	drewgon::Report::fatal(pos,
+	reportError(pos,
 	"Unterminated string literal detected");
    }
 
    void errStrEscAndUnterm(Position * pos){
-	drewgon::Report::fatal(pos,
+	reportError(pos,
 	"Unterminated string literal with bad escape sequence detected");
    }
 
    void errIntOverflow(Position * pos){
-	drewgon::Report::fatal(pos, "Integer literal overflow");
+	reportError(pos, "Integer literal overflow");
    }
 
    static std::string tokenKindString(int tokenKind);
 
+   // The widest vector instructions the hand-written scanner
+   // uses: by default, the widest the CPU supports
+   enum SimdLevel{ SCALAR, SSE2, AVX2 };
+   static SimdLevel simdLevel();
+   static const char * simdName(SimdLevel level);
+   // Use no wider than level from now on (for benchmarking).
+   // Scanners that already exist are unaffected.
+   static void limitSimd(SimdLevel level);
+
    void outputTokens(std::ostream& outstream);
+   // The same tokens (and lexical errors) in the binary format
+   void outputBinaryTokens(std::ostream& outstream);
+
+protected:
+   // Scans only the text from begin up to end, which starts
+   // just after a newline (one chunk of a parallel scan). The
+   // text is never replayed as a token stream.
+   Scanner(const SourceFile * srcIn, size_t begin, size_t end,
+     Arena * arenaIn, bool handWrittenIn);
 
 private:
    drewgon::Parser::semantic_type *yylval = nullptr;
-   size_t lineNum;
-   size_t colNum;
+   const SourceFile * src;
+   Arena * arena;
+   size_t textEnd;
+   size_t readPos = 0;
+   size_t tokenStart = 0;
+   size_t tokenEnd = 0;
+   size_t errors = 0;
+   // Where the END token is
+   SourceLoc endLoc() const;
+
+   // Used by the hand-written scanner
+   int scanString(const char * quote, const char * end);
+   const bool handWritten;
+   const SimdLevel simd;
+   size_t scanPos = 0;
+
+   // Set when replaying a token stream, or writing one
+   int replayNext( drewgon::Parser::semantic_type * const lval);
+   TokenReader * replay = nullptr;
+   TokenWriter * recorder = nullptr;
+
+   // Set when the source is scanned in parallel
+   int parallelNext( drewgon::Parser::semantic_type * const lval);
+   ParallelScanner * parallel = nullptr;
+
+   // Set when scanning on a thread of its own
+   int pipelineNext( drewgon::Parser::semantic_type * const lval);
+   PipelinedScanner * pipeline = nullptr;
 };
 
 } /* end namespace */
@@ -0,0 +1,283 @@
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "server.hpp"
+#include "errors.hpp"
+
+namespace drewgon{
+
+//Requests larger than this are rejected rather than buffered
+static const uint32_t MAX_REQUEST_STRINGS = 4096;
+static const uint32_t MAX_REQUEST_STRING_LEN = 1 << 20;
+
+static void putU32(unsigned char * out, uint32_t val){
+	out[0] = static_cast<unsigned char>(val >> 24);
+	out[1] = static_cast<unsigned char>(val >> 16);
+	out[2] = static_cast<unsigned char>(val >> 8);
+	out[3] = static_cast<unsigned char>(val);
+}
+
+static uint32_t getU32(const unsigned char * in){
+	return static_cast<uint32_t>(in[0]) << 24
+	  | static_cast<uint32_t>(in[1]) << 16
+	  | static_cast<uint32_t>(in[2]) << 8
+	  | static_cast<uint32_t>(in[3]);
+}
+
+static bool writeAll(int fd, const void * data, size_t len){
+	const char * bytes = static_cast<const char *>(data);
+	while (len > 0){
+		ssize_t sent = send(fd, bytes, len, MSG_NOSIGNAL);
+		if (sent < 0){
+			if (errno == EINTR){ continue; }
+			return false;
+		}
+		bytes += sent;
+		len -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+static bool readAll(int fd, void * data, size_t len){
+	char * bytes = static_cast<char *>(data);
+	while (len > 0){
+		ssize_t got = read(fd, bytes, len);
+		if (got < 0){
+			if (errno == EINTR){ continue; }
+			return false;
+		}
+		if (got == 0){ return false; }
+		bytes += got;
+		len -= static_cast<size_t>(got);
+	}
+	return true;
+}
+
+static bool readU32(int fd, uint32_t& val){
+	unsigned char buf[4];
+	if (!readAll(fd, buf, 4)){ return false; }
+	val = getU32(buf);
+	return true;
+}
+
+static bool writeU32(int fd, uint32_t val){
+	unsigned char buf[4];
+	putU32(buf, val);
+	return writeAll(fd, buf, 4);
+}
+
+static bool sendFrame(int fd, char tag, const char * data, size_t len){
+	unsigned char header[5];
+	header[0] = static_cast<unsigned char>(tag);
+	putU32(header + 1, static_cast<uint32_t>(len));
+	return writeAll(fd, header, 5) && writeAll(fd, data, len);
+}
+
+//A streambuf that sends whatever is written to it to the
+// client as frames with the given tag. Output is buffered
+// and sent whenever the buffer fills or the stream is flushed,
+// so the client sees output as the compilation produces it.
+class FrameBuf : public std::streambuf{
+public:
+	FrameBuf(int fdIn, char tagIn) : fd(fdIn), tag(tagIn){
+		setp(buf, buf + sizeof(buf));
+	}
+protected:
+	int_type overflow(int_type ch) override{
+		if (!sendBuffered()){ return traits_type::eof(); }
+		if (!traits_type::eq_int_type(ch, traits_type::eof())){
+			*pptr() = traits_type::to_char_type(ch);
+			pbump(1);
+		}
+		return traits_type::not_eof(ch);
+	}
+	int sync() override{
+		return sendBuffered() ? 0 : -1;
+	}
+private:
+	bool sendBuffered(){
+		size_t len = static_cast<size_t>(pptr() - pbase());
+		setp(buf, buf + sizeof(buf));
+		if (len == 0){ return true; }
+		return sendFrame(fd, tag, buf, len);
+	}
+	int fd;
+	char tag;
+	char buf[8192];
+};
+
+static bool readRequest(int fd, std::vector<std::string>& strings){
+	uint32_t count;
+	if (!readU32(fd, count)){ return false; }
+	if (count == 0 || count > MAX_REQUEST_STRINGS){ return false; }
+	for (uint32_t i = 0; i < count; i++){
+		uint32_t len;
+		if (!readU32(fd, len)){ return false; }
+		if (len > MAX_REQUEST_STRING_LEN){ return false; }
+		std::string str(len, '\0');
+		if (len > 0 && !readAll(fd, &str[0], len)){ return false; }
+		strings.push_back(str);
+	}
+	return true;
+}
+
+static void serveConnection(int fd, ServerHandler handler){
+	std::vector<std::string> strings;
+	if (!readRequest(fd, strings)){
+		close(fd);
+		return;
+	}
+	std::string cwd = strings[0];
+	std::vector<std::string> args(strings.begin() + 1, strings.end());
+
+	FrameBuf outBuf(fd, 'O');
+	FrameBuf errBuf(fd, 'E');
+	std::ostream out(&outBuf);
+	std::ostream err(&errBuf);
+	Report::redirect(&err, &out);
+	int status;
+	try {
+		status = handler(args, cwd);
+	} catch (...) {
+		//One bad request shouldn't take down every other
+		// client of the server
+		err << "Compile server: request aborted\n";
+		status = 1;
+	}
+	out.flush();
+	err.flush();
+	Report::redirect(nullptr, nullptr);
+
+	unsigned char code[4];
+	putU32(code, static_cast<uint32_t>(status));
+	sendFrame(fd, 'X', reinterpret_cast<const char *>(code), 4);
+	close(fd);
+}
+
+static bool socketAddress(const char * path, struct sockaddr_un& addr){
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)){
+		std::cerr << "Socket path too long: " << path << std::endl;
+		return false;
+	}
+	strcpy(addr.sun_path, path);
+	return true;
+}
+
+int runServer(const char * socketPath, ServerHandler handler){
+	struct sockaddr_un addr;
+	if (!socketAddress(socketPath, addr)){ return 1; }
+
+	//A socket left behind by an earlier server is replaced,
+	// but never anything else that happens to be at the path
+	struct stat existing;
+	if (lstat(socketPath, &existing) == 0){
+		if (!S_ISSOCK(existing.st_mode)){
+			std::cerr << socketPath << " exists and is not a socket\n";
+			return 1;
+		}
+		unlink(socketPath);
+	}
+
+	int listenFD = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFD < 0){
+		std::cerr << "socket: " << strerror(errno) << std::endl;
+		return 1;
+	}
+	if (bind(listenFD, reinterpret_cast<struct sockaddr *>(&addr),
+	  sizeof(addr)) != 0){
+		std::cerr << "Could not bind " << socketPath << ": "
+		  << strerror(errno) << std::endl;
+		close(listenFD);
+		return 1;
+	}
+	if (listen(listenFD, SOMAXCONN) != 0){
+		std::cerr << "listen: " << strerror(errno) << std::endl;
+		close(listenFD);
+		return 1;
+	}
+
+	while (true){
+		int conn = accept(listenFD, nullptr, nullptr);
+		if (conn < 0){
+			if (errno == EINTR || errno == ECONNABORTED){ continue; }
+			std::cerr << "accept: " << strerror(errno) << std::endl;
+			close(listenFD);
+			return 1;
+		}
+		std::thread(serveConnection, conn, handler).detach();
+	}
+}
+
+int runClient(const char * socketPath,
+  const std::vector<std::string>& args){
+	struct sockaddr_un addr;
+	if (!socketAddress(socketPath, addr)){ return 1; }
+
+	char cwd[PATH_MAX];
+	if (getcwd(cwd, sizeof(cwd)) == nullptr){
+		std::cerr << "getcwd: " << strerror(errno) << std::endl;
+		return 1;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0){
+		std::cerr << "socket: " << strerror(errno) << std::endl;
+		return 1;
+	}
+	if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+	  sizeof(addr)) != 0){
+		std::cerr << "Could not connect to compile server "
+		  << socketPath << ": " << strerror(errno) << std::endl;
+		close(fd);
+		return 1;
+	}
+
+	bool sent = writeU32(fd, static_cast<uint32_t>(args.size() + 1));
+	sent = sent && writeU32(fd, static_cast<uint32_t>(strlen(cwd)));
+	sent = sent && writeAll(fd, cwd, strlen(cwd));
+	for (const std::string& arg : args){
+		sent = sent && writeU32(fd, static_cast<uint32_t>(arg.size()));
+		sent = sent && writeAll(fd, arg.data(), arg.size());
+	}
+	if (!sent){
+		std::cerr << "Could not send request to compile server\n";
+		close(fd);
+		return 1;
+	}
+
+	std::string payload;
+	while (true){
+		unsigned char header[5];
+		if (!readAll(fd, header, 5)){ break; }
+		uint32_t len = getU32(header + 1);
+		payload.resize(len);
+		if (len > 0 && !readAll(fd, &payload[0], len)){ break; }
+		std::streamsize size = static_cast<std::streamsize>(len);
+		if (header[0] == 'O'){
+			std::cout.write(payload.data(), size);
+		} else if (header[0] == 'E'){
+			std::cerr.write(payload.data(), size);
+		} else if (header[0] == 'X' && len == 4){
+			close(fd);
+			std::cout << std::flush;
+			const unsigned char * code =
+			  reinterpret_cast<const unsigned char *>(payload.data());
+			return static_cast<int>(getU32(code));
+		}
+	}
+	close(fd);
+	std::cout << std::flush;
+	std::cerr << "Compile server closed the connection\n";
+	return 1;
+}
+
+}
@@ -0,0 +1,42 @@
+#ifndef DREWGON_SERVER_HPP
+#define DREWGON_SERVER_HPP
+
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace drewgon{
+
+// Compile-server mode. A long-running dgc listens on a Unix
+// domain socket and handles each connection on its own thread,
+// so that repeated compilations skip process startup and reuse
+// the warm process (including the type flyweights).
+//
+// Wire format: the client sends a u32 count followed by that
+// many strings, each a u32 length and its bytes. The first
+// string is the client's working directory and the rest are
+// the command-line arguments. The server answers with a
+// sequence of frames, each a tag byte, a u32 length and a
+// payload: 'O' for standard output, 'E' for standard error,
+// and a final 'X' whose 4-byte payload is the exit status.
+// All integers are big-endian.
+
+//Runs one request. Its standard output and error are whatever
+// Report::messages() and Report::diagnostics() are bound to
+// when it is called.
+typedef std::function<int(const std::vector<std::string>& args,
+  const std::string& cwd)> ServerHandler;
+
+//Serve requests on socketPath until the process is killed.
+// Only returns (with a nonzero status) if the socket cannot
+// be set up.
+int runServer(const char * socketPath, ServerHandler handler);
+
+//Send args to the server at socketPath, copy its output to
+// std::cout and std::cerr, and return its exit status.
+int runClient(const char * socketPath,
+  const std::vector<std::string>& args);
+
+}
+
+#endif
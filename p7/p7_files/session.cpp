@@ -0,0 +1,223 @@
+#include "session.hpp"
+#include "scanner.hpp"
+#include "rd_parser.hpp"
+#include "token_stream.hpp"
+#include "timing.hpp"
+
+namespace drewgon{
+
+CompilationSession::CompilationSession(const char * inPathIn)
+: myInPath(inPathIn){
+}
+
+CompilationSession::~CompilationSession(){
+	if (memReport){ reportMemory(Report::diagnostics()); }
+	if (mySource != nullptr){ SourceManager::setCurrent(outerLines); }
+	delete myIR;
+	delete myTypeAnalysis;
+	delete myNameAnalysis;
+	delete mySource;
+	delete myFlatTypes;
+	delete myFlatNames;
+	delete myFlatAST;
+}
+
+void CompilationSession::reportMemory(std::ostream& out) const{
+	out << "Token arena: " << myTokenArena.bytesUsed() << " bytes used in "
+	  << myTokenArena.numChunks() << " chunks ("
+	  << myTokenArena.bytesReserved() << " bytes reserved)\n";
+	out << "AST arena: " << myASTArena.bytesUsed() << " bytes used in "
+	  << myASTArena.numChunks() << " chunks ("
+	  << myASTArena.bytesReserved() << " bytes reserved)\n";
+	if (myFlatAST != nullptr){
+		out << "Flat AST: " << myFlatAST->size() << " nodes in "
+		  << myFlatAST->bytesUsed() << " bytes\n";
+	}
+}
+
+const SourceFile * CompilationSession::source(){
+	if (mySource != nullptr){ return mySource; }
+	mySource = SourceFile::open(myInPath);
+	if (mySource == nullptr){
+		std::string msg = "Bad input stream ";
+		msg += myInPath;
+		throw new InternalError(msg.c_str());
+	}
+	//Positions reported from here on are in this file
+	outerLines = SourceManager::setCurrent(mySource->lines());
+	return mySource;
+}
+
+ProgramNode * CompilationSession::parse(){
+	if (parsed){ return myAST; }
+	parsed = true;
+
+	if (FlatAST * cached = cachedAST()){
+		PhaseTimer timer("rebuild AST");
+		ASTBuilder builder(&myASTArena);
+		myAST = cached->toAST(&builder);
+		return myAST;
+	}
+
+	bool cleanScan = false;
+	myAST = parseSource(cleanScan);
+	if (myAST != nullptr && cleanScan && astCache != nullptr){
+		storeAST();
+	}
+	return myAST;
+}
+
+ProgramNode * CompilationSession::parseSource(bool& cleanScan){
+	//This pointer will be set to the root of the
+	// AST after parsing
+	ProgramNode * root = nullptr;
+
+	Scanner scanner(source(), &myTokenArena, myFastScan, myLexThreads,
+	  myPipeline);
+	ASTBuilder builder(&myASTArena);
+
+	PhaseTimer timer("parse");
+	int errCode;
+	if (myRDParse || myLazyBodies){
+		RDParser parser(scanner, &root, &builder, myLazyBodies);
+		errCode = parser.parse();
+	} else {
+		Parser parser(scanner, &root, &builder);
+		errCode = parser.parse();
+	}
+	if (errCode != 0){ return nullptr; }
+	cleanScan = scanner.numErrors() == 0;
+	return root;
+}
+
+FlatAST * CompilationSession::cachedAST(){
+	if (cacheChecked){ return fromCache ? myFlatAST : nullptr; }
+	cacheChecked = true;
+	//A replayed token stream has its lines found as it is
+	// scanned, so it isn't cached
+	const SourceFile * src = source();
+	if (astCache == nullptr || TokenReader::recognizes(src)){
+		astCache = nullptr;
+		return nullptr;
+	}
+
+	PhaseTimer timer("load AST");
+	myFlatAST = astCache->load(src);
+	fromCache = myFlatAST != nullptr;
+	flattened = fromCache;
+	return myFlatAST;
+}
+
+//Only a tree that scanned and parsed without errors is stored
+// (loading one reports none), so the bodies that --lazy-bodies
+// left for later are parsed first. The flat copy that is stored
+// is kept as the session's flat AST.
+void CompilationSession::storeAST(){
+	parsedAll = true;
+	if (myLazyBodies){
+		PhaseTimer timer("parse bodies");
+		if (!myAST->parseBodies()){
+			myAST = nullptr;
+			return;
+		}
+	}
+	flattened = true;
+	{
+		PhaseTimer timer("flatten AST");
+		myFlatAST = FlatAST::build(myAST);
+	}
+	PhaseTimer timer("store AST");
+	astCache->store(source(), myFlatAST);
+}
+
+ProgramNode * CompilationSession::parseAll(){
+	if (parsedAll){ return myAST; }
+	parsedAll = true;
+
+	ProgramNode * ast = parse();
+	if (ast == nullptr || !myLazyBodies){ return ast; }
+
+	PhaseTimer timer("parse bodies");
+	if (!ast->parseBodies()){ myAST = nullptr; }
+	return myAST;
+}
+
+NameAnalysis * CompilationSession::nameAnalysis(){
+	if (named){ return myNameAnalysis; }
+	named = true;
+
+	//Name analysis needs every body, and a body that doesn't
+	// parse must stop the compilation there, as it would have
+	// if the parser hadn't left it for later
+	ProgramNode * ast = parseAll();
+	if (ast == nullptr){ return nullptr; }
+
+	PhaseTimer timer("name analysis");
+	myNameAnalysis = NameAnalysis::build(ast);
+	return myNameAnalysis;
+}
+
+TypeAnalysis * CompilationSession::typeAnalysis(){
+	if (typed){ return myTypeAnalysis; }
+	typed = true;
+
+	NameAnalysis * na = nameAnalysis();
+	if (na == nullptr){ return nullptr; }
+
+	PhaseTimer timer("type analysis");
+	myTypeAnalysis = TypeAnalysis::build(na);
+	return myTypeAnalysis;
+}
+
+IRProgram * CompilationSession::ir(){
+	if (lowered){ return myIR; }
+	lowered = true;
+
+	TypeAnalysis * ta = typeAnalysis();
+	if (ta == nullptr){ return nullptr; }
+
+	PhaseTimer timer("3AC lowering");
+	myIR = ta->ast->to3AC(ta, cache);
+	return myIR;
+}
+
+FlatAST * CompilationSession::flatAST(){
+	if (flattened){ return myFlatAST; }
+	if (cachedAST() != nullptr){ return myFlatAST; }
+
+	ProgramNode * ast = parseAll();
+	//Parsing flattens the tree itself when it stores it in the cache
+	if (flattened){ return myFlatAST; }
+	flattened = true;
+	if (ast == nullptr){ return nullptr; }
+
+	PhaseTimer timer("flatten AST");
+	myFlatAST = FlatAST::build(ast);
+	return myFlatAST;
+}
+
+FlatNameAnalysis * CompilationSession::flatNameAnalysis(){
+	if (flatNamed){ return myFlatNames; }
+	flatNamed = true;
+
+	FlatAST * ast = flatAST();
+	if (ast == nullptr){ return nullptr; }
+
+	PhaseTimer timer("flat name analysis");
+	myFlatNames = FlatNameAnalysis::build(ast);
+	return myFlatNames;
+}
+
+FlatTypeAnalysis * CompilationSession::flatTypeAnalysis(){
+	if (flatTyped){ return myFlatTypes; }
+	flatTyped = true;
+
+	FlatNameAnalysis * names = flatNameAnalysis();
+	if (names == nullptr){ return nullptr; }
+
+	PhaseTimer timer("flat type analysis");
+	myFlatTypes = FlatTypeAnalysis::build(names);
+	return myFlatTypes;
+}
+
+}
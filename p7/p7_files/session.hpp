@@ -0,0 +1,135 @@
+#ifndef DREWGON_SESSION_HPP
+#define DREWGON_SESSION_HPP
+
+#include "ast.hpp"
+#include "name_analysis.hpp"
+#include "type_analysis.hpp"
+#include "flat_analysis.hpp"
+#include "ast_cache.hpp"
+#include "source.hpp"
+#include "arena.hpp"
+
+namespace drewgon{
+
+// A single compilation of one input file. Each phase of the
+// pipeline runs lazily, at most once, and its result is kept
+// so that every output requested on the command line shares
+// the same AST, analyses and IR instead of redoing the front
+// end from scratch. A phase that fails is remembered as failed
+// (its result is nullptr) and is not retried.
+class CompilationSession{
+public:
+	CompilationSession(const char * inPathIn);
+	~CompilationSession();
+	const char * inPath() const { return myInPath; }
+
+	//Reuse (and fill) a function cache when lowering and
+	// generating code. Must be set before ir() is first called.
+	void setCache(FnCache * cacheIn){ cache = cacheIn; }
+
+	//Load the AST from (or, once parsed, store it in) an AST
+	// cache. Must be set before the input is first parsed. On a
+	// hit, the AST is rebuilt from the cached flat copy (which
+	// flatAST() then returns) instead of being parsed, and so
+	// comes with every function body parsed.
+	void setASTCache(ASTCache * astCacheIn){ astCache = astCacheIn; }
+
+	//Scan with the hand-written scanner rather than flex's
+	void setFastScan(bool fastScanIn){ myFastScan = fastScanIn; }
+	bool fastScan() const { return myFastScan; }
+
+	//Scan a large input in parallel, on up to this many threads
+	void setLexThreads(unsigned int lexThreadsIn){ myLexThreads = lexThreadsIn; }
+	unsigned int lexThreads() const { return myLexThreads; }
+
+	//Scan on a thread of its own, while the parser runs
+	void setPipeline(bool pipelineIn){ myPipeline = pipelineIn; }
+	bool pipeline() const { return myPipeline; }
+
+	//Parse with the hand-written parser rather than bison's
+	void setRDParse(bool rdParseIn){ myRDParse = rdParseIn; }
+	bool rdParse() const { return myRDParse; }
+
+	//Leave function bodies to be parsed when they are first
+	// needed (with the hand-written parser)
+	void setLazyBodies(bool lazyBodiesIn){ myLazyBodies = lazyBodiesIn; }
+	bool lazyBodies() const { return myLazyBodies; }
+
+	//Where the tokens of the input (and their positions) are
+	// allocated. They, like the source text, are kept until the
+	// session is done, and are then freed all at once.
+	Arena * tokenArena(){ return &myTokenArena; }
+
+	//Where the nodes of the AST are allocated, likewise
+	Arena * astArena(){ return &myASTArena; }
+
+	//Report how much memory the session's arenas took, when the
+	// session is done
+	void setMemReport(bool memReportIn){ memReport = memReportIn; }
+	void reportMemory(std::ostream& out) const;
+
+	//Each of these runs the requested phase (and everything
+	// it depends on) the first time it is called, and returns
+	// the cached result on every later call.
+	const SourceFile * source();
+	ProgramNode * parse();
+	//As parse, but with every function body parsed too
+	ProgramNode * parseAll();
+	NameAnalysis * nameAnalysis();
+	TypeAnalysis * typeAnalysis();
+	IRProgram * ir();
+
+	//A flat copy of the AST (see flat_ast.hpp), and the
+	// analyses of it, which report the same errors as those above
+	FlatAST * flatAST();
+	FlatNameAnalysis * flatNameAnalysis();
+	FlatTypeAnalysis * flatTypeAnalysis();
+private:
+	//Sets cleanScan if the parse succeeds with no lexical errors
+	ProgramNode * parseSource(bool& cleanScan);
+	//The flat AST in the AST cache for the input, or nullptr
+	FlatAST * cachedAST();
+	void storeAST();
+
+	const char * myInPath;
+	FnCache * cache = nullptr;
+	ASTCache * astCache = nullptr;
+	bool myFastScan = false;
+	unsigned int myLexThreads = 1;
+	bool myPipeline = false;
+	bool myRDParse = false;
+	bool myLazyBodies = false;
+	bool memReport = false;
+
+	//Tokens (and so the AST) point into the source text, so
+	// it is kept until the session is done. While it is, its
+	// SourceManager is the one positions are located with on
+	// the session's thread (in place of outerLines).
+	SourceFile * mySource = nullptr;
+	const SourceManager * outerLines = nullptr;
+	Arena myTokenArena;
+	Arena myASTArena;
+
+	bool parsed = false;
+	bool parsedAll = false;
+	bool named = false;
+	bool typed = false;
+	bool lowered = false;
+	bool flattened = false;
+	bool flatNamed = false;
+	bool flatTyped = false;
+	bool cacheChecked = false;
+	bool fromCache = false;
+
+	ProgramNode * myAST = nullptr;
+	NameAnalysis * myNameAnalysis = nullptr;
+	TypeAnalysis * myTypeAnalysis = nullptr;
+	IRProgram * myIR = nullptr;
+	FlatAST * myFlatAST = nullptr;
+	FlatNameAnalysis * myFlatNames = nullptr;
+	FlatTypeAnalysis * myFlatTypes = nullptr;
+};
+
+}
+
+#endif
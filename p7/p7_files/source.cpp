@@ -0,0 +1,90 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include "source.hpp"
+
+namespace drewgon{
+
+SourceFile * SourceFile::open(const char * path){
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0){ return nullptr; }
+
+	SourceFile * src = new SourceFile();
+	struct stat info;
+	if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+		size_t len = static_cast<size_t>(info.st_size);
+		void * addr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED){
+			madvise(addr, len, MADV_SEQUENTIAL);
+			src->myData = static_cast<const char *>(addr);
+			src->mySize = len;
+			src->mapped = true;
+			src->myLines.text = src->myData;
+			src->myLines.size = src->mySize;
+			close(fd);
+			return src;
+		}
+	}
+
+	//Fall back to reading the whole file
+	char buf[65536];
+	while (true){
+		ssize_t got = read(fd, buf, sizeof(buf));
+		if (got < 0){
+			if (errno == EINTR){ continue; }
+			close(fd);
+			delete src;
+			return nullptr;
+		}
+		if (got == 0){ break; }
+		src->contents.append(buf, static_cast<size_t>(got));
+	}
+	close(fd);
+	src->myData = src->contents.data();
+	src->mySize = src->contents.size();
+	src->myLines.text = src->myData;
+	src->myLines.size = src->mySize;
+	return src;
+}
+
+SourceFile::~SourceFile(){
+	if (mapped){
+		munmap(const_cast<char *>(myData), mySize);
+	}
+}
+
+static thread_local const SourceManager * currentManager = nullptr;
+
+const SourceManager * SourceManager::current(){
+	return currentManager;
+}
+
+const SourceManager * SourceManager::setCurrent(const SourceManager * mgr){
+	const SourceManager * old = currentManager;
+	currentManager = mgr;
+	return old;
+}
+
+void SourceManager::findLines() const{
+	lineStarts.push_back(0);
+	const char * end = text + size;
+	for (const char * p = text; p < end; p++){
+		p = static_cast<const char *>(memchr(p, '\n', static_cast<size_t>(end - p)));
+		if (p == nullptr){ break; }
+		lineStarts.push_back(static_cast<SourceLoc>(p + 1 - text));
+	}
+}
+
+void SourceManager::locate(SourceLoc loc, size_t& line, size_t& col) const{
+	if (lineStarts.empty()){ findLines(); }
+	//The last line that starts at or before loc
+	auto after = std::upper_bound(lineStarts.begin(), lineStarts.end(), loc);
+	line = static_cast<size_t>(after - lineStarts.begin());
+	col = loc - *(after - 1) + 1;
+}
+
+}
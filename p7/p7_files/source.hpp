@@ -0,0 +1,73 @@
+#ifndef DREWGON_SOURCE_HPP
+#define DREWGON_SOURCE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace drewgon{
+
+//A place in the file being compiled, as a byte offset into it
+typedef uint32_t SourceLoc;
+
+// Turns SourceLocs into the lines and columns (each counted from
+// 1, columns in bytes) that are shown to the user. The table of
+// where each line starts is built the first time it is needed, so
+// a compilation that reports nothing never builds it.
+class SourceManager{
+public:
+	//Where loc is
+	void locate(SourceLoc loc, size_t& line, size_t& col) const;
+
+	//For input without text to find the lines in (a replayed
+	// token stream), the lines are given as they are found: the
+	// next line starts at start, which must be past where the last
+	// line started
+	void addLine(SourceLoc start) const { lineStarts.push_back(start); }
+	size_t numLines() const { return lineStarts.size(); }
+	SourceLoc lineStart(size_t line) const { return lineStarts[line - 1]; }
+
+	//The manager that positions are located with on this thread:
+	// the one for the file the thread is compiling. Setting it
+	// returns the one it replaces.
+	static const SourceManager * current();
+	static const SourceManager * setCurrent(const SourceManager * mgr);
+private:
+	friend class SourceFile;
+	SourceManager(){ }
+	void findLines() const;
+
+	const char * text = nullptr;
+	size_t size = 0;
+	mutable std::vector<SourceLoc> lineStarts;
+};
+
+// The complete text of one input file, held in memory for as
+// long as the compilation that reads it. The file is mapped
+// rather than read where possible, so that the scanner (and the
+// tokens that point back into the text) read it in place.
+class SourceFile{
+public:
+	//Returns nullptr if the file can't be opened or read
+	static SourceFile * open(const char * path);
+	~SourceFile();
+
+	const char * data() const { return myData; }
+	size_t size() const { return mySize; }
+	const SourceManager * lines() const { return &myLines; }
+	SourceManager * lines(){ return &myLines; }
+private:
+	SourceFile() : myData(nullptr), mySize(0), mapped(false){ }
+
+	const char * myData;
+	size_t mySize;
+	bool mapped;
+	//Holds the text of files that couldn't be mapped (such as
+	// pipes and empty files)
+	std::string contents;
+	SourceManager myLines;
+};
+
+}
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef DREWGON_SPAN_HPP
+#define DREWGON_SPAN_HPP
+
+#include <cstddef>
+
+namespace drewgon{
+
+// A run of objects laid out one after another, such as the
+// children of an AST node. A Span only views the objects; they
+// belong to whatever allocated them (for the AST, an Arena).
+template <typename T>
+class Span{
+public:
+	Span() : myItems(nullptr), mySize(0){ }
+	Span(T * itemsIn, size_t sizeIn) : myItems(itemsIn), mySize(sizeIn){ }
+
+	T * begin() const { return myItems; }
+	T * end() const { return myItems + mySize; }
+	size_t size() const { return mySize; }
+	bool empty() const { return mySize == 0; }
+	T& front() const { return myItems[0]; }
+	T& back() const { return myItems[mySize - 1]; }
+	T& operator[](size_t idx) const { return myItems[idx]; }
+private:
+	T * myItems;
+	size_t mySize;
+};
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef DREWGON_SPSC_RING_HPP
+#define DREWGON_SPSC_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace drewgon{
+
+// A fixed-size queue between exactly one producer thread and one
+// consumer thread, which takes no locks. Each side owns one index
+// (the producer the tail, the consumer the head) and only reads
+// the other's, publishing items with a release store that the
+// other side's acquire load pairs with. Each side also keeps its
+// own copy of the other's index, and only rereads the shared one
+// when the ring looks full (or empty), so that the two threads
+// rarely touch the same cache line.
+//
+// Capacity must be a power of 2.
+template <typename T, size_t Capacity>
+class SpscRing{
+public:
+	SpscRing(){ }
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	//Producer only: add item, unless the ring is full
+	bool tryPush(const T& item){
+		size_t tail = myTail.load(std::memory_order_relaxed);
+		if (tail - headSeen == Capacity){
+			headSeen = myHead.load(std::memory_order_acquire);
+			if (tail - headSeen == Capacity){ return false; }
+		}
+		slots[tail % Capacity] = item;
+		myTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer only: take the oldest item, unless the ring is empty
+	bool tryPop(T& item){
+		size_t head = myHead.load(std::memory_order_relaxed);
+		if (head == tailSeen){
+			tailSeen = myTail.load(std::memory_order_acquire);
+			if (head == tailSeen){ return false; }
+		}
+		item = slots[head % Capacity];
+		myHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+private:
+	static_assert((Capacity & (Capacity - 1)) == 0,
+	  "SpscRing capacity must be a power of 2");
+	static const size_t LINE = 64;
+
+	//The consumer's side, then the producer's, each on its own
+	// cache line
+	std::atomic<size_t> myHead{0};
+	size_t tailSeen = 0;
+	char consumerPad[LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+	std::atomic<size_t> myTail{0};
+	size_t headSeen = 0;
+	char producerPad[LINE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+	T slots[Capacity];
+};
+
+}
+
+#endif
@@ -4,6 +4,14 @@ namespace drewgon{
 
 SymbolTable::SymbolTable(){
 	scopeTableChain = new std::list<ScopeTable *>();
+	leftScopes = new std::list<ScopeTable *>();
+}
+
+SymbolTable::~SymbolTable(){
+	for (ScopeTable * scope : *scopeTableChain){ delete scope; }
+	for (ScopeTable * scope : *leftScopes){ delete scope; }
+	delete scopeTableChain;
+	delete leftScopes;
 }
 
 void SymbolTable::print(){
@@ -24,6 +32,7 @@ void SymbolTable::leaveScope(){
 		throw new InternalError("Attempt to pop"
 			"empty symbol table");
 	}
+	leftScopes->push_back(scopeTableChain->front());
 	scopeTableChain->pop_front();
 }
 
@@ -31,14 +40,14 @@ ScopeTable * SymbolTable::getCurrentScope(){
 	return scopeTableChain->front();
 }
 
-bool SymbolTable::clash(std::string varName){
-	bool hasClash = getCurrentScope()->clash(varName);
+bool SymbolTable::clash(SymbolId id){
+	bool hasClash = getCurrentScope()->clash(id);
 	return hasClash;
 }
 
-SemSymbol * SymbolTable::find(std::string varName){
+SemSymbol * SymbolTable::find(SymbolId id){
 	for (ScopeTable * scope : *scopeTableChain){
-		SemSymbol * sym = scope->lookup(varName);
+		SemSymbol * sym = scope->lookup(id);
 		if (sym != nullptr) { return sym; }
 	}
 	return nullptr;
@@ -49,7 +58,12 @@ bool SymbolTable::insert(SemSymbol * symbol){
 }
 
 ScopeTable::ScopeTable(){
-	symbols = new HashMap<std::string, SemSymbol *>();
+	symbols = new HashMap<SymbolId, SemSymbol *>();
+}
+
+ScopeTable::~ScopeTable(){
+	for (auto entry : *symbols){ delete entry.second; }
+	delete symbols;
 }
 
 std::string ScopeTable::toString(){
@@ -61,16 +75,16 @@ std::string ScopeTable::toString(){
 	return result;
 }
 
-bool ScopeTable::clash(std::string varName){
-	SemSymbol * found = lookup(varName);
+bool ScopeTable::clash(SymbolId id){
+	SemSymbol * found = lookup(id);
 	if (found != nullptr){
 		return true;
 	}
 	return false;
 }
 
-SemSymbol * ScopeTable::lookup(std::string name){
-	auto found = symbols->find(name);
+SemSymbol * ScopeTable::lookup(SymbolId id){
+	auto found = symbols->find(id);
 	if (found == symbols->end()){
 		return NULL;
 	}
@@ -78,12 +92,12 @@ SemSymbol * ScopeTable::lookup(std::string name){
 }
 
 bool ScopeTable::insert(SemSymbol * symbol){
-	std::string symName = symbol->getName();
-	bool alreadyInScope = (this->lookup(symName) != NULL);
+	SymbolId symId = symbol->getId();
+	bool alreadyInScope = (this->lookup(symId) != NULL);
 	if (alreadyInScope){
 		return false;
 	}
-	this->symbols->insert(std::make_pair(symName, symbol));
+	this->symbols->insert(std::make_pair(symId, symbol));
 	return true;
 }
 
@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <list>
 #include "types.hpp"
+#include "interner.hpp"
 
 //Use an alias template so that we can use
 // "HashMap" and it means "std::unordered_map"
@@ -23,13 +24,16 @@ enum SymbolKind {
 //A semantic symbol, which represents a single
 // variable, function, etc. Semantic symbols
 // exist for the lifetime of a scope in the
-// symbol table.
+// symbol table. A symbol holds its name as the
+// name's interned ID.
 class SemSymbol {
 public:
-	SemSymbol(std::string nameIn, const DataType * typeIn)
-	: myName(nameIn), myType(typeIn){ }
+	SemSymbol(SymbolId idIn, const DataType * typeIn)
+	: myId(idIn), myType(typeIn){ }
+	virtual ~SemSymbol(){ }
 	virtual std::string toString();
-	std::string getName() const { return myName; }
+	const std::string& getName() const { return Interner::name(myId); }
+	SymbolId getId() const { return myId; }
 	virtual SymbolKind getKind() const = 0;
 
 	virtual const DataType * getDataType() const{
@@ -43,21 +47,21 @@ public:
 		return "UNKNOWN KIND";
 	}
 private:
-	std::string myName;
+	SymbolId myId;
 	const DataType * myType;
 };
 
 class VarSymbol : public SemSymbol {
 public:
-	VarSymbol(std::string name, const DataType * type)
-	: SemSymbol(name, type) { }
+	VarSymbol(SymbolId id, const DataType * type)
+	: SemSymbol(id, type) { }
 	virtual SymbolKind getKind() const override { return VAR; }
 };
 
 class FnSymbol : public SemSymbol{
 public:
-	FnSymbol(std::string name, const FnType * fnType)
-	: SemSymbol(name, fnType){ }
+	FnSymbol(SymbolId id, const FnType * fnType)
+	: SemSymbol(id, fnType){ }
 	virtual SymbolKind getKind() const { return FN; }
 	SymbolKind getKind(){ return FN; }
 };
@@ -67,42 +71,53 @@ public:
 // semantic symbols for a single scope. For example,
 // the globals scope will be represented by a ScopeTable,
 // and the contents of each function can be represented by
-// a ScopeTable.
+// a ScopeTable. Symbols are keyed by the ID of their
+// name. A scope owns the symbols inserted into it.
 class ScopeTable {
 	public:
 		ScopeTable();
-		SemSymbol * lookup(std::string name);
+		~ScopeTable();
+		SemSymbol * lookup(SymbolId id);
+		//Takes ownership of symbol if it is inserted
 		bool insert(SemSymbol * symbol);
-		bool clash(std::string name);
+		bool clash(SymbolId id);
 		std::string toString();
-		void addVar(std::string name, const DataType * type){
-			insert(new VarSymbol(name, type));
+		void addVar(SymbolId id, const DataType * type){
+			insert(new VarSymbol(id, type));
 		}
-		void addFn(std::string name, FnType * type){
-			insert(new FnSymbol(name, type));
+		void addFn(SymbolId id, FnType * type){
+			insert(new FnSymbol(id, type));
 		}
 	private:
-		HashMap<std::string, SemSymbol *> * symbols;
+		HashMap<SymbolId, SemSymbol *> * symbols;
 };
 
+//The chain of scopes in force at a point in the program. A
+// scope that is left isn't freed until the table is, since the
+// AST (and the passes after name analysis) hold on to the
+// symbols that were declared in it.
 class SymbolTable{
 	public:
 		SymbolTable();
+		~SymbolTable();
+		SymbolTable(const SymbolTable&) = delete;
+		SymbolTable& operator=(const SymbolTable&) = delete;
 		ScopeTable * enterScope();
 		void leaveScope();
 		ScopeTable * getCurrentScope();
 		bool insert(SemSymbol * symbol);
-		SemSymbol * find(std::string varName);
-		bool clash(std::string name);
-		void addVar(std::string name, const DataType * type){
-			getCurrentScope()->addVar(name, type);
+		SemSymbol * find(SymbolId id);
+		bool clash(SymbolId id);
+		void addVar(SymbolId id, const DataType * type){
+			getCurrentScope()->addVar(id, type);
 		}
-		void addFn(std::string name, FnType * type){
-			getCurrentScope()->addFn(name, type);
+		void addFn(SymbolId id, FnType * type){
+			getCurrentScope()->addFn(id, type);
 		}
 		void print();
 	private:
 		std::list<ScopeTable *> * scopeTableChain;
+		std::list<ScopeTable *> * leftScopes;
 };
 
 
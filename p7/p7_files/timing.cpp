@@ -0,0 +1,191 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <time.h>
+#include "timing.hpp"
+
+namespace drewgon{
+
+static const size_t NO_PARENT = static_cast<size_t>(-1);
+
+uint64_t TimingTrack::wallNow(){
+	auto since = std::chrono::steady_clock::now().time_since_epoch();
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(since);
+	return static_cast<uint64_t>(ns.count());
+}
+
+uint64_t TimingTrack::cpuNow(){
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0){ return 0; }
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000u
+	  + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+TimingTrack::TimingTrack(const std::string& nameIn, bool reportIn,
+  TraceLog * traceIn)
+: name(nameIn), wantReport(reportIn), trace(traceIn),
+  active(reportIn || traceIn != nullptr), outer(currentSlot()),
+  open(NO_PARENT){
+	if (active){ currentSlot() = this; }
+}
+
+TimingTrack::~TimingTrack(){
+	if (!active){ return; }
+	currentSlot() = outer;
+	if (trace != nullptr){ trace->add(*this); }
+}
+
+size_t TimingTrack::begin(const char * eventName,
+  const std::string& detail){
+	Event event;
+	event.name = eventName;
+	event.detail = detail;
+	event.parent = open;
+	event.wall = 0;
+	event.cpu = 0;
+	event.cpuStart = cpuNow();
+	event.start = wallNow();
+	events.push_back(event);
+	open = events.size() - 1;
+	return open;
+}
+
+void TimingTrack::end(size_t idx){
+	Event& event = events[idx];
+	event.wall = wallNow() - event.start;
+	event.cpu = cpuNow() - event.cpuStart;
+	open = event.parent;
+}
+
+void TimingTrack::accumulate(const char * accName, uint64_t wallNs){
+	for (Accumulated& acc : accumulated){
+		if (acc.name == accName && acc.parent == open){
+			acc.wall += wallNs;
+			acc.count++;
+			return;
+		}
+	}
+	Accumulated acc;
+	acc.name = accName;
+	acc.parent = open;
+	acc.wall = wallNs;
+	acc.count = 1;
+	accumulated.push_back(acc);
+}
+
+static void reportLine(std::ostream& out, uint64_t wall, const uint64_t * cpu,
+  int depth, const std::string& label){
+	out << std::setw(12) << std::fixed << std::setprecision(3)
+	  << static_cast<double>(wall) / 1e6;
+	if (cpu == nullptr){
+		out << std::setw(12) << "-";
+	} else {
+		out << std::setw(12) << static_cast<double>(*cpu) / 1e6;
+	}
+	out << "  " << std::string(static_cast<size_t>(depth) * 2, ' ')
+	  << label << "\n";
+}
+
+void TimingTrack::reportChildren(std::ostream& out, size_t parent,
+  int depth) const{
+	for (const Accumulated& acc : accumulated){
+		if (acc.parent != parent){ continue; }
+		std::string label = acc.name;
+		label += " (" + std::to_string(acc.count) + " calls)";
+		reportLine(out, acc.wall, nullptr, depth, label);
+	}
+	for (size_t i = 0; i < events.size(); i++){
+		const Event& event = events[i];
+		if (event.parent != parent){ continue; }
+		std::string label = event.name;
+		if (!event.detail.empty()){ label += " " + event.detail; }
+		reportLine(out, event.wall, &event.cpu, depth, label);
+		reportChildren(out, i, depth + 1);
+	}
+}
+
+void TimingTrack::report(std::ostream& out) const{
+	if (!wantReport){ return; }
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << "===-- Time report for " << name << " --===\n";
+	out << std::setw(12) << "Wall (ms)" << std::setw(12) << "CPU (ms)"
+	  << "  Phase\n";
+	reportChildren(out, NO_PARENT, 0);
+	out.flags(flags);
+	out.precision(precision);
+}
+
+static std::string jsonString(const std::string& str){
+	std::string res = "\"";
+	for (char c : str){
+		if (c == '"' || c == '\\'){
+			res += '\\';
+			res += c;
+		} else if (static_cast<unsigned char>(c) < 0x20){
+			std::ostringstream esc;
+			esc << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+			  << static_cast<int>(c);
+			res += esc.str();
+		} else {
+			res += c;
+		}
+	}
+	return res + "\"";
+}
+
+static std::string micros(uint64_t ns){
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(3)
+	  << static_cast<double>(ns) / 1e3;
+	return out.str();
+}
+
+TraceLog::TraceLog() : origin(TimingTrack::wallNow()){
+}
+
+void TraceLog::add(const TimingTrack& track){
+	std::lock_guard<std::mutex> guard(lock);
+	int tid = ++numTracks;
+	std::string tidStr = std::to_string(tid);
+
+	events.push_back("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+	  "\"tid\":" + tidStr + ",\"args\":{\"name\":"
+	  + jsonString(track.name) + "}}");
+	for (size_t i = 0; i < track.events.size(); i++){
+		const TimingTrack::Event& event = track.events[i];
+		std::string args = "\"cpu_ms\":" + micros(event.cpu / 1000);
+		if (!event.detail.empty()){
+			args += ",\"detail\":" + jsonString(event.detail);
+		}
+		for (const TimingTrack::Accumulated& acc : track.accumulated){
+			if (acc.parent != i){ continue; }
+			args += "," + jsonString(std::string(acc.name) + "_ms") + ":"
+			  + micros(acc.wall / 1000);
+			args += "," + jsonString(std::string(acc.name) + "_calls")
+			  + ":" + std::to_string(acc.count);
+		}
+		std::string label = event.name;
+		if (!event.detail.empty()){ label += " " + event.detail; }
+		uint64_t start = event.start > origin ? event.start - origin : 0;
+		events.push_back("{\"name\":" + jsonString(label)
+		  + ",\"cat\":\"dgc\",\"ph\":\"X\",\"pid\":1,\"tid\":" + tidStr
+		  + ",\"ts\":" + micros(start) + ",\"dur\":" + micros(event.wall)
+		  + ",\"args\":{" + args + "}}");
+	}
+}
+
+bool TraceLog::write(const char * path){
+	std::lock_guard<std::mutex> guard(lock);
+	std::ofstream out(path);
+	if (!out.good()){ return false; }
+	out << "{\"traceEvents\":[\n";
+	for (size_t i = 0; i < events.size(); i++){
+		out << events[i] << (i + 1 < events.size() ? ",\n" : "\n");
+	}
+	out << "],\"displayTimeUnit\":\"ms\"}\n";
+	return out.good();
+}
+
+}
@@ -0,0 +1,111 @@
+#ifndef DREWGON_TIMING_HPP
+#define DREWGON_TIMING_HPP
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace drewgon{
+
+class TraceLog;
+
+// The timings collected while compiling one input file. A track
+// is active on the thread that created it until it is destroyed;
+// while no track is active every timer below does nothing but
+// check for one, so timing costs (almost) nothing when it is off.
+class TimingTrack{
+public:
+	//Start timing on this thread if a report was asked for or
+	// there is a trace to add to. Otherwise the track is inert.
+	TimingTrack(const std::string& nameIn, bool reportIn,
+	  TraceLog * traceIn);
+	~TimingTrack();
+
+	//The active track on this thread, or nullptr
+	static TimingTrack * current(){ return currentSlot(); }
+
+	//Open and close a (possibly nested) timed region
+	size_t begin(const char * name, const std::string& detail);
+	void end(size_t event);
+
+	//Add time spent in many small pieces (e.g. one call to the
+	// scanner per token) under the innermost open region
+	void accumulate(const char * name, uint64_t wallNs);
+
+	//Print the per-phase times collected so far, nested by
+	// region, if a report was asked for
+	void report(std::ostream& out) const;
+
+	static uint64_t wallNow();
+	static uint64_t cpuNow();
+private:
+	struct Event{
+		const char * name;
+		std::string detail;
+		size_t parent;
+		uint64_t start;
+		uint64_t wall;
+		uint64_t cpuStart;
+		uint64_t cpu;
+	};
+	struct Accumulated{
+		const char * name;
+		size_t parent;
+		uint64_t wall;
+		size_t count;
+	};
+	static TimingTrack *& currentSlot(){
+		static thread_local TimingTrack * track = nullptr;
+		return track;
+	}
+	void reportChildren(std::ostream& out, size_t parent,
+	  int depth) const;
+
+	friend class TraceLog;
+	std::string name;
+	bool wantReport;
+	TraceLog * trace;
+	bool active;
+	TimingTrack * outer;
+	std::vector<Event> events;
+	std::vector<Accumulated> accumulated;
+	size_t open;
+};
+
+// Times one region of the pipeline for as long as it is in
+// scope. Does nothing if no TimingTrack is active.
+class PhaseTimer{
+public:
+	PhaseTimer(const char * name) : PhaseTimer(name, std::string()){}
+	PhaseTimer(const char * name, const std::string& detail)
+	: track(TimingTrack::current()), event(0){
+		if (track != nullptr){ event = track->begin(name, detail); }
+	}
+	~PhaseTimer(){
+		if (track != nullptr){ track->end(event); }
+	}
+private:
+	TimingTrack * track;
+	size_t event;
+};
+
+// Collects finished tracks from any number of threads and
+// writes them out as a Chrome trace-event JSON file, with
+// one thread (tid) per input file.
+class TraceLog{
+public:
+	TraceLog();
+	void add(const TimingTrack& track);
+	bool write(const char * path);
+private:
+	std::mutex lock;
+	uint64_t origin;
+	std::vector<std::string> events;
+	int numTracks = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include "token_stream.hpp"
+#include "tokens.hpp"
+#include "errors.hpp"
+
+namespace drewgon{
+
+using TokenKind = drewgon::Parser::token;
+
+static const char MAGIC[] = "\x7f" "DGT";
+static const size_t MAGIC_LEN = 4;
+static const char VERSION = 1;
+static const int ERROR_RECORD = 0xff;
+//Buffered output is handed to the stream in pieces of this size
+static const size_t FLUSH_AT = 64 * 1024;
+
+//The kind byte of a token kind (or END, or ERROR_RECORD)
+static unsigned char kindByte(int kind){
+	if (kind == TokenKind::END){ return 0; }
+	if (kind == ERROR_RECORD){ return ERROR_RECORD; }
+	return static_cast<unsigned char>(kind - 256);
+}
+
+size_t TokenWriter::TextHash::operator()(const Text& text) const{
+	//FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < text.len; i++){
+		hash ^= static_cast<unsigned char>(text.data[i]);
+		hash *= 1099511628211ull;
+	}
+	return static_cast<size_t>(hash);
+}
+
+TokenWriter::TokenWriter(std::ostream& outIn, const SourceManager * linesIn)
+: out(outIn), lines(linesIn){
+	buf.append(MAGIC, MAGIC_LEN);
+	buf += VERSION;
+}
+
+void TokenWriter::varint(uint64_t val){
+	while (val >= 0x80){
+		buf += static_cast<char>((val & 0x7f) | 0x80);
+		val >>= 7;
+	}
+	buf += static_cast<char>(val);
+}
+
+void TokenWriter::position(int kind, const Position * pos, size_t& line,
+  size_t& endCol){
+	size_t col;
+	lines->locate(pos->offsetBegin(), line, col);
+	buf += static_cast<char>(kindByte(kind));
+	if (line < prevLine || (line == prevLine && col < prevEnd)){
+		throw new InternalError("Token stream records out of order");
+	}
+	varint(line - prevLine);
+	varint(line == prevLine ? col - prevEnd : col);
+	//Nothing in a stream spans lines
+	endCol = col + (pos->offsetEnd() - pos->offsetBegin());
+}
+
+void TokenWriter::string(const char * data, size_t len){
+	Text text;
+	text.data = data;
+	text.len = len;
+	auto known = strings.find(text);
+	if (known != strings.end()){
+		varint(known->second);
+		return;
+	}
+	uint64_t ref = strings.size();
+	strings[text] = ref;
+	varint(ref);
+	varint(len);
+	buf.append(data, len);
+}
+
+void TokenWriter::flushIfFull(){
+	if (buf.size() < FLUSH_AT){ return; }
+	out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+	buf.clear();
+}
+
+void TokenWriter::token(const Token * tok){
+	const Position * pos = tok->pos();
+	int kind = tok->kind();
+	size_t line;
+	size_t endCol;
+	position(kind, pos, line, endCol);
+	if (kind == TokenKind::ID){
+		const IDToken * id = static_cast<const IDToken *>(tok);
+		string(id->text(), id->length());
+	} else if (kind == TokenKind::STRINGLITERAL){
+		const StrToken * str = static_cast<const StrToken *>(tok);
+		string(str->text(), str->length());
+	} else {
+		varint(pos->offsetEnd() - pos->offsetBegin());
+		if (kind == TokenKind::INTLITERAL){
+			int num = static_cast<const IntLitToken *>(tok)->num();
+			varint(static_cast<uint64_t>(num));
+		}
+	}
+	prevLine = line;
+	prevEnd = endCol;
+	flushIfFull();
+}
+
+void TokenWriter::error(const Position * pos, const std::string& msg){
+	size_t line;
+	size_t endCol;
+	position(ERROR_RECORD, pos, line, endCol);
+	varint(pos->offsetEnd() - pos->offsetBegin());
+	messages.push_back(msg);
+	string(messages.back().data(), messages.back().size());
+	flushIfFull();
+}
+
+void TokenWriter::end(SourceLoc loc){
+	Position pos(loc, loc);
+	size_t line;
+	size_t endCol;
+	position(TokenKind::END, &pos, line, endCol);
+	out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+	buf.clear();
+	out.flush();
+}
+
+bool TokenReader::recognizes(const SourceFile * src){
+	return src->size() > MAGIC_LEN
+	  && memcmp(src->data(), MAGIC, MAGIC_LEN) == 0;
+}
+
+TokenReader::TokenReader(const SourceFile * src, Arena * arenaIn)
+: pos(src->data() + MAGIC_LEN), end(src->data() + src->size()),
+  arena(arenaIn), lines(src->lines()){
+	if (*pos != VERSION){
+		throw new InternalError("Unsupported token stream version");
+	}
+	pos++;
+	if (lines->numLines() == 0){ lines->addLine(0); }
+}
+
+void TokenReader::malformed(){
+	throw new InternalError("Malformed token stream");
+}
+
+uint64_t TokenReader::varint(){
+	uint64_t val = 0;
+	for (unsigned int shift = 0; shift < 64; shift += 7){
+		if (pos == end){ malformed(); }
+		unsigned char byte = static_cast<unsigned char>(*pos++);
+		val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0){ return val; }
+	}
+	malformed();
+	return 0;
+}
+
+Position TokenReader::locate(size_t recLine, size_t recCol, size_t len){
+	if (recCol == 0 || recLine < widthLine){ malformed(); }
+	//Each new line starts just past the furthest any record on
+	// the line before it reached (so that each line is as wide as
+	// it must be). A stream replayed again finds its lines already
+	// there.
+	while (lines->numLines() < recLine){
+		size_t last = lines->numLines();
+		uint64_t start = lines->lineStart(last) + 1
+		  + (last == widthLine ? lastWidth : 0);
+		if (start >= UINT32_MAX){ malformed(); }
+		lines->addLine(static_cast<SourceLoc>(start));
+	}
+	if (recLine > widthLine){
+		widthLine = recLine;
+		lastWidth = 0;
+	}
+	lastWidth = std::max(lastWidth, recCol - 1 + len);
+	uint64_t begin = lines->lineStart(recLine) + recCol - 1;
+	if (begin + len >= UINT32_MAX){ malformed(); }
+	return Position(static_cast<SourceLoc>(begin),
+	  static_cast<SourceLoc>(begin + len));
+}
+
+const char * TokenReader::string(size_t& len){
+	uint64_t ref = varint();
+	if (ref < strings.size()){
+		len = strings[ref].len;
+		return strings[ref].data;
+	}
+	if (ref != strings.size()){ malformed(); }
+	len = length();
+	if (len > static_cast<size_t>(end - pos)){ malformed(); }
+	Text text;
+	text.data = pos;
+	text.len = len;
+	strings.push_back(text);
+	pos += len;
+	return text.data;
+}
+
+int TokenReader::next(Parser::semantic_type * lval){
+	while (true){
+		if (pos == end){ malformed(); }
+		int byte = static_cast<unsigned char>(*pos++);
+		size_t lineDelta = length();
+		size_t colIn = length();
+		size_t recLine = line + lineDelta;
+		size_t recCol = lineDelta == 0 ? prevEnd + colIn : colIn;
+
+		if (byte == 0){
+			myEndLoc = locate(recLine, recCol, 0).offsetBegin();
+			return TokenKind::END;
+		}
+		if (byte == ERROR_RECORD){
+			size_t len = length();
+			size_t msgLen;
+			const char * msg = string(msgLen);
+			Position errPos = locate(recLine, recCol, len);
+			Report::fatal(&errPos, std::string(msg, msgLen));
+			continue;
+		}
+
+		int kind = byte + 256;
+		size_t len;
+		const char * text = nullptr;
+		if (kind == TokenKind::ID || kind == TokenKind::STRINGLITERAL){
+			text = string(len);
+		} else {
+			len = length();
+		}
+		Position tokPos = locate(recLine, recCol, len);
+		if (kind == TokenKind::ID){
+			lval->transToken = arena->make<IDToken>(tokPos, text, len);
+		} else if (kind == TokenKind::STRINGLITERAL){
+			lval->transToken = arena->make<StrToken>(tokPos, text, len);
+		} else if (kind == TokenKind::INTLITERAL){
+			int num = static_cast<int>(varint());
+			lval->transToken = arena->make<IntLitToken>(tokPos, num);
+		} else {
+			lval->lexeme = arena->make<Token>(tokPos, kind);
+		}
+		line = recLine;
+		prevEnd = recCol + len;
+		return kind;
+	}
+}
+
+}
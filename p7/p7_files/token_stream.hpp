@@ -0,0 +1,131 @@
+#ifndef DREWGON_TOKEN_STREAM_HPP
+#define DREWGON_TOKEN_STREAM_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "grammar.hh"
+#include "arena.hpp"
+#include "source.hpp"
+
+// The compact binary form of a token stream, which dgc -t writes
+// with --binary-tokens, and which dgc reads back in place of the
+// source it came from (the Scanner replays it rather than lexing).
+// A stream is a header, then a record per token or lexical error,
+// then a record for the end of the input:
+//
+//   header   "\x7f" "DGT" and a version byte
+//   record   a kind byte, the line (as a delta) and the column,
+//            then by kind:
+//     ID, STRINGLITERAL   a string reference
+//     INTLITERAL          the length and the value
+//     error (0xff)        the length and the message (a string
+//                         reference)
+//     end (0)             nothing
+//     any other kind      the length
+//
+// Tokens of other kinds are stored as their kind less 256. The
+// line is a delta from the previous token's line; on the same line
+// the column is counted from where the previous token ended, and
+// otherwise it is absolute. (Errors don't move where the next
+// record is counted from.) A replayed stream has no text for its
+// lines to be found in, so the reader gives the file's SourceManager
+// the lines as it reads them. Strings are interned: a reference is
+// the string's index in the order strings first appear, and when
+// it is a new string (the next index) its length and bytes follow.
+// Every number is an unsigned LEB128 varint.
+
+namespace drewgon{
+
+class Token;
+class Position;
+
+class TokenWriter{
+public:
+	//Positions are located with linesIn
+	TokenWriter(std::ostream& outIn, const SourceManager * linesIn);
+	void token(const Token * tok);
+	void error(const Position * pos, const std::string& msg);
+	//Write the end record (at loc) and flush the stream
+	void end(SourceLoc loc);
+private:
+	class Text{
+	public:
+		const char * data;
+		size_t len;
+		bool operator==(const Text& other) const{
+			return len == other.len && memcmp(data, other.data, len) == 0;
+		}
+	};
+	class TextHash{
+	public:
+		size_t operator()(const Text& text) const;
+	};
+
+	//Write the kind byte and where pos begins, and find the line
+	// it is on and the column it ends at
+	void position(int kind, const Position * pos, size_t& line,
+	  size_t& endCol);
+	void varint(uint64_t val);
+	void string(const char * data, size_t len);
+	void flushIfFull();
+
+	std::ostream& out;
+	const SourceManager * lines;
+	std::string buf;
+	size_t prevLine = 1;
+	size_t prevEnd = 1;
+	std::unordered_map<Text, uint64_t, TextHash> strings;
+	//Error messages, so that they outlive their entry in strings
+	std::list<std::string> messages;
+};
+
+class TokenReader{
+public:
+	//Whether src holds a token stream rather than source text
+	static bool recognizes(const SourceFile * src);
+
+	//Tokens are made in arenaIn. They refer to the stream's
+	// text, so src must outlive them.
+	TokenReader(const SourceFile * src, Arena * arenaIn);
+
+	//The next token, as Scanner::yylex would return it. Errors
+	// recorded in the stream are reported as they are passed.
+	int next(Parser::semantic_type * lval);
+
+	//Where the end of the input was (once next returns END)
+	SourceLoc endLoc() const { return myEndLoc; }
+private:
+	uint64_t varint();
+	size_t length(){ return static_cast<size_t>(varint()); }
+	const char * string(size_t& len);
+	void malformed();
+	//The span of len characters from line and col, adding lines
+	// to the SourceManager as they are reached
+	Position locate(size_t recLine, size_t recCol, size_t len);
+
+	const char * pos;
+	const char * end;
+	Arena * arena;
+	const SourceManager * lines;
+	size_t line = 1;
+	size_t prevEnd = 1;
+	//How far the furthest record on the latest line reached
+	size_t widthLine = 1;
+	size_t lastWidth = 0;
+	SourceLoc myEndLoc = 0;
+	class Text{
+	public:
+		const char * data;
+		size_t len;
+	};
+	std::vector<Text> strings;
+};
+
+}
+
+#endif
@@ -6,7 +6,7 @@ namespace drewgon{
 using TokenKind = drewgon::Parser::token;
 using Lexeme = drewgon::Parser::semantic_type;
 
-static std::string tokenKindString(int tokKind){
+std::string tokenKindString(int tokKind){
 	switch(tokKind){
 		case TokenKind::AND: return "AND";
 		case TokenKind::ARROW: return "ARROW";
@@ -54,13 +54,13 @@ static std::string tokenKindString(int tokKind){
 	}
 }
 
-Token::Token(Position * posIn, int kindIn)
+Token::Token(const Position& posIn, int kindIn)
   : myPos(posIn), myKind(kindIn){
 }
 
 std::string Token::toString(){
 	return tokenKindString(kind())
-	+ " " + myPos->begin();
+	+ " " + myPos.begin();
 }
 
 int Token::kind() const {
@@ -68,42 +68,43 @@ int Token::kind() const {
 }
 
 const Position * Token::pos() const {
-	return myPos;
+	return &myPos;
 }
 
-IDToken::IDToken(Position * posIn, std::string vIn)
-  : Token(posIn, TokenKind::ID), myValue(vIn){
+IDToken::IDToken(const Position& posIn, const char * textIn, size_t lenIn)
+  : Token(posIn, TokenKind::ID), myText(textIn), myLen(lenIn),
+    myId(Interner::intern(textIn, lenIn)){
 }
 
 std::string IDToken::toString(){
 	return tokenKindString(kind()) + ":"
-	+ myValue + " " + myPos->begin();
+	+ value() + " " + myPos.begin();
 }
 
 const std::string IDToken::value() const {
-	return this->myValue;
+	return std::string(myText, myLen);
 }
 
-StrToken::StrToken(Position * posIn, std::string sIn)
-  : Token(posIn, TokenKind::STRINGLITERAL), myStr(sIn){
+StrToken::StrToken(const Position& posIn, const char * textIn, size_t lenIn)
+  : Token(posIn, TokenKind::STRINGLITERAL), myText(textIn), myLen(lenIn){
 }
 
 std::string StrToken::toString(){
 	return tokenKindString(kind()) + ":"
-	+ this->myStr + " " + myPos->begin();
+	+ str() + " " + myPos.begin();
 }
 
 const std::string StrToken::str() const {
-	return this->myStr;
+	return std::string(myText, myLen);
 }
 
-IntLitToken::IntLitToken(Position * pos, int numIn)
-  : Token(pos, TokenKind::INTLITERAL), myNum(numIn){}
+IntLitToken::IntLitToken(const Position& posIn, int numIn)
+  : Token(posIn, TokenKind::INTLITERAL), myNum(numIn){}
 
 std::string IntLitToken::toString(){
 	return tokenKindString(kind()) + ":"
 	+ std::to_string(this->myNum) + " "
-	+ myPos->begin();
+	+ myPos.begin();
 }
 
 int IntLitToken::num() const {
@@ -3,45 +3,60 @@
 
 #include <string>
 #include "position.hpp"
+#include "interner.hpp"
 
 namespace drewgon{
 
+//The name of a token kind, as it is written out with -t
+std::string tokenKindString(int tokKind);
+
 class Token{
 public:
-	Token(Position * pos, int kindIn);
+	Token(const Position& posIn, int kindIn);
 	virtual std::string toString();
 	size_t line() const;
 	size_t col() const;
 	int kind() const;
 	const Position * pos() const;
 protected:
-	const Position * myPos;
+	Position myPos;
 private:
 	const int myKind;
 };
 
 class IDToken : public Token{
 public:
-	IDToken(Position * posIn, std::string valIn);
+	//The name is a view of the source text, not a copy, and is
+	// interned as the token is made
+	IDToken(const Position& posIn, const char * textIn, size_t lenIn);
 	const std::string value() const;
+	const char * text() const { return myText; }
+	size_t length() const { return myLen; }
+	SymbolId id() const { return myId; }
 	virtual std::string toString() override;
 private:
-	const std::string myValue;
+	const char * myText;
+	const size_t myLen;
+	const SymbolId myId;
 
 };
 
 class StrToken : public Token{
 public:
-	StrToken(Position * posIn, std::string valIn);
+	//The literal is a view of the source text, not a copy
+	StrToken(const Position& posIn, const char * textIn, size_t lenIn);
 	virtual std::string toString() override;
 	const std::string str() const;
+	const char * text() const { return myText; }
+	size_t length() const { return myLen; }
 private:
-	const std::string myStr;
+	const char * myText;
+	const size_t myLen;
 };
 
 class IntLitToken : public Token{
 public:
-	IntLitToken(Position * posIn, int numIn);
+	IntLitToken(const Position& posIn, int numIn);
 	virtual std::string toString() override;
 	int num() const;
 private:
@@ -2,6 +2,7 @@
 
 #include "name_analysis.hpp"
 #include "type_analysis.hpp"
+#include "timing.hpp"
 
 namespace drewgon {
 
@@ -12,6 +13,7 @@ TypeAnalysis * TypeAnalysis::build(NameAnalysis * nameAnalysis){
 
 	ast->typeAnalysis(typeAnalysis);
 	if (typeAnalysis->hasError){
+		delete typeAnalysis;
 		return nullptr;
 	}
 
@@ -20,7 +22,7 @@ TypeAnalysis * TypeAnalysis::build(NameAnalysis * nameAnalysis){
 }
 
 void ProgramNode::typeAnalysis(TypeAnalysis * typing){
-	for (auto decl : *myGlobals){
+	for (auto decl : myGlobals){
 		decl->typeAnalysis(typing);
 	}
 	typing->nodeType(this, BasicType::VOID());
@@ -41,22 +43,24 @@ void VarDeclNode::typeAnalysis(TypeAnalysis * typing){
 }
 
 void FnDeclNode::typeAnalysis(TypeAnalysis * typing){
+	PhaseTimer timer("function", ID()->getName());
 	myRetType->typeAnalysis(typing);
 	const DataType * retDataType = typing->nodeType(myRetType);
 
 	//auto formalTypes = new std::list<const DataType *>();
-	auto formalNodes = new std::list<TypeNode *>();
-	for (auto formal : *myFormals){
+	std::vector<TypeNode *> formalNodes;
+	for (auto formal : myFormals){
 		formal->typeAnalysis(typing);
 		TypeNode * typeNode = formal->getTypeNode();
-		formalNodes->push_back(typeNode);
+		formalNodes.push_back(typeNode);
 	}
-	const TypeList * list = TypeList::produce(formalNodes);
+	const TypeList * list = TypeList::produce(Span<TypeNode *>(
+	  formalNodes.data(), formalNodes.size()));
 
 	typing->nodeType(this, FnType::produce(list, retDataType));
 
 	typing->setCurrentFnType(typing->nodeType(this)->asFn());
-	for (auto stmt : *myBody){
+	for (auto stmt : body()){
 		stmt->typeAnalysis(typing);
 	}
 	typing->setCurrentFnType(nullptr);
@@ -125,10 +129,10 @@ void AssignExpNode::typeAnalysis(TypeAnalysis * typing){
 
 void CallExpNode::typeAnalysis(TypeAnalysis * typing){
 
-	std::list<const DataType *> * aList = new std::list<const DataType *>();
-	for (auto actual : *myArgs){
+	std::list<const DataType *> aList;
+	for (auto actual : myArgs){
 		actual->typeAnalysis(typing);
-		aList->push_back(typing->nodeType(actual));
+		aList.push_back(typing->nodeType(actual));
 	}
 
 	SemSymbol * calleeSym = myID->getSymbol();
@@ -143,15 +147,15 @@ void CallExpNode::typeAnalysis(TypeAnalysis * typing){
 
 	const TypeList * formals = fnType->getFormalTypes();
 	const std::list<const DataType *>* fList = formals->getTypes();
-	if (aList->size() != fList->size()){
+	if (aList.size() != fList->size()){
 		typing->errArgCount(pos());
 		//Note: we still consider the call to return the
 		// return type
 	} else {
-		auto actualTypesItr = aList->begin();
+		auto actualTypesItr = aList.begin();
 		auto formalTypesItr = fList->begin();
-		auto actualsItr = myArgs->begin();
-		while(actualTypesItr != aList->end()){
+		auto actualsItr = myArgs.begin();
+		while(actualTypesItr != aList.end()){
 			const DataType * actualType = *actualTypesItr;
 			const DataType * formalType = *formalTypesItr;
 			ExpNode * actual = *actualsItr;
@@ -514,7 +518,7 @@ void IfStmtNode::typeAnalysis(TypeAnalysis * typing){
 			ErrorType::produce());
 	}
 
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->typeAnalysis(typing);
 	}
 
@@ -537,10 +541,10 @@ void IfElseStmtNode::typeAnalysis(TypeAnalysis * typing){
 		typing->errIfCond(myCond->pos());
 		goodCond = false;
 	}
-	for (auto stmt : *myBodyTrue){
+	for (auto stmt : myBodyTrue){
 		stmt->typeAnalysis(typing);
 	}
-	for (auto stmt : *myBodyFalse){
+	for (auto stmt : myBodyFalse){
 		stmt->typeAnalysis(typing);
 	}
 
@@ -562,7 +566,7 @@ void WhileStmtNode::typeAnalysis(TypeAnalysis * typing){
 		typing->errLoopCond(myCond->pos());
 	}
 
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->typeAnalysis(typing);
 	}
 
@@ -581,7 +585,7 @@ void ForStmtNode::typeAnalysis(TypeAnalysis * typing){
 	}
 
 	myItr->typeAnalysis(typing);
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->typeAnalysis(typing);
 	}
 }
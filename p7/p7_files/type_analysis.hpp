@@ -19,7 +19,9 @@ class TypeAnalysis {
 
 private:
 	//The private constructor here means that the type analysis
-	// can only be created via the static build function
+	// can only be created via the static build function (or, to
+	// report its errors, by the flat one in flat_analysis.cpp)
+	friend class FlatTyper;
 	TypeAnalysis(){
 		hasError = false;
 	}
@@ -58,17 +58,22 @@ static bool typelistMatch(const std::list<const DataType *> * first, const std::
 	return true;
 }
 
-TypeList * TypeList::produce(const std::list<TypeNode *> * typeNodes){
-	//Use a flyweight here
-	static std::list<TypeList *> knownLists;
-
+TypeList * TypeList::produce(const Span<TypeNode *>& typeNodes){
 	std::list<const DataType *> * candidate = new std::list<const DataType *>();
-	for (auto node : *typeNodes){
+	for (auto node : typeNodes){
 		const TypeNode * n = &(*node);
 		const DataType * t = n->getType();
 		candidate->push_back(t);
 	}
+	return produce(candidate);
+}
+
+TypeList * TypeList::produce(std::list<const DataType *> * candidate){
+	//Use a flyweight here
+	static std::list<TypeList *> knownLists;
+	static std::mutex knownLock;
 
+	std::lock_guard<std::mutex> guard(knownLock);
 	TypeList * exists = nullptr;
 	for (TypeList * known : knownLists){
 		if (typelistMatch(known->types, candidate)){
@@ -82,6 +87,7 @@ TypeList * TypeList::produce(const std::list<TypeNode *> * typeNodes){
 		knownLists.push_back(t);
 		return t;
 	} else {
+		delete candidate;
 		return exists;
 	}
 }
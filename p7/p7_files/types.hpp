@@ -4,8 +4,10 @@
 #include <list>
 #include <sstream>
 #include "errors.hpp"
+#include "span.hpp"
 
 #include <unordered_map>
+#include <mutex>
 
 #ifndef DREWGON_HASH_MAP_ALIAS
 // Use an alias template so that we can use
@@ -108,16 +110,23 @@ public:
 		//means that the flyweights variable persists between
 		// multiple calls to this function (it is essentially
 		// a global variable that can only be accessed
-		// in this function).
-		static std::list<BasicType *> flyweights;
+		// in this function). There are only a handful of base
+		// types, so all of them are built up front; the language
+		// guarantees a static local is initialized exactly once
+		// even if several threads get here at the same time, so
+		// lookups afterwards need no locking.
+		static BasicType * const flyweights[] = {
+			new BasicType(BaseType::INT),
+			new BasicType(BaseType::VOID),
+			new BasicType(BaseType::STRING),
+			new BasicType(BaseType::BOOL),
+		};
 		for(BasicType * fly : flyweights){
 			if (fly->getBaseType() == base){
 				return fly;
 			}
 		}
-		BasicType * newType = new BasicType(base);
-		flyweights.push_back(newType);
-		return newType;
+		throw new InternalError("produce of unknown base type");
 	}
 	const BasicType * asBasic() const override {
 		return this;
@@ -131,6 +140,9 @@ public:
 	bool isBool() const override {
 		return myBaseType == BaseType::BOOL;
 	}
+	bool isString() const override {
+		return myBaseType == BaseType::STRING;
+	}
 	virtual bool isVoid() const override {
 		return myBaseType == BaseType::VOID;
 	}
@@ -164,7 +176,9 @@ private:
 
 class TypeList : public DataType{
 public:
-	static TypeList * produce(const std::list<TypeNode *> * typeNodes);
+	static TypeList * produce(const Span<TypeNode *>& typeNodes);
+	//The list of the given types, which it takes
+	static TypeList * produce(std::list<const DataType *> * candidate);
 	size_t count() const{ return types->size(); }
 	size_t getSize() const {
 		size_t res = 0;
@@ -198,6 +212,10 @@ class FnType : public DataType{
 public:
 	static FnType * produce(const TypeList * inTypes, const DataType * outType){
 		static std::list<FnType *> knownFnTypes;
+		//Compilations may run concurrently (see batch mode),
+		// so the flyweight list is guarded
+		static std::mutex knownLock;
+		std::lock_guard<std::mutex> guard(knownLock);
 		for (auto knownFnType : knownFnTypes){
 			if (knownFnType->sameSigAs(inTypes, outType)){
 				return knownFnType;
@@ -8,7 +8,7 @@ static void doIndent(std::ostream& out, int indent){
 }
 
 void ProgramNode::unparse(std::ostream& out, int indent){
-	for (DeclNode * decl : *myGlobals){
+	for (DeclNode * decl : myGlobals){
 		decl->unparse(out, indent);
 	}
 }
@@ -41,13 +41,13 @@ void FnDeclNode::unparse(std::ostream& out, int indent){
 	myID->unparse(out, 0);
 	out << "(";
 	bool firstFormal = true;
-	for(auto formal : *myFormals){
+	for(auto formal : myFormals){
 		if (firstFormal) { firstFormal = false; }
 		else { out << ", "; }
 		formal->unparse(out, 0);
 	}
 	out << "){\n";
-	for(auto stmt : *myBody){
+	for(auto stmt : body()){
 		stmt->unparse(out, indent+1);
 	}
 	doIndent(out, indent);
@@ -109,7 +109,7 @@ void IfStmtNode::unparse(std::ostream& out, int indent){
 	out << "if (";
 	myCond->unparse(out, 0);
 	out << "){\n";
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->unparse(out, indent + 1);
 	}
 	doIndent(out, indent);
@@ -121,12 +121,12 @@ void IfElseStmtNode::unparse(std::ostream& out, int indent){
 	out << "if (";
 	myCond->unparse(out, 0);
 	out << "){\n";
-	for (auto stmt : *myBodyTrue){
+	for (auto stmt : myBodyTrue){
 		stmt->unparse(out, indent + 1);
 	}
 	doIndent(out, indent);
 	out << "} else {\n";
-	for (auto stmt : *myBodyFalse){
+	for (auto stmt : myBodyFalse){
 		stmt->unparse(out, indent + 1);
 	}
 	doIndent(out, indent);
@@ -138,7 +138,7 @@ void WhileStmtNode::unparse(std::ostream& out, int indent){
 	out << "while (";
 	myCond->unparse(out, 0);
 	out << "){\n";
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->unparse(out, indent + 1);
 	}
 	doIndent(out, indent);
@@ -154,7 +154,7 @@ void ForStmtNode::unparse(std::ostream& out, int indent){
 	out << "; ";
 	myItr->unparse(out, -1);
 	out << "){\n";
-	for (auto stmt : *myBody){
+	for (auto stmt : myBody){
 		stmt->unparse(out, indent + 1);
 	}
 	doIndent(out, indent);
@@ -197,7 +197,7 @@ void CallExpNode::unparse(std::ostream& out, int indent){
 	out << "(";
 
 	bool firstArg = true;
-	for(auto arg : *myArgs){
+	for(auto arg : myArgs){
 		if (firstArg) { firstArg = false; }
 		else { out << ", "; }
 		arg->unparse(out, 0);
@@ -323,7 +323,7 @@ void FnTypeNode::unparse(std::ostream& out, int indent){
 	doIndent(out, indent);
 	bool first = true;
 	out << "fn (";
-	for (auto inType : *myInTypes){
+	for (auto inType : myInTypes){
 		if (first){ first = false; }
 		else { out << ", "; }
 		inType->unparse(out, indent);
@@ -342,7 +342,7 @@ void AssignExpNode::unparse(std::ostream& out, int indent){
 
 void IDNode::unparse(std::ostream& out, int indent){
 	doIndent(out, indent);
-	out << name;
+	out << getName();
 	if (mySymbol != nullptr){
 		out << "("
 		  << mySymbol->getDataType()->getString()
@@ -366,7 +366,7 @@ void IntLitNode::unparse(std::ostream& out, int indent){
 
 void StrLitNode::unparse(std::ostream& out, int indent){
 	doIndent(out, indent);
-	out << myStr;
+	out.write(myText, static_cast<std::streamsize>(myLen));
 }
 
 void TrueNode::unparse(std::ostream& out, int indent){
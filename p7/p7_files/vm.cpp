@@ -0,0 +1,440 @@
+#include <algorithm>
+#include <memory>
+#include "vm.hpp"
+#include "errors.hpp"
+#include "host_runtime.hpp"
+#include "timing.hpp"
+
+namespace drewgon{
+
+namespace {
+
+//Enough for the deep recursion the test programs do, while
+// still catching runaway recursion before it exhausts memory
+const size_t STACK_SLOTS = size_t(1) << 22;
+const size_t MAX_DEPTH = size_t(1) << 18;
+
+[[noreturn]] void vmError(const std::string& msg){
+	throw new InternalError(("VM: " + msg).c_str());
+}
+
+//The text of a string literal, as the scanner kept it (quoted
+// and escaped), turned into the string it stands for
+std::string unescape(const std::string& lit){
+	std::string res;
+	size_t end = lit.size() > 0 && lit.back() == '"' ? lit.size() - 1 : lit.size();
+	for (size_t i = lit.empty() || lit[0] != '"' ? 0 : 1; i < end; i++){
+		if (lit[i] != '\\' || i + 1 == end){
+			res += lit[i];
+			continue;
+		}
+		i++;
+		switch (lit[i]){
+			case 'n': res += '\n'; break;
+			case 't': res += '\t'; break;
+			default: res += lit[i]; break;
+		}
+	}
+	return res;
+}
+
+//Arithmetic wraps around, as it does in generated code
+int64_t wrap(uint64_t val){
+	return static_cast<int64_t>(val);
+}
+
+uint64_t bits(int64_t val){
+	return static_cast<uint64_t>(val);
+}
+
+}
+
+VMBuilder::VMBuilder(VMProgram * vmIn, IRProgram * prog) : vm(vmIn){
+	std::list<Procedure *> * procs = prog->getProcs();
+	uint32_t idx = 0;
+	for (Procedure * p : *procs){
+		procIdx[p->getName()] = idx++;
+		for (auto str : p->getStrings()){
+			vm->strings.push_back(unescape(str.second));
+			const char * text = vm->strings.back().c_str();
+			stringAddrs[str.first] = reinterpret_cast<intptr_t>(text);
+		}
+	}
+
+	//A function's global holds the function, as its procedure
+	// index plus one so that an unset function pointer is 0
+	for (Opd * opd : prog->globalSyms()){
+		SymOpd * sym = static_cast<SymOpd *>(opd);
+		int64_t val = 0;
+		if (sym->getSym()->getKind() == FN){
+			auto found = procIdx.find(sym->getName());
+			if (found != procIdx.end()){ val = found->second + 1; }
+		}
+		globalSlots[opd] = static_cast<uint32_t>(vm->globals.size());
+		vm->globals.push_back(val);
+	}
+}
+
+void VMBuilder::emit(VMOp op, uint32_t a, uint32_t b, uint32_t c){
+	VMInstr instr;
+	instr.op = op;
+	instr.a = a;
+	instr.b = b;
+	instr.c = c;
+	vm->code.push_back(instr);
+}
+
+uint32_t VMBuilder::frameSlot(int64_t val){
+	uint32_t slot = static_cast<uint32_t>(init.size());
+	init.push_back(val);
+	return slot << 1;
+}
+
+uint32_t VMBuilder::operand(Opd * opd){
+	if (opd == nullptr){
+		throw new InternalError("VM: null operand");
+	}
+	auto global = globalSlots.find(opd);
+	if (global != globalSlots.end()){
+		return global->second << 1 | 1;
+	}
+	auto local = frameSlots.find(opd);
+	if (local != frameSlots.end()){
+		return local->second;
+	}
+
+	//Literals share a slot per value
+	int64_t val;
+	auto str = stringAddrs.find(opd);
+	if (str != stringAddrs.end()){
+		val = str->second;
+	} else if (LitOpd * lit = dynamic_cast<LitOpd *>(opd)){
+		val = std::stoll(lit->valString());
+	} else {
+		uint32_t slot = frameSlot(0);
+		frameSlots[opd] = slot;
+		return slot;
+	}
+	auto known = constSlots.find(val);
+	if (known != constSlots.end()){
+		return known->second;
+	}
+	uint32_t slot = frameSlot(val);
+	constSlots[val] = slot;
+	return slot;
+}
+
+void VMBuilder::jump(VMOp op, Label * target, uint32_t cnd){
+	jumps.push_back(std::make_pair(vm->code.size(), target));
+	emit(op, cnd);
+}
+
+void VMBuilder::call(SemSymbol * callee){
+	if (callee->getKind() == FN){
+		auto found = procIdx.find(callee->getName());
+		if (found == procIdx.end()){
+			vmError("no procedure for " + callee->getName());
+		}
+		emit(VM_CALL, found->second);
+	} else {
+		emit(VM_CALL_PTR, operand(proc->getSymOpd(callee)));
+	}
+}
+
+uint32_t VMBuilder::argIndex(size_t index){
+	vm->maxArgs = std::max(vm->maxArgs, index);
+	return static_cast<uint32_t>(index);
+}
+
+void VMBuilder::translate(Procedure * procIn){
+	proc = procIn;
+	if (proc->isCached()){
+		vmError(proc->getName() + " has no 3AC: it came from the function cache");
+	}
+	frameSlots.clear();
+	constSlots.clear();
+	init.clear();
+	labelAt.clear();
+	jumps.clear();
+
+	VMProgram::Proc res;
+	res.entry = vm->code.size();
+	for (auto quad : *proc->getQuads()){
+		for (Label * label : quad->getLabels()){
+			labelAt[label] = vm->code.size();
+		}
+		quad->toVM(*this);
+	}
+	for (Label * label : proc->getLeave()->getLabels()){
+		labelAt[label] = vm->code.size();
+	}
+	proc->getLeave()->toVM(*this);
+
+	for (auto jump : jumps){
+		auto found = labelAt.find(jump.second);
+		if (found == labelAt.end()){
+			vmError("jump to unknown label " + jump.second->getName());
+		}
+		vm->code[jump.first].c = static_cast<uint32_t>(found->second);
+	}
+	res.numSlots = init.size();
+	res.initAt = vm->templates.size();
+	vm->templates.insert(vm->templates.end(), init.begin(), init.end());
+	vm->procs.push_back(res);
+}
+
+VMProgram * VMProgram::compile(IRProgram * prog){
+	PhaseTimer timer("vm translate");
+	VMProgram * vm = new VMProgram();
+	try {
+		VMBuilder builder(vm, prog);
+		auto main = builder.procIdx.find("main");
+		if (main == builder.procIdx.end()){ vmError("no main function"); }
+		vm->mainProc = main->second;
+		for (Procedure * proc : *prog->getProcs()){
+			builder.translate(proc);
+		}
+	} catch (InternalError *){
+		delete vm;
+		throw;
+	}
+	return vm;
+}
+
+//Threaded dispatch: each handler ends by jumping straight to the
+// next instruction's handler, through a table of label
+// addresses (a GNU extension, hence the pragmas)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+int64_t VMProgram::run(){
+	static void * const handlers[] = {
+		&&op_mov,
+		&&op_add, &&op_sub, &&op_mul, &&op_div,
+		&&op_eq, &&op_ne, &&op_lt, &&op_gt, &&op_le, &&op_ge,
+		&&op_and, &&op_or,
+		&&op_neg, &&op_not,
+		&&op_jmp, &&op_jz,
+		&&op_out_int, &&op_out_bool, &&op_out_str,
+		&&op_in_int, &&op_in_bool, &&op_mayhem,
+		&&op_set_arg, &&op_get_arg, &&op_set_ret, &&op_get_ret,
+		&&op_call, &&op_call_ptr, &&op_ret,
+	};
+
+	class Frame{
+	public:
+		const VMInstr * ret;
+		int64_t * slots;
+	};
+
+	//Not zeroed, so that only the pages the program reaches get
+	// touched: calls fill in every slot of a frame
+	std::unique_ptr<int64_t[]> stack(new int64_t[STACK_SLOTS]);
+	std::unique_ptr<Frame[]> calls(new Frame[MAX_DEPTH]);
+	std::vector<int64_t> args(maxArgs + 1);
+	std::vector<int64_t> globalVals(globals);
+	int64_t * stackEnd = stack.get() + STACK_SLOTS;
+	const VMInstr * start = code.data();
+	const int64_t * tmpl = templates.data();
+	int64_t * glob = globalVals.data();
+	int64_t * arg = args.data();
+	int64_t retVal = 0;
+	size_t depth = 0;
+
+	const Proc * callee = &procs[mainProc];
+	int64_t * frame = stack.get();
+	int64_t * top = frame;
+	const VMInstr * ip = nullptr;
+	goto enter;
+
+#define VAL(opd) (((opd) & 1 ? glob : frame)[(opd) >> 1])
+#define NEXT() do { ip++; goto *handlers[ip->op]; } while (0)
+#define BINOP(expr) do { \
+		int64_t lhs = VAL(ip->b); \
+		int64_t rhs = VAL(ip->c); \
+		VAL(ip->a) = (expr); \
+		NEXT(); \
+	} while (0)
+
+op_mov: VAL(ip->a) = VAL(ip->b); NEXT();
+op_add: BINOP(wrap(bits(lhs) + bits(rhs)));
+op_sub: BINOP(wrap(bits(lhs) - bits(rhs)));
+op_mul: BINOP(wrap(bits(lhs) * bits(rhs)));
+op_div: {
+	int64_t lhs = VAL(ip->b);
+	int64_t rhs = VAL(ip->c);
+	if (rhs == 0){ vmError("division by zero"); }
+	VAL(ip->a) = rhs == -1 ? wrap(0 - bits(lhs)) : lhs / rhs;
+	NEXT();
+}
+op_eq: BINOP(lhs == rhs);
+op_ne: BINOP(lhs != rhs);
+op_lt: BINOP(lhs < rhs);
+op_gt: BINOP(lhs > rhs);
+op_le: BINOP(lhs <= rhs);
+op_ge: BINOP(lhs >= rhs);
+op_and: BINOP(lhs & rhs);
+op_or: BINOP(lhs | rhs);
+op_neg: VAL(ip->a) = wrap(0 - bits(VAL(ip->b))); NEXT();
+op_not: VAL(ip->a) = VAL(ip->b) == 0; NEXT();
+op_jmp:
+	ip = start + ip->c;
+	goto *handlers[ip->op];
+op_jz:
+	if (VAL(ip->a) == 0){
+		ip = start + ip->c;
+		goto *handlers[ip->op];
+	}
+	NEXT();
+op_out_int: hostrt::printInt(VAL(ip->a)); NEXT();
+op_out_bool: hostrt::printBool(VAL(ip->a)); NEXT();
+op_out_str:
+	hostrt::printString(reinterpret_cast<const char *>(
+	  static_cast<intptr_t>(VAL(ip->a))));
+	NEXT();
+op_in_int: VAL(ip->a) = hostrt::getInt(); NEXT();
+op_in_bool: VAL(ip->a) = hostrt::getBool(); NEXT();
+op_mayhem: VAL(ip->a) = hostrt::mayhem(); NEXT();
+op_set_arg: arg[ip->b] = VAL(ip->a); NEXT();
+op_get_arg: VAL(ip->a) = arg[ip->b]; NEXT();
+op_set_ret: retVal = VAL(ip->a); NEXT();
+op_get_ret: VAL(ip->a) = retVal; NEXT();
+op_call_ptr: {
+	int64_t fn = VAL(ip->a);
+	if (fn < 1 || static_cast<uint64_t>(fn) > procs.size()){
+		vmError("call through a function pointer that was never set");
+	}
+	callee = &procs[static_cast<size_t>(fn - 1)];
+	goto call;
+}
+op_call:
+	callee = &procs[ip->a];
+call:
+	if (depth == MAX_DEPTH){ vmError("stack overflow"); }
+	calls[depth].ret = ip + 1;
+	calls[depth].slots = frame;
+	depth++;
+	frame = top;
+enter:
+	if (callee->numSlots > static_cast<size_t>(stackEnd - frame)){
+		vmError("stack overflow");
+	}
+	top = frame + callee->numSlots;
+	std::copy(tmpl + callee->initAt, tmpl + callee->initAt + callee->numSlots,
+	  frame);
+	ip = start + callee->entry;
+	goto *handlers[ip->op];
+op_ret:
+	if (depth == 0){
+		Report::messages().flush();
+		return retVal;
+	}
+	top = frame;
+	depth--;
+	ip = calls[depth].ret;
+	frame = calls[depth].slots;
+	goto *handlers[ip->op];
+
+#undef BINOP
+#undef NEXT
+#undef VAL
+}
+
+#pragma GCC diagnostic pop
+
+void BinOpQuad::toVM(VMBuilder& vm){
+	//Every value is a quadword, and the byte-wide operations
+	// are only ever applied to bools, so both widths share
+	// their handlers
+	VMOp op;
+	switch (opr){
+		case ADD64: case ADD8: op = VM_ADD; break;
+		case SUB64: case SUB8: op = VM_SUB; break;
+		case MULT64: case MULT8: op = VM_MUL; break;
+		case DIV64: case DIV8: op = VM_DIV; break;
+		case EQ64: case EQ8: op = VM_EQ; break;
+		case NEQ64: case NEQ8: op = VM_NE; break;
+		case LT64: case LT8: op = VM_LT; break;
+		case GT64: case GT8: op = VM_GT; break;
+		case LTE64: case LTE8: op = VM_LE; break;
+		case GTE64: case GTE8: op = VM_GE; break;
+		case AND64: case AND8: op = VM_AND; break;
+		case OR64: case OR8: op = VM_OR; break;
+		default: throw new InternalError("VM: bad binary operator");
+	}
+	vm.emit(op, vm.operand(dst), vm.operand(src1), vm.operand(src2));
+}
+
+void UnaryOpQuad::toVM(VMBuilder& vm){
+	VMOp opc = op == NEG64 || op == NEG8 ? VM_NEG : VM_NOT;
+	vm.emit(opc, vm.operand(dst), vm.operand(src));
+}
+
+void AssignQuad::toVM(VMBuilder& vm){
+	vm.emit(VM_MOV, vm.operand(dst), vm.operand(src));
+}
+
+void LocQuad::toVM(VMBuilder& vm){
+	throw new InternalError("VM: LocQuad is never generated");
+}
+
+void GotoQuad::toVM(VMBuilder& vm){
+	vm.jump(VM_JMP, tgt);
+}
+
+void IfzQuad::toVM(VMBuilder& vm){
+	vm.jump(VM_JZ, tgt, vm.operand(cnd));
+}
+
+void NopQuad::toVM(VMBuilder& vm){
+	//Labels on a nop just refer to the next instruction
+}
+
+void IntrinsicOutputQuad::toVM(VMBuilder& vm){
+	VMOp op = VM_OUT_INT;
+	if (myType->isString()){
+		op = VM_OUT_STR;
+	} else if (myType->isBool()){
+		op = VM_OUT_BOOL;
+	}
+	vm.emit(op, vm.operand(myArg));
+}
+
+void IntrinsicInputQuad::toVM(VMBuilder& vm){
+	VMOp op = myType->isBool() ? VM_IN_BOOL : VM_IN_INT;
+	vm.emit(op, vm.operand(myArg));
+}
+
+void IntrinsicMayhemQuad::toVM(VMBuilder& vm){
+	vm.emit(VM_MAYHEM, vm.operand(myDst));
+}
+
+void CallQuad::toVM(VMBuilder& vm){
+	vm.call(callee);
+}
+
+void EnterQuad::toVM(VMBuilder& vm){
+	//Calls set up the frame
+}
+
+void LeaveQuad::toVM(VMBuilder& vm){
+	vm.emit(VM_RET);
+}
+
+void SetArgQuad::toVM(VMBuilder& vm){
+	vm.emit(VM_SET_ARG, vm.operand(opd), vm.argIndex(index));
+}
+
+void GetArgQuad::toVM(VMBuilder& vm){
+	vm.emit(VM_GET_ARG, vm.operand(opd), vm.argIndex(index));
+}
+
+void SetRetQuad::toVM(VMBuilder& vm){
+	vm.emit(VM_SET_RET, vm.operand(opd));
+}
+
+void GetRetQuad::toVM(VMBuilder& vm){
+	vm.emit(VM_GET_RET, vm.operand(opd));
+}
+
+}
@@ -0,0 +1,114 @@
+#ifndef DREWGON_VM_HPP
+#define DREWGON_VM_HPP
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include "3ac.hpp"
+
+namespace drewgon{
+
+enum VMOp : uint32_t{
+	VM_MOV,
+	VM_ADD, VM_SUB, VM_MUL, VM_DIV,
+	VM_EQ, VM_NE, VM_LT, VM_GT, VM_LE, VM_GE,
+	VM_AND, VM_OR,
+	VM_NEG, VM_NOT,
+	VM_JMP, VM_JZ,
+	VM_OUT_INT, VM_OUT_BOOL, VM_OUT_STR,
+	VM_IN_INT, VM_IN_BOOL, VM_MAYHEM,
+	VM_SET_ARG, VM_GET_ARG, VM_SET_RET, VM_GET_RET,
+	VM_CALL, VM_CALL_PTR, VM_RET
+};
+
+//Operands are slot numbers, shifted left by one with the low
+// bit set for globals. Jumps keep their target's index in c,
+// and calls the callee's procedure index in a.
+class VMInstr{
+public:
+	VMOp op;
+	uint32_t a;
+	uint32_t b;
+	uint32_t c;
+};
+
+// A program's 3AC translated into bytecode for dgc's own
+// interpreter, so that it can run without x64 code being
+// generated, assembled or linked for it.
+//
+// Every value lives in a 64-bit slot, either in the running
+// procedure's frame or among the globals. Literals get frame
+// slots too, which a call fills in from the procedure's
+// template, so instructions never tell constants apart from
+// variables.
+//
+// Runtime intrinsics behave as they do under --run, writing to
+// Report::messages() and reading from std::cin. Errors the
+// program makes (dividing by zero, recursing too deeply) are
+// reported by throwing an InternalError.
+class VMProgram{
+public:
+	//Throws an InternalError for 3AC the VM can't run, such as
+	// a procedure whose quads were never built because it came
+	// from the function cache
+	static VMProgram * compile(IRProgram * prog);
+
+	//Call main, returning the value it returns
+	int64_t run();
+private:
+	friend class VMBuilder;
+	class Proc{
+	public:
+		size_t entry;
+		size_t numSlots;
+		//Where the proc's frame template starts in templates
+		size_t initAt;
+	};
+
+	VMProgram(){ }
+
+	std::vector<VMInstr> code;
+	std::vector<Proc> procs;
+	std::vector<int64_t> templates;
+	std::vector<int64_t> globals;
+	size_t maxArgs = 0;
+	size_t mainProc = 0;
+	//Backing store for string literals, which slots point into
+	std::list<std::string> strings;
+};
+
+// Translates a procedure's quads into a VMProgram, one at a time
+// through Quad::toVM.
+class VMBuilder{
+public:
+	void emit(VMOp op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0);
+	uint32_t operand(Opd * opd);
+	//A JMP or JZ (testing cnd) to target
+	void jump(VMOp op, Label * target, uint32_t cnd = 0);
+	void call(SemSymbol * callee);
+	uint32_t argIndex(size_t index);
+private:
+	VMBuilder(VMProgram * vmIn, IRProgram * prog);
+	void translate(Procedure * proc);
+	uint32_t frameSlot(int64_t init);
+	friend class VMProgram;
+
+	VMProgram * vm;
+	std::map<Opd *, uint32_t> globalSlots;
+	std::map<Opd *, int64_t> stringAddrs;
+	std::map<std::string, uint32_t> procIdx;
+
+	//The procedure being translated
+	Procedure * proc = nullptr;
+	std::map<Opd *, uint32_t> frameSlots;
+	std::map<int64_t, uint32_t> constSlots;
+	std::vector<int64_t> init;
+	std::map<Label *, size_t> labelAt;
+	std::vector<std::pair<size_t, Label *>> jumps;
+};
+
+}
+
+#endif
@@ -0,0 +1,725 @@
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <unordered_map>
+#include "x64_assembler.hpp"
+#include "errors.hpp"
+
+namespace drewgon{
+
+namespace {
+
+//A piece of the assembly text. Statements are parsed in place
+// through these, so nothing is copied out of the text unless
+// it has to outlive the line (such as a symbol name).
+class Span{
+public:
+	Span() : begin(nullptr), end(nullptr){ }
+	Span(const char * beginIn, const char * endIn)
+	: begin(beginIn), end(endIn){ }
+	bool empty() const{ return begin == end; }
+	size_t size() const{ return static_cast<size_t>(end - begin); }
+	char operator[](size_t idx) const{ return begin[idx]; }
+	char back() const{ return end[-1]; }
+	Span from(size_t idx) const{ return Span(begin + idx, end); }
+	Span upTo(size_t idx) const{ return Span(begin, begin + idx); }
+	Span trim() const{
+		const char * b = begin;
+		const char * e = end;
+		while (b < e && (*b == ' ' || *b == '\t' || *b == '\r')){ b++; }
+		while (e > b && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')){ e--; }
+		return Span(b, e);
+	}
+	//The index of the first c at or after start, or size()
+	size_t find(char c, size_t start = 0) const{
+		size_t len = size();
+		if (start >= len){ return len; }
+		const void * found = memchr(begin + start, c, len - start);
+		if (found == nullptr){ return len; }
+		return static_cast<size_t>(static_cast<const char *>(found) - begin);
+	}
+	bool operator==(const char * str) const{
+		size_t len = size();
+		return strncmp(begin, str, len) == 0 && str[len] == '\0';
+	}
+	std::string str() const{ return std::string(begin, end); }
+
+	const char * begin;
+	const char * end;
+};
+
+class Operand{
+public:
+	enum Kind { REG, IMM, MEM };
+	Kind kind = IMM;
+	//Size in bytes of a register operand
+	size_t size = 0;
+	int reg = -1;
+	//Memory operands: base register (or -1 for an absolute
+	// address), plus displacement and/or symbol
+	int base = -1;
+	int64_t value = 0;
+	std::string symbol;
+	//Byte registers that can only be named with a REX prefix
+	bool needsRex = false;
+	bool indirect = false;
+};
+
+bool fitsInt8(int64_t val){ return val >= -128 && val <= 127; }
+bool fitsInt32(int64_t val){
+	return val >= -2147483648LL && val <= 2147483647LL;
+}
+
+class Assembler{
+public:
+	Assembler() : mod(new ObjModule()), section(ObjModule::TEXT){ }
+	ObjModule * run(const std::string& text);
+private:
+	[[noreturn]] void fail(const std::string& msg);
+	void statement(Span stmt);
+	void directive(Span name, Span args);
+	void instruction(const std::string& mnemonic,
+	  std::vector<Operand>& ops);
+	void operand(Span text, Operand& op);
+	int64_t expression(Span text, std::string& symbol);
+	void define(Span label);
+	const ObjSymbol * lookup(const std::string& name) const{
+		auto found = symbolIdx.find(name);
+		if (found == symbolIdx.end()){ return nullptr; }
+		return &mod->symbols[found->second];
+	}
+
+	std::vector<unsigned char>& code(){
+		return mod->sections[section].bytes;
+	}
+	void byte(int val){
+		code().push_back(static_cast<unsigned char>(val));
+	}
+	void imm(int64_t val, size_t width){
+		for (size_t i = 0; i < width; i++){
+			byte(static_cast<int>((static_cast<uint64_t>(val) >> (8 * i)) & 0xff));
+		}
+	}
+	void reloc(RelocType type, const std::string& sym, int64_t addend){
+		ObjReloc rel;
+		rel.offset = code().size();
+		rel.type = type;
+		rel.symbol = sym;
+		rel.addend = addend;
+		mod->sections[section].relocs.push_back(rel);
+		referenced.insert(sym);
+	}
+	//A value the CPU sign-extends from 32 bits, which it must fit
+	// in (only a mov to a register has a 64-bit immediate)
+	void imm32(const Operand& op){
+		if (!op.symbol.empty()){
+			reloc(R_X86_64_32S, op.symbol, op.value);
+			imm(0, 4);
+		} else {
+			if (!fitsInt32(op.value)){ fail("value out of range"); }
+			imm(op.value, 4);
+		}
+	}
+
+	void rex(bool wide, int regField, const Operand& rm, bool force);
+	void modrm(int regField, const Operand& rm);
+	void encode(std::initializer_list<int> opcode, bool wide, int regField,
+	  const Operand& rm, bool forceRex);
+	void branch(std::initializer_list<int> opcode, const Operand& target);
+
+	ObjModule * mod;
+	size_t section;
+	Span line;
+	std::vector<Operand> ops;
+	std::set<std::string> globals;
+	std::set<std::string> referenced;
+	std::unordered_map<std::string, size_t> symbolIdx;
+	//Branches to labels, resolved once every label is known
+	struct Fixup{
+		size_t section;
+		size_t offset;
+		std::string label;
+		int64_t addend;
+	};
+	std::vector<Fixup> fixups;
+};
+
+//The assembler's lookup tables are small enough that a scan
+// beats a map, particularly in an unoptimized build
+class NamedCode{
+public:
+	const char * name;
+	int code;
+};
+
+template <size_t N>
+int findCode(const NamedCode (&table)[N], Span name){
+	if (name.empty()){ return -1; }
+	for (const NamedCode& entry : table){
+		if (entry.name[0] == name[0] && name == entry.name){
+			return entry.code;
+		}
+	}
+	return -1;
+}
+
+template <size_t N>
+int findCode(const NamedCode (&table)[N], const std::string& name){
+	return findCode(table, Span(name.data(), name.data() + name.size()));
+}
+
+const NamedCode regs64[] = {
+	{"rax", 0}, {"rcx", 1}, {"rdx", 2}, {"rbx", 3},
+	{"rsp", 4}, {"rbp", 5}, {"rsi", 6}, {"rdi", 7},
+	{"r8", 8}, {"r9", 9}, {"r10", 10}, {"r11", 11},
+	{"r12", 12}, {"r13", 13}, {"r14", 14}, {"r15", 15},
+};
+
+const NamedCode regs8[] = {
+	{"al", 0}, {"cl", 1}, {"dl", 2}, {"bl", 3},
+	{"spl", 4}, {"bpl", 5}, {"sil", 6}, {"dil", 7},
+	{"r8b", 8}, {"r9b", 9}, {"r10b", 10}, {"r11b", 11},
+	{"r12b", 12}, {"r13b", 13}, {"r14b", 14}, {"r15b", 15},
+};
+
+//Condition codes, for jcc and setcc
+const NamedCode conditions[] = {
+	{"o", 0}, {"no", 1}, {"b", 2}, {"ae", 3}, {"e", 4}, {"z", 4},
+	{"ne", 5}, {"nz", 5}, {"be", 6}, {"a", 7}, {"s", 8}, {"ns", 9},
+	{"l", 12}, {"ge", 13}, {"le", 14}, {"g", 15},
+};
+
+//The /digit opcode extension of each two-operand ALU op
+const NamedCode aluOps[] = {
+	{"add", 0}, {"or", 1}, {"and", 4}, {"sub", 5},
+	{"xor", 6}, {"cmp", 7},
+};
+
+//...and of each one-operand op in the F6/F7 group
+const NamedCode unaryOps[] = {
+	{"not", 2}, {"neg", 3}, {"mul", 4}, {"imul", 5},
+	{"div", 6}, {"idiv", 7},
+};
+
+bool isSymbolChar(char c, bool first){
+	return isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '.'
+	  || c == '$' || (!first && isdigit(static_cast<unsigned char>(c)));
+}
+
+void Assembler::fail(const std::string& msg){
+	throw new InternalError(("Assembler: " + msg + " in: " + line.str()).c_str());
+}
+
+int64_t Assembler::expression(Span text, std::string& symbol){
+	Span expr = text.trim();
+	if (expr.empty()){ fail("missing expression"); }
+	if (isSymbolChar(expr[0], true) && expr[0] != '$'){
+		size_t pos = 0;
+		while (pos < expr.size() && isSymbolChar(expr[pos], false)){ pos++; }
+		symbol.assign(expr.begin, pos);
+		expr = expr.from(pos).trim();
+		if (expr.empty()){ return 0; }
+		if (expr[0] != '+' && expr[0] != '-'){ fail("bad expression"); }
+		if (expr[0] == '+'){ expr = expr.from(1).trim(); }
+	}
+	//The text is NUL-terminated, so strtoll stops in time;
+	// it just must not stop anywhere but the end of expr
+	char * end = nullptr;
+	int64_t value = strtoll(expr.begin, &end, 0);
+	if (end == expr.begin || end != expr.end){ fail("bad number"); }
+	return value;
+}
+
+void Assembler::operand(Span text, Operand& op){
+	op = Operand();
+	text = text.trim();
+	if (!text.empty() && text[0] == '*'){
+		op.indirect = true;
+		text = text.from(1).trim();
+	}
+	if (text.empty()){ fail("missing operand"); }
+	if (text[0] == '%'){
+		Span name = text.from(1);
+		int r64 = findCode(regs64, name);
+		int r8 = r64 < 0 ? findCode(regs8, name) : -1;
+		op.kind = Operand::REG;
+		if (r64 >= 0){
+			op.size = 8;
+			op.reg = r64;
+		} else if (r8 >= 0){
+			op.size = 1;
+			op.reg = r8;
+			op.needsRex = op.reg >= 4 && op.reg < 8;
+		} else {
+			fail("bad register %" + name.str());
+		}
+		return;
+	}
+	if (text[0] == '$'){
+		op.kind = Operand::IMM;
+		op.value = expression(text.from(1), op.symbol);
+		return;
+	}
+
+	//disp(%base), or an absolute address written as an
+	// expression (possibly in parentheses)
+	size_t paren = text.find('(');
+	if (paren < text.size() && text.find('%', paren) < text.size()){
+		size_t close = text.find(')', paren);
+		if (close == text.size() || !text.from(close + 1).trim().empty()){
+			fail("bad memory operand");
+		}
+		Span baseName = text.upTo(close).from(paren + 1).trim();
+		if (baseName.find(',') < baseName.size()){
+			fail("indexed addressing is not supported");
+		}
+		if (baseName.empty() || baseName[0] != '%'){
+			fail("bad base register");
+		}
+		int r64 = findCode(regs64, baseName.from(1));
+		if (r64 < 0){ fail("bad base register"); }
+		op.kind = Operand::MEM;
+		op.base = r64;
+		Span disp = text.upTo(paren).trim();
+		if (!disp.empty()){ op.value = expression(disp, op.symbol); }
+		return;
+	}
+	if (text[0] == '(' && text.back() == ')'){
+		text = Span(text.begin + 1, text.end - 1);
+	}
+	op.kind = Operand::MEM;
+	op.value = expression(text, op.symbol);
+}
+
+void Assembler::rex(bool wide, int regField, const Operand& rm, bool force){
+	int rmReg = rm.kind == Operand::REG ? rm.reg : rm.base;
+	int val = 0x40;
+	if (wide){ val |= 0x8; }
+	if (regField >= 8){ val |= 0x4; }
+	if (rmReg >= 8){ val |= 0x1; }
+	if (val != 0x40 || force || rm.needsRex){ byte(val); }
+}
+
+void Assembler::modrm(int regField, const Operand& rm){
+	int reg = (regField & 7) << 3;
+	if (rm.kind == Operand::REG){
+		byte(0xc0 | reg | (rm.reg & 7));
+		return;
+	}
+	if (rm.kind != Operand::MEM){ fail("expected a register or memory"); }
+	if (rm.base < 0){
+		//Absolute [disp32], with no base or index
+		byte(0x04 | reg);
+		byte(0x25);
+		imm32(rm);
+		return;
+	}
+	int base = rm.base & 7;
+	bool needSIB = base == 4;
+	if (rm.symbol.empty() && rm.value == 0 && base != 5){
+		byte(0x00 | reg | (needSIB ? 4 : base));
+		if (needSIB){ byte(0x24); }
+	} else if (rm.symbol.empty() && fitsInt8(rm.value)){
+		byte(0x40 | reg | (needSIB ? 4 : base));
+		if (needSIB){ byte(0x24); }
+		imm(rm.value, 1);
+	} else {
+		if (!fitsInt32(rm.value)){ fail("displacement out of range"); }
+		byte(0x80 | reg | (needSIB ? 4 : base));
+		if (needSIB){ byte(0x24); }
+		imm32(rm);
+	}
+}
+
+void Assembler::encode(std::initializer_list<int> opcode, bool wide,
+  int regField, const Operand& rm, bool forceRex){
+	rex(wide, regField, rm, forceRex);
+	for (int b : opcode){ byte(b); }
+	modrm(regField, rm);
+}
+
+void Assembler::branch(std::initializer_list<int> opcode,
+  const Operand& target){
+	if (target.kind != Operand::MEM || target.base >= 0
+	  || target.symbol.empty()){
+		fail("bad branch target");
+	}
+	for (int b : opcode){ byte(b); }
+	Fixup fix;
+	fix.section = section;
+	fix.offset = code().size();
+	fix.label = target.symbol;
+	fix.addend = target.value;
+	fixups.push_back(fix);
+	imm(0, 4);
+}
+
+void Assembler::instruction(const std::string& mnemonic,
+  std::vector<Operand>& ops){
+	if (mnemonic == "ret" || mnemonic == "retq"){
+		if (!ops.empty()){ fail("unexpected operand"); }
+		byte(0xc3);
+		return;
+	}
+	if (mnemonic == "nop"){
+		if (!ops.empty()){ fail("unexpected operand"); }
+		byte(0x90);
+		return;
+	}
+	if (mnemonic == "cqto" || mnemonic == "cqo"){
+		if (!ops.empty()){ fail("unexpected operand"); }
+		byte(0x48);
+		byte(0x99);
+		return;
+	}
+	if (mnemonic == "call" || mnemonic == "callq"
+	  || mnemonic == "jmp" || mnemonic == "jmpq"){
+		bool isCall = mnemonic[0] == 'c';
+		if (ops.size() != 1){ fail("expected one operand"); }
+		Operand& target = ops[0];
+		if (target.indirect){
+			if (target.kind == Operand::REG && target.size != 8){
+				fail("operand size mismatch");
+			}
+			encode({0xff}, false, isCall ? 2 : 4, target, false);
+		} else if (isCall){
+			branch({0xe8}, target);
+		} else {
+			branch({0xe9}, target);
+		}
+		return;
+	}
+	if (mnemonic[0] == 'j'){
+		int cc = findCode(conditions, mnemonic.substr(1));
+		if (cc < 0){ fail("unknown instruction " + mnemonic); }
+		if (ops.size() != 1 || ops[0].indirect){ fail("bad jump"); }
+		branch({0x0f, 0x80 | cc}, ops[0]);
+		return;
+	}
+	if (mnemonic.compare(0, 3, "set") == 0){
+		int cc = findCode(conditions, mnemonic.substr(3));
+		if (cc < 0){ fail("unknown instruction " + mnemonic); }
+		if (ops.size() != 1){ fail("expected one operand"); }
+		if (ops[0].kind == Operand::REG && ops[0].size != 1){
+			fail("operand size mismatch");
+		}
+		encode({0x0f, 0x90 | cc}, false, 0, ops[0], false);
+		return;
+	}
+	if (mnemonic == "movzbq"){
+		if (ops.size() != 2){ fail("expected two operands"); }
+		Operand& src = ops[0];
+		Operand& dst = ops[1];
+		if (src.indirect || dst.indirect){ fail("unexpected *"); }
+		if (src.kind == Operand::IMM || dst.kind != Operand::REG){
+			fail("bad operand");
+		}
+		if ((src.kind == Operand::REG && src.size != 1) || dst.size != 8){
+			fail("operand size mismatch");
+		}
+		encode({0x0f, 0xb6}, true, dst.reg, src, false);
+		return;
+	}
+
+	//Everything else takes an operand size, either from the
+	// mnemonic's suffix or from its register operands
+	std::string base = mnemonic;
+	size_t size = 0;
+	int aluDigit = -1;
+	int unaryDigit = -1;
+	auto isKnown = [&aluDigit, &unaryDigit](const std::string& name){
+		aluDigit = findCode(aluOps, name);
+		unaryDigit = findCode(unaryOps, name);
+		return aluDigit >= 0 || unaryDigit >= 0
+		  || name == "mov" || name == "push" || name == "pop";
+	};
+	if (!isKnown(base)){
+		char suffix = base[base.size() - 1];
+		base.resize(base.size() - 1);
+		if (!isKnown(base)){ fail("unknown instruction " + mnemonic); }
+		if (suffix == 'q'){ size = 8; }
+		else if (suffix == 'b'){ size = 1; }
+		else { fail("unsupported operand size"); }
+	}
+	for (const Operand& op : ops){
+		if (op.indirect){ fail("unexpected *"); }
+		if (op.kind != Operand::REG){ continue; }
+		if (size == 0){ size = op.size; }
+		if (op.size != size){ fail("operand size mismatch"); }
+	}
+	if (size == 0){ fail("no instruction suffix"); }
+	bool wide = size == 8;
+
+	if (base == "push" || base == "pop"){
+		if (ops.size() != 1 || ops[0].kind != Operand::REG || !wide){
+			fail("bad operand");
+		}
+		if (ops[0].reg >= 8){ byte(0x41); }
+		byte((base == "push" ? 0x50 : 0x58) + (ops[0].reg & 7));
+		return;
+	}
+
+	if (unaryDigit >= 0 && ops.size() == 1){
+		encode({wide ? 0xf7 : 0xf6}, wide, unaryDigit, ops[0], false);
+		return;
+	}
+	if (base == "imul" && ops.size() == 2){
+		if (ops[1].kind != Operand::REG || !wide){ fail("bad operand"); }
+		if (ops[0].kind == Operand::IMM){ fail("bad operand"); }
+		encode({0x0f, 0xaf}, wide, ops[1].reg, ops[0], false);
+		return;
+	}
+	if (ops.size() != 2){ fail("expected two operands"); }
+	Operand& src = ops[0];
+	Operand& dst = ops[1];
+	if (dst.kind == Operand::IMM){ fail("bad destination"); }
+	if (src.kind == Operand::MEM && dst.kind == Operand::MEM){
+		fail("too many memory references");
+	}
+	bool forceRex = src.needsRex || dst.needsRex;
+
+	if (base == "mov"){
+		if (src.kind == Operand::REG){
+			encode({wide ? 0x89 : 0x88}, wide, src.reg, dst, forceRex);
+		} else if (src.kind == Operand::MEM){
+			encode({wide ? 0x8b : 0x8a}, wide, dst.reg, src, forceRex);
+		} else if (!wide){
+			encode({0xc6}, false, 0, dst, forceRex);
+			imm(src.value, 1);
+		} else if (src.symbol.empty() && !fitsInt32(src.value)
+		  && dst.kind == Operand::REG){
+			//movabs
+			rex(true, 0, dst, false);
+			byte(0xb8 + (dst.reg & 7));
+			imm(src.value, 8);
+		} else {
+			encode({0xc7}, true, 0, dst, forceRex);
+			imm32(src);
+		}
+		return;
+	}
+
+	if (aluDigit < 0){ fail("bad operands for " + mnemonic); }
+	int digit = aluDigit;
+	if (src.kind == Operand::REG){
+		encode({digit * 8 + (wide ? 1 : 0)}, wide, src.reg, dst, forceRex);
+	} else if (src.kind == Operand::MEM){
+		encode({digit * 8 + (wide ? 3 : 2)}, wide, dst.reg, src, forceRex);
+	} else if (!wide){
+		encode({0x80}, false, digit, dst, forceRex);
+		imm(src.value, 1);
+	} else if (src.symbol.empty() && fitsInt8(src.value)){
+		encode({0x83}, true, digit, dst, forceRex);
+		imm(src.value, 1);
+	} else {
+		encode({0x81}, true, digit, dst, forceRex);
+		imm32(src);
+	}
+}
+
+void Assembler::define(Span label){
+	std::string name = label.str();
+	if (lookup(name) != nullptr){
+		fail("symbol " + name + " is already defined");
+	}
+	symbolIdx[name] = mod->symbols.size();
+	ObjSymbol sym;
+	sym.name = name;
+	sym.section = section;
+	sym.offset = code().size();
+	sym.global = false;
+	mod->symbols.push_back(sym);
+}
+
+static std::string unescape(Span lit, bool& ok){
+	std::string res;
+	ok = lit.size() >= 2 && lit[0] == '"' && lit.back() == '"';
+	for (size_t i = 1; ok && i + 1 < lit.size(); i++){
+		char c = lit[i];
+		if (c != '\\'){
+			res += c;
+			continue;
+		}
+		i++;
+		if (i + 1 >= lit.size()){ ok = false; break; }
+		switch (lit[i]){
+			case 'n': res += '\n'; break;
+			case 't': res += '\t'; break;
+			case '"': res += '"'; break;
+			case '\\': res += '\\'; break;
+			case '0': res += '\0'; break;
+			default: ok = false;
+		}
+	}
+	return res;
+}
+
+void Assembler::directive(Span name, Span args){
+	if (name == ".text"){
+		section = ObjModule::TEXT;
+	} else if (name == ".data"){
+		section = ObjModule::DATA;
+	} else if (name == ".globl" || name == ".global"){
+		globals.insert(args.trim().str());
+	} else if (name == ".asciz" || name == ".string"){
+		bool ok;
+		std::string str = unescape(args.trim(), ok);
+		if (!ok){ fail("bad string"); }
+		for (char c : str){ byte(c); }
+		byte(0);
+	} else if (name == ".quad" || name == ".byte"){
+		size_t width = name == ".quad" ? 8 : 1;
+		std::string symbol;
+		int64_t val = expression(args, symbol);
+		if (!symbol.empty()){
+			if (width != 8){ fail("symbol too wide for .byte"); }
+			reloc(R_X86_64_64, symbol, val);
+			val = 0;
+		}
+		imm(val, width);
+	} else if (name == ".space" || name == ".zero"){
+		std::string symbol;
+		int64_t val = expression(args, symbol);
+		if (!symbol.empty() || val < 0){ fail("bad size"); }
+		code().resize(code().size() + static_cast<size_t>(val), 0);
+	} else if (name == ".align" || name == ".p2align"){
+		std::string symbol;
+		int64_t val = expression(args, symbol);
+		if (name == ".p2align"){ val = 1LL << val; }
+		if (!symbol.empty() || val <= 0){ fail("bad alignment"); }
+		size_t align = static_cast<size_t>(val);
+		int fill = section == ObjModule::TEXT ? 0x90 : 0;
+		while (code().size() % align != 0){ byte(fill); }
+		if (align > mod->sections[section].align){
+			mod->sections[section].align = align;
+		}
+	} else {
+		fail("unsupported directive " + name.str());
+	}
+}
+
+void Assembler::statement(Span stmt){
+	stmt = stmt.trim();
+	//Leading labels
+	while (!stmt.empty()){
+		size_t pos = 0;
+		if (!isSymbolChar(stmt[0], true)){ break; }
+		while (pos < stmt.size() && isSymbolChar(stmt[pos], false)){ pos++; }
+		if (pos >= stmt.size() || stmt[pos] != ':'){ break; }
+		define(stmt.upTo(pos));
+		stmt = stmt.from(pos + 1).trim();
+	}
+	if (stmt.empty()){ return; }
+
+	size_t space = 0;
+	while (space < stmt.size() && stmt[space] != ' ' && stmt[space] != '\t'){
+		space++;
+	}
+	Span name = stmt.upTo(space);
+	Span rest = stmt.from(space);
+	if (name[0] == '.'){
+		directive(name, rest);
+		return;
+	}
+
+	//Split the operands at top-level commas, reusing the
+	// operands from the last instruction
+	size_t numOps = 0;
+	int depth = 0;
+	const char * start = rest.begin;
+	for (const char * c = rest.begin; c <= rest.end; c++){
+		bool last = c == rest.end;
+		if (!last && *c == '('){ depth++; }
+		if (!last && *c == ')'){ depth--; }
+		if (!last && (*c != ',' || depth != 0)){ continue; }
+		Span text = Span(start, c);
+		start = c + 1;
+		if (last && numOps == 0 && text.trim().empty()){ break; }
+		if (numOps == ops.size()){ ops.push_back(Operand()); }
+		operand(text, ops[numOps++]);
+	}
+	ops.resize(numOps);
+	instruction(name.str(), ops);
+}
+
+ObjModule * Assembler::run(const std::string& text){
+	const char * pos = text.c_str();
+	const char * textEnd = pos + text.size();
+	while (pos < textEnd){
+		const char * eol = pos;
+		while (eol < textEnd && *eol != '\n'){ eol++; }
+		line = Span(pos, eol);
+
+		//Split into statements on ; and drop # comments,
+		// except inside string literals
+		const char * stmt = pos;
+		bool inString = false;
+		const char * c = pos;
+		for (; c < eol; c++){
+			if (inString){
+				if (*c == '\\' && c + 1 < eol){ c++; }
+				else if (*c == '"'){ inString = false; }
+			} else if (*c == '"'){
+				inString = true;
+			} else if (*c == '#'){
+				break;
+			} else if (*c == ';'){
+				statement(Span(stmt, c));
+				stmt = c + 1;
+			}
+		}
+		statement(Span(stmt, c));
+		pos = eol + 1;
+	}
+	line = Span();
+
+	//Resolve branches: to labels in the same section directly,
+	// and to anything else through a relocation
+	for (const Fixup& fix : fixups){
+		std::vector<unsigned char>& bytes = mod->sections[fix.section].bytes;
+		const ObjSymbol * target = lookup(fix.label);
+		if (target != nullptr && target->section == fix.section
+		  && !globals.count(fix.label)){
+			int64_t rel = static_cast<int64_t>(target->offset) + fix.addend
+			  - static_cast<int64_t>(fix.offset + 4);
+			for (size_t i = 0; i < 4; i++){
+				bytes[fix.offset + i] = static_cast<unsigned char>(
+				  (static_cast<uint64_t>(rel) >> (8 * i)) & 0xff);
+			}
+			continue;
+		}
+		ObjReloc rel;
+		rel.offset = fix.offset;
+		rel.type = target == nullptr ? R_X86_64_PLT32 : R_X86_64_PC32;
+		rel.symbol = fix.label;
+		rel.addend = fix.addend - 4;
+		mod->sections[fix.section].relocs.push_back(rel);
+		referenced.insert(fix.label);
+	}
+
+	for (ObjSymbol& sym : mod->symbols){
+		if (globals.count(sym.name)){ sym.global = true; }
+	}
+	std::set<std::string> undefined = referenced;
+	undefined.insert(globals.begin(), globals.end());
+	for (const std::string& name : undefined){
+		if (lookup(name) != nullptr){ continue; }
+		ObjSymbol sym;
+		sym.name = name;
+		sym.section = ObjSymbol::UNDEFINED;
+		sym.offset = 0;
+		sym.global = true;
+		mod->symbols.push_back(sym);
+	}
+	return mod;
+}
+
+}
+
+ObjModule * assembleX64(const std::string& text){
+	Assembler assembler;
+	return assembler.run(text);
+}
+
+}
@@ -0,0 +1,18 @@
+#ifndef DREWGON_X64_ASSEMBLER_HPP
+#define DREWGON_X64_ASSEMBLER_HPP
+
+#include <string>
+#include "obj_module.hpp"
+
+namespace drewgon{
+
+// Assemble the AT&T-syntax x64 that IRProgram::toX64 emits into
+// an ObjModule. Only the instructions and directives the back
+// end uses are supported; anything else, or anything that gas
+// would reject (such as mismatched operand sizes), is reported
+// by throwing an InternalError that names the offending line.
+ObjModule * assembleX64(const std::string& text);
+
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include <ostream>
+#include <sstream>
 #include <stdlib.h>
 #include "3ac.hpp"
+#include "timing.hpp"
 
 namespace drewgon{
 
@@ -24,13 +26,14 @@ void IRProgram::datagenX64(std::ostream& out){
 	out << ".globl main \n";
 	out << ".data \n";
 	
-	int i = 0;
-	for (auto cur : strings)
+	for (auto proc : *this->procs)
 	{
-		out << "str_" << i << ":";
-		out << "\t.asciz " << cur.second <<";\n";
-		cur.first->setIsString();
-		i++;
+		for (auto cur : proc->getStrings())
+		{
+			out << cur.first->valString() << ":";
+			out << "\t.asciz " << cur.second <<";\n";
+			cur.first->setIsString();
+		}
 	}
 
 	for (auto g: globals)
@@ -41,7 +44,14 @@ void IRProgram::datagenX64(std::ostream& out){
 		memLoc += sym->getName();
 		size_t width = sym->getDataType()->getSize();
 		out << memLoc << ": ";
-		if (width == 8)
+		if (sym->getKind() == FN)
+		{
+			//A function's global holds its address, for
+			// calls through variables of function type
+			std::string name = sym->getName();
+			out << ".quad " << (name == "main" ? name : "fun_" + name) << "\n";
+		}
+		else if (width == 8)
 		{
 			out << ".quad 0 \n";
 		}
@@ -65,7 +75,17 @@ void IRProgram::toX64(std::ostream& out){
 	out << ".text\n";
 	for (auto proc: *this->procs)
 	{
-		proc->toX64(out);
+		if (cache != nullptr && !proc->isCached())
+		{
+			std::ostringstream code;
+			proc->toX64(code);
+			out << code.str();
+			cache->store(proc->getCacheKey(), proc->toCached(code.str()));
+		}
+		else
+		{
+			proc->toX64(out);
+		}
 		out << "\n";
 		
 	}
@@ -100,6 +120,11 @@ void Procedure::allocLocals(){
 }
 
 void Procedure::toX64(std::ostream& out){
+	PhaseTimer timer("function", myName);
+	if (cached != nullptr){
+		out << cached->x64;
+		return;
+	}
 	//Allocate all locals
 	allocLocals();
 
@@ -108,7 +133,9 @@ void Procedure::toX64(std::ostream& out){
 	out << "#Fn body " << myName << "\n";
 	for (auto quad : *bodyQuads){
 		quad->codegenLabels(out);
-		out << "#" << quad->toString() << "\n";
+		out << "#";
+		quad->print(out);
+		out << "\n";
 		quad->codegenX64(out);
 	}
 	out << "#Fn epilogue " << myName << "\n";
@@ -150,10 +177,11 @@ void BinOpQuad::codegenX64(std::ostream& out){
 	}
 	else if(op == DIV64)
 	{
-		src1->genLoadVal(out, D);
-		src2->genLoadVal(out, A);
-		out << "movq $0, %rdx\nidivq %rbx\nmovq %rax, %rbx\n";
-		dst->genStoreVal(out, B);
+		//Sign-extend the dividend into rdx:rax
+		src1->genLoadVal(out, A);
+		src2->genLoadVal(out, B);
+		out << "cqto\nidivq %rbx\n";
+		dst->genStoreVal(out, A);
 	}
 	else if(op == MULT64)
 	{
@@ -169,6 +197,7 @@ void BinOpQuad::codegenX64(std::ostream& out){
 		src2->genLoadVal(out, B);
 		out << "cmpq " << "%rbx, " << "%rax\n";
 		out << "sete " << "%al\n" ;
+		out << "movzbq %al, %rax\n";
 		dst->genStoreVal(out, A);
 
 	}
@@ -178,6 +207,7 @@ void BinOpQuad::codegenX64(std::ostream& out){
 		src2->genLoadVal(out, B);
 		out << "cmpq " << "%rbx, " << "%rax\n";
 		out << "setne " << "%al\n" ;
+		out << "movzbq %al, %rax\n";
 		dst->genStoreVal(out, A);
 
 	}
@@ -187,6 +217,7 @@ void BinOpQuad::codegenX64(std::ostream& out){
 		src2->genLoadVal(out, B);
 		out << "cmpq " << "%rbx, " << "%rax\n";
 		out << "setl " << "%al\n" ;
+		out << "movzbq %al, %rax\n";
 		dst->genStoreVal(out, A);
 
 	}
@@ -196,6 +227,7 @@ void BinOpQuad::codegenX64(std::ostream& out){
 		src2->genLoadVal(out, B);
 		out << "cmpq " << "%rbx, " << "%rax\n";
 		out << "setg " << "%al\n" ;
+		out << "movzbq %al, %rax\n";
 		dst->genStoreVal(out, A);
 
 	}
@@ -205,6 +237,7 @@ void BinOpQuad::codegenX64(std::ostream& out){
 		src2->genLoadVal(out, B);
 		out << "cmpq " << "%rbx, " << "%rax\n";
 		out << "setle " << "%al\n" ;
+		out << "movzbq %al, %rax\n";
 		dst->genStoreVal(out, A);
 
 	}
@@ -215,6 +248,7 @@ void BinOpQuad::codegenX64(std::ostream& out){
 		src2->genLoadVal(out, B);
 		out << "cmpq " << "%rbx, " << "%rax\n";
 		out << "setge " << "%al\n";
+		out << "movzbq %al, %rax\n";
 		dst->genStoreVal(out, A);
 
 	}
@@ -232,7 +266,7 @@ void BinOpQuad::codegenX64(std::ostream& out){
 	{
 		src1->genLoadVal(out, A);
 		src2->genLoadVal(out, B);
-		out << "orq " << "%rax, " << "%rax\n" ;
+		out << "orq " << "%rbx, " << "%rax\n" ;
 		dst->genStoreVal(out, A);
 
 	}
@@ -351,7 +385,8 @@ void UnaryOpQuad::codegenX64(std::ostream& out){
 	src->genLoadVal(out, A);
 	if(op == NOT64) {
 		out << "cmpq $0, %rax\n"
-			<< "setz %al\n";
+			<< "setz %al\n"
+			<< "movzbq %al, %rax\n";
 	} else if (op == NEG64) {
 		out << "negq %rax\n";
 	}
@@ -394,34 +429,48 @@ void IntrinsicOutputQuad::codegenX64(std::ostream& out){
 	if(myArg->getIsString()){
 		out << "callq printString\n";
 	}
-	if (myArg->getWidth() == 8){
-		out << "callq printInt\n";
+	else if (myType->isBool()){
+		//A byte-wide bool only sets the low byte of the register
+		if (myArg->getWidth() == 1){
+			out << "movzbq %dil, %rdi\n";
+		}
+		out << "callq printBool\n";
 	}
 	else{
-		out << "callq printByte\n";
+		out << "callq printInt\n";
 	}
 }
 
 void IntrinsicInputQuad::codegenX64(std::ostream& out){
-	myArg->genStoreVal(out, DI);
-	if (myArg->getWidth() == 8)
-	out << "callq writeInt\n";
-	else if (myArg->getWidth() == 1)
-	out << "callq writeByte\n";
-	else
-	out << "callq writeString";
+	if (myType->isBool()){
+		out << "callq getBool\n";
+	}
+	else{
+		out << "callq getInt\n";
+	}
+	myArg->genStoreVal(out, A);
 }
 
 void CallQuad::codegenX64(std::ostream& out){
-	if(callee->getDataType()->asFn())
+	if(ptr != nullptr)
 	{
-		out << "movq " << "(%rbp), %rax\n";
-		out << "callq " << "*rax" << "\n"; 
+		//A call through a variable of function type
+		ptr->genLoadVal(out, A);
+		out << "callq " << "*%rax" << "\n";
+	}
+	else if(callee->getName() == "main"){
+		out << "callq main\n";
 	}
 	else{
 		out << "callq " << "fun_" << callee->getName() << "\n";
 	}
-	
+
+	//Pop the arguments that SetArgQuad pushed
+	size_t numArgs = callee->getDataType()->asFn()->getFormalTypes()
+	  ->getTypes()->size();
+	if (numArgs > 6){
+		out << "addq $" << 8 * (numArgs - 6) << ", %rsp\n";
+	}
 }
 
 void EnterQuad::codegenX64(std::ostream& out){
@@ -458,7 +507,26 @@ void SetArgQuad::codegenX64(std::ostream& out){
 }
 
 void GetArgQuad::codegenX64(std::ostream& out){
-	//We don't actually need to do anything here
+	//Copy the argument out of the register it was passed in
+	if (index == 1)
+		opd->genStoreVal(out, DI);
+	else if (index == 2)
+		opd->genStoreVal(out, SI);
+	else if (index == 3)
+		opd->genStoreVal(out, D);
+	else if (index == 4)
+		opd->genStoreVal(out, C);
+	else if (index == 5)
+		opd->genStoreVal(out, E);
+	else if (index == 6)
+		opd->genStoreVal(out, F);
+	else
+	{
+		//The caller pushed the rest in order, so the last is
+		// nearest the return address
+		out << "movq " << 8 * (numArgs - index) << "(%rbp), %rax\n";
+		opd->genStoreVal(out, A);
+	}
 }
 
 void SetRetQuad::codegenX64(std::ostream& out){